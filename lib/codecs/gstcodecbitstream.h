@@ -0,0 +1,55 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Memory provided by the application for the slices of a picture, so they
+ * are written where they are consumed, e.g. a mapped GPU upload buffer.
+ * alloc() returns at least @size bytes, and their actual size in
+ * @allocated, or NULL if the decoder has to use its own memory. Memory not
+ * handed to the application along with its picture is given back through
+ * release(). */
+typedef struct
+{
+  guint8 * (*alloc) (gpointer user_data, gsize size, gsize * allocated);
+  void (*release) (gpointer user_data, guint8 * data);
+  gpointer user_data;
+} GstCodecBitstreamAllocator;
+
+/* A slice NAL unit, without start code */
+typedef struct
+{
+  const guint8 *data;
+  gsize size;
+} GstCodecSliceSegment;
+
+/* Receives the slices of a picture by reference, instead of copied, right
+ * before the picture is handed to the application. @picture is the
+ * decoder's picture description. The slices point into the input buffers,
+ * which are kept until the picture is released. */
+typedef struct
+{
+  void (*func) (gpointer user_data, gconstpointer picture,
+      const GstCodecSliceSegment * segments, guint n_segments);
+  gpointer user_data;
+} GstCodecSliceSegmentsCallback;
+
+G_END_DECLS
@@ -0,0 +1,89 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Set of DPB slots, slot i being bit i. The DPBs keep one per picture
+ * state, e.g. "short term reference" or "needed for output", so their
+ * queries test and count bits instead of visiting every picture. */
+typedef guint64 GstCodecDpbMask;
+
+#define GST_CODEC_DPB_MASK_SIZE 64
+#define GST_CODEC_DPB_MASK_BIT(i) (G_GUINT64_CONSTANT (1) << (i))
+/* slots lower than @i */
+#define GST_CODEC_DPB_MASK_BELOW(i) (GST_CODEC_DPB_MASK_BIT (i) - 1)
+
+static inline void
+gst_codec_dpb_mask_set (GstCodecDpbMask * mask, guint i, gboolean value)
+{
+  if (value)
+    *mask |= GST_CODEC_DPB_MASK_BIT (i);
+  else
+    *mask &= ~GST_CODEC_DPB_MASK_BIT (i);
+}
+
+/* Returns the lowest slot in @mask, or -1 if it's empty. */
+static inline gint
+gst_codec_dpb_mask_first (GstCodecDpbMask mask)
+{
+#if defined(__GNUC__)
+  return mask ? __builtin_ctzll (mask) : -1;
+#else
+  gint i;
+
+  for (i = 0; i < GST_CODEC_DPB_MASK_SIZE; i++) {
+    if (mask & GST_CODEC_DPB_MASK_BIT (i))
+      return i;
+  }
+  return -1;
+#endif
+}
+
+static inline guint
+gst_codec_dpb_mask_count (GstCodecDpbMask mask)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll (mask);
+#else
+  mask = mask - ((mask >> 1) & G_GUINT64_CONSTANT (0x5555555555555555));
+  mask = (mask & G_GUINT64_CONSTANT (0x3333333333333333))
+      + ((mask >> 2) & G_GUINT64_CONSTANT (0x3333333333333333));
+  mask = (mask + (mask >> 4)) & G_GUINT64_CONSTANT (0x0f0f0f0f0f0f0f0f);
+  return (mask * G_GUINT64_CONSTANT (0x0101010101010101)) >> 56;
+#endif
+}
+
+/* Drops slot @i, moving the higher ones down by one, as removing the
+ * picture at @i from the DPB does. */
+static inline GstCodecDpbMask
+gst_codec_dpb_mask_remove (GstCodecDpbMask mask, guint i)
+{
+  GstCodecDpbMask below = GST_CODEC_DPB_MASK_BELOW (i);
+
+  return (mask & below) | ((mask >> 1) & ~below);
+}
+
+/* Iterates over the slots of @mask in increasing order. @mask is consumed. */
+#define GST_CODEC_DPB_MASK_FOREACH(i, mask) \
+  for (; ((i) = gst_codec_dpb_mask_first (mask)) >= 0; \
+      (mask) &= (mask) - 1)
+
+G_END_DECLS
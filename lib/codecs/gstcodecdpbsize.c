@@ -0,0 +1,164 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstcodecdpbsize.h"
+#include "gsth264picture.h"
+
+#if !GST_CHECK_VERSION(1,23,0)
+typedef enum
+{
+  GST_H264_LEVEL_L1 = 10,
+  GST_H264_LEVEL_L1B = 9,
+  GST_H264_LEVEL_L1_1 = 11,
+  GST_H264_LEVEL_L1_2 = 12,
+  GST_H264_LEVEL_L1_3 = 13,
+  GST_H264_LEVEL_L2 = 20,
+  GST_H264_LEVEL_L2_1 = 21,
+  GST_H264_LEVEL_L2_2 = 22,
+  GST_H264_LEVEL_L3 = 30,
+  GST_H264_LEVEL_L3_1 = 31,
+  GST_H264_LEVEL_L3_2 = 32,
+  GST_H264_LEVEL_L4 = 40,
+  GST_H264_LEVEL_L4_1 = 41,
+  GST_H264_LEVEL_L4_2 = 42,
+  GST_H264_LEVEL_L5 = 50,
+  GST_H264_LEVEL_L5_1 = 51,
+  GST_H264_LEVEL_L5_2 = 52,
+  GST_H264_LEVEL_L6 = 60,
+  GST_H264_LEVEL_L6_1 = 61,
+  GST_H264_LEVEL_L6_2 = 62,
+} GstH264Level;
+#endif
+
+typedef struct
+{
+  GstH264Level level;
+
+  guint32 max_mbps;
+  guint32 max_fs;
+  guint32 max_dpb_mbs;
+  guint32 max_main_br;
+} LevelLimits;
+
+static const LevelLimits level_limits_map[] = {
+  {GST_H264_LEVEL_L1, 1485, 99, 396, 64},
+  {GST_H264_LEVEL_L1B, 1485, 99, 396, 128},
+  {GST_H264_LEVEL_L1_1, 3000, 396, 900, 192},
+  {GST_H264_LEVEL_L1_2, 6000, 396, 2376, 384},
+  {GST_H264_LEVEL_L1_3, 11800, 396, 2376, 768},
+  {GST_H264_LEVEL_L2, 11880, 396, 2376, 2000},
+  {GST_H264_LEVEL_L2_1, 19800, 792, 4752, 4000},
+  {GST_H264_LEVEL_L2_2, 20250, 1620, 8100, 4000},
+  {GST_H264_LEVEL_L3, 40500, 1620, 8100, 10000},
+  {GST_H264_LEVEL_L3_1, 108000, 3600, 18000, 14000},
+  {GST_H264_LEVEL_L3_2, 216000, 5120, 20480, 20000},
+  {GST_H264_LEVEL_L4, 245760, 8192, 32768, 20000},
+  {GST_H264_LEVEL_L4_1, 245760, 8192, 32768, 50000},
+  {GST_H264_LEVEL_L4_2, 522240, 8704, 34816, 50000},
+  {GST_H264_LEVEL_L5, 589824, 22080, 110400, 135000},
+  {GST_H264_LEVEL_L5_1, 983040, 36864, 184320, 240000},
+  {GST_H264_LEVEL_L5_2, 2073600, 36864, 184320, 240000},
+  {GST_H264_LEVEL_L6, 4177920, 139264, 696320, 240000},
+  {GST_H264_LEVEL_L6_1, 8355840, 139264, 696320, 480000},
+  {GST_H264_LEVEL_L6_2, 16711680, 139264, 696320, 800000}
+};
+
+static gint
+h264_level_to_max_dpb_mbs (GstH264Level level)
+{
+  gint i;
+  for (i = 0; i < G_N_ELEMENTS (level_limits_map); i++) {
+    if (level == level_limits_map[i].level)
+      return level_limits_map[i].max_dpb_mbs;
+  }
+
+  return 0;
+}
+
+gint
+gst_codec_h264_get_max_dpb_size (const GstH264SPS * sps)
+{
+  guint8 level;
+  gint max_dpb_mbs;
+  gint width_mb, height_mb;
+  gint max_dpb_frames;
+  gint max_dpb_size;
+
+  /* Spec A.3.1 and A.3.2
+   * For Baseline, Constrained Baseline and Main profile, the indicated level is
+   * Level 1b if level_idc is equal to 11 and constraint_set3_flag is equal to 1
+   */
+  level = sps->level_idc;
+  if (level == 11 && (sps->profile_idc == 66 || sps->profile_idc == 77) &&
+      sps->constraint_set3_flag) {
+    /* Level 1b */
+    level = 9;
+  }
+
+  max_dpb_mbs = h264_level_to_max_dpb_mbs ((GstH264Level) level);
+  if (!max_dpb_mbs)
+    return 0;
+
+  width_mb = sps->width / 16;
+  height_mb = sps->height / 16;
+
+  max_dpb_frames = MIN (max_dpb_mbs / (width_mb * height_mb),
+      GST_H264_DPB_MAX_SIZE);
+
+  if (sps->vui_parameters_present_flag
+      && sps->vui_parameters.bitstream_restriction_flag)
+    max_dpb_frames = MAX (1, sps->vui_parameters.max_dec_frame_buffering);
+
+  /* Case 1) There might be some non-conforming streams that require more DPB
+   * size than that of specified one by SPS
+   * Case 2) If bitstream_restriction_flag is not present,
+   * max_dec_frame_buffering should be inferred
+   * to be equal to MaxDpbFrames, then MaxDpbFrames can exceed num_ref_frames
+   * See https://chromium-review.googlesource.com/c/chromium/src/+/760276/
+   */
+  max_dpb_size = MAX (max_dpb_frames, sps->num_ref_frames);
+  if (max_dpb_size > GST_H264_DPB_MAX_SIZE) {
+    GST_WARNING ("Too large calculated DPB size %d", max_dpb_size);
+    max_dpb_size = GST_H264_DPB_MAX_SIZE;
+  }
+
+  return max_dpb_size;
+}
+
+gint
+gst_codec_h265_get_max_dpb_size (const GstH265SPS * sps)
+{
+  gint max_dpb_size;
+  gint MaxLumaPS;
+  const gint MaxDpbPicBuf = 6;
+  gint PicSizeInSamplesY;
+
+  /* A.4.1 */
+  MaxLumaPS = 35651584;
+  PicSizeInSamplesY = sps->width * sps->height;
+  if (PicSizeInSamplesY <= (MaxLumaPS >> 2))
+    max_dpb_size = MaxDpbPicBuf * 4;
+  else if (PicSizeInSamplesY <= (MaxLumaPS >> 1))
+    max_dpb_size = MaxDpbPicBuf * 2;
+  else if (PicSizeInSamplesY <= ((3 * MaxLumaPS) >> 2))
+    max_dpb_size = (MaxDpbPicBuf * 4) / 3;
+  else
+    max_dpb_size = MaxDpbPicBuf;
+
+  return MIN (max_dpb_size, 16);
+}
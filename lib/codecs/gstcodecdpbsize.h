@@ -0,0 +1,37 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <gst/gst.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+
+G_BEGIN_DECLS
+
+/* DPB sizes of a sequence, as the decoders allocate them, computed from its
+ * SPS alone. Neither needs a decoder instance nor registers a type, so they
+ * can be used before any element exists. */
+
+/* In frames, or 0 if the level of @sps is unknown. */
+gint gst_codec_h264_get_max_dpb_size (const GstH264SPS * sps);
+
+/* In pictures. */
+gint gst_codec_h265_get_max_dpb_size (const GstH265SPS * sps);
+
+G_END_DECLS
@@ -0,0 +1,44 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Sent right before a buffer which ends an access unit, so a decoder
+ * framing unaligned byte-stream input can finish the access unit with that
+ * buffer instead of waiting for the start of the next one. Decoders
+ * receiving aligned input ignore it. */
+#define GST_CODEC_EVENT_AU_END "GstCodecAUEnd"
+
+static inline GstEvent *
+gst_codec_event_new_au_end (void)
+{
+  return gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM,
+      gst_structure_new_empty (GST_CODEC_EVENT_AU_END));
+}
+
+static inline gboolean
+gst_codec_event_is_au_end (GstEvent * event)
+{
+  return GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM
+      && gst_event_has_name (event, GST_CODEC_EVENT_AU_END);
+}
+
+G_END_DECLS
@@ -0,0 +1,664 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstcodecindex.h"
+#include "gststartcode.h"
+
+#include <string.h>
+
+#define INDEX_MAGIC "VKIX"
+#define INDEX_VERSION 2
+#define HEADER_SIZE 24
+#define ENTRY_SIZE 28
+#define PARAM_SET_SIZE 16
+
+#define N_PARAM_SET_TYPES (GST_CODEC_INDEX_PPS + 1)
+#define MAX_IDS 256
+
+struct _GstCodecIndex
+{
+  GstCodecIndexCodec codec;
+  GArray *entries;
+  /* only when their content changes, in stream order */
+  GArray *param_sets;
+  guint32 n_frames;
+
+  /* scanning state */
+  guint64 offset;
+  gint64 au_start;
+  gboolean first_au;
+  gint64 pts;
+  guint64 hashes[N_PARAM_SET_TYPES][MAX_IDS];
+  guint16 pps_sps[MAX_IDS];
+  guint16 sps_vps[MAX_IDS];
+};
+
+/* Reads the first bits of a NAL unit payload, removing the emulation
+ * prevention bytes. */
+typedef struct
+{
+  const guint8 *data;
+  gsize size;
+  gsize pos;
+  guint zeros;
+  guint8 cur;
+  guint bits_left;
+} NalReader;
+
+static void
+nal_reader_init (NalReader * r, const guint8 * data, gsize size)
+{
+  r->data = data;
+  r->size = size;
+  r->pos = 0;
+  r->zeros = 0;
+  r->cur = 0;
+  r->bits_left = 0;
+}
+
+static gboolean
+nal_reader_read_bits (NalReader * r, guint n, guint32 * val)
+{
+  guint32 v = 0;
+
+  while (n--) {
+    if (r->bits_left == 0) {
+      if (r->pos < r->size && r->zeros >= 2 && r->data[r->pos] == 0x03) {
+        r->pos++;
+        r->zeros = 0;
+      }
+      if (r->pos >= r->size)
+        return FALSE;
+      r->cur = r->data[r->pos++];
+      r->zeros = r->cur ? 0 : r->zeros + 1;
+      r->bits_left = 8;
+    }
+    r->bits_left--;
+    v = (v << 1) | ((r->cur >> r->bits_left) & 1);
+  }
+
+  *val = v;
+  return TRUE;
+}
+
+static gboolean
+nal_reader_skip (NalReader * r, guint n)
+{
+  guint32 v;
+
+  while (n > 0) {
+    guint count = MIN (n, 32);
+
+    if (!nal_reader_read_bits (r, count, &v))
+      return FALSE;
+    n -= count;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+nal_reader_read_ue (NalReader * r, guint32 * val)
+{
+  guint leading = 0;
+  guint32 bit, suffix;
+
+  for (;;) {
+    if (!nal_reader_read_bits (r, 1, &bit))
+      return FALSE;
+    if (bit)
+      break;
+    if (++leading == 32)
+      return FALSE;
+  }
+
+  if (!nal_reader_read_bits (r, leading, &suffix))
+    return FALSE;
+
+  *val = (1u << leading) - 1 + suffix;
+  return TRUE;
+}
+
+/* an id which fits the tables */
+static gboolean
+nal_reader_read_id (NalReader * r, guint16 * id)
+{
+  guint32 val;
+
+  if (!nal_reader_read_ue (r, &val) || val >= MAX_IDS)
+    return FALSE;
+
+  *id = val;
+  return TRUE;
+}
+
+/* FNV-1a, 64 bits */
+static guint64
+hash_bytes (const guint8 * data, gsize size)
+{
+  guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * G_GUINT64_CONSTANT (1099511628211);
+
+  return hash;
+}
+
+GstCodecIndex *
+gst_codec_index_new (GstCodecIndexCodec codec)
+{
+  GstCodecIndex *index = g_new0 (GstCodecIndex, 1);
+  guint i;
+
+  index->codec = codec;
+  index->entries = g_array_new (FALSE, FALSE, sizeof (GstCodecIndexEntry));
+  index->param_sets =
+      g_array_new (FALSE, FALSE, sizeof (GstCodecIndexParamSet));
+  index->au_start = -1;
+  index->first_au = TRUE;
+  index->pts = -1;
+  for (i = 0; i < MAX_IDS; i++) {
+    index->pps_sps[i] = GST_CODEC_INDEX_NO_ID;
+    index->sps_vps[i] = GST_CODEC_INDEX_NO_ID;
+  }
+
+  return index;
+}
+
+void
+gst_codec_index_free (GstCodecIndex * index)
+{
+  if (!index)
+    return;
+
+  g_array_unref (index->entries);
+  g_array_unref (index->param_sets);
+  g_free (index);
+}
+
+static void
+add_param_set (GstCodecIndex * index, GstCodecIndexParamSetType type,
+    guint16 id, const guint8 * nal, gsize size, guint64 offset)
+{
+  GstCodecIndexParamSet ps;
+  /* 0 is kept for ids never seen */
+  guint64 hash = hash_bytes (nal, size) | 1;
+
+  if (index->hashes[type][id] == hash)
+    return;
+
+  index->hashes[type][id] = hash;
+
+  ps.offset = offset;
+  ps.size = size;
+  ps.type = type;
+  ps.id = id;
+  g_array_append_val (index->param_sets, ps);
+}
+
+static void
+add_access_unit (GstCodecIndex * index, guint64 offset, guint8 nal_type,
+    gboolean keyframe, guint16 pps_id)
+{
+  GstCodecIndexEntry entry;
+
+  if (keyframe) {
+    entry.offset = index->au_start >= 0 ? (guint64) index->au_start : offset;
+    entry.pts = index->first_au ? index->pts : -1;
+    entry.frame = index->n_frames;
+    entry.nal_type = nal_type;
+    entry.pps_id = pps_id;
+    entry.sps_id = pps_id != GST_CODEC_INDEX_NO_ID ?
+        index->pps_sps[pps_id] : GST_CODEC_INDEX_NO_ID;
+    entry.vps_id = entry.sps_id != GST_CODEC_INDEX_NO_ID ?
+        index->sps_vps[entry.sps_id] : GST_CODEC_INDEX_NO_ID;
+    g_array_append_val (index->entries, entry);
+  }
+
+  index->n_frames++;
+  index->first_au = FALSE;
+  index->au_start = -1;
+}
+
+/* A new access unit begins with the first of these after a slice. The
+ * prefix NAL units are left out: they precede every slice of the base
+ * layer, not only the first. */
+static inline gboolean
+h264_starts_access_unit (guint8 type)
+{
+  return (type >= 6 && type <= 9) || (type >= 15 && type <= 18);
+}
+
+static void
+h264_index_nal (GstCodecIndex * index, const guint8 * nal, gsize size,
+    guint64 offset)
+{
+  guint8 type = nal[0] & 0x1f;
+  NalReader r;
+  guint16 id, sps_id;
+  guint32 val;
+
+  nal_reader_init (&r, nal + 1, size - 1);
+
+  if (type >= 1 && type <= 5) {
+    /* first_mb_in_slice == 0 starts a picture */
+    if (!nal_reader_read_ue (&r, &val) || val != 0)
+      return;
+    if (!nal_reader_read_ue (&r, &val) || !nal_reader_read_id (&r, &id))
+      id = GST_CODEC_INDEX_NO_ID;
+    add_access_unit (index, offset, type, type == 5, id);
+    return;
+  }
+
+  if (!h264_starts_access_unit (type))
+    return;
+
+  if (index->au_start < 0)
+    index->au_start = offset;
+
+  if (type == 7) {
+    /* profile_idc, constraint flags, level_idc */
+    if (nal_reader_skip (&r, 24) && nal_reader_read_id (&r, &id))
+      add_param_set (index, GST_CODEC_INDEX_SPS, id, nal, size, offset + 3);
+  } else if (type == 8) {
+    if (nal_reader_read_id (&r, &id) && nal_reader_read_id (&r, &sps_id)) {
+      index->pps_sps[id] = sps_id;
+      add_param_set (index, GST_CODEC_INDEX_PPS, id, nal, size, offset + 3);
+    }
+  }
+}
+
+static gboolean
+h265_skip_profile_tier_level (NalReader * r, guint max_sub_layers_minus1)
+{
+  guint32 profile_present = 0, level_present = 0, flag;
+  guint i;
+
+  /* general profile, tier and level */
+  if (!nal_reader_skip (r, 96))
+    return FALSE;
+
+  for (i = 0; i < max_sub_layers_minus1; i++) {
+    if (!nal_reader_read_bits (r, 1, &flag))
+      return FALSE;
+    profile_present |= flag << i;
+    if (!nal_reader_read_bits (r, 1, &flag))
+      return FALSE;
+    level_present |= flag << i;
+  }
+
+  if (max_sub_layers_minus1 > 0
+      && !nal_reader_skip (r, 2 * (8 - max_sub_layers_minus1)))
+    return FALSE;
+
+  for (i = 0; i < max_sub_layers_minus1; i++) {
+    if ((profile_present & (1 << i)) && !nal_reader_skip (r, 88))
+      return FALSE;
+    if ((level_present & (1 << i)) && !nal_reader_skip (r, 8))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* A new access unit begins with the first of these after a slice. */
+static inline gboolean
+h265_starts_access_unit (guint8 type)
+{
+  return (type >= 32 && type <= 35) || type == 39 || (type >= 41
+      && type <= 44) || (type >= 48 && type <= 55);
+}
+
+static void
+h265_index_nal (GstCodecIndex * index, const guint8 * nal, gsize size,
+    guint64 offset)
+{
+  guint8 type = (nal[0] >> 1) & 0x3f;
+  NalReader r;
+  guint16 id, sps_id;
+  guint32 val;
+
+  if (size < 2)
+    return;
+
+  nal_reader_init (&r, nal + 2, size - 2);
+
+  if (type < 32) {
+    gboolean irap = type >= 16 && type <= 23;
+
+    /* first_slice_segment_in_pic_flag */
+    if (!nal_reader_read_bits (&r, 1, &val) || !val)
+      return;
+    /* no_output_of_prior_pics_flag */
+    if ((irap && !nal_reader_skip (&r, 1)) || !nal_reader_read_id (&r, &id))
+      id = GST_CODEC_INDEX_NO_ID;
+    add_access_unit (index, offset, type, irap, id);
+    return;
+  }
+
+  if (!h265_starts_access_unit (type))
+    return;
+
+  if (index->au_start < 0)
+    index->au_start = offset;
+
+  if (type == 32) {
+    if (nal_reader_read_bits (&r, 4, &val))
+      add_param_set (index, GST_CODEC_INDEX_VPS, val, nal, size, offset + 3);
+  } else if (type == 33) {
+    guint32 vps_id, max_sub_layers_minus1;
+
+    if (nal_reader_read_bits (&r, 4, &vps_id)
+        && nal_reader_read_bits (&r, 3, &max_sub_layers_minus1)
+        && nal_reader_skip (&r, 1)
+        && h265_skip_profile_tier_level (&r, max_sub_layers_minus1)
+        && nal_reader_read_id (&r, &id)) {
+      index->sps_vps[id] = vps_id;
+      add_param_set (index, GST_CODEC_INDEX_SPS, id, nal, size, offset + 3);
+    }
+  } else if (type == 34) {
+    if (nal_reader_read_id (&r, &id) && nal_reader_read_id (&r, &sps_id)) {
+      index->pps_sps[id] = sps_id;
+      add_param_set (index, GST_CODEC_INDEX_PPS, id, nal, size, offset + 3);
+    }
+  }
+}
+
+void
+gst_codec_index_scan (GstCodecIndex * index, const guint8 * data, gsize size,
+    gint64 pts)
+{
+  gssize start;
+
+  g_return_if_fail (index != NULL);
+
+  index->first_au = TRUE;
+  index->pts = pts;
+
+  start = gst_codec_find_start_code (data, size);
+  while (start >= 0) {
+    gsize nal = start + 3;
+    gssize next = -1;
+    gsize end = size;
+
+    if (nal < size) {
+      next = gst_codec_find_start_code (data + nal, size - nal);
+      if (next >= 0) {
+        next += nal;
+        end = next;
+      }
+    }
+
+    /* trailing_zero_8bits, or the zero_byte of the next start code */
+    while (end > nal && data[end - 1] == 0)
+      end--;
+
+    if (end > nal) {
+      if (index->codec == GST_CODEC_INDEX_H264)
+        h264_index_nal (index, data + nal, end - nal, index->offset + start);
+      else
+        h265_index_nal (index, data + nal, end - nal, index->offset + start);
+    }
+
+    start = next;
+  }
+
+  index->offset += size;
+}
+
+GstCodecIndexCodec
+gst_codec_index_get_codec (GstCodecIndex * index)
+{
+  return index->codec;
+}
+
+guint
+gst_codec_index_get_n_entries (GstCodecIndex * index)
+{
+  return index->entries->len;
+}
+
+const GstCodecIndexEntry *
+gst_codec_index_get_entry (GstCodecIndex * index, guint n)
+{
+  g_return_val_if_fail (n < index->entries->len, NULL);
+
+  return &g_array_index (index->entries, GstCodecIndexEntry, n);
+}
+
+guint32
+gst_codec_index_get_n_frames (GstCodecIndex * index)
+{
+  return index->n_frames;
+}
+
+GArray *
+gst_codec_index_get_param_sets (GstCodecIndex * index, guint n)
+{
+  const GstCodecIndexEntry *entry;
+  gint last[N_PARAM_SET_TYPES][MAX_IDS];
+  GArray *sets;
+  guint i, t, id;
+
+  g_return_val_if_fail (n < index->entries->len, NULL);
+
+  entry = &g_array_index (index->entries, GstCodecIndexEntry, n);
+  memset (last, -1, sizeof (last));
+
+  for (i = 0; i < index->param_sets->len; i++) {
+    const GstCodecIndexParamSet *ps =
+        &g_array_index (index->param_sets, GstCodecIndexParamSet, i);
+
+    if (ps->offset >= entry->offset)
+      break;
+    last[ps->type][ps->id] = i;
+  }
+
+  sets = g_array_new (FALSE, FALSE, sizeof (GstCodecIndexParamSet));
+  for (t = 0; t < N_PARAM_SET_TYPES; t++) {
+    for (id = 0; id < MAX_IDS; id++) {
+      if (last[t][id] >= 0) {
+        g_array_append_val (sets, g_array_index (index->param_sets,
+                GstCodecIndexParamSet, last[t][id]));
+      }
+    }
+  }
+
+  return sets;
+}
+
+/* The file is little endian: a header, the entries and the parameter
+ * sets. */
+static void
+put_u16 (GByteArray * buf, guint16 val)
+{
+  val = GUINT16_TO_LE (val);
+  g_byte_array_append (buf, (const guint8 *) &val, 2);
+}
+
+static void
+put_u32 (GByteArray * buf, guint32 val)
+{
+  val = GUINT32_TO_LE (val);
+  g_byte_array_append (buf, (const guint8 *) &val, 4);
+}
+
+static void
+put_u64 (GByteArray * buf, guint64 val)
+{
+  val = GUINT64_TO_LE (val);
+  g_byte_array_append (buf, (const guint8 *) &val, 8);
+}
+
+static guint16
+get_u16 (const guint8 * data)
+{
+  guint16 val;
+
+  memcpy (&val, data, 2);
+  return GUINT16_FROM_LE (val);
+}
+
+static guint32
+get_u32 (const guint8 * data)
+{
+  guint32 val;
+
+  memcpy (&val, data, 4);
+  return GUINT32_FROM_LE (val);
+}
+
+static guint64
+get_u64 (const guint8 * data)
+{
+  guint64 val;
+
+  memcpy (&val, data, 8);
+  return GUINT64_FROM_LE (val);
+}
+
+static inline gboolean
+valid_id (guint16 id)
+{
+  return id < MAX_IDS || id == GST_CODEC_INDEX_NO_ID;
+}
+
+gboolean
+gst_codec_index_save (GstCodecIndex * index, const gchar * filename,
+    GError ** error)
+{
+  GByteArray *buf;
+  gboolean ret;
+  guint i;
+
+  buf = g_byte_array_sized_new (HEADER_SIZE + index->entries->len * ENTRY_SIZE
+      + index->param_sets->len * PARAM_SET_SIZE);
+
+  g_byte_array_append (buf, (const guint8 *) INDEX_MAGIC, 4);
+  put_u32 (buf, INDEX_VERSION);
+  put_u32 (buf, index->codec);
+  put_u32 (buf, index->n_frames);
+  put_u32 (buf, index->entries->len);
+  put_u32 (buf, index->param_sets->len);
+
+  for (i = 0; i < index->entries->len; i++) {
+    const GstCodecIndexEntry *entry =
+        &g_array_index (index->entries, GstCodecIndexEntry, i);
+    const guint8 nal_type[2] = { entry->nal_type, 0 };
+
+    put_u64 (buf, entry->offset);
+    put_u64 (buf, entry->pts);
+    put_u32 (buf, entry->frame);
+    g_byte_array_append (buf, nal_type, 2);
+    put_u16 (buf, entry->vps_id);
+    put_u16 (buf, entry->sps_id);
+    put_u16 (buf, entry->pps_id);
+  }
+
+  for (i = 0; i < index->param_sets->len; i++) {
+    const GstCodecIndexParamSet *ps =
+        &g_array_index (index->param_sets, GstCodecIndexParamSet, i);
+    const guint8 type[2] = { ps->type, 0 };
+
+    put_u64 (buf, ps->offset);
+    put_u32 (buf, ps->size);
+    g_byte_array_append (buf, type, 2);
+    put_u16 (buf, ps->id);
+  }
+
+  ret = g_file_set_contents (filename, (const gchar *) buf->data, buf->len,
+      error);
+  g_byte_array_unref (buf);
+
+  return ret;
+}
+
+GstCodecIndex *
+gst_codec_index_load (const gchar * filename, GError ** error)
+{
+  GstCodecIndex *index = NULL;
+  gchar *contents;
+  const guint8 *data;
+  gsize size;
+  guint32 codec, n_entries, n_param_sets;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, &size, error))
+    return NULL;
+
+  data = (const guint8 *) contents;
+  if (size < HEADER_SIZE || memcmp (data, INDEX_MAGIC, 4) != 0
+      || get_u32 (data + 4) != INDEX_VERSION)
+    goto invalid;
+
+  codec = get_u32 (data + 8);
+  n_entries = get_u32 (data + 16);
+  n_param_sets = get_u32 (data + 20);
+  if (codec > GST_CODEC_INDEX_H265 || size != HEADER_SIZE
+      + (guint64) n_entries * ENTRY_SIZE
+      + (guint64) n_param_sets * PARAM_SET_SIZE)
+    goto invalid;
+
+  index = gst_codec_index_new (codec);
+  index->n_frames = get_u32 (data + 12);
+  data += HEADER_SIZE;
+
+  g_array_set_size (index->entries, n_entries);
+  for (i = 0; i < n_entries; i++, data += ENTRY_SIZE) {
+    GstCodecIndexEntry *entry =
+        &g_array_index (index->entries, GstCodecIndexEntry, i);
+
+    entry->offset = get_u64 (data);
+    entry->pts = get_u64 (data + 8);
+    entry->frame = get_u32 (data + 16);
+    entry->nal_type = data[20];
+    entry->vps_id = get_u16 (data + 22);
+    entry->sps_id = get_u16 (data + 24);
+    entry->pps_id = get_u16 (data + 26);
+    if (!valid_id (entry->vps_id) || !valid_id (entry->sps_id)
+        || !valid_id (entry->pps_id)) {
+      gst_codec_index_free (index);
+      goto invalid;
+    }
+  }
+
+  g_array_set_size (index->param_sets, n_param_sets);
+  for (i = 0; i < n_param_sets; i++, data += PARAM_SET_SIZE) {
+    GstCodecIndexParamSet *ps =
+        &g_array_index (index->param_sets, GstCodecIndexParamSet, i);
+
+    ps->offset = get_u64 (data);
+    ps->size = get_u32 (data + 8);
+    ps->type = data[12];
+    ps->id = get_u16 (data + 14);
+    if (ps->type >= N_PARAM_SET_TYPES || ps->id >= MAX_IDS) {
+      gst_codec_index_free (index);
+      goto invalid;
+    }
+  }
+
+  g_free (contents);
+  return index;
+
+invalid:
+  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+      "%s is not a valid stream index", filename);
+  g_free (contents);
+  return NULL;
+}
@@ -0,0 +1,113 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Random access index of an H.264 or H.265 Annex B byte stream: where its
+ * IDR (H.264) or IRAP (H.265) access units and parameter sets are, found
+ * from the NAL unit headers and the first bits of the slice headers and
+ * parameter sets only, so a stream is scanned at the speed of the start
+ * code search.
+ *
+ * Every entry is a random access point, thus it starts a GOP, which lasts
+ * until the frame of the next entry, or gst_codec_index_get_n_frames(). */
+typedef struct _GstCodecIndex GstCodecIndex;
+
+typedef enum
+{
+  GST_CODEC_INDEX_H264,
+  GST_CODEC_INDEX_H265,
+} GstCodecIndexCodec;
+
+typedef enum
+{
+  GST_CODEC_INDEX_VPS,
+  GST_CODEC_INDEX_SPS,
+  GST_CODEC_INDEX_PPS,
+} GstCodecIndexParamSetType;
+
+/* unknown parameter set id, out of the range of every id: H.264 PPS ids go
+ * up to 255 */
+#define GST_CODEC_INDEX_NO_ID 0xffff
+
+typedef struct
+{
+  /* of the start code of the first NAL unit of the access unit */
+  guint64 offset;
+  /* -1 if unknown */
+  gint64 pts;
+  /* access units before it, in decode order */
+  guint32 frame;
+  /* of its first slice */
+  guint8 nal_type;
+  /* parameter sets it refers to; the VPS is always unknown for H.264 */
+  guint16 vps_id;
+  guint16 sps_id;
+  guint16 pps_id;
+} GstCodecIndexEntry;
+
+typedef struct
+{
+  /* of the NAL unit header, after the start code */
+  guint64 offset;
+  guint32 size;
+  guint8 type;
+  guint16 id;
+} GstCodecIndexParamSet;
+
+GstCodecIndex * gst_codec_index_new               (GstCodecIndexCodec codec);
+
+void            gst_codec_index_free              (GstCodecIndex * index);
+
+/* Indexes @data, which holds complete NAL units: a whole stream, e.g. a
+ * mapped file, or a demuxed packet. Consecutive calls index consecutive
+ * parts of the stream. @pts is given to the first access unit starting in
+ * @data, or -1. */
+void            gst_codec_index_scan              (GstCodecIndex * index,
+                                                   const guint8 * data,
+                                                   gsize size,
+                                                   gint64 pts);
+
+GstCodecIndexCodec gst_codec_index_get_codec      (GstCodecIndex * index);
+
+guint           gst_codec_index_get_n_entries     (GstCodecIndex * index);
+
+const GstCodecIndexEntry * gst_codec_index_get_entry (GstCodecIndex * index,
+                                                   guint n);
+
+/* access units scanned */
+guint32         gst_codec_index_get_n_frames      (GstCodecIndex * index);
+
+/* Returns the parameter sets in force at entry @n, the last one of every
+ * type and id before it, in the order they have to be parsed. Those right
+ * before the entry, within its access unit, aren't included. */
+GArray *        gst_codec_index_get_param_sets    (GstCodecIndex * index,
+                                                   guint n);
+
+gboolean        gst_codec_index_save              (GstCodecIndex * index,
+                                                   const gchar * filename,
+                                                   GError ** error);
+
+GstCodecIndex * gst_codec_index_load              (const gchar * filename,
+                                                   GError ** error);
+
+G_END_DECLS
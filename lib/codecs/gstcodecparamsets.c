@@ -0,0 +1,164 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstcodecparamsets.h"
+
+#include <string.h>
+
+typedef struct
+{
+  guint id;
+  guint64 hash;
+  gsize size;
+  /* the buffer stays with the slot when the entry is forgotten, so a
+   * stream switching between a few sets doesn't allocate */
+  gsize allocated;
+  guint8 *data;
+} GstCodecParamSetEntry;
+
+typedef struct
+{
+  /* a stream rarely has more than a couple sets of a type, so they are
+   * looked up by content in the stored order */
+  GstCodecParamSetEntry entries[GST_CODEC_PARAM_SETS_MAX_IDS];
+  guint n_entries;
+} GstCodecParamSetTable;
+
+struct _GstCodecParamSets
+{
+  GstCodecParamSetTable tables[GST_CODEC_PARAM_SET_N_TYPES];
+};
+
+/* FNV-1a, 64 bits */
+static guint64
+hash_bytes (const guint8 * data, gsize size)
+{
+  guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * G_GUINT64_CONSTANT (1099511628211);
+
+  return hash;
+}
+
+static inline gboolean
+entry_equals (const GstCodecParamSetEntry * entry, guint64 hash,
+    const guint8 * data, gsize size)
+{
+  return entry->hash == hash && entry->size == size
+      && memcmp (entry->data, data, size) == 0;
+}
+
+GstCodecParamSets *
+gst_codec_param_sets_new (void)
+{
+  return g_new0 (GstCodecParamSets, 1);
+}
+
+void
+gst_codec_param_sets_free (GstCodecParamSets * sets)
+{
+  guint t, i;
+
+  if (!sets)
+    return;
+
+  for (t = 0; t < GST_CODEC_PARAM_SET_N_TYPES; t++) {
+    for (i = 0; i < GST_CODEC_PARAM_SETS_MAX_IDS; i++)
+      g_free (sets->tables[t].entries[i].data);
+  }
+
+  g_free (sets);
+}
+
+void
+gst_codec_param_sets_clear (GstCodecParamSets * sets)
+{
+  guint t;
+
+  for (t = 0; t < GST_CODEC_PARAM_SET_N_TYPES; t++)
+    sets->tables[t].n_entries = 0;
+}
+
+gboolean
+gst_codec_param_sets_lookup (GstCodecParamSets * sets,
+    GstCodecParamSetType type, const guint8 * data, gsize size, guint * id)
+{
+  GstCodecParamSetTable *table;
+  guint64 hash;
+  guint i;
+
+  g_return_val_if_fail (type < GST_CODEC_PARAM_SET_N_TYPES, FALSE);
+
+  table = &sets->tables[type];
+  if (table->n_entries == 0)
+    return FALSE;
+
+  hash = hash_bytes (data, size);
+  for (i = 0; i < table->n_entries; i++) {
+    if (entry_equals (&table->entries[i], hash, data, size)) {
+      *id = table->entries[i].id;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+void
+gst_codec_param_sets_store (GstCodecParamSets * sets,
+    GstCodecParamSetType type, guint id, const guint8 * data, gsize size)
+{
+  GstCodecParamSetTable *table;
+  GstCodecParamSetEntry *entry = NULL;
+  guint64 hash;
+  guint i;
+
+  g_return_if_fail (type < GST_CODEC_PARAM_SET_N_TYPES);
+  g_return_if_fail (id < GST_CODEC_PARAM_SETS_MAX_IDS);
+
+  table = &sets->tables[type];
+  hash = hash_bytes (data, size);
+
+  for (i = 0; i < table->n_entries; i++) {
+    if (table->entries[i].id == id) {
+      entry = &table->entries[i];
+      break;
+    }
+  }
+
+  if (entry) {
+    if (entry_equals (entry, hash, data, size))
+      return;
+
+    for (i = type + 1; i < GST_CODEC_PARAM_SET_N_TYPES; i++)
+      sets->tables[i].n_entries = 0;
+  } else {
+    entry = &table->entries[table->n_entries++];
+    entry->id = id;
+  }
+
+  if (entry->allocated < size) {
+    entry->data = g_realloc (entry->data, size);
+    entry->allocated = size;
+  }
+  memcpy (entry->data, data, size);
+  entry->size = size;
+  entry->hash = hash;
+}
@@ -0,0 +1,63 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Raw bytes of the parameter sets a decoder has parsed, by type and id, so
+ * a set re-sent unchanged (e.g. before every IDR) is recognized without
+ * parsing it. Storing a set which replaces another of the same id forgets
+ * the sets of the following types, since their parsing might depend on
+ * it. */
+typedef struct _GstCodecParamSets GstCodecParamSets;
+
+typedef enum
+{
+  GST_CODEC_PARAM_SET_VPS,
+  GST_CODEC_PARAM_SET_SPS,
+  GST_CODEC_PARAM_SET_PPS,
+  GST_CODEC_PARAM_SET_N_TYPES,
+} GstCodecParamSetType;
+
+/* ids are lower than this, for every type */
+#define GST_CODEC_PARAM_SETS_MAX_IDS 256
+
+GstCodecParamSets * gst_codec_param_sets_new    (void);
+
+void                gst_codec_param_sets_free   (GstCodecParamSets * sets);
+
+void                gst_codec_param_sets_clear  (GstCodecParamSets * sets);
+
+/* Returns TRUE, and the id of the set in @id, if the NAL unit in @data is
+ * byte-identical to the last one stored with its id. */
+gboolean            gst_codec_param_sets_lookup (GstCodecParamSets * sets,
+                                                 GstCodecParamSetType type,
+                                                 const guint8 * data,
+                                                 gsize size,
+                                                 guint * id);
+
+void                gst_codec_param_sets_store  (GstCodecParamSets * sets,
+                                                 GstCodecParamSetType type,
+                                                 guint id,
+                                                 const guint8 * data,
+                                                 gsize size);
+
+G_END_DECLS
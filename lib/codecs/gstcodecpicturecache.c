@@ -0,0 +1,115 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstcodecpicturecache.h"
+
+#include <string.h>
+
+struct _GstCodecPictureCache
+{
+  gint ref_count;
+
+  gsize pic_size;
+
+  GMutex lock;
+  GPtrArray *free_pics;
+  guint capacity;
+};
+
+/* Enough for a DPB of 16 field pairs until the decoder sets it. */
+#define DEFAULT_CAPACITY 34
+
+GstCodecPictureCache *
+gst_codec_picture_cache_new (gsize pic_size)
+{
+  GstCodecPictureCache *cache = g_new0 (GstCodecPictureCache, 1);
+
+  cache->ref_count = 1;
+  cache->pic_size = pic_size;
+  cache->capacity = DEFAULT_CAPACITY;
+  g_mutex_init (&cache->lock);
+  cache->free_pics = g_ptr_array_new ();
+
+  return cache;
+}
+
+GstCodecPictureCache *
+gst_codec_picture_cache_ref (GstCodecPictureCache * cache)
+{
+  g_atomic_int_inc (&cache->ref_count);
+  return cache;
+}
+
+void
+gst_codec_picture_cache_unref (GstCodecPictureCache * cache)
+{
+  if (!g_atomic_int_dec_and_test (&cache->ref_count))
+    return;
+
+  g_ptr_array_foreach (cache->free_pics, (GFunc) g_free, NULL);
+  g_ptr_array_unref (cache->free_pics);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
+
+/* Drops the spare pictures if it shrinks. Nothing is preallocated: the
+ * cache fills up as pictures are freed. */
+void
+gst_codec_picture_cache_set_capacity (GstCodecPictureCache * cache,
+    guint capacity)
+{
+  g_mutex_lock (&cache->lock);
+  cache->capacity = capacity;
+  while (cache->free_pics->len > capacity) {
+    g_free (g_ptr_array_remove_index_fast (cache->free_pics,
+            cache->free_pics->len - 1));
+  }
+  g_mutex_unlock (&cache->lock);
+}
+
+gpointer
+gst_codec_picture_cache_acquire (GstCodecPictureCache * cache)
+{
+  gpointer pic = NULL;
+
+  g_mutex_lock (&cache->lock);
+  if (cache->free_pics->len > 0) {
+    pic = g_ptr_array_remove_index_fast (cache->free_pics,
+        cache->free_pics->len - 1);
+  }
+  g_mutex_unlock (&cache->lock);
+
+  if (!pic)
+    return g_malloc0 (cache->pic_size);
+
+  memset (pic, 0, cache->pic_size);
+  return pic;
+}
+
+void
+gst_codec_picture_cache_release (GstCodecPictureCache * cache, gpointer pic)
+{
+  g_mutex_lock (&cache->lock);
+  if (cache->free_pics->len < cache->capacity) {
+    g_ptr_array_add (cache->free_pics, pic);
+    pic = NULL;
+  }
+  g_mutex_unlock (&cache->lock);
+
+  g_free (pic);
+}
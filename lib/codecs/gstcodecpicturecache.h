@@ -0,0 +1,47 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Freed GstH264Picture or GstH265Picture structures of a decoder, reused for
+ * its next pictures so decoding doesn't allocate once the DPB is full. It
+ * keeps up to its capacity, and frees them when the decoder and the last of
+ * its pictures are gone: it's refcounted, as pictures might outlive the
+ * decoder that created them. */
+typedef struct _GstCodecPictureCache GstCodecPictureCache;
+
+GstCodecPictureCache * gst_codec_picture_cache_new          (gsize pic_size);
+
+GstCodecPictureCache * gst_codec_picture_cache_ref          (GstCodecPictureCache * cache);
+
+void                   gst_codec_picture_cache_unref        (GstCodecPictureCache * cache);
+
+void                   gst_codec_picture_cache_set_capacity (GstCodecPictureCache * cache,
+                                                             guint capacity);
+
+/* Returns zeroed memory, as g_malloc0() would. */
+gpointer               gst_codec_picture_cache_acquire      (GstCodecPictureCache * cache);
+
+void                   gst_codec_picture_cache_release      (GstCodecPictureCache * cache,
+                                                             gpointer pic);
+
+G_END_DECLS
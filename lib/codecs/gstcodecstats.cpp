@@ -0,0 +1,219 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstcodecstats.h"
+
+#include <atomic>
+
+struct Histogram
+{
+  std::atomic<guint64> count;
+  std::atomic<guint64> total;
+  std::atomic<guint64> max;
+  std::atomic<guint64> buckets[GST_CODEC_STATS_HISTOGRAM_BUCKETS];
+};
+
+struct _GstCodecStats
+{
+  gint ref_count;
+
+  std::atomic<guint64> counters[GST_CODEC_STATS_N_COUNTERS];
+  std::atomic<gint64> gauges[GST_CODEC_STATS_N_GAUGES];
+  std::atomic<gint64> gauge_peaks[GST_CODEC_STATS_N_GAUGES];
+  Histogram timers[GST_CODEC_STATS_N_TIMERS];
+};
+
+static void
+update_max (std::atomic<gint64> & max, gint64 value)
+{
+  gint64 current = max.load (std::memory_order_relaxed);
+
+  while (value > current && !max.compare_exchange_weak (current, value,
+          std::memory_order_relaxed));
+}
+
+static void
+update_max (std::atomic<guint64> & max, guint64 value)
+{
+  guint64 current = max.load (std::memory_order_relaxed);
+
+  while (value > current && !max.compare_exchange_weak (current, value,
+          std::memory_order_relaxed));
+}
+
+/* position of the most significant bit; gulong is 32 bits wide on Windows */
+static guint
+msb_position (guint64 value)
+{
+  guint shift = 0;
+
+  if (value >> 32) {
+    shift = 32;
+    value >>= 32;
+  }
+
+  return shift + g_bit_storage ((gulong) value) - 1;
+}
+
+static guint
+bucket_index (guint64 value)
+{
+  guint msb;
+
+  if (value < 4)
+    return value;
+
+  msb = msb_position (value);
+  if (msb > GST_CODEC_STATS_HISTOGRAM_BUCKETS / 4)
+    return GST_CODEC_STATS_HISTOGRAM_BUCKETS - 1;
+
+  /* the two bits after the most significant one pick the sub-bucket */
+  return 4 * (msb - 1) + ((value >> (msb - 2)) & 3);
+}
+
+/* highest value recorded in the bucket */
+static guint64
+bucket_upper_bound (guint index)
+{
+  guint msb;
+  guint64 lower;
+
+  if (index < 4)
+    return index;
+
+  msb = index / 4 + 1;
+  lower = (guint64) (4 + index % 4) << (msb - 2);
+
+  return lower + ((guint64) 1 << (msb - 2)) - 1;
+}
+
+GstCodecStats *
+gst_codec_stats_new (void)
+{
+  GstCodecStats *stats = new GstCodecStats ();
+
+  stats->ref_count = 1;
+
+  return stats;
+}
+
+GstCodecStats *
+gst_codec_stats_ref (GstCodecStats * stats)
+{
+  g_atomic_int_inc (&stats->ref_count);
+  return stats;
+}
+
+void
+gst_codec_stats_unref (GstCodecStats * stats)
+{
+  if (g_atomic_int_dec_and_test (&stats->ref_count))
+    delete stats;
+}
+
+void
+gst_codec_stats_add (GstCodecStats * stats, GstCodecStatsCounter counter,
+    guint64 value)
+{
+  if (stats)
+    stats->counters[counter].fetch_add (value, std::memory_order_relaxed);
+}
+
+void
+gst_codec_stats_gauge_add (GstCodecStats * stats, GstCodecStatsGauge gauge,
+    gint64 delta)
+{
+  gint64 value;
+
+  if (!stats)
+    return;
+
+  value = stats->gauges[gauge].fetch_add (delta,
+      std::memory_order_relaxed) + delta;
+  update_max (stats->gauge_peaks[gauge], value);
+}
+
+void
+gst_codec_stats_record (GstCodecStats * stats, GstCodecStatsTimer timer,
+    GstClockTime start)
+{
+  Histogram *histogram;
+  guint64 elapsed;
+
+  if (!stats)
+    return;
+
+  elapsed = gst_util_get_timestamp () - start;
+  histogram = &stats->timers[timer];
+
+  histogram->count.fetch_add (1, std::memory_order_relaxed);
+  histogram->total.fetch_add (elapsed, std::memory_order_relaxed);
+  histogram->buckets[bucket_index (elapsed)].fetch_add (1,
+      std::memory_order_relaxed);
+  update_max (histogram->max, elapsed);
+}
+
+void
+gst_codec_stats_snapshot (GstCodecStats * stats,
+    GstCodecStatsSnapshot * snapshot)
+{
+  guint i, j;
+
+  for (i = 0; i < GST_CODEC_STATS_N_COUNTERS; i++)
+    snapshot->counters[i] = stats->counters[i].load (std::memory_order_relaxed);
+
+  for (i = 0; i < GST_CODEC_STATS_N_GAUGES; i++) {
+    snapshot->gauges[i] =
+        MAX (stats->gauges[i].load (std::memory_order_relaxed), 0);
+    snapshot->gauge_peaks[i] =
+        stats->gauge_peaks[i].load (std::memory_order_relaxed);
+  }
+
+  for (i = 0; i < GST_CODEC_STATS_N_TIMERS; i++) {
+    Histogram *histogram = &stats->timers[i];
+    GstCodecStatsHistogram *dest = &snapshot->timers[i];
+
+    dest->count = histogram->count.load (std::memory_order_relaxed);
+    dest->total = histogram->total.load (std::memory_order_relaxed);
+    dest->max = histogram->max.load (std::memory_order_relaxed);
+    for (j = 0; j < GST_CODEC_STATS_HISTOGRAM_BUCKETS; j++)
+      dest->buckets[j] = histogram->buckets[j].load (std::memory_order_relaxed);
+  }
+}
+
+guint64
+gst_codec_stats_histogram_percentile (const GstCodecStatsHistogram * histogram,
+    gdouble percentile)
+{
+  guint64 rank, seen = 0;
+  guint i;
+
+  if (histogram->count == 0)
+    return 0;
+
+  rank = (guint64) (CLAMP (percentile, 0.0, 1.0) * histogram->count + 0.5);
+  rank = CLAMP (rank, 1, histogram->count);
+
+  for (i = 0; i < GST_CODEC_STATS_HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank)
+      return MIN (bucket_upper_bound (i), histogram->max);
+  }
+
+  return histogram->max;
+}
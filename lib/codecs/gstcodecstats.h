@@ -0,0 +1,109 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Counters and time histograms shared by the parser, its elements and their
+ * base classes. Everything is updated with relaxed atomics, so they can be
+ * read while the stream is being parsed. Recording functions accept a NULL
+ * stats, which is how collection is disabled. The stats are refcounted since
+ * pictures might outlive the decoder that created them. */
+typedef struct _GstCodecStats GstCodecStats;
+
+typedef enum
+{
+  GST_CODEC_STATS_NALS,
+  GST_CODEC_STATS_SLICES,
+  GST_CODEC_STATS_BYTES_COPIED,
+  /* parameter sets re-sent unchanged, neither parsed nor notified */
+  GST_CODEC_STATS_PARAM_SETS_SKIPPED,
+  GST_CODEC_STATS_N_COUNTERS,
+} GstCodecStatsCounter;
+
+/* values going up and down, whose peak is kept too */
+typedef enum
+{
+  GST_CODEC_STATS_PICTURES_IN_FLIGHT,
+  GST_CODEC_STATS_N_GAUGES,
+} GstCodecStatsGauge;
+
+typedef enum
+{
+  GST_CODEC_STATS_NAL_IDENTIFICATION,
+  GST_CODEC_STATS_DPB_MANAGEMENT,
+  GST_CODEC_STATS_CLIENT_CALLBACKS,
+  GST_CODEC_STATS_N_TIMERS,
+} GstCodecStatsTimer;
+
+/* Four buckets per power of two, so a recorded time is known within 25%,
+ * up to 2^41 ns. Larger times land in the last bucket. */
+#define GST_CODEC_STATS_HISTOGRAM_BUCKETS 160
+
+typedef struct
+{
+  guint64 count;
+  guint64 total;
+  guint64 max;
+  guint64 buckets[GST_CODEC_STATS_HISTOGRAM_BUCKETS];
+} GstCodecStatsHistogram;
+
+typedef struct
+{
+  guint64 counters[GST_CODEC_STATS_N_COUNTERS];
+  guint64 gauges[GST_CODEC_STATS_N_GAUGES];
+  guint64 gauge_peaks[GST_CODEC_STATS_N_GAUGES];
+  GstCodecStatsHistogram timers[GST_CODEC_STATS_N_TIMERS];
+} GstCodecStatsSnapshot;
+
+GstCodecStats *   gst_codec_stats_new          (void);
+
+GstCodecStats *   gst_codec_stats_ref          (GstCodecStats * stats);
+
+void              gst_codec_stats_unref        (GstCodecStats * stats);
+
+void              gst_codec_stats_add          (GstCodecStats * stats,
+                                                GstCodecStatsCounter counter,
+                                                guint64 value);
+
+void              gst_codec_stats_gauge_add    (GstCodecStats * stats,
+                                                GstCodecStatsGauge gauge,
+                                                gint64 delta);
+
+void              gst_codec_stats_record       (GstCodecStats * stats,
+                                                GstCodecStatsTimer timer,
+                                                GstClockTime start);
+
+void              gst_codec_stats_snapshot     (GstCodecStats * stats,
+                                                GstCodecStatsSnapshot * snapshot);
+
+guint64           gst_codec_stats_histogram_percentile (const GstCodecStatsHistogram * histogram,
+                                                        gdouble percentile);
+
+/* Returns the start time to pass to gst_codec_stats_record(). The clock is
+ * only read if stats are collected. */
+static inline GstClockTime
+gst_codec_stats_start (GstCodecStats * stats)
+{
+  return stats ? gst_util_get_timestamp () : 0;
+}
+
+G_END_DECLS
@@ -60,6 +60,10 @@
 
 #include <gst/base/base.h>
 #include "gsth264decoder.h"
+#include "gstcodecdpbsize.h"
+#include "gstcodecevent.h"
+#include "gstcodecparamsets.h"
+#include "gststartcode.h"
 
 GST_DEBUG_CATEGORY (gst_h264_decoder_debug);
 #define GST_CAT_DEFAULT gst_h264_decoder_debug
@@ -134,6 +138,11 @@ struct _GstH264DecoderPrivate
   gboolean process_ref_pic_lists;
   guint preferred_output_delay;
 
+  /* only IDR pictures are decoded, and whether the slices of the current
+   * frame were skipped for that */
+  gboolean keyframes_only;
+  gboolean frame_skipped;
+
   /* Reference picture lists, constructed for each frame */
   GArray *ref_pic_list_p0;
   GArray *ref_pic_list_b0;
@@ -152,6 +161,21 @@ struct _GstH264DecoderPrivate
 
   /* For delayed output */
   GstQueueArray *output_queue;
+
+  /* raw SPS and PPS held by the parser, to skip the ones re-sent */
+  GstCodecParamSets *param_sets;
+
+  GstCodecStats *stats;
+
+  /* set by the subclass, where the pictures come from */
+  GstCodecPictureCache *picture_cache;
+
+  /* access unit framing of unaligned byte-stream input: bytes of the
+   * adapter already scanned, whether they hold a slice, and whether the
+   * next buffer ends the access unit */
+  gsize parse_offset;
+  gboolean parse_has_vcl;
+  gboolean parse_au_end;
 };
 
 typedef struct
@@ -184,6 +208,10 @@ static gboolean gst_h264_decoder_set_format (GstVideoDecoder * decoder,
 static GstFlowReturn gst_h264_decoder_finish (GstVideoDecoder * decoder);
 static gboolean gst_h264_decoder_flush (GstVideoDecoder * decoder);
 static GstFlowReturn gst_h264_decoder_drain (GstVideoDecoder * decoder);
+static gboolean gst_h264_decoder_sink_event (GstVideoDecoder * decoder,
+    GstEvent * event);
+static GstFlowReturn gst_h264_decoder_parse (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame, GstAdapter * adapter, gboolean at_eos);
 static GstFlowReturn gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
 
@@ -312,6 +340,8 @@ gst_h264_decoder_class_init (GstH264DecoderClass * klass)
   decoder_class->finish = GST_DEBUG_FUNCPTR (gst_h264_decoder_finish);
   decoder_class->flush = GST_DEBUG_FUNCPTR (gst_h264_decoder_flush);
   decoder_class->drain = GST_DEBUG_FUNCPTR (gst_h264_decoder_drain);
+  decoder_class->sink_event = GST_DEBUG_FUNCPTR (gst_h264_decoder_sink_event);
+  decoder_class->parse = GST_DEBUG_FUNCPTR (gst_h264_decoder_parse);
   decoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_h264_decoder_handle_frame);
 
@@ -382,6 +412,8 @@ gst_h264_decoder_init (GstH264Decoder * self)
       gst_queue_array_new_for_struct (sizeof (GstH264DecoderOutputFrame), 1);
   gst_queue_array_set_clear_func (priv->output_queue,
       (GDestroyNotify) gst_h264_decoder_clear_output_frame);
+
+  priv->param_sets = gst_codec_param_sets_new ();
 }
 
 static void
@@ -399,6 +431,9 @@ gst_h264_decoder_finalize (GObject * object)
   g_array_unref (priv->ref_pic_list0);
   g_array_unref (priv->ref_pic_list1);
   gst_queue_array_free (priv->output_queue);
+  gst_codec_param_sets_free (priv->param_sets);
+  g_clear_pointer (&priv->stats, gst_codec_stats_unref);
+  g_clear_pointer (&priv->picture_cache, gst_codec_picture_cache_unref);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -411,6 +446,7 @@ gst_h264_decoder_reset (GstH264Decoder * self)
   gst_clear_buffer (&priv->codec_data);
   g_clear_pointer (&self->input_state, gst_video_codec_state_unref);
   g_clear_pointer (&priv->parser, gst_h264_nal_parser_free);
+  gst_codec_param_sets_clear (priv->param_sets);
   g_clear_pointer (&priv->dpb, gst_h264_dpb_free);
   gst_clear_h264_picture (&priv->last_field);
 
@@ -418,6 +454,9 @@ gst_h264_decoder_reset (GstH264Decoder * self)
   priv->width = 0;
   priv->height = 0;
   priv->nal_length_size = 4;
+  priv->parse_offset = 0;
+  priv->parse_has_vcl = FALSE;
+  priv->parse_au_end = FALSE;
 }
 
 static gboolean
@@ -490,9 +529,14 @@ static gboolean
 gst_h264_decoder_flush (GstVideoDecoder * decoder)
 {
   GstH264Decoder *self = GST_H264_DECODER (decoder);
+  GstH264DecoderPrivate *priv = self->priv;
 
   gst_h264_decoder_clear_dpb (self, TRUE);
 
+  priv->parse_offset = 0;
+  priv->parse_has_vcl = FALSE;
+  priv->parse_au_end = FALSE;
+
   return TRUE;
 }
 
@@ -511,6 +555,178 @@ gst_h264_decoder_finish (GstVideoDecoder * decoder)
   return gst_h264_decoder_drain (decoder);
 }
 
+/* Same as gst_h264_parser_identify_nalu(), but the end of the NAL unit is
+ * found with the SIMD start code scanner. */
+static GstH264ParserResult
+gst_h264_decoder_identify_nalu_byte_stream (const guint8 * data, guint offset,
+    gsize size, GstH264NalParser * parser, GstH264NalUnit * nalu)
+{
+  GstH264ParserResult pres;
+  gssize end;
+
+  pres = gst_h264_parser_identify_nalu_unchecked (parser, data, offset, size,
+      nalu);
+  if (pres != GST_H264_PARSER_OK)
+    return pres;
+
+  /* 1 byte long, at the end of an AU, so no need to wait for the next one */
+  if (nalu->type == GST_H264_NAL_SEQ_END ||
+      nalu->type == GST_H264_NAL_STREAM_END)
+    return pres;
+
+  end = gst_codec_find_start_code (data + nalu->offset, size - nalu->offset);
+  if (end < 0)
+    return GST_H264_PARSER_NO_NAL_END;
+
+  /* trailing zeros belong to the next start code */
+  while (end > 0 && data[nalu->offset + end - 1] == 0)
+    end--;
+
+  nalu->size = end;
+  if (nalu->size < 2)
+    return GST_H264_PARSER_BROKEN_DATA;
+
+  return GST_H264_PARSER_OK;
+}
+
+static GstH264ParserResult
+gst_h264_decoder_identify_nalu (GstH264Decoder * self, const GstMapInfo * map,
+    guint offset, GstH264NalUnit * nalu)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstClockTime start = gst_codec_stats_start (priv->stats);
+  GstH264ParserResult pres;
+
+  if (priv->in_format == GST_H264_DECODER_FORMAT_AVC) {
+    pres = gst_h264_parser_identify_nalu_avc (priv->parser,
+        map->data, offset, map->size, priv->nal_length_size, nalu);
+  } else {
+    pres = gst_h264_decoder_identify_nalu_byte_stream (map->data, offset,
+        map->size, priv->parser, nalu);
+
+    if (pres == GST_H264_PARSER_NO_NAL_END)
+      pres = GST_H264_PARSER_OK;
+  }
+
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_NAL_IDENTIFICATION,
+      start);
+  if (pres == GST_H264_PARSER_OK)
+    gst_codec_stats_add (priv->stats, GST_CODEC_STATS_NALS, 1);
+
+  return pres;
+}
+
+static gboolean
+gst_h264_decoder_sink_event (GstVideoDecoder * decoder, GstEvent * event)
+{
+  GstH264Decoder *self = GST_H264_DECODER (decoder);
+
+  if (gst_codec_event_is_au_end (event)) {
+    self->priv->parse_au_end = TRUE;
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->sink_event (decoder, event);
+}
+
+/* Whether the NAL unit starting at @data, of which at least two bytes are
+ * available, begins a new access unit after one holding a slice
+ * (7.4.1.2.3). Slices are checked for first_mb_in_slice == 0. */
+static gboolean
+gst_h264_decoder_nal_starts_au (const guint8 * data, gboolean * vcl)
+{
+  guint8 type = data[0] & 0x1f;
+
+  switch (type) {
+    case GST_H264_NAL_SLICE:
+    case GST_H264_NAL_SLICE_DPA:
+    case GST_H264_NAL_SLICE_IDR:
+      *vcl = TRUE;
+      /* ue(v) is 0 when its first bit is set */
+      return (data[1] & 0x80) != 0;
+    case GST_H264_NAL_SLICE_DPB:
+    case GST_H264_NAL_SLICE_DPC:
+      *vcl = TRUE;
+      return FALSE;
+    case GST_H264_NAL_SEI:
+    case GST_H264_NAL_SPS:
+    case GST_H264_NAL_PPS:
+    case GST_H264_NAL_AU_DELIMITER:
+      *vcl = FALSE;
+      return TRUE;
+    default:
+      *vcl = FALSE;
+      return type >= 14 && type <= 18;
+  }
+}
+
+/* Splits byte-stream input that isn't aligned to access units, so no
+ * h264parse is needed upstream. Only the NAL unit headers and the first
+ * bit of the slice headers are looked at here; the NAL units are parsed
+ * once, by handle_frame(). */
+static GstFlowReturn
+gst_h264_decoder_parse (GstVideoDecoder * decoder, GstVideoCodecFrame * frame,
+    GstAdapter * adapter, gboolean at_eos)
+{
+  GstH264Decoder *self = GST_H264_DECODER (decoder);
+  GstH264DecoderPrivate *priv = self->priv;
+  const guint8 *data;
+  gsize size, au_size = 0;
+  gssize sc;
+  gboolean vcl;
+
+  size = gst_adapter_available (adapter);
+  if (size == 0)
+    return GST_VIDEO_DECODER_FLOW_NEED_DATA;
+
+  data = gst_adapter_map (adapter, size);
+
+  while (TRUE) {
+    sc = gst_codec_find_start_code (data + priv->parse_offset,
+        size - priv->parse_offset);
+    if (sc < 0) {
+      /* the start code might continue in the next buffer */
+      priv->parse_offset = MAX (priv->parse_offset, MAX (size, 2) - 2);
+      break;
+    }
+    sc += priv->parse_offset;
+
+    /* NAL unit header and first byte of the slice header */
+    if (sc + 5 > size) {
+      priv->parse_offset = sc;
+      break;
+    }
+
+    if (gst_h264_decoder_nal_starts_au (data + sc + 3, &vcl)
+        && priv->parse_has_vcl) {
+      /* a zero_byte before the start code belongs to the next unit */
+      au_size = sc > 0 && data[sc - 1] == 0 ? sc - 1 : sc;
+      priv->parse_offset = sc + 3 - au_size;
+      priv->parse_has_vcl = vcl;
+      break;
+    }
+
+    priv->parse_has_vcl |= vcl;
+    priv->parse_offset = sc + 3;
+  }
+
+  gst_adapter_unmap (adapter);
+
+  if (au_size == 0) {
+    if (!at_eos && !priv->parse_au_end)
+      return GST_VIDEO_DECODER_FLOW_NEED_DATA;
+
+    au_size = size;
+    priv->parse_offset = 0;
+    priv->parse_has_vcl = FALSE;
+    priv->parse_au_end = FALSE;
+  }
+
+  gst_video_decoder_add_to_frame (decoder, au_size);
+  return gst_video_decoder_have_frame (decoder);
+}
+
 static GstFlowReturn
 gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -529,35 +745,16 @@ gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
       GST_TIME_ARGS (GST_BUFFER_DTS (in_buf)));
 
   priv->current_frame = frame;
+  priv->frame_skipped = FALSE;
 
   gst_buffer_map (in_buf, &map, GST_MAP_READ);
-  if (priv->in_format == GST_H264_DECODER_FORMAT_AVC) {
-    pres = gst_h264_parser_identify_nalu_avc (priv->parser,
-        map.data, 0, map.size, priv->nal_length_size, &nalu);
-
-    while (pres == GST_H264_PARSER_OK && decode_ret == GST_FLOW_OK) {
-      decode_ret = gst_h264_decoder_decode_nal (self, &nalu);
-
-      pres = gst_h264_parser_identify_nalu_avc (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, priv->nal_length_size,
-          &nalu);
-    }
-  } else {
-    pres = gst_h264_parser_identify_nalu (priv->parser,
-        map.data, 0, map.size, &nalu);
-
-    if (pres == GST_H264_PARSER_NO_NAL_END)
-      pres = GST_H264_PARSER_OK;
-
-    while (pres == GST_H264_PARSER_OK && decode_ret == GST_FLOW_OK) {
-      decode_ret = gst_h264_decoder_decode_nal (self, &nalu);
+  pres = gst_h264_decoder_identify_nalu (self, &map, 0, &nalu);
 
-      pres = gst_h264_parser_identify_nalu (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, &nalu);
+  while (pres == GST_H264_PARSER_OK && decode_ret == GST_FLOW_OK) {
+    decode_ret = gst_h264_decoder_decode_nal (self, &nalu);
 
-      if (pres == GST_H264_PARSER_NO_NAL_END)
-        pres = GST_H264_PARSER_OK;
-    }
+    pres = gst_h264_decoder_identify_nalu (self, &map,
+        nalu.offset + nalu.size, &nalu);
   }
 
   gst_buffer_unmap (in_buf, &map);
@@ -575,6 +772,14 @@ gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
     return decode_ret;
   }
 
+  if (priv->frame_skipped && !priv->current_picture) {
+    /* not a keyframe */
+    gst_video_decoder_release_frame (decoder, frame);
+    priv->current_frame = NULL;
+
+    return decode_ret;
+  }
+
   gst_h264_decoder_finish_current_picture (self, &decode_ret);
   gst_video_codec_frame_unref (frame);
   priv->current_frame = NULL;
@@ -587,6 +792,23 @@ gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
   return decode_ret;
 }
 
+/* Whether @nalu is byte-identical to the parameter set of its id held by
+ * the parser, which is returned then. */
+static gboolean
+gst_h264_decoder_is_param_set_resent (GstH264Decoder * self,
+    GstH264NalUnit * nalu, GstCodecParamSetType type, guint * id)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (!gst_codec_param_sets_lookup (priv->param_sets, type,
+          nalu->data + nalu->offset, nalu->size, id))
+    return FALSE;
+
+  gst_codec_stats_add (priv->stats, GST_CODEC_STATS_PARAM_SETS_SKIPPED, 1);
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_h264_decoder_parse_sps (GstH264Decoder * self, GstH264NalUnit * nalu)
 {
@@ -595,6 +817,16 @@ gst_h264_decoder_parse_sps (GstH264Decoder * self, GstH264NalUnit * nalu)
   GstH264SPS sps;
   GstH264ParserResult pres;
   GstFlowReturn ret;
+  guint id;
+
+  /* The SPS is processed anyway, since a different one might have been
+   * activated since, but neither parsed nor notified again */
+  if (gst_h264_decoder_is_param_set_resent (self, nalu,
+          GST_CODEC_PARAM_SET_SPS, &id)) {
+    GST_LOG_OBJECT (self, "SPS %u re-sent", id);
+    priv->parser->last_sps = &priv->parser->sps[id];
+    return gst_h264_decoder_process_sps (self, &priv->parser->sps[id]);
+  }
 
   pres = gst_h264_parse_sps (nalu, &sps);
   if (pres != GST_H264_PARSER_OK) {
@@ -614,6 +846,9 @@ gst_h264_decoder_parse_sps (GstH264Decoder * self, GstH264NalUnit * nalu)
           &sps) != GST_H264_PARSER_OK) {
     GST_WARNING_OBJECT (self, "Failed to update SPS");
     ret = GST_FLOW_ERROR;
+  } else {
+    gst_codec_param_sets_store (priv->param_sets, GST_CODEC_PARAM_SET_SPS,
+        sps.id, nalu->data + nalu->offset, nalu->size);
   }
 
   gst_h264_sps_clear (&sps);
@@ -629,6 +864,14 @@ gst_h264_decoder_parse_pps (GstH264Decoder * self, GstH264NalUnit * nalu)
   GstH264PPS pps;
   GstH264ParserResult pres;
   GstFlowReturn ret = GST_FLOW_OK;
+  guint id;
+
+  if (gst_h264_decoder_is_param_set_resent (self, nalu,
+          GST_CODEC_PARAM_SET_PPS, &id)) {
+    GST_LOG_OBJECT (self, "PPS %u re-sent", id);
+    priv->parser->last_pps = &priv->parser->pps[id];
+    return GST_FLOW_OK;
+  }
 
   pres = gst_h264_parse_pps (priv->parser, nalu, &pps);
   if (pres != GST_H264_PARSER_OK) {
@@ -648,6 +891,9 @@ gst_h264_decoder_parse_pps (GstH264Decoder * self, GstH264NalUnit * nalu)
       != GST_H264_PARSER_OK) {
     GST_WARNING_OBJECT (self, "Failed to update PPS");
     ret = GST_FLOW_ERROR;
+  } else {
+    gst_codec_param_sets_store (priv->param_sets, GST_CODEC_PARAM_SET_PPS,
+        pps.id, nalu->data + nalu->offset, nalu->size);
   }
 
   gst_h264_pps_clear (&pps);
@@ -759,38 +1005,9 @@ gst_h264_decoder_update_pic_nums (GstH264Decoder * self,
     GstH264Picture * current_picture, gint frame_num)
 {
   GstH264DecoderPrivate *priv = self->priv;
-  GArray *dpb = gst_h264_dpb_get_pictures_all (priv->dpb);
-  gint i;
-
-  for (i = 0; i < dpb->len; i++) {
-    GstH264Picture *picture = g_array_index (dpb, GstH264Picture *, i);
 
-    if (!GST_H264_PICTURE_IS_REF (picture))
-      continue;
-
-    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture)) {
-      if (GST_H264_PICTURE_IS_FRAME (current_picture))
-        picture->long_term_pic_num = picture->long_term_frame_idx;
-      else if (current_picture->field == picture->field)
-        picture->long_term_pic_num = 2 * picture->long_term_frame_idx + 1;
-      else
-        picture->long_term_pic_num = 2 * picture->long_term_frame_idx;
-    } else {
-      if (picture->frame_num > frame_num)
-        picture->frame_num_wrap = picture->frame_num - priv->max_frame_num;
-      else
-        picture->frame_num_wrap = picture->frame_num;
-
-      if (GST_H264_PICTURE_IS_FRAME (current_picture))
-        picture->pic_num = picture->frame_num_wrap;
-      else if (picture->field == current_picture->field)
-        picture->pic_num = 2 * picture->frame_num_wrap + 1;
-      else
-        picture->pic_num = 2 * picture->frame_num_wrap;
-    }
-  }
-
-  g_array_unref (dpb);
+  gst_h264_dpb_update_pic_nums (priv->dpb, current_picture, frame_num,
+      priv->max_frame_num);
 }
 
 static GstH264Picture *
@@ -988,7 +1205,8 @@ gst_h264_decoder_handle_frame_num_gap (GstH264Decoder * self, gint frame_num)
   unused_short_term_frame_num =
       (priv->prev_ref_frame_num + 1) % priv->max_frame_num;
   while (unused_short_term_frame_num != frame_num) {
-    GstH264Picture *picture = gst_h264_picture_new ();
+    GstH264Picture *picture =
+        gst_h264_picture_new_from_cache (priv->picture_cache);
     GstFlowReturn ret = GST_FLOW_OK;
 
     if (!gst_h264_decoder_init_gap_picture (self, picture,
@@ -1063,6 +1281,7 @@ gst_h264_decoder_start_current_picture (GstH264Decoder * self)
   gint frame_num;
   GstFlowReturn ret = GST_FLOW_OK;
   GstH264Picture *current_picture;
+  GstClockTime start;
 
   g_assert (priv->current_picture != NULL);
   g_assert (priv->active_sps != NULL);
@@ -1103,11 +1322,15 @@ gst_h264_decoder_start_current_picture (GstH264Decoder * self)
     }
   }
 
+  start = gst_codec_stats_start (priv->stats);
+
   gst_h264_decoder_update_pic_nums (self, current_picture, frame_num);
 
   if (priv->process_ref_pic_lists)
     gst_h264_decoder_prepare_ref_pic_lists (self, current_picture);
 
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
+
   klass = GST_H264_DECODER_GET_CLASS (self);
   if (klass->start_picture) {
     ret = klass->start_picture (self, priv->current_picture,
@@ -1134,7 +1357,7 @@ gst_h264_decoder_new_field_picture (GstH264Decoder * self,
     return NULL;
   }
 
-  new_picture = gst_h264_picture_new ();
+  new_picture = gst_h264_picture_new_from_cache (self->priv->picture_cache);
   /* don't confuse subclass by non-existing picture */
   if (!picture->nonexisting) {
     GstFlowReturn ret;
@@ -1304,7 +1527,7 @@ gst_h264_decoder_parse_slice (GstH264Decoder * self, GstH264NalUnit * nalu)
         GST_ERROR_OBJECT (self, "Couldn't duplicate the first field picture");
       }
     } else {
-      picture = gst_h264_picture_new ();
+      picture = gst_h264_picture_new_from_cache (priv->picture_cache);
 
       if (klass->new_picture)
         ret = klass->new_picture (self, priv->current_frame, picture);
@@ -1331,9 +1554,19 @@ gst_h264_decoder_parse_slice (GstH264Decoder * self, GstH264NalUnit * nalu)
   return gst_h264_decoder_decode_slice (self);
 }
 
+/* The second field of an IDR frame is a non-IDR picture, so a field left
+ * unpaired is completed by the following one. */
+static inline gboolean
+gst_h264_decoder_is_keyframe_slice (GstH264Decoder * self,
+    GstH264NalUnit * nalu)
+{
+  return nalu->type == GST_H264_NAL_SLICE_IDR || self->priv->last_field;
+}
+
 static GstFlowReturn
 gst_h264_decoder_decode_nal (GstH264Decoder * self, GstH264NalUnit * nalu)
 {
+  GstH264DecoderPrivate *priv = self->priv;
   GstFlowReturn ret = GST_FLOW_OK;
   GstH264DecoderClass* klass = GST_H264_DECODER_GET_CLASS (self);
 
@@ -1356,6 +1589,11 @@ gst_h264_decoder_decode_nal (GstH264Decoder * self, GstH264NalUnit * nalu)
     case GST_H264_NAL_SLICE_DPC:
     case GST_H264_NAL_SLICE_IDR:
     case GST_H264_NAL_SLICE_EXT:
+      if (priv->keyframes_only
+          && !gst_h264_decoder_is_keyframe_slice (self, nalu)) {
+        priv->frame_skipped = TRUE;
+        break;
+      }
       ret = gst_h264_decoder_parse_slice (self, nalu);
       break;
     case GST_H264_NAL_AU_DELIMITER:
@@ -1489,6 +1727,11 @@ gst_h264_decoder_set_format (GstVideoDecoder * decoder,
 
     priv->in_format = format;
     priv->align = align;
+
+    /* without alignment, access units are framed by parse() */
+    gst_video_decoder_set_packetized (decoder,
+        format == GST_H264_DECODER_FORMAT_AVC
+        || align == GST_H264_DECODER_ALIGN_AU);
   }
 
   if (priv->codec_data) {
@@ -2019,7 +2262,8 @@ gst_h264_decoder_sliding_window_picture_marking (GstH264Decoder * self,
         "Unmark reference flag of picture %p (frame_num %d, poc %d)",
         to_unmark, to_unmark->frame_num, to_unmark->pic_order_cnt);
 
-    gst_h264_picture_set_reference (to_unmark, GST_H264_PICTURE_REF_NONE, TRUE);
+    gst_h264_dpb_set_reference (priv->dpb, to_unmark,
+        GST_H264_PICTURE_REF_NONE, TRUE);
     gst_h264_picture_unref (to_unmark);
 
     num_ref_pics--;
@@ -2112,6 +2356,7 @@ gst_h264_decoder_finish_picture (GstH264Decoder * self,
   GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH264DecoderPrivate *priv = self->priv;
   GstH264DpbBumpMode bump_level = get_bump_level (self);
+  GstClockTime start = gst_codec_stats_start (priv->stats);
 
   /* Finish processing the picture.
    * Start by storing previous picture data for later use */
@@ -2133,6 +2378,9 @@ gst_h264_decoder_finish_picture (GstH264Decoder * self,
    * them as such */
   gst_h264_dpb_delete_unused (priv->dpb);
 
+  /* bumping is left out, as it calls the subclass to output pictures */
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
+
   /* If field pictures belong to different codec frame,
    * drop codec frame of the second field because we are consuming
    * only the first codec frame via GstH264Decoder::output_picture() method */
@@ -2270,78 +2518,6 @@ gst_h264_decoder_update_max_num_reorder_frames (GstH264Decoder * self,
 
   return TRUE;
 }
-
-#if !GST_CHECK_VERSION(1,23,0)
-typedef enum
-{
-  GST_H264_LEVEL_L1 = 10,
-  GST_H264_LEVEL_L1B = 9,
-  GST_H264_LEVEL_L1_1 = 11,
-  GST_H264_LEVEL_L1_2 = 12,
-  GST_H264_LEVEL_L1_3 = 13,
-  GST_H264_LEVEL_L2 = 20,
-  GST_H264_LEVEL_L2_1 = 21,
-  GST_H264_LEVEL_L2_2 = 22,
-  GST_H264_LEVEL_L3 = 30,
-  GST_H264_LEVEL_L3_1 = 31,
-  GST_H264_LEVEL_L3_2 = 32,
-  GST_H264_LEVEL_L4 = 40,
-  GST_H264_LEVEL_L4_1 = 41,
-  GST_H264_LEVEL_L4_2 = 42,
-  GST_H264_LEVEL_L5 = 50,
-  GST_H264_LEVEL_L5_1 = 51,
-  GST_H264_LEVEL_L5_2 = 52,
-  GST_H264_LEVEL_L6 = 60,
-  GST_H264_LEVEL_L6_1 = 61,
-  GST_H264_LEVEL_L6_2 = 62,
-} GstH264Level;
-#endif
-
-typedef struct
-{
-  GstH264Level level;
-
-  guint32 max_mbps;
-  guint32 max_fs;
-  guint32 max_dpb_mbs;
-  guint32 max_main_br;
-} LevelLimits;
-
-static const LevelLimits level_limits_map[] = {
-  {GST_H264_LEVEL_L1, 1485, 99, 396, 64},
-  {GST_H264_LEVEL_L1B, 1485, 99, 396, 128},
-  {GST_H264_LEVEL_L1_1, 3000, 396, 900, 192},
-  {GST_H264_LEVEL_L1_2, 6000, 396, 2376, 384},
-  {GST_H264_LEVEL_L1_3, 11800, 396, 2376, 768},
-  {GST_H264_LEVEL_L2, 11880, 396, 2376, 2000},
-  {GST_H264_LEVEL_L2_1, 19800, 792, 4752, 4000},
-  {GST_H264_LEVEL_L2_2, 20250, 1620, 8100, 4000},
-  {GST_H264_LEVEL_L3, 40500, 1620, 8100, 10000},
-  {GST_H264_LEVEL_L3_1, 108000, 3600, 18000, 14000},
-  {GST_H264_LEVEL_L3_2, 216000, 5120, 20480, 20000},
-  {GST_H264_LEVEL_L4, 245760, 8192, 32768, 20000},
-  {GST_H264_LEVEL_L4_1, 245760, 8192, 32768, 50000},
-  {GST_H264_LEVEL_L4_2, 522240, 8704, 34816, 50000},
-  {GST_H264_LEVEL_L5, 589824, 22080, 110400, 135000},
-  {GST_H264_LEVEL_L5_1, 983040, 36864, 184320, 240000},
-  {GST_H264_LEVEL_L5_2, 2073600, 36864, 184320, 240000},
-  {GST_H264_LEVEL_L6, 4177920, 139264, 696320, 240000},
-  {GST_H264_LEVEL_L6_1, 8355840, 139264, 696320, 480000},
-  {GST_H264_LEVEL_L6_2, 16711680, 139264, 696320, 800000}
-};
-
-static gint
-h264_level_to_max_dpb_mbs (GstH264Level level)
-{
-  gint i;
-  for (i = 0; i < G_N_ELEMENTS (level_limits_map); i++) {
-    if (level == level_limits_map[i].level)
-      return level_limits_map[i].max_dpb_mbs;
-  }
-
-  return 0;
-}
-
 static void
 gst_h264_decoder_set_latency (GstH264Decoder * self, const GstH264SPS * sps,
     gint max_dpb_size)
@@ -2411,10 +2587,6 @@ gst_h264_decoder_process_sps (GstH264Decoder * self, GstH264SPS * sps)
 {
   GstH264DecoderClass *klass = GST_H264_DECODER_GET_CLASS (self);
   GstH264DecoderPrivate *priv = self->priv;
-  guint8 level;
-  gint max_dpb_mbs;
-  gint width_mb, height_mb;
-  gint max_dpb_frames;
   gint max_dpb_size;
   gint prev_max_dpb_size;
   gboolean prev_interlaced;
@@ -2438,44 +2610,10 @@ gst_h264_decoder_process_sps (GstH264Decoder * self, GstH264SPS * sps)
 
   interlaced = !sps->frame_mbs_only_flag;
 
-  /* Spec A.3.1 and A.3.2
-   * For Baseline, Constrained Baseline and Main profile, the indicated level is
-   * Level 1b if level_idc is equal to 11 and constraint_set3_flag is equal to 1
-   */
-  level = sps->level_idc;
-  if (level == 11 && (sps->profile_idc == 66 || sps->profile_idc == 77) &&
-      sps->constraint_set3_flag) {
-    /* Level 1b */
-    level = 9;
-  }
-
-  max_dpb_mbs = h264_level_to_max_dpb_mbs ((GstH264Level) level);
-  if (!max_dpb_mbs)
+  max_dpb_size = gst_codec_h264_get_max_dpb_size (sps);
+  if (!max_dpb_size)
     return GST_FLOW_ERROR;
 
-  width_mb = sps->width / 16;
-  height_mb = sps->height / 16;
-
-  max_dpb_frames = MIN (max_dpb_mbs / (width_mb * height_mb),
-      GST_H264_DPB_MAX_SIZE);
-
-  if (sps->vui_parameters_present_flag
-      && sps->vui_parameters.bitstream_restriction_flag)
-    max_dpb_frames = MAX (1, sps->vui_parameters.max_dec_frame_buffering);
-
-  /* Case 1) There might be some non-conforming streams that require more DPB
-   * size than that of specified one by SPS
-   * Case 2) If bitstream_restriction_flag is not present,
-   * max_dec_frame_buffering should be inferred
-   * to be equal to MaxDpbFrames, then MaxDpbFrames can exceed num_ref_frames
-   * See https://chromium-review.googlesource.com/c/chromium/src/+/760276/
-   */
-  max_dpb_size = MAX (max_dpb_frames, sps->num_ref_frames);
-  if (max_dpb_size > GST_H264_DPB_MAX_SIZE) {
-    GST_WARNING_OBJECT (self, "Too large calculated DPB size %d", max_dpb_size);
-    max_dpb_size = GST_H264_DPB_MAX_SIZE;
-  }
-
   /* Safety, so that subclass don't need bound checking */
   g_return_val_if_fail (max_dpb_size <= GST_H264_DPB_MAX_SIZE, GST_FLOW_ERROR);
 
@@ -2564,7 +2702,11 @@ gst_h264_decoder_decode_slice (GstH264Decoder * self)
   priv->max_pic_num = slice->header.max_pic_num;
 
   if (priv->process_ref_pic_lists) {
-    if (!gst_h264_decoder_modify_ref_pic_lists (self)) {
+    GstClockTime start = gst_codec_stats_start (priv->stats);
+    gboolean modified = gst_h264_decoder_modify_ref_pic_lists (self);
+
+    gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
+    if (!modified) {
       ret = GST_FLOW_ERROR;
       goto beach;
     }
@@ -3321,6 +3463,97 @@ gst_h264_decoder_set_process_ref_pic_lists (GstH264Decoder * decoder,
   decoder->priv->process_ref_pic_lists = process;
 }
 
+/**
+ * gst_h264_decoder_set_keyframes_only:
+ * @decoder: a #GstH264Decoder
+ * @keyframes_only: whether only the IDR pictures are decoded
+ *
+ * Called to skip the non-IDR pictures, e.g. for thumbnails. Their slices
+ * are dropped once identified, so no picture is created for them.
+ */
+void
+gst_h264_decoder_set_keyframes_only (GstH264Decoder * decoder,
+    gboolean keyframes_only)
+{
+  decoder->priv->keyframes_only = keyframes_only;
+}
+
+/**
+ * gst_h264_decoder_set_stats:
+ * @decoder: a #GstH264Decoder
+ * @stats: (nullable): a #GstCodecStats
+ *
+ * Sets where the time spent identifying NAL units and managing the DPB, and
+ * the number of NAL units, are recorded. %NULL disables it.
+ */
+void
+gst_h264_decoder_set_stats (GstH264Decoder * decoder, GstCodecStats * stats)
+{
+  GstH264DecoderPrivate *priv = decoder->priv;
+
+  if (stats)
+    gst_codec_stats_ref (stats);
+  g_clear_pointer (&priv->stats, gst_codec_stats_unref);
+  priv->stats = stats;
+}
+
+/**
+ * gst_h264_decoder_set_picture_cache:
+ * @decoder: a #GstH264Decoder
+ * @cache: (nullable): a #GstCodecPictureCache of #GstH264Picture
+ *
+ * Sets where the pictures are allocated from and returned to once freed.
+ * %NULL allocates every picture.
+ */
+void
+gst_h264_decoder_set_picture_cache (GstH264Decoder * decoder,
+    GstCodecPictureCache * cache)
+{
+  GstH264DecoderPrivate *priv = decoder->priv;
+
+  if (cache)
+    gst_codec_picture_cache_ref (cache);
+  g_clear_pointer (&priv->picture_cache, gst_codec_picture_cache_unref);
+  priv->picture_cache = cache;
+}
+
+/**
+ * gst_h264_decoder_get_input_buffer:
+ * @decoder: a #GstH264Decoder
+ *
+ * Retrieves the buffer being decoded, whose mapped data the NAL units passed
+ * to the subclass point into. A picture never spans more than one buffer.
+ * Only meaningful within the vfuncs called while decoding a frame.
+ *
+ * Returns: (transfer none) (nullable): a #GstBuffer
+ */
+GstBuffer *
+gst_h264_decoder_get_input_buffer (GstH264Decoder * decoder)
+{
+  GstH264DecoderPrivate *priv = decoder->priv;
+
+  return priv->current_frame ? priv->current_frame->input_buffer : NULL;
+}
+
+/**
+ * gst_h264_decoder_get_nal_length_size:
+ * @decoder: a #GstH264Decoder
+ *
+ * Retrieves the size of the length prefix of the NAL units of packetized
+ * input, as set by the codec data.
+ *
+ * Returns: the size in bytes, from 1 to 4, or 0 for byte-stream input
+ */
+guint
+gst_h264_decoder_get_nal_length_size (GstH264Decoder * decoder)
+{
+  GstH264DecoderPrivate *priv = decoder->priv;
+
+  if (priv->in_format == GST_H264_DECODER_FORMAT_AVC)
+    return priv->nal_length_size;
+  return 0;
+}
+
 /**
  * gst_h264_decoder_get_picture:
  * @decoder: a #GstH264Decoder
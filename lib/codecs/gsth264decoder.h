@@ -25,6 +25,7 @@
 #include <gst/video/video.h>
 #include <gst/codecparsers/gsth264parser.h>
 #include "gsth264picture.h"
+#include "gstcodecstats.h"
 
 G_BEGIN_DECLS
 
@@ -259,6 +260,19 @@ void gst_h264_decoder_set_process_ref_pic_lists (GstH264Decoder * decoder,
 GstH264Picture * gst_h264_decoder_get_picture   (GstH264Decoder * decoder,
                                                  guint32 system_frame_number);
 
+void gst_h264_decoder_set_keyframes_only (GstH264Decoder * decoder,
+                                          gboolean keyframes_only);
+
+void gst_h264_decoder_set_stats (GstH264Decoder * decoder,
+                                 GstCodecStats * stats);
+
+void gst_h264_decoder_set_picture_cache (GstH264Decoder * decoder,
+                                         GstCodecPictureCache * cache);
+
+GstBuffer * gst_h264_decoder_get_input_buffer (GstH264Decoder * decoder);
+
+guint gst_h264_decoder_get_nal_length_size (GstH264Decoder * decoder);
+
 G_END_DECLS
 
 #endif /* __GST_H264_DECODER_H__ */
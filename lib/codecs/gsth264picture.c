@@ -22,7 +22,9 @@
 #endif
 
 #include "gsth264picture.h"
+#include "gstcodecdpbmask.h"
 #include <stdlib.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_EXTERN (gst_h264_decoder_debug);
 #define GST_CAT_DEFAULT gst_h264_decoder_debug
@@ -32,10 +34,17 @@ GST_DEFINE_MINI_OBJECT_TYPE (GstH264Picture, gst_h264_picture);
 static void
 _gst_h264_picture_free (GstH264Picture * picture)
 {
+  GstCodecPictureCache *cache = picture->cache;
+
   if (picture->notify)
     picture->notify (picture->user_data);
 
-  g_free (picture);
+  if (cache) {
+    gst_codec_picture_cache_release (cache, picture);
+    gst_codec_picture_cache_unref (cache);
+  } else {
+    g_free (picture);
+  }
 }
 
 /**
@@ -47,10 +56,30 @@ _gst_h264_picture_free (GstH264Picture * picture)
  */
 GstH264Picture *
 gst_h264_picture_new (void)
+{
+  return gst_h264_picture_new_from_cache (NULL);
+}
+
+/**
+ * gst_h264_picture_new_from_cache:
+ * @cache: (nullable): a #GstCodecPictureCache of #GstH264Picture
+ *
+ * Create new #GstH264Picture, reusing a freed one kept by @cache, to which
+ * it returns once freed.
+ *
+ * Returns: a new #GstH264Picture
+ */
+GstH264Picture *
+gst_h264_picture_new_from_cache (GstCodecPictureCache * cache)
 {
   GstH264Picture *pic;
 
-  pic = g_new0 (GstH264Picture, 1);
+  if (cache) {
+    pic = gst_codec_picture_cache_acquire (cache);
+    pic->cache = gst_codec_picture_cache_ref (cache);
+  } else {
+    pic = g_new0 (GstH264Picture, 1);
+  }
 
   pic->top_field_order_cnt = G_MAXINT32;
   pic->bottom_field_order_cnt = G_MAXINT32;
@@ -103,9 +132,34 @@ gst_h264_picture_get_user_data (GstH264Picture * picture)
   return picture->user_data;
 }
 
+/* Room for the frames of the largest DPB, split in fields, and for the
+ * pictures overflowing it on broken streams */
+#define DPB_CAPACITY GST_CODEC_DPB_MASK_SIZE
+
 struct _GstH264Dpb
 {
+  /* The stored pictures, in decoding order. The fields the queries look
+   * at are copied, at the same index, in the columns and masks below, so
+   * a picture is only dereferenced once it's found. */
   GArray *pic_list;
+  gint32 poc[DPB_CAPACITY];
+  gint32 frame_num[DPB_CAPACITY];
+  gint32 frame_num_wrap[DPB_CAPACITY];
+  gint32 pic_num[DPB_CAPACITY];
+  gint32 long_term_pic_num[DPB_CAPACITY];
+  gint32 long_term_frame_idx[DPB_CAPACITY];
+  guint8 field[DPB_CAPACITY];
+
+  GstCodecDpbMask short_ref;
+  GstCodecDpbMask long_ref;
+  GstCodecDpbMask needed_for_output;
+  GstCodecDpbMask second_field;
+  GstCodecDpbMask nonexisting;
+  /* frames and complementary field pairs, as counted for the fullness */
+  GstCodecDpbMask frame_buffers;
+  /* frames and first fields of a pair, the pictures that can be output */
+  GstCodecDpbMask complete;
+
   gint max_num_frames;
   gint num_output_needed;
   guint32 max_num_reorder_frames;
@@ -115,6 +169,9 @@ struct _GstH264Dpb
   gboolean interlaced;
 };
 
+#define DPB_PICTURE(dpb, i) g_array_index ((dpb)->pic_list, GstH264Picture *, i)
+#define DPB_REF(dpb) ((dpb)->short_ref | (dpb)->long_ref)
+
 static void
 gst_h264_dpb_init (GstH264Dpb * dpb)
 {
@@ -123,6 +180,96 @@ gst_h264_dpb_init (GstH264Dpb * dpb)
   dpb->last_output_non_ref = FALSE;
 }
 
+/* Copies the fields of the picture at @i */
+static void
+gst_h264_dpb_store (GstH264Dpb * dpb, guint i)
+{
+  GstH264Picture *picture = DPB_PICTURE (dpb, i);
+  gboolean is_frame = GST_H264_PICTURE_IS_FRAME (picture);
+
+  dpb->poc[i] = picture->pic_order_cnt;
+  dpb->frame_num[i] = picture->frame_num;
+  dpb->frame_num_wrap[i] = picture->frame_num_wrap;
+  dpb->pic_num[i] = picture->pic_num;
+  dpb->long_term_pic_num[i] = picture->long_term_pic_num;
+  dpb->long_term_frame_idx[i] = picture->long_term_frame_idx;
+  dpb->field[i] = picture->field;
+
+  gst_codec_dpb_mask_set (&dpb->short_ref, i,
+      GST_H264_PICTURE_IS_SHORT_TERM_REF (picture));
+  gst_codec_dpb_mask_set (&dpb->long_ref, i,
+      GST_H264_PICTURE_IS_LONG_TERM_REF (picture));
+  gst_codec_dpb_mask_set (&dpb->needed_for_output, i,
+      picture->needed_for_output);
+  gst_codec_dpb_mask_set (&dpb->second_field, i, picture->second_field);
+  gst_codec_dpb_mask_set (&dpb->nonexisting, i, picture->nonexisting);
+  gst_codec_dpb_mask_set (&dpb->frame_buffers, i, !picture->second_field
+      && (is_frame || picture->other_field));
+  gst_codec_dpb_mask_set (&dpb->complete, i, is_frame
+      || (picture->other_field && !picture->second_field));
+}
+
+static gint
+gst_h264_dpb_find (GstH264Dpb * dpb, GstH264Picture * picture)
+{
+  gint i;
+
+  for (i = 0; i < dpb->pic_list->len; i++) {
+    if (DPB_PICTURE (dpb, i) == picture)
+      return i;
+  }
+
+  return -1;
+}
+
+/* Copies again the fields of @picture, and of its other field, if they are
+ * stored */
+static void
+gst_h264_dpb_refresh (GstH264Dpb * dpb, GstH264Picture * picture)
+{
+  gint i;
+
+  i = gst_h264_dpb_find (dpb, picture);
+  if (i >= 0)
+    gst_h264_dpb_store (dpb, i);
+
+  if (picture->other_field) {
+    i = gst_h264_dpb_find (dpb, picture->other_field);
+    if (i >= 0)
+      gst_h264_dpb_store (dpb, i);
+  }
+}
+
+/* NOTE: the order is kept, instead of moving the last picture to @i, since
+ * the last picture need to be referenced for bumping decision */
+static void
+gst_h264_dpb_remove (GstH264Dpb * dpb, guint i)
+{
+  guint n = dpb->pic_list->len - i - 1;
+
+  g_array_remove_index (dpb->pic_list, i);
+
+#define REMOVE_COLUMN(column) \
+  memmove (&dpb->column[i], &dpb->column[i + 1], n * sizeof (dpb->column[0]))
+  REMOVE_COLUMN (poc);
+  REMOVE_COLUMN (frame_num);
+  REMOVE_COLUMN (frame_num_wrap);
+  REMOVE_COLUMN (pic_num);
+  REMOVE_COLUMN (long_term_pic_num);
+  REMOVE_COLUMN (long_term_frame_idx);
+  REMOVE_COLUMN (field);
+#undef REMOVE_COLUMN
+
+  dpb->short_ref = gst_codec_dpb_mask_remove (dpb->short_ref, i);
+  dpb->long_ref = gst_codec_dpb_mask_remove (dpb->long_ref, i);
+  dpb->needed_for_output =
+      gst_codec_dpb_mask_remove (dpb->needed_for_output, i);
+  dpb->second_field = gst_codec_dpb_mask_remove (dpb->second_field, i);
+  dpb->nonexisting = gst_codec_dpb_mask_remove (dpb->nonexisting, i);
+  dpb->frame_buffers = gst_codec_dpb_mask_remove (dpb->frame_buffers, i);
+  dpb->complete = gst_codec_dpb_mask_remove (dpb->complete, i);
+}
+
 /**
  * gst_h264_dpb_new: (skip)
  *
@@ -139,8 +286,7 @@ gst_h264_dpb_new (void)
   gst_h264_dpb_init (dpb);
 
   dpb->pic_list =
-      g_array_sized_new (FALSE, TRUE, sizeof (GstH264Picture *),
-      GST_H264_DPB_MAX_SIZE);
+      g_array_sized_new (FALSE, TRUE, sizeof (GstH264Picture *), DPB_CAPACITY);
   g_array_set_clear_func (dpb->pic_list,
       (GDestroyNotify) gst_clear_h264_picture);
 
@@ -239,6 +385,9 @@ gst_h264_dpb_clear (GstH264Dpb * dpb)
   g_return_if_fail (dpb != NULL);
 
   g_array_set_size (dpb->pic_list, 0);
+  dpb->short_ref = dpb->long_ref = 0;
+  dpb->needed_for_output = dpb->second_field = dpb->nonexisting = 0;
+  dpb->frame_buffers = dpb->complete = 0;
   gst_h264_dpb_init (dpb);
 }
 
@@ -273,6 +422,13 @@ gst_h264_dpb_add (GstH264Dpb * dpb, GstH264Picture * picture)
   g_return_if_fail (dpb != NULL);
   g_return_if_fail (GST_IS_H264_PICTURE (picture));
 
+  if (dpb->pic_list->len >= DPB_CAPACITY) {
+    GST_ERROR ("DPB is full with %d pictures, dropping picture %p",
+        dpb->pic_list->len, picture);
+    gst_h264_picture_unref (picture);
+    return;
+  }
+
   /* C.4.2 Decoding of gaps in frame_num and storage of "non-existing" pictures
    *
    * The "non-existing" frame is stored in an empty frame buffer and is marked
@@ -295,9 +451,11 @@ gst_h264_dpb_add (GstH264Dpb * dpb, GstH264Picture * picture)
   /* Link each field */
   if (picture->second_field && picture->other_field) {
     picture->other_field->other_field = picture;
+    gst_h264_dpb_refresh (dpb, picture->other_field);
   }
 
   g_array_append_val (dpb->pic_list, picture);
+  gst_h264_dpb_store (dpb, dpb->pic_list->len - 1);
 
   if (dpb->pic_list->len > dpb->max_num_frames * (dpb->interlaced + 1))
     GST_ERROR ("DPB size is %d, exceed the max size %d",
@@ -324,18 +482,16 @@ gst_h264_dpb_delete_unused (GstH264Dpb * dpb)
 
   g_return_if_fail (dpb != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
+  /* from the end, so the indices left to visit don't move */
+  for (i = dpb->pic_list->len - 1; i >= 0; i--) {
+    GstCodecDpbMask used = dpb->needed_for_output | DPB_REF (dpb);
 
-    /* NOTE: don't use g_array_remove_index_fast here since the last picture
-     * need to be referenced for bumping decision */
-    if (!picture->needed_for_output && !GST_H264_PICTURE_IS_REF (picture)) {
+    if (!(used & GST_CODEC_DPB_MASK_BIT (i))) {
       GST_TRACE
           ("remove picture %p (frame num: %d, poc: %d, field: %d) from dpb",
-          picture, picture->frame_num, picture->pic_order_cnt, picture->field);
-      g_array_remove_index (dpb->pic_list, i);
-      i--;
+          DPB_PICTURE (dpb, i), dpb->frame_num[i], dpb->poc[i],
+          dpb->field[i]);
+      gst_h264_dpb_remove (dpb, i);
     }
   }
 }
@@ -351,24 +507,10 @@ gst_h264_dpb_delete_unused (GstH264Dpb * dpb)
 gint
 gst_h264_dpb_num_ref_frames (GstH264Dpb * dpb)
 {
-  gint i;
-  gint ret = 0;
-
   g_return_val_if_fail (dpb != NULL, -1);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    /* Count frame, not field picture */
-    if (picture->second_field)
-      continue;
-
-    if (GST_H264_PICTURE_IS_REF (picture))
-      ret++;
-  }
-
-  return ret;
+  /* Count frame, not field picture */
+  return gst_codec_dpb_mask_count (DPB_REF (dpb) & ~dpb->second_field);
 }
 
 /**
@@ -380,16 +522,18 @@ gst_h264_dpb_num_ref_frames (GstH264Dpb * dpb)
 void
 gst_h264_dpb_mark_all_non_ref (GstH264Dpb * dpb)
 {
+  GstCodecDpbMask ref;
   gint i;
 
   g_return_if_fail (dpb != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    gst_h264_picture_set_reference (picture, GST_H264_PICTURE_REF_NONE, FALSE);
+  ref = DPB_REF (dpb);
+  GST_CODEC_DPB_MASK_FOREACH (i, ref) {
+    gst_h264_picture_set_reference (DPB_PICTURE (dpb, i),
+        GST_H264_PICTURE_REF_NONE, FALSE);
   }
+
+  dpb->short_ref = dpb->long_ref = 0;
 }
 
 /**
@@ -404,17 +548,15 @@ gst_h264_dpb_mark_all_non_ref (GstH264Dpb * dpb)
 GstH264Picture *
 gst_h264_dpb_get_short_ref_by_pic_num (GstH264Dpb * dpb, gint pic_num)
 {
+  GstCodecDpbMask short_ref;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    if (GST_H264_PICTURE_IS_SHORT_TERM_REF (picture)
-        && picture->pic_num == pic_num)
-      return picture;
+  short_ref = dpb->short_ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, short_ref) {
+    if (dpb->pic_num[i] == pic_num)
+      return DPB_PICTURE (dpb, i);
   }
 
   GST_WARNING ("No short term reference picture for %d", pic_num);
@@ -437,17 +579,15 @@ GstH264Picture *
 gst_h264_dpb_get_long_ref_by_long_term_pic_num (GstH264Dpb * dpb,
     gint long_term_pic_num)
 {
+  GstCodecDpbMask long_ref;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture) &&
-        picture->long_term_pic_num == long_term_pic_num)
-      return picture;
+  long_ref = dpb->long_ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, long_ref) {
+    if (dpb->long_term_pic_num[i] == long_term_pic_num)
+      return DPB_PICTURE (dpb, i);
   }
 
   GST_WARNING ("No long term reference picture for %d", long_term_pic_num);
@@ -466,24 +606,22 @@ gst_h264_dpb_get_long_ref_by_long_term_pic_num (GstH264Dpb * dpb,
 GstH264Picture *
 gst_h264_dpb_get_lowest_frame_num_short_ref (GstH264Dpb * dpb)
 {
+  GstCodecDpbMask short_ref;
   gint i;
-  GstH264Picture *ret = NULL;
+  gint lowest = -1;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    if (GST_H264_PICTURE_IS_SHORT_TERM_REF (picture) &&
-        (!ret || picture->frame_num_wrap < ret->frame_num_wrap))
-      ret = picture;
+  short_ref = dpb->short_ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, short_ref) {
+    if (lowest < 0 || dpb->frame_num_wrap[i] < dpb->frame_num_wrap[lowest])
+      lowest = i;
   }
 
-  if (ret)
-    gst_h264_picture_ref (ret);
+  if (lowest < 0)
+    return NULL;
 
-  return ret;
+  return gst_h264_picture_ref (DPB_PICTURE (dpb, lowest));
 }
 
 /**
@@ -503,24 +641,21 @@ void
 gst_h264_dpb_get_pictures_short_term_ref (GstH264Dpb * dpb,
     gboolean include_non_existing, gboolean include_second_field, GArray * out)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_if_fail (dpb != NULL);
   g_return_if_fail (out != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    if (!include_second_field && picture->second_field)
-      continue;
+  mask = dpb->short_ref;
+  if (!include_second_field)
+    mask &= ~dpb->second_field;
+  if (!include_non_existing)
+    mask &= ~dpb->nonexisting;
 
-    if (GST_H264_PICTURE_IS_SHORT_TERM_REF (picture) &&
-        (include_non_existing || (!include_non_existing &&
-                !picture->nonexisting))) {
-      gst_h264_picture_ref (picture);
-      g_array_append_val (out, picture);
-    }
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    GstH264Picture *picture = gst_h264_picture_ref (DPB_PICTURE (dpb, i));
+    g_array_append_val (out, picture);
   }
 }
 
@@ -540,22 +675,19 @@ void
 gst_h264_dpb_get_pictures_long_term_ref (GstH264Dpb * dpb,
     gboolean include_second_field, GArray * out)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_if_fail (dpb != NULL);
   g_return_if_fail (out != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
+  mask = dpb->long_ref;
+  if (!include_second_field)
+    mask &= ~dpb->second_field;
 
-    if (!include_second_field && picture->second_field)
-      continue;
-
-    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture)) {
-      gst_h264_picture_ref (picture);
-      g_array_append_val (out, picture);
-    }
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    GstH264Picture *picture = gst_h264_picture_ref (DPB_PICTURE (dpb, i));
+    g_array_append_val (out, picture);
   }
 }
 
@@ -634,21 +766,8 @@ gst_h264_dpb_has_empty_frame_buffer (GstH264Dpb * dpb)
     if (dpb->pic_list->len < dpb->max_num_frames)
       return TRUE;
   } else {
-    gint i;
-    gint count = 0;
     /* Count the number of complementary field pairs */
-    for (i = 0; i < dpb->pic_list->len; i++) {
-      GstH264Picture *picture =
-          g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-      if (picture->second_field)
-        continue;
-
-      if (GST_H264_PICTURE_IS_FRAME (picture) || picture->other_field)
-        count++;
-    }
-
-    if (count < dpb->max_num_frames)
+    if (gst_codec_dpb_mask_count (dpb->frame_buffers) < dpb->max_num_frames)
       return TRUE;
   }
 
@@ -659,37 +778,20 @@ static gint
 gst_h264_dpb_get_lowest_output_needed_picture (GstH264Dpb * dpb,
     GstH264Picture ** picture)
 {
+  GstCodecDpbMask mask;
   gint i;
-  GstH264Picture *lowest = NULL;
   gint index = -1;
 
   *picture = NULL;
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH264Picture *picture =
-        g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-    if (!picture->needed_for_output)
-      continue;
-
-    if (!GST_H264_PICTURE_IS_FRAME (picture) &&
-        (!picture->other_field || picture->second_field))
-      continue;
-
-    if (!lowest) {
-      lowest = picture;
-      index = i;
-      continue;
-    }
-
-    if (picture->pic_order_cnt < lowest->pic_order_cnt) {
-      lowest = picture;
+  mask = dpb->needed_for_output & dpb->complete;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    if (index < 0 || dpb->poc[i] < dpb->poc[index])
       index = i;
-    }
   }
 
-  if (lowest)
-    *picture = gst_h264_picture_ref (lowest);
+  if (index >= 0)
+    *picture = gst_h264_picture_ref (DPB_PICTURE (dpb, index));
 
   return index;
 }
@@ -754,14 +856,10 @@ gst_h264_dpb_needs_bump (GstH264Dpb * dpb, GstH264Picture * to_insert,
        precede any frame in the coded video sequence in decoding order
        and follow it in output order. Safe. */
     if (lowest_index >= dpb->max_num_reorder_frames) {
-      guint i, need_output;
+      guint need_output;
 
-      need_output = 0;
-      for (i = 0; i < lowest_index; i++) {
-        GstH264Picture *p = g_array_index (dpb->pic_list, GstH264Picture *, i);
-        if (p->needed_for_output)
-          need_output++;
-      }
+      need_output = gst_codec_dpb_mask_count (dpb->needed_for_output &
+          GST_CODEC_DPB_MASK_BELOW (lowest_index));
 
       if (need_output >= dpb->max_num_reorder_frames) {
         GST_TRACE ("frame with lowest poc %d has %d precede frame, already"
@@ -893,18 +991,20 @@ gst_h264_dpb_bump (GstH264Dpb * dpb, gboolean drain)
     return NULL;
 
   picture->needed_for_output = FALSE;
+  gst_codec_dpb_mask_set (&dpb->needed_for_output, index, FALSE);
 
   dpb->num_output_needed--;
   g_assert (dpb->num_output_needed >= 0);
 
-  /* NOTE: don't use g_array_remove_index_fast here since the last picture
-   * need to be referenced for bumping decision */
-  if (!GST_H264_PICTURE_IS_REF (picture) || drain)
-    g_array_remove_index (dpb->pic_list, index);
+  if (!(DPB_REF (dpb) & GST_CODEC_DPB_MASK_BIT (index)) || drain)
+    gst_h264_dpb_remove (dpb, index);
 
   other_picture = picture->other_field;
   if (other_picture) {
     other_picture->needed_for_output = FALSE;
+    i = gst_h264_dpb_find (dpb, other_picture);
+    if (i >= 0)
+      gst_codec_dpb_mask_set (&dpb->needed_for_output, i, FALSE);
 
     /* At this moment, this picture should be interlaced */
     picture->buffer_flags |= GST_VIDEO_BUFFER_FLAG_INTERLACED;
@@ -914,17 +1014,8 @@ gst_h264_dpb_bump (GstH264Dpb * dpb, gboolean drain)
     if (picture->pic_order_cnt < other_picture->pic_order_cnt)
       picture->buffer_flags |= GST_VIDEO_BUFFER_FLAG_TFF;
 
-    if (!other_picture->ref) {
-      for (i = 0; i < dpb->pic_list->len; i++) {
-        GstH264Picture *tmp =
-            g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-        if (tmp == other_picture) {
-          g_array_remove_index (dpb->pic_list, i);
-          break;
-        }
-      }
-    }
+    if (!other_picture->ref && i >= 0)
+      gst_h264_dpb_remove (dpb, i);
     /* Now other field may or may not exist */
   }
 
@@ -954,6 +1045,88 @@ gst_h264_dpb_set_last_output (GstH264Dpb * dpb, GstH264Picture * picture)
   dpb->last_output_non_ref = !picture->ref_pic;
 }
 
+/**
+ * gst_h264_dpb_set_reference:
+ * @dpb: a #GstH264Dpb
+ * @picture: a #GstH264Picture stored in @dpb
+ * @reference: a GstH264PictureReference
+ * @other_field: %TRUE if @reference needs to be applied to the
+ * other field if any
+ *
+ * Same as gst_h264_picture_set_reference(), for pictures in @dpb, which
+ * keeps a copy of their reference state.
+ */
+void
+gst_h264_dpb_set_reference (GstH264Dpb * dpb, GstH264Picture * picture,
+    GstH264PictureReference reference, gboolean other_field)
+{
+  g_return_if_fail (dpb != NULL);
+  g_return_if_fail (picture != NULL);
+
+  gst_h264_picture_set_reference (picture, reference, other_field);
+  gst_h264_dpb_refresh (dpb, picture);
+}
+
+/**
+ * gst_h264_dpb_update_pic_nums:
+ * @dpb: a #GstH264Dpb
+ * @current_picture: the #GstH264Picture being decoded
+ * @frame_num: the frame_num of @current_picture
+ * @max_frame_num: MaxFrameNum of the active SPS
+ *
+ * Derive FrameNumWrap, PicNum and LongTermPicNum of the reference pictures,
+ * as in "8.2.4.1 Decoding process for picture numbers"
+ */
+void
+gst_h264_dpb_update_pic_nums (GstH264Dpb * dpb,
+    GstH264Picture * current_picture, gint frame_num, gint max_frame_num)
+{
+  gboolean is_frame;
+  GstCodecDpbMask mask;
+  gint i;
+
+  g_return_if_fail (dpb != NULL);
+  g_return_if_fail (current_picture != NULL);
+
+  is_frame = GST_H264_PICTURE_IS_FRAME (current_picture);
+
+  mask = dpb->long_ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    gint long_term_pic_num;
+
+    if (is_frame)
+      long_term_pic_num = dpb->long_term_frame_idx[i];
+    else if (current_picture->field == dpb->field[i])
+      long_term_pic_num = 2 * dpb->long_term_frame_idx[i] + 1;
+    else
+      long_term_pic_num = 2 * dpb->long_term_frame_idx[i];
+
+    dpb->long_term_pic_num[i] = long_term_pic_num;
+    DPB_PICTURE (dpb, i)->long_term_pic_num = long_term_pic_num;
+  }
+
+  mask = dpb->short_ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    GstH264Picture *picture = DPB_PICTURE (dpb, i);
+    gint frame_num_wrap, pic_num;
+
+    if (dpb->frame_num[i] > frame_num)
+      frame_num_wrap = dpb->frame_num[i] - max_frame_num;
+    else
+      frame_num_wrap = dpb->frame_num[i];
+
+    if (is_frame)
+      pic_num = frame_num_wrap;
+    else if (dpb->field[i] == current_picture->field)
+      pic_num = 2 * frame_num_wrap + 1;
+    else
+      pic_num = 2 * frame_num_wrap;
+
+    dpb->frame_num_wrap[i] = picture->frame_num_wrap = frame_num_wrap;
+    dpb->pic_num[i] = picture->pic_num = pic_num;
+  }
+}
+
 static gint
 get_picNumX (GstH264Picture * picture, GstH264RefPicMarking * ref_pic_marking)
 {
@@ -981,6 +1154,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
   gint pic_num_x;
   gint max_long_term_frame_idx;
   GstH264Picture *other;
+  GstCodecDpbMask long_ref;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, FALSE);
@@ -999,7 +1173,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
       pic_num_x = get_picNumX (picture, ref_pic_marking);
       other = gst_h264_dpb_get_short_ref_by_pic_num (dpb, pic_num_x);
       if (other) {
-        gst_h264_picture_set_reference (other,
+        gst_h264_dpb_set_reference (dpb, other,
             GST_H264_PICTURE_REF_NONE, GST_H264_PICTURE_IS_FRAME (picture));
         GST_TRACE ("MMCO-1: unmark short-term ref picture %p, (poc %d)",
             other, other->pic_order_cnt);
@@ -1014,7 +1188,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
       other = gst_h264_dpb_get_long_ref_by_long_term_pic_num (dpb,
           ref_pic_marking->long_term_pic_num);
       if (other) {
-        gst_h264_picture_set_reference (other,
+        gst_h264_dpb_set_reference (dpb, other,
             GST_H264_PICTURE_REF_NONE, FALSE);
         GST_TRACE ("MMCO-2: unmark long-term ref picture %p, (poc %d)",
             other, other->pic_order_cnt);
@@ -1037,17 +1211,17 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
 
       /* If we have long-term ref picture for LongTermFrameIdx,
        * mark the picture as non-reference */
-      for (i = 0; i < dpb->pic_list->len; i++) {
-        GstH264Picture *tmp =
-            g_array_index (dpb->pic_list, GstH264Picture *, i);
+      long_ref = dpb->long_ref;
+      GST_CODEC_DPB_MASK_FOREACH (i, long_ref) {
+        GstH264Picture *tmp = DPB_PICTURE (dpb, i);
 
-        if (GST_H264_PICTURE_IS_LONG_TERM_REF (tmp)
-            && tmp->long_term_frame_idx == ref_pic_marking->long_term_frame_idx) {
+        if (dpb->long_term_frame_idx[i] ==
+            ref_pic_marking->long_term_frame_idx) {
           if (GST_H264_PICTURE_IS_FRAME (tmp)) {
             /* When long_term_frame_idx is already assigned to a long-term
              * reference frame, that frame is marked as "unused for reference"
              */
-            gst_h264_picture_set_reference (tmp,
+            gst_h264_dpb_set_reference (dpb, tmp,
                 GST_H264_PICTURE_REF_NONE, TRUE);
             GST_TRACE ("MMCO-3: unmark old long-term frame %p (poc %d)",
                 tmp, tmp->pic_order_cnt);
@@ -1059,7 +1233,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
              * reference field pair, that complementary field pair and both of
              * its fields are marked as "unused for reference"
              */
-            gst_h264_picture_set_reference (tmp,
+            gst_h264_dpb_set_reference (dpb, tmp,
                 GST_H264_PICTURE_REF_NONE, TRUE);
             GST_TRACE ("MMCO-3: unmark old long-term field-pair %p (poc %d)",
                 tmp, tmp->pic_order_cnt);
@@ -1077,13 +1251,13 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
             /* NOTE: "other" here is short-ref, so "other" and "tmp" must not be
              * identical picture */
             if (!tmp->other_field) {
-              gst_h264_picture_set_reference (tmp,
+              gst_h264_dpb_set_reference (dpb, tmp,
                   GST_H264_PICTURE_REF_NONE, FALSE);
               GST_TRACE ("MMCO-3: unmark old long-term field %p (poc %d)",
                   tmp, tmp->pic_order_cnt);
             } else if (tmp->other_field != other &&
                 (!other->other_field || other->other_field != tmp)) {
-              gst_h264_picture_set_reference (tmp,
+              gst_h264_dpb_set_reference (dpb, tmp,
                   GST_H264_PICTURE_REF_NONE, FALSE);
               GST_TRACE ("MMCO-3: unmark old long-term field %p (poc %d)",
                   tmp, tmp->pic_order_cnt);
@@ -1105,6 +1279,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
         other->other_field->long_term_frame_idx =
             ref_pic_marking->long_term_frame_idx;
       }
+      gst_h264_dpb_refresh (dpb, other);
       break;
     case 4:
       /* 8.2.5.4.4  All pictures for which LongTermFrameIdx is greater than
@@ -1115,12 +1290,12 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
 
       GST_TRACE ("MMCO-4: max_long_term_frame_idx %d", max_long_term_frame_idx);
 
-      for (i = 0; i < dpb->pic_list->len; i++) {
-        other = g_array_index (dpb->pic_list, GstH264Picture *, i);
+      long_ref = dpb->long_ref;
+      GST_CODEC_DPB_MASK_FOREACH (i, long_ref) {
+        other = DPB_PICTURE (dpb, i);
 
-        if (GST_H264_PICTURE_IS_LONG_TERM_REF (other) &&
-            other->long_term_frame_idx > max_long_term_frame_idx) {
-          gst_h264_picture_set_reference (other,
+        if (dpb->long_term_frame_idx[i] > max_long_term_frame_idx) {
+          gst_h264_dpb_set_reference (dpb, other,
               GST_H264_PICTURE_REF_NONE, FALSE);
           GST_TRACE ("MMCO-4: unmark long-term ref pic %p, index %d, (poc %d)",
               other, other->long_term_frame_idx, other->pic_order_cnt);
@@ -1129,11 +1304,7 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
       break;
     case 5:
       /* 8.2.5.4.5 Unmark all reference pictures */
-      for (i = 0; i < dpb->pic_list->len; i++) {
-        other = g_array_index (dpb->pic_list, GstH264Picture *, i);
-        gst_h264_picture_set_reference (other,
-            GST_H264_PICTURE_REF_NONE, FALSE);
-      }
+      gst_h264_dpb_mark_all_non_ref (dpb);
       picture->mem_mgmt_5 = TRUE;
       picture->frame_num = 0;
       /* When the current picture includes a memory management control operation
@@ -1159,15 +1330,14 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
 
       /* If we have long-term ref picture for LongTermFrameIdx,
        * mark the picture as non-reference */
-      for (i = 0; i < dpb->pic_list->len; i++) {
-        other = g_array_index (dpb->pic_list, GstH264Picture *, i);
-
-        if (GST_H264_PICTURE_IS_LONG_TERM_REF (other) &&
-            other->long_term_frame_idx ==
+      long_ref = dpb->long_ref;
+      GST_CODEC_DPB_MASK_FOREACH (i, long_ref) {
+        if (dpb->long_term_frame_idx[i] ==
             ref_pic_marking->long_term_frame_idx) {
+          other = DPB_PICTURE (dpb, i);
           GST_TRACE ("MMCO-6: unmark old long-term ref pic %p (poc %d)",
               other, other->pic_order_cnt);
-          gst_h264_picture_set_reference (other,
+          gst_h264_dpb_set_reference (dpb, other,
               GST_H264_PICTURE_REF_NONE, TRUE);
           break;
         }
@@ -1181,6 +1351,8 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
         picture->other_field->long_term_frame_idx =
             ref_pic_marking->long_term_frame_idx;
       }
+      /* the first field is stored already */
+      gst_h264_dpb_refresh (dpb, picture);
       break;
     default:
       g_assert_not_reached ();
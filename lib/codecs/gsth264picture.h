@@ -21,6 +21,7 @@
 #define __GST_H264_PICTURE_H__
 
 #include "codecs-prelude.h"
+#include "gstcodecpicturecache.h"
 #include <gst/codecparsers/gsth264parser.h>
 #include <gst/video/video.h>
 
@@ -163,6 +164,9 @@ struct _GstH264Picture
 
   gpointer user_data;
   GDestroyNotify notify;
+
+  /* where it returns once freed, if any */
+  GstCodecPictureCache *cache;
 };
 
 /**
@@ -186,6 +190,8 @@ GType gst_h264_picture_get_type (void);
 
 GstH264Picture * gst_h264_picture_new (void);
 
+GstH264Picture * gst_h264_picture_new_from_cache (GstCodecPictureCache * cache);
+
 static inline GstH264Picture *
 gst_h264_picture_ref (GstH264Picture * picture)
 {
@@ -321,6 +327,18 @@ gboolean         gst_h264_dpb_perform_memory_management_control_operation (GstH2
                                                                            GstH264RefPicMarking *ref_pic_marking,
                                                                            GstH264Picture * picture);
 
+
+void  gst_h264_dpb_set_reference    (GstH264Dpb * dpb,
+                                     GstH264Picture * picture,
+                                     GstH264PictureReference reference,
+                                     gboolean other_field);
+
+
+void  gst_h264_dpb_update_pic_nums  (GstH264Dpb * dpb,
+                                     GstH264Picture * current_picture,
+                                     gint frame_num,
+                                     gint max_frame_num);
+
 /* Internal methods */
 void  gst_h264_picture_set_reference (GstH264Picture * picture,
                                       GstH264PictureReference reference,
@@ -32,6 +32,10 @@
 
 #include <gst/base/base.h>
 #include "gsth265decoder.h"
+#include "gstcodecdpbsize.h"
+#include "gstcodecevent.h"
+#include "gstcodecparamsets.h"
+#include "gststartcode.h"
 
 GST_DEBUG_CATEGORY (gst_h265_decoder_debug);
 #define GST_CAT_DEFAULT gst_h265_decoder_debug
@@ -121,6 +125,11 @@ struct _GstH265DecoderPrivate
   gboolean new_bitstream;
   gboolean prev_nal_is_eos;
 
+  /* only IRAP pictures are decoded */
+  gboolean keyframes_only;
+  /* NAL units with a higher TemporalId are dropped, 0 keeps all */
+  guint temporal_layers;
+
   /* Reference picture lists, constructed for each slice */
   gboolean process_ref_pic_lists;
   GArray *ref_pic_list_tmp;
@@ -133,6 +142,21 @@ struct _GstH265DecoderPrivate
   guint preferred_output_delay;
   gboolean is_live;
   GstQueueArray *output_queue;
+
+  /* raw VPS, SPS and PPS held by the parser, to skip the ones re-sent */
+  GstCodecParamSets *param_sets;
+
+  GstCodecStats *stats;
+
+  /* set by the subclass, where the pictures come from */
+  GstCodecPictureCache *picture_cache;
+
+  /* access unit framing of unaligned byte-stream input: bytes of the
+   * adapter already scanned, whether they hold a slice, and whether the
+   * next buffer ends the access unit */
+  gsize parse_offset;
+  gboolean parse_has_vcl;
+  gboolean parse_au_end;
 };
 
 typedef struct
@@ -175,6 +199,10 @@ static gboolean gst_h265_decoder_set_format (GstVideoDecoder * decoder,
 static GstFlowReturn gst_h265_decoder_finish (GstVideoDecoder * decoder);
 static gboolean gst_h265_decoder_flush (GstVideoDecoder * decoder);
 static GstFlowReturn gst_h265_decoder_drain (GstVideoDecoder * decoder);
+static gboolean gst_h265_decoder_sink_event (GstVideoDecoder * decoder,
+    GstEvent * event);
+static GstFlowReturn gst_h265_decoder_parse (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame, GstAdapter * adapter, gboolean at_eos);
 static GstFlowReturn gst_h265_decoder_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
 
@@ -203,6 +231,8 @@ gst_h265_decoder_class_init (GstH265DecoderClass * klass)
   decoder_class->finish = GST_DEBUG_FUNCPTR (gst_h265_decoder_finish);
   decoder_class->flush = GST_DEBUG_FUNCPTR (gst_h265_decoder_flush);
   decoder_class->drain = GST_DEBUG_FUNCPTR (gst_h265_decoder_drain);
+  decoder_class->sink_event = GST_DEBUG_FUNCPTR (gst_h265_decoder_sink_event);
+  decoder_class->parse = GST_DEBUG_FUNCPTR (gst_h265_decoder_parse);
   decoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_h265_decoder_handle_frame);
 }
@@ -232,6 +262,8 @@ gst_h265_decoder_init (GstH265Decoder * self)
       gst_queue_array_new_for_struct (sizeof (GstH265DecoderOutputFrame), 1);
   gst_queue_array_set_clear_func (priv->output_queue,
       (GDestroyNotify) gst_h265_decoder_clear_output_frame);
+
+  priv->param_sets = gst_codec_param_sets_new ();
 }
 
 static void
@@ -245,6 +277,9 @@ gst_h265_decoder_finalize (GObject * object)
   g_array_unref (priv->ref_pic_list1);
   g_array_unref (priv->nalu);
   gst_queue_array_free (priv->output_queue);
+  gst_codec_param_sets_free (priv->param_sets);
+  g_clear_pointer (&priv->stats, gst_codec_stats_unref);
+  g_clear_pointer (&priv->picture_cache, gst_codec_picture_cache_unref);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -256,9 +291,13 @@ gst_h265_decoder_start (GstVideoDecoder * decoder)
   GstH265DecoderPrivate *priv = self->priv;
 
   priv->parser = gst_h265_parser_new ();
+  gst_codec_param_sets_clear (priv->param_sets);
   priv->dpb = gst_h265_dpb_new ();
   priv->new_bitstream = TRUE;
   priv->prev_nal_is_eos = FALSE;
+  priv->parse_offset = 0;
+  priv->parse_has_vcl = FALSE;
+  priv->parse_au_end = FALSE;
 
   return TRUE;
 }
@@ -280,6 +319,7 @@ gst_h265_decoder_stop (GstVideoDecoder * decoder)
     gst_h265_parser_free (priv->parser);
     priv->parser = NULL;
   }
+  gst_codec_param_sets_clear (priv->param_sets);
 
   if (priv->dpb) {
     gst_h265_dpb_free (priv->dpb);
@@ -351,27 +391,12 @@ gst_h265_decoder_process_sps (GstH265Decoder * self, GstH265SPS * sps)
   GstH265DecoderPrivate *priv = self->priv;
   gint max_dpb_size;
   gint prev_max_dpb_size;
-  gint MaxLumaPS;
-  const gint MaxDpbPicBuf = 6;
-  gint PicSizeInSamplesY;
   guint8 field_seq_flag = 0;
   guint8 progressive_source_flag = 0;
   guint8 interlaced_source_flag = 0;
   GstFlowReturn ret = GST_FLOW_OK;
 
-  /* A.4.1 */
-  MaxLumaPS = 35651584;
-  PicSizeInSamplesY = sps->width * sps->height;
-  if (PicSizeInSamplesY <= (MaxLumaPS >> 2))
-    max_dpb_size = MaxDpbPicBuf * 4;
-  else if (PicSizeInSamplesY <= (MaxLumaPS >> 1))
-    max_dpb_size = MaxDpbPicBuf * 2;
-  else if (PicSizeInSamplesY <= ((3 * MaxLumaPS) >> 2))
-    max_dpb_size = (MaxDpbPicBuf * 4) / 3;
-  else
-    max_dpb_size = MaxDpbPicBuf;
-
-  max_dpb_size = MIN (max_dpb_size, 16);
+  max_dpb_size = gst_codec_h265_get_max_dpb_size (sps);
 
   if (sps->vui_parameters_present_flag)
     field_seq_flag = sps->vui_params.field_seq_flag;
@@ -629,9 +654,12 @@ gst_h265_decoder_decode_slice (GstH265Decoder * self)
   g_assert (klass->decode_slice);
 
   if (priv->process_ref_pic_lists) {
+    GstClockTime start = gst_codec_stats_start (priv->stats);
+
     l0 = priv->ref_pic_list0;
     l1 = priv->ref_pic_list1;
     gst_h265_decoder_process_ref_pic_lists (self, picture, slice, &l0, &l1);
+    gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
   }
 
   ret = klass->decode_slice (self, picture, slice, l0, l1);
@@ -694,7 +722,7 @@ gst_h265_decoder_process_slice (GstH265Decoder * self, GstH265Slice * slice)
 
     g_assert (priv->current_frame);
 
-    picture = gst_h265_picture_new ();
+    picture = gst_h265_picture_new_from_cache (priv->picture_cache);
     /* This allows accessing the frame from the picture. */
     picture->system_frame_number = priv->current_frame->system_frame_number;
 
@@ -755,12 +783,13 @@ gst_h265_decoder_parse_slice (GstH265Decoder * self, GstH265NalUnit * nalu)
    * 2) a BLA picture
    * 3) a CRA picture that is the first access unit in the bitstream
    * 4) first picture that follows an end of sequence NAL unit in decoding order
-   * 5) has HandleCraAsBlaFlag == 1 (set by external means, so not considering )
+   * 5) has HandleCraAsBlaFlag == 1, which is the case when only the keyframes
+   *    are decoded, since the pictures preceding it were skipped
    */
   if (GST_H265_IS_NAL_TYPE_IDR (nalu->type) ||
       GST_H265_IS_NAL_TYPE_BLA (nalu->type) ||
-      (GST_H265_IS_NAL_TYPE_CRA (nalu->type) && priv->new_bitstream) ||
-      priv->prev_nal_is_eos) {
+      (GST_H265_IS_NAL_TYPE_CRA (nalu->type) && (priv->new_bitstream
+              || priv->keyframes_only)) || priv->prev_nal_is_eos) {
     slice.no_rasl_output_flag = TRUE;
   }
 
@@ -770,7 +799,8 @@ gst_h265_decoder_parse_slice (GstH265Decoder * self, GstH265NalUnit * nalu)
     if (slice.no_rasl_output_flag && !priv->new_bitstream) {
       /* C 3.2 */
       slice.clear_dpb = TRUE;
-      if (nalu->type == GST_H265_NAL_SLICE_CRA_NUT) {
+      /* the prior keyframes are still to be output */
+      if (nalu->type == GST_H265_NAL_SLICE_CRA_NUT && !priv->keyframes_only) {
         slice.no_output_of_prior_pics_flag = TRUE;
       } else {
         slice.no_output_of_prior_pics_flag =
@@ -789,6 +819,23 @@ gst_h265_decoder_parse_slice (GstH265Decoder * self, GstH265NalUnit * nalu)
   return GST_H265_PARSER_OK;
 }
 
+/* Whether @nalu is byte-identical to the parameter set of its id held by
+ * the parser, which is returned then. */
+static gboolean
+gst_h265_decoder_is_param_set_resent (GstH265Decoder * self,
+    GstH265NalUnit * nalu, GstCodecParamSetType type, guint * id)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  if (!gst_codec_param_sets_lookup (priv->param_sets, type,
+          nalu->data + nalu->offset, nalu->size, id))
+    return FALSE;
+
+  gst_codec_stats_add (priv->stats, GST_CODEC_STATS_PARAM_SETS_SKIPPED, 1);
+
+  return TRUE;
+}
+
 static GstH265ParserResult
 gst_h265_decoder_parse_nalu (GstH265Decoder * self, GstH265NalUnit * nalu)
 {
@@ -799,17 +846,51 @@ gst_h265_decoder_parse_nalu (GstH265Decoder * self, GstH265NalUnit * nalu)
   GstH265ParserResult ret = GST_H265_PARSER_OK;
   GstH265DecoderNalUnit decoder_nalu;
   GstH265DecoderClass* klass = GST_H265_DECODER_GET_CLASS (self);
+  guint id;
 
   GST_LOG_OBJECT (self, "Parsed nal type: %d, offset %d, size %d",
       nalu->type, nalu->offset, nalu->size);
 
+  /* sub-bitstream extraction (clause 10): pictures of the kept sub-layers
+   * never refer to the dropped ones, whose frames are released without
+   * picture */
+  if (priv->temporal_layers > 0
+      && nalu->temporal_id_plus1 > priv->temporal_layers) {
+    GST_LOG_OBJECT (self, "Dropping nal of temporal sub-layer %d",
+        nalu->temporal_id_plus1 - 1);
+    return GST_H265_PARSER_OK;
+  }
+
   switch (nalu->type) {
     case GST_H265_NAL_VPS:
+      if (gst_h265_decoder_is_param_set_resent (self, nalu,
+              GST_CODEC_PARAM_SET_VPS, &id)) {
+        GST_LOG_OBJECT (self, "VPS %u re-sent", id);
+        priv->parser->last_vps = &priv->parser->vps[id];
+        break;
+      }
+
       ret = gst_h265_parser_parse_vps (priv->parser, nalu, &vps);
       if (klass->update_picture_parameters)
         klass->update_picture_parameters (self, GST_H265_NAL_VPS, &vps);
+      if (ret == GST_H265_PARSER_OK) {
+        gst_codec_param_sets_store (priv->param_sets, GST_CODEC_PARAM_SET_VPS,
+            vps.id, nalu->data + nalu->offset, nalu->size);
+      }
       break;
     case GST_H265_NAL_SPS:
+      /* The SPS is processed anyway, since a different one might have been
+       * activated since, but neither parsed nor notified again */
+      if (gst_h265_decoder_is_param_set_resent (self, nalu,
+              GST_CODEC_PARAM_SET_SPS, &id)) {
+        GST_LOG_OBJECT (self, "SPS %u re-sent", id);
+        priv->parser->last_sps = &priv->parser->sps[id];
+        memset (&decoder_nalu, 0, sizeof (GstH265DecoderNalUnit));
+        decoder_nalu.unit.sps = priv->parser->sps[id];
+        g_array_append_val (priv->nalu, decoder_nalu);
+        break;
+      }
+
       ret = gst_h265_parser_parse_sps (priv->parser, nalu, &sps, TRUE);
       if (ret != GST_H265_PARSER_OK)
         break;
@@ -817,14 +898,28 @@ gst_h265_decoder_parse_nalu (GstH265Decoder * self, GstH265NalUnit * nalu)
       if (klass->update_picture_parameters)
         klass->update_picture_parameters (self, GST_H265_NAL_SPS, &sps);
 
+      gst_codec_param_sets_store (priv->param_sets, GST_CODEC_PARAM_SET_SPS,
+          sps.id, nalu->data + nalu->offset, nalu->size);
+
       memset (&decoder_nalu, 0, sizeof (GstH265DecoderNalUnit));
       decoder_nalu.unit.sps = sps;
       g_array_append_val (priv->nalu, decoder_nalu);
       break;
     case GST_H265_NAL_PPS:
+      if (gst_h265_decoder_is_param_set_resent (self, nalu,
+              GST_CODEC_PARAM_SET_PPS, &id)) {
+        GST_LOG_OBJECT (self, "PPS %u re-sent", id);
+        priv->parser->last_pps = &priv->parser->pps[id];
+        break;
+      }
+
       ret = gst_h265_parser_parse_pps (priv->parser, nalu, &pps);
       if (klass->update_picture_parameters)
         klass->update_picture_parameters (self, GST_H265_NAL_PPS, &pps);
+      if (ret == GST_H265_PARSER_OK) {
+        gst_codec_param_sets_store (priv->param_sets, GST_CODEC_PARAM_SET_PPS,
+            pps.id, nalu->data + nalu->offset, nalu->size);
+      }
       break;
     case GST_H265_NAL_PREFIX_SEI:
     case GST_H265_NAL_SUFFIX_SEI:
@@ -846,6 +941,9 @@ gst_h265_decoder_parse_nalu (GstH265Decoder * self, GstH265NalUnit * nalu)
     case GST_H265_NAL_SLICE_IDR_W_RADL:
     case GST_H265_NAL_SLICE_IDR_N_LP:
     case GST_H265_NAL_SLICE_CRA_NUT:
+      /* the frame is released without picture */
+      if (priv->keyframes_only && !GST_H265_IS_NAL_TYPE_IRAP (nalu->type))
+        break;
       ret = gst_h265_decoder_parse_slice (self, nalu);
       priv->new_bitstream = FALSE;
       priv->prev_nal_is_eos = FALSE;
@@ -950,6 +1048,10 @@ gst_h265_decoder_parse_codec_data (GstH265Decoder * self, const guint8 * data,
   priv->nal_length_size = (data[21] & 0x03) + 1;
   GST_DEBUG_OBJECT (self, "nal length size %u", priv->nal_length_size);
 
+  /* the hvcC sets replace the ones held by the parser, and its PPS aren't
+   * notified, so none of them is taken as re-sent afterwards */
+  gst_codec_param_sets_clear (priv->param_sets);
+
   num_nal_arrays = data[22];
   off = 23;
 
@@ -1082,6 +1184,11 @@ gst_h265_decoder_set_format (GstVideoDecoder * decoder,
 
     priv->in_format = format;
     priv->align = align;
+
+    /* without alignment, access units are framed by parse() */
+    gst_video_decoder_set_packetized (decoder,
+        format != GST_H265_DECODER_FORMAT_BYTE
+        || align == GST_H265_DECODER_ALIGN_AU);
   }
 
   if (priv->codec_data) {
@@ -1110,9 +1217,14 @@ static gboolean
 gst_h265_decoder_flush (GstVideoDecoder * decoder)
 {
   GstH265Decoder *self = GST_H265_DECODER (decoder);
+  GstH265DecoderPrivate *priv = self->priv;
 
   gst_h265_decoder_clear_dpb (self, TRUE);
 
+  priv->parse_offset = 0;
+  priv->parse_has_vcl = FALSE;
+  priv->parse_au_end = FALSE;
+
   return TRUE;
 }
 
@@ -1397,15 +1509,15 @@ gst_h265_decoder_derive_and_mark_rps (GstH265Decoder * self,
   /* Mark all ref pics in RefPicSetLtCurr and RefPicSetLtFol as long_term_refs */
   for (i = 0; i < self->NumPocLtCurr; i++) {
     if (self->RefPicSetLtCurr[i]) {
-      self->RefPicSetLtCurr[i]->ref = TRUE;
-      self->RefPicSetLtCurr[i]->long_term = TRUE;
+      gst_h265_dpb_set_reference (priv->dpb, self->RefPicSetLtCurr[i], TRUE,
+          TRUE);
     }
   }
 
   for (i = 0; i < self->NumPocLtFoll; i++) {
     if (self->RefPicSetLtFoll[i]) {
-      self->RefPicSetLtFoll[i]->ref = TRUE;
-      self->RefPicSetLtFoll[i]->long_term = TRUE;
+      gst_h265_dpb_set_reference (priv->dpb, self->RefPicSetLtFoll[i], TRUE,
+          TRUE);
     }
   }
 
@@ -1442,8 +1554,7 @@ gst_h265_decoder_derive_and_mark_rps (GstH265Decoder * self,
             self->NumPocStFoll)) {
       GST_LOG_OBJECT (self, "Mark Picture %p (poc %d) as non-ref", dpb_pic,
           dpb_pic->pic_order_cnt);
-      dpb_pic->ref = FALSE;
-      dpb_pic->long_term = FALSE;
+      gst_h265_dpb_set_reference (priv->dpb, dpb_pic, FALSE, FALSE);
     }
   }
 
@@ -1725,6 +1836,7 @@ gst_h265_decoder_start_current_picture (GstH265Decoder * self)
   GstH265DecoderClass *klass;
   GstH265DecoderPrivate *priv = self->priv;
   GstFlowReturn ret = GST_FLOW_OK;
+  GstClockTime start;
 
   g_assert (priv->current_picture != NULL);
   g_assert (priv->active_sps != NULL);
@@ -1742,8 +1854,10 @@ gst_h265_decoder_start_current_picture (GstH265Decoder * self)
     return GST_FLOW_OK;
   }
 
+  start = gst_codec_stats_start (priv->stats);
   gst_h265_decoder_prepare_rps (self, &priv->current_slice,
       priv->current_picture);
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
 
   ret = gst_h265_decoder_dpb_init (self,
       &priv->current_slice, priv->current_picture);
@@ -1773,6 +1887,7 @@ gst_h265_decoder_finish_picture (GstH265Decoder * self,
   GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH265DecoderPrivate *priv = self->priv;
   const GstH265SPS *sps = priv->active_sps;
+  GstClockTime start;
 
   g_assert (ret != NULL);
 
@@ -1780,6 +1895,7 @@ gst_h265_decoder_finish_picture (GstH265Decoder * self,
       "Finishing picture %p (poc %d), entries in DPB %d",
       picture, picture->pic_order_cnt, gst_h265_dpb_get_size (priv->dpb));
 
+  start = gst_codec_stats_start (priv->stats);
   gst_h265_dpb_delete_unused (priv->dpb);
 
   /* This picture is decode only, drop corresponding frame */
@@ -1794,6 +1910,9 @@ gst_h265_decoder_finish_picture (GstH265Decoder * self,
    * reference picture marking for this picture */
   gst_h265_dpb_add (priv->dpb, picture);
 
+  /* bumping is left out, as it calls the subclass to output pictures */
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_DPB_MANAGEMENT, start);
+
   /* NOTE: As per C.5.2.2, bumping by sps_max_dec_pic_buffering_minus1 is
    * applied only for the output and removal of pictures from the DPB before
    * the decoding of the current picture. So pass zero here */
@@ -1858,6 +1977,174 @@ gst_h265_decoder_reset_frame_state (GstH265Decoder * self)
   g_array_set_size (priv->nalu, 0);
 }
 
+/* Same as gst_h265_parser_identify_nalu(), but the end of the NAL unit is
+ * found with the SIMD start code scanner. */
+static GstH265ParserResult
+gst_h265_decoder_identify_nalu_byte_stream (const guint8 * data, guint offset,
+    gsize size, GstH265Parser * parser, GstH265NalUnit * nalu)
+{
+  GstH265ParserResult pres;
+  gssize end;
+
+  pres = gst_h265_parser_identify_nalu_unchecked (parser, data, offset, size,
+      nalu);
+  if (pres != GST_H265_PARSER_OK)
+    return pres;
+
+  /* 2 bytes long, at the end of an AU, so no need to wait for the next one */
+  if (nalu->type == GST_H265_NAL_EOS || nalu->type == GST_H265_NAL_EOB)
+    return pres;
+
+  end = gst_codec_find_start_code (data + nalu->offset, size - nalu->offset);
+  if (end < 0)
+    return GST_H265_PARSER_NO_NAL_END;
+
+  /* trailing zeros belong to the next start code */
+  while (end > 0 && data[nalu->offset + end - 1] == 0)
+    end--;
+
+  nalu->size = end;
+  if (nalu->size < 3)
+    return GST_H265_PARSER_BROKEN_DATA;
+
+  return GST_H265_PARSER_OK;
+}
+
+static GstH265ParserResult
+gst_h265_decoder_identify_nalu (GstH265Decoder * self, const GstMapInfo * map,
+    guint offset, GstH265NalUnit * nalu)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstClockTime start = gst_codec_stats_start (priv->stats);
+  GstH265ParserResult pres;
+
+  if (priv->in_format == GST_H265_DECODER_FORMAT_HVC1 ||
+      priv->in_format == GST_H265_DECODER_FORMAT_HEV1) {
+    pres = gst_h265_parser_identify_nalu_hevc (priv->parser,
+        map->data, offset, map->size, priv->nal_length_size, nalu);
+  } else {
+    pres = gst_h265_decoder_identify_nalu_byte_stream (map->data, offset,
+        map->size, priv->parser, nalu);
+
+    if (pres == GST_H265_PARSER_NO_NAL_END)
+      pres = GST_H265_PARSER_OK;
+  }
+
+  gst_codec_stats_record (priv->stats, GST_CODEC_STATS_NAL_IDENTIFICATION,
+      start);
+  if (pres == GST_H265_PARSER_OK)
+    gst_codec_stats_add (priv->stats, GST_CODEC_STATS_NALS, 1);
+
+  return pres;
+}
+
+static gboolean
+gst_h265_decoder_sink_event (GstVideoDecoder * decoder, GstEvent * event)
+{
+  GstH265Decoder *self = GST_H265_DECODER (decoder);
+
+  if (gst_codec_event_is_au_end (event)) {
+    self->priv->parse_au_end = TRUE;
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->sink_event (decoder, event);
+}
+
+/* Whether the NAL unit starting at @data, of which at least three bytes
+ * are available, begins a new access unit after one holding a slice
+ * (7.4.2.4.4). Slices are checked for first_slice_segment_in_pic_flag. */
+static gboolean
+gst_h265_decoder_nal_starts_au (const guint8 * data, gboolean * vcl)
+{
+  guint8 type = (data[0] >> 1) & 0x3f;
+
+  if (type <= 31) {
+    *vcl = TRUE;
+    return (data[2] & 0x80) != 0;
+  }
+
+  *vcl = FALSE;
+
+  switch (type) {
+    case GST_H265_NAL_VPS:
+    case GST_H265_NAL_SPS:
+    case GST_H265_NAL_PPS:
+    case GST_H265_NAL_AUD:
+    case GST_H265_NAL_PREFIX_SEI:
+      return TRUE;
+    default:
+      return (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+  }
+}
+
+/* Splits byte-stream input that isn't aligned to access units, so no
+ * h265parse is needed upstream. Only the NAL unit headers and the first
+ * bit of the slice segment headers are looked at here; the NAL units are
+ * parsed once, by handle_frame(). */
+static GstFlowReturn
+gst_h265_decoder_parse (GstVideoDecoder * decoder, GstVideoCodecFrame * frame,
+    GstAdapter * adapter, gboolean at_eos)
+{
+  GstH265Decoder *self = GST_H265_DECODER (decoder);
+  GstH265DecoderPrivate *priv = self->priv;
+  const guint8 *data;
+  gsize size, au_size = 0;
+  gssize sc;
+  gboolean vcl;
+
+  size = gst_adapter_available (adapter);
+  if (size == 0)
+    return GST_VIDEO_DECODER_FLOW_NEED_DATA;
+
+  data = gst_adapter_map (adapter, size);
+
+  while (TRUE) {
+    sc = gst_codec_find_start_code (data + priv->parse_offset,
+        size - priv->parse_offset);
+    if (sc < 0) {
+      /* the start code might continue in the next buffer */
+      priv->parse_offset = MAX (priv->parse_offset, MAX (size, 2) - 2);
+      break;
+    }
+    sc += priv->parse_offset;
+
+    /* NAL unit header and first byte of the slice segment header */
+    if (sc + 6 > size) {
+      priv->parse_offset = sc;
+      break;
+    }
+
+    if (gst_h265_decoder_nal_starts_au (data + sc + 3, &vcl)
+        && priv->parse_has_vcl) {
+      /* a zero_byte before the start code belongs to the next unit */
+      au_size = sc > 0 && data[sc - 1] == 0 ? sc - 1 : sc;
+      priv->parse_offset = sc + 3 - au_size;
+      priv->parse_has_vcl = vcl;
+      break;
+    }
+
+    priv->parse_has_vcl |= vcl;
+    priv->parse_offset = sc + 3;
+  }
+
+  gst_adapter_unmap (adapter);
+
+  if (au_size == 0) {
+    if (!at_eos && !priv->parse_au_end)
+      return GST_VIDEO_DECODER_FLOW_NEED_DATA;
+
+    au_size = size;
+    priv->parse_offset = 0;
+    priv->parse_has_vcl = FALSE;
+    priv->parse_au_end = FALSE;
+  }
+
+  gst_video_decoder_add_to_frame (decoder, au_size);
+  return gst_video_decoder_have_frame (decoder);
+}
+
 static GstFlowReturn
 gst_h265_decoder_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -1886,37 +2173,15 @@ gst_h265_decoder_handle_frame (GstVideoDecoder * decoder,
     return GST_FLOW_ERROR;
   }
 
-  if (priv->in_format == GST_H265_DECODER_FORMAT_HVC1 ||
-      priv->in_format == GST_H265_DECODER_FORMAT_HEV1) {
-    pres = gst_h265_parser_identify_nalu_hevc (priv->parser,
-        map.data, 0, map.size, priv->nal_length_size, &nalu);
-
-    while (pres == GST_H265_PARSER_OK) {
-      pres = gst_h265_decoder_parse_nalu (self, &nalu);
-      if (pres != GST_H265_PARSER_OK)
-        break;
-
-      pres = gst_h265_parser_identify_nalu_hevc (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, priv->nal_length_size,
-          &nalu);
-    }
-  } else {
-    pres = gst_h265_parser_identify_nalu (priv->parser,
-        map.data, 0, map.size, &nalu);
+  pres = gst_h265_decoder_identify_nalu (self, &map, 0, &nalu);
 
-    if (pres == GST_H265_PARSER_NO_NAL_END)
-      pres = GST_H265_PARSER_OK;
-
-    while (pres == GST_H265_PARSER_OK) {
-      pres = gst_h265_decoder_parse_nalu (self, &nalu);
-      if (pres != GST_H265_PARSER_OK)
-        break;
+  while (pres == GST_H265_PARSER_OK) {
+    pres = gst_h265_decoder_parse_nalu (self, &nalu);
+    if (pres != GST_H265_PARSER_OK)
+      break;
 
-      pres = gst_h265_parser_identify_nalu (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, &nalu);
-      if (pres == GST_H265_PARSER_NO_NAL_END)
-        pres = GST_H265_PARSER_OK;
-    }
+    pres = gst_h265_decoder_identify_nalu (self, &map,
+        nalu.offset + nalu.size, &nalu);
   }
 
   for (i = 0; i < priv->nalu->len && decode_ret == GST_FLOW_OK; i++) {
@@ -1981,6 +2246,115 @@ gst_h265_decoder_set_process_ref_pic_lists (GstH265Decoder * decoder,
   decoder->priv->process_ref_pic_lists = process;
 }
 
+/**
+ * gst_h265_decoder_set_keyframes_only:
+ * @decoder: a #GstH265Decoder
+ * @keyframes_only: whether only the IRAP pictures are decoded
+ *
+ * Called to skip the non-IRAP pictures, e.g. for thumbnails. Their slices
+ * are dropped once identified, so no picture is created for them. Every
+ * CRA picture is handled as a BLA one.
+ */
+void
+gst_h265_decoder_set_keyframes_only (GstH265Decoder * decoder,
+    gboolean keyframes_only)
+{
+  decoder->priv->keyframes_only = keyframes_only;
+}
+
+/**
+ * gst_h265_decoder_set_temporal_layers:
+ * @decoder: a #GstH265Decoder
+ * @n_layers: number of temporal sub-layers decoded, 0 for all of them
+ *
+ * Called to decode a lower frame rate: the NAL units whose TemporalId is
+ * @n_layers or higher are dropped once identified, so no picture is
+ * created for them.
+ */
+void
+gst_h265_decoder_set_temporal_layers (GstH265Decoder * decoder,
+    guint n_layers)
+{
+  decoder->priv->temporal_layers = n_layers;
+}
+
+/**
+ * gst_h265_decoder_set_stats:
+ * @decoder: a #GstH265Decoder
+ * @stats: (nullable): a #GstCodecStats
+ *
+ * Sets where the time spent identifying NAL units and managing the DPB, and
+ * the number of NAL units, are recorded. %NULL disables it.
+ */
+void
+gst_h265_decoder_set_stats (GstH265Decoder * decoder, GstCodecStats * stats)
+{
+  GstH265DecoderPrivate *priv = decoder->priv;
+
+  if (stats)
+    gst_codec_stats_ref (stats);
+  g_clear_pointer (&priv->stats, gst_codec_stats_unref);
+  priv->stats = stats;
+}
+
+/**
+ * gst_h265_decoder_set_picture_cache:
+ * @decoder: a #GstH265Decoder
+ * @cache: (nullable): a #GstCodecPictureCache of #GstH265Picture
+ *
+ * Sets where the pictures are allocated from and returned to once freed.
+ * %NULL allocates every picture.
+ */
+void
+gst_h265_decoder_set_picture_cache (GstH265Decoder * decoder,
+    GstCodecPictureCache * cache)
+{
+  GstH265DecoderPrivate *priv = decoder->priv;
+
+  if (cache)
+    gst_codec_picture_cache_ref (cache);
+  g_clear_pointer (&priv->picture_cache, gst_codec_picture_cache_unref);
+  priv->picture_cache = cache;
+}
+
+/**
+ * gst_h265_decoder_get_input_buffer:
+ * @decoder: a #GstH265Decoder
+ *
+ * Retrieves the buffer being decoded, whose mapped data the NAL units passed
+ * to the subclass point into. A picture never spans more than one buffer.
+ * Only meaningful within the vfuncs called while decoding a frame.
+ *
+ * Returns: (transfer none) (nullable): a #GstBuffer
+ */
+GstBuffer *
+gst_h265_decoder_get_input_buffer (GstH265Decoder * decoder)
+{
+  GstH265DecoderPrivate *priv = decoder->priv;
+
+  return priv->current_frame ? priv->current_frame->input_buffer : NULL;
+}
+
+/**
+ * gst_h265_decoder_get_nal_length_size:
+ * @decoder: a #GstH265Decoder
+ *
+ * Retrieves the size of the length prefix of the NAL units of packetized
+ * input, as set by the codec data.
+ *
+ * Returns: the size in bytes, from 1 to 4, or 0 for byte-stream input
+ */
+guint
+gst_h265_decoder_get_nal_length_size (GstH265Decoder * decoder)
+{
+  GstH265DecoderPrivate *priv = decoder->priv;
+
+  if ((priv->in_format == GST_H265_DECODER_FORMAT_HVC1
+      || priv->in_format == GST_H265_DECODER_FORMAT_HEV1))
+    return priv->nal_length_size;
+  return 0;
+}
+
 /**
  * gst_h265_decoder_get_picture:
  * @decoder: a #GstH265Decoder
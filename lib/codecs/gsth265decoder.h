@@ -25,6 +25,7 @@
 
 #include "codecs-prelude.h"
 #include "gsth265picture.h"
+#include "gstcodecstats.h"
 
 G_BEGIN_DECLS
 
@@ -208,6 +209,22 @@ void gst_h265_decoder_set_process_ref_pic_lists (GstH265Decoder * decoder,
 GstH265Picture * gst_h265_decoder_get_picture   (GstH265Decoder * decoder,
                                                  guint32 system_frame_number);
 
+void gst_h265_decoder_set_keyframes_only (GstH265Decoder * decoder,
+                                          gboolean keyframes_only);
+
+void gst_h265_decoder_set_temporal_layers (GstH265Decoder * decoder,
+                                           guint n_layers);
+
+void gst_h265_decoder_set_stats (GstH265Decoder * decoder,
+                                 GstCodecStats * stats);
+
+void gst_h265_decoder_set_picture_cache (GstH265Decoder * decoder,
+                                         GstCodecPictureCache * cache);
+
+GstBuffer * gst_h265_decoder_get_input_buffer (GstH265Decoder * decoder);
+
+guint gst_h265_decoder_get_nal_length_size (GstH265Decoder * decoder);
+
 G_END_DECLS
 
 #endif /* __GST_H265_DECODER_H__ */
@@ -22,6 +22,8 @@
 #endif
 
 #include "gsth265picture.h"
+#include "gstcodecdpbmask.h"
+#include <string.h>
 
 GST_DEBUG_CATEGORY_EXTERN (gst_h265_decoder_debug);
 #define GST_CAT_DEFAULT gst_h265_decoder_debug
@@ -31,10 +33,17 @@ GST_DEFINE_MINI_OBJECT_TYPE (GstH265Picture, gst_h265_picture);
 static void
 _gst_h265_picture_free (GstH265Picture * picture)
 {
+  GstCodecPictureCache *cache = picture->cache;
+
   if (picture->notify)
     picture->notify (picture->user_data);
 
-  g_free (picture);
+  if (cache) {
+    gst_codec_picture_cache_release (cache, picture);
+    gst_codec_picture_cache_unref (cache);
+  } else {
+    g_free (picture);
+  }
 }
 
 /**
@@ -46,10 +55,30 @@ _gst_h265_picture_free (GstH265Picture * picture)
  */
 GstH265Picture *
 gst_h265_picture_new (void)
+{
+  return gst_h265_picture_new_from_cache (NULL);
+}
+
+/**
+ * gst_h265_picture_new_from_cache:
+ * @cache: (nullable): a #GstCodecPictureCache of #GstH265Picture
+ *
+ * Create new #GstH265Picture, reusing a freed one kept by @cache, to which
+ * it returns once freed.
+ *
+ * Returns: a new #GstH265Picture
+ */
+GstH265Picture *
+gst_h265_picture_new_from_cache (GstCodecPictureCache * cache)
 {
   GstH265Picture *pic;
 
-  pic = g_new0 (GstH265Picture, 1);
+  if (cache) {
+    pic = gst_codec_picture_cache_acquire (cache);
+    pic->cache = gst_codec_picture_cache_ref (cache);
+  } else {
+    pic = g_new0 (GstH265Picture, 1);
+  }
 
   pic->pic_struct = GST_H265_SEI_PIC_STRUCT_FRAME;
   /* 0: interlaced, 1: progressive, 2: unspecified, 3: reserved, can be
@@ -104,13 +133,100 @@ gst_h265_picture_get_user_data (GstH265Picture * picture)
   return picture->user_data;
 }
 
+/* Room for the largest DPB, the current picture, and the pictures
+ * overflowing it on broken streams */
+#define DPB_CAPACITY GST_CODEC_DPB_MASK_SIZE
+
 struct _GstH265Dpb
 {
+  /* The stored pictures. The fields the queries look at are copied, at the
+   * same index, in the columns and masks below, so a picture is only
+   * dereferenced once it's found. */
   GArray *pic_list;
+  gint32 poc[DPB_CAPACITY];
+  gint32 poc_lsb[DPB_CAPACITY];
+  guint32 pic_latency_cnt[DPB_CAPACITY];
+
+  GstCodecDpbMask ref;
+  GstCodecDpbMask long_term;
+  GstCodecDpbMask needed_for_output;
+
   gint max_num_pics;
   gint num_output_needed;
 };
 
+#define DPB_PICTURE(dpb, i) g_array_index ((dpb)->pic_list, GstH265Picture *, i)
+
+/* Copies the fields of the picture at @i */
+static void
+gst_h265_dpb_store (GstH265Dpb * dpb, guint i)
+{
+  GstH265Picture *picture = DPB_PICTURE (dpb, i);
+
+  dpb->poc[i] = picture->pic_order_cnt;
+  dpb->poc_lsb[i] = picture->pic_order_cnt_lsb;
+  dpb->pic_latency_cnt[i] = picture->pic_latency_cnt;
+
+  gst_codec_dpb_mask_set (&dpb->ref, i, picture->ref);
+  gst_codec_dpb_mask_set (&dpb->long_term, i, picture->long_term);
+  gst_codec_dpb_mask_set (&dpb->needed_for_output, i,
+      picture->needed_for_output);
+}
+
+/* Moves the slot @from to @to, which is overwritten */
+static void
+gst_h265_dpb_move (GstH265Dpb * dpb, guint from, guint to)
+{
+  GstCodecDpbMask bit = GST_CODEC_DPB_MASK_BIT (from);
+
+  dpb->poc[to] = dpb->poc[from];
+  dpb->poc_lsb[to] = dpb->poc_lsb[from];
+  dpb->pic_latency_cnt[to] = dpb->pic_latency_cnt[from];
+
+  gst_codec_dpb_mask_set (&dpb->ref, to, dpb->ref & bit);
+  gst_codec_dpb_mask_set (&dpb->long_term, to, dpb->long_term & bit);
+  gst_codec_dpb_mask_set (&dpb->needed_for_output, to,
+      dpb->needed_for_output & bit);
+}
+
+/* Removes the picture at @i, keeping the order of the others */
+static void
+gst_h265_dpb_remove (GstH265Dpb * dpb, guint i)
+{
+  guint n = dpb->pic_list->len - i - 1;
+
+  g_array_remove_index (dpb->pic_list, i);
+
+#define REMOVE_COLUMN(column) \
+  memmove (&dpb->column[i], &dpb->column[i + 1], n * sizeof (dpb->column[0]))
+  REMOVE_COLUMN (poc);
+  REMOVE_COLUMN (poc_lsb);
+  REMOVE_COLUMN (pic_latency_cnt);
+#undef REMOVE_COLUMN
+
+  dpb->ref = gst_codec_dpb_mask_remove (dpb->ref, i);
+  dpb->long_term = gst_codec_dpb_mask_remove (dpb->long_term, i);
+  dpb->needed_for_output =
+      gst_codec_dpb_mask_remove (dpb->needed_for_output, i);
+}
+
+/* Removes the picture at @i, moving the last one in its place */
+static void
+gst_h265_dpb_remove_fast (GstH265Dpb * dpb, guint i)
+{
+  guint last = dpb->pic_list->len - 1;
+  GstCodecDpbMask below_last = GST_CODEC_DPB_MASK_BELOW (last);
+
+  g_array_remove_index_fast (dpb->pic_list, i);
+
+  if (i != last)
+    gst_h265_dpb_move (dpb, last, i);
+
+  dpb->ref &= below_last;
+  dpb->long_term &= below_last;
+  dpb->needed_for_output &= below_last;
+}
+
 /**
  * gst_h265_dpb_new: (skip)
  *
@@ -126,8 +242,7 @@ gst_h265_dpb_new (void)
   dpb = g_new0 (GstH265Dpb, 1);
 
   dpb->pic_list =
-      g_array_sized_new (FALSE, TRUE, sizeof (GstH265Picture *),
-      GST_H265_DPB_MAX_SIZE);
+      g_array_sized_new (FALSE, TRUE, sizeof (GstH265Picture *), DPB_CAPACITY);
   g_array_set_clear_func (dpb->pic_list,
       (GDestroyNotify) gst_clear_h265_picture);
 
@@ -191,6 +306,7 @@ gst_h265_dpb_clear (GstH265Dpb * dpb)
   g_return_if_fail (dpb != NULL);
 
   g_array_set_size (dpb->pic_list, 0);
+  dpb->ref = dpb->long_term = dpb->needed_for_output = 0;
   dpb->num_output_needed = 0;
 }
 
@@ -208,15 +324,20 @@ gst_h265_dpb_add (GstH265Dpb * dpb, GstH265Picture * picture)
   g_return_if_fail (dpb != NULL);
   g_return_if_fail (GST_IS_H265_PICTURE (picture));
 
+  if (dpb->pic_list->len >= DPB_CAPACITY) {
+    GST_ERROR ("DPB is full with %d pictures, dropping picture %p",
+        dpb->pic_list->len, picture);
+    gst_h265_picture_unref (picture);
+    return;
+  }
+
   if (picture->output_flag) {
+    GstCodecDpbMask needed_for_output = dpb->needed_for_output;
     gint i;
 
-    for (i = 0; i < dpb->pic_list->len; i++) {
-      GstH265Picture *other =
-          g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-      if (other->needed_for_output)
-        other->pic_latency_cnt++;
+    GST_CODEC_DPB_MASK_FOREACH (i, needed_for_output) {
+      dpb->pic_latency_cnt[i]++;
+      DPB_PICTURE (dpb, i)->pic_latency_cnt = dpb->pic_latency_cnt[i];
     }
 
     dpb->num_output_needed++;
@@ -230,6 +351,7 @@ gst_h265_dpb_add (GstH265Dpb * dpb, GstH265Picture * picture)
   picture->long_term = FALSE;
 
   g_array_append_val (dpb->pic_list, picture);
+  gst_h265_dpb_store (dpb, dpb->pic_list->len - 1);
 }
 
 /**
@@ -245,15 +367,14 @@ gst_h265_dpb_delete_unused (GstH265Dpb * dpb)
 
   g_return_if_fail (dpb != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
+  /* from the end, so the indices left to visit don't move */
+  for (i = dpb->pic_list->len - 1; i >= 0; i--) {
+    GstCodecDpbMask used = dpb->needed_for_output | dpb->ref;
 
-    if (!picture->needed_for_output && !picture->ref) {
+    if (!(used & GST_CODEC_DPB_MASK_BIT (i))) {
       GST_TRACE ("remove picture %p (poc %d) from dpb",
-          picture, picture->pic_order_cnt);
-      g_array_remove_index (dpb->pic_list, i);
-      i--;
+          DPB_PICTURE (dpb, i), dpb->poc[i]);
+      gst_h265_dpb_remove (dpb, i);
     }
   }
 }
@@ -267,20 +388,9 @@ gst_h265_dpb_delete_unused (GstH265Dpb * dpb)
 gint
 gst_h265_dpb_num_ref_pictures (GstH265Dpb * dpb)
 {
-  gint i;
-  gint ret = 0;
-
   g_return_val_if_fail (dpb != NULL, -1);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (picture->ref)
-      ret++;
-  }
-
-  return ret;
+  return gst_codec_dpb_mask_count (dpb->ref);
 }
 
 /**
@@ -292,15 +402,46 @@ gst_h265_dpb_num_ref_pictures (GstH265Dpb * dpb)
 void
 gst_h265_dpb_mark_all_non_ref (GstH265Dpb * dpb)
 {
+  GstCodecDpbMask ref;
   gint i;
 
   g_return_if_fail (dpb != NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
+  ref = dpb->ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, ref) {
+    DPB_PICTURE (dpb, i)->ref = FALSE;
+  }
+
+  dpb->ref = 0;
+}
 
-    picture->ref = FALSE;
+/**
+ * gst_h265_dpb_set_reference:
+ * @dpb: a #GstH265Dpb
+ * @picture: a #GstH265Picture stored in @dpb
+ * @ref: whether @picture is used for reference
+ * @long_term: whether @picture is used for long-term reference
+ *
+ * Update the reference marking of @picture, of which @dpb keeps a copy
+ */
+void
+gst_h265_dpb_set_reference (GstH265Dpb * dpb, GstH265Picture * picture,
+    gboolean ref, gboolean long_term)
+{
+  gint i;
+
+  g_return_if_fail (dpb != NULL);
+  g_return_if_fail (picture != NULL);
+
+  picture->ref = ref;
+  picture->long_term = long_term;
+
+  for (i = 0; i < dpb->pic_list->len; i++) {
+    if (DPB_PICTURE (dpb, i) == picture) {
+      gst_codec_dpb_mask_set (&dpb->ref, i, ref);
+      gst_codec_dpb_mask_set (&dpb->long_term, i, long_term);
+      break;
+    }
   }
 }
 
@@ -316,16 +457,15 @@ gst_h265_dpb_mark_all_non_ref (GstH265Dpb * dpb)
 GstH265Picture *
 gst_h265_dpb_get_ref_by_poc (GstH265Dpb * dpb, gint poc)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (picture->ref && picture->pic_order_cnt == poc)
-      return gst_h265_picture_ref (picture);
+  mask = dpb->ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    if (dpb->poc[i] == poc)
+      return gst_h265_picture_ref (DPB_PICTURE (dpb, i));
   }
 
   GST_DEBUG ("No short term reference picture for %d", poc);
@@ -345,16 +485,15 @@ gst_h265_dpb_get_ref_by_poc (GstH265Dpb * dpb, gint poc)
 GstH265Picture *
 gst_h265_dpb_get_ref_by_poc_lsb (GstH265Dpb * dpb, gint poc_lsb)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (picture->ref && picture->pic_order_cnt_lsb == poc_lsb)
-      return gst_h265_picture_ref (picture);
+  mask = dpb->ref;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    if (dpb->poc_lsb[i] == poc_lsb)
+      return gst_h265_picture_ref (DPB_PICTURE (dpb, i));
   }
 
   GST_DEBUG ("No short term reference picture for %d", poc_lsb);
@@ -374,16 +513,15 @@ gst_h265_dpb_get_ref_by_poc_lsb (GstH265Dpb * dpb, gint poc_lsb)
 GstH265Picture *
 gst_h265_dpb_get_short_ref_by_poc (GstH265Dpb * dpb, gint poc)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (picture->ref && !picture->long_term && picture->pic_order_cnt == poc)
-      return gst_h265_picture_ref (picture);
+  mask = dpb->ref & ~dpb->long_term;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    if (dpb->poc[i] == poc)
+      return gst_h265_picture_ref (DPB_PICTURE (dpb, i));
   }
 
   GST_DEBUG ("No short term reference picture for %d", poc);
@@ -403,16 +541,15 @@ gst_h265_dpb_get_short_ref_by_poc (GstH265Dpb * dpb, gint poc)
 GstH265Picture *
 gst_h265_dpb_get_long_ref_by_poc (GstH265Dpb * dpb, gint poc)
 {
+  GstCodecDpbMask mask;
   gint i;
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (picture->ref && picture->long_term && picture->pic_order_cnt == poc)
-      return gst_h265_picture_ref (picture);
+  mask = dpb->ref & dpb->long_term;
+  GST_CODEC_DPB_MASK_FOREACH (i, mask) {
+    if (dpb->poc[i] == poc)
+      return gst_h265_picture_ref (DPB_PICTURE (dpb, i));
   }
 
   GST_DEBUG ("No long term reference picture for %d", poc);
@@ -483,16 +620,11 @@ gst_h265_dpb_get_picture (GstH265Dpb * dpb, guint32 system_frame_number)
 static gboolean
 gst_h265_dpb_check_latency_count (GstH265Dpb * dpb, guint32 max_latency)
 {
+  GstCodecDpbMask needed_for_output = dpb->needed_for_output;
   gint i;
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (!picture->needed_for_output)
-      continue;
-
-    if (picture->pic_latency_cnt >= max_latency)
+  GST_CODEC_DPB_MASK_FOREACH (i, needed_for_output) {
+    if (dpb->pic_latency_cnt[i] >= max_latency)
       return TRUE;
   }
 
@@ -556,33 +688,19 @@ static gint
 gst_h265_dpb_get_lowest_output_needed_picture (GstH265Dpb * dpb,
     GstH265Picture ** picture)
 {
+  GstCodecDpbMask needed_for_output = dpb->needed_for_output;
   gint i;
-  GstH265Picture *lowest = NULL;
   gint index = -1;
 
   *picture = NULL;
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
-    GstH265Picture *picture =
-        g_array_index (dpb->pic_list, GstH265Picture *, i);
-
-    if (!picture->needed_for_output)
-      continue;
-
-    if (!lowest) {
-      lowest = picture;
-      index = i;
-      continue;
-    }
-
-    if (picture->pic_order_cnt < lowest->pic_order_cnt) {
-      lowest = picture;
+  GST_CODEC_DPB_MASK_FOREACH (i, needed_for_output) {
+    if (index < 0 || dpb->poc[i] < dpb->poc[index])
       index = i;
-    }
   }
 
-  if (lowest)
-    *picture = gst_h265_picture_ref (lowest);
+  if (index >= 0)
+    *picture = gst_h265_picture_ref (DPB_PICTURE (dpb, index));
 
   return index;
 }
@@ -616,12 +734,13 @@ gst_h265_dpb_bump (GstH265Dpb * dpb, gboolean drain)
     return NULL;
 
   picture->needed_for_output = FALSE;
+  gst_codec_dpb_mask_set (&dpb->needed_for_output, index, FALSE);
 
   dpb->num_output_needed--;
   g_assert (dpb->num_output_needed >= 0);
 
-  if (!picture->ref || drain)
-    g_array_remove_index_fast (dpb->pic_list, index);
+  if (!(dpb->ref & GST_CODEC_DPB_MASK_BIT (index)) || drain)
+    gst_h265_dpb_remove_fast (dpb, index);
 
   return picture;
 }
@@ -26,6 +26,7 @@
 #endif
 
 #include "codecs-prelude.h"
+#include "gstcodecpicturecache.h"
 
 #include <gst/codecparsers/gsth265parser.h>
 #include <gst/gst.h>
@@ -93,6 +94,9 @@ struct _GstH265Picture
 
   gpointer user_data;
   GDestroyNotify notify;
+
+  /* where it returns once freed, if any */
+  GstCodecPictureCache *cache;
 };
 
 
@@ -101,6 +105,8 @@ GType gst_h265_picture_get_type (void);
 
 GstH265Picture * gst_h265_picture_new (void);
 
+GstH265Picture * gst_h265_picture_new_from_cache (GstCodecPictureCache * cache);
+
 static inline GstH265Picture *
 gst_h265_picture_ref (GstH265Picture * picture)
 {
@@ -173,6 +179,12 @@ gint  gst_h265_dpb_num_ref_pictures (GstH265Dpb * dpb);
 void  gst_h265_dpb_mark_all_non_ref (GstH265Dpb * dpb);
 
 
+void  gst_h265_dpb_set_reference    (GstH265Dpb * dpb,
+                                     GstH265Picture * picture,
+                                     gboolean ref,
+                                     gboolean long_term);
+
+
 GstH265Picture * gst_h265_dpb_get_ref_by_poc       (GstH265Dpb * dpb,
                                                     gint poc);
 
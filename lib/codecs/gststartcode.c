@@ -0,0 +1,194 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gststartcode.h"
+
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_SIMD 1
+#define TARGET(isa) __attribute__ ((target (isa)))
+#include <immintrin.h>
+#elif defined (_MSC_VER) && defined (_M_X64)
+#define HAVE_X86_SIMD 1
+#define TARGET(isa)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+/* Skips up to three bytes at a time: no start code can begin at i, i + 1 or
+ * i + 2 if data[i + 2] is greater than 1. */
+static gssize
+find_start_code_scalar (const guint8 * data, gsize size)
+{
+  gsize i = 0;
+
+  while (i + 2 < size) {
+    if (data[i + 2] > 1)
+      i += 3;
+    else if (data[i + 1])
+      i += 2;
+    else if (data[i] || data[i + 2] != 1)
+      i++;
+    else
+      return i;
+  }
+
+  return -1;
+}
+
+#ifdef HAVE_X86_SIMD
+static gssize
+find_start_code_tail (const guint8 * data, gsize size, gsize i)
+{
+  gssize ret = find_start_code_scalar (data + i, size - i);
+
+  return ret < 0 ? -1 : (gssize) (i + ret);
+}
+
+/* Each lane tells whether a start code begins there, comparing the block
+ * against itself shifted by one and two bytes. Blocks without any zero byte
+ * are skipped before the shifted loads. */
+TARGET ("sse2") static gssize
+find_start_code_sse2 (const guint8 * data, gsize size)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi8 (1);
+  gsize i;
+
+  for (i = 0; i + 18 <= size; i += 16) {
+    __m128i b0 = _mm_loadu_si128 ((const __m128i *) (data + i));
+    __m128i z0 = _mm_cmpeq_epi8 (b0, zero);
+    __m128i b1, b2, m;
+    guint mask;
+
+    if (!_mm_movemask_epi8 (z0))
+      continue;
+
+    b1 = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+    b2 = _mm_loadu_si128 ((const __m128i *) (data + i + 2));
+    m = _mm_and_si128 (_mm_and_si128 (z0, _mm_cmpeq_epi8 (b1, zero)),
+        _mm_cmpeq_epi8 (b2, one));
+    mask = _mm_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+  }
+
+  return find_start_code_tail (data, size, i);
+}
+
+TARGET ("avx2") static gssize
+find_start_code_avx2 (const guint8 * data, gsize size)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i one = _mm256_set1_epi8 (1);
+  gsize i;
+
+  for (i = 0; i + 34 <= size; i += 32) {
+    __m256i b0 = _mm256_loadu_si256 ((const __m256i *) (data + i));
+    __m256i z0 = _mm256_cmpeq_epi8 (b0, zero);
+    __m256i b1, b2, m;
+    guint32 mask;
+
+    if (!_mm256_movemask_epi8 (z0))
+      continue;
+
+    b1 = _mm256_loadu_si256 ((const __m256i *) (data + i + 1));
+    b2 = _mm256_loadu_si256 ((const __m256i *) (data + i + 2));
+    m = _mm256_and_si256 (_mm256_and_si256 (z0, _mm256_cmpeq_epi8 (b1, zero)),
+        _mm256_cmpeq_epi8 (b2, one));
+    mask = (guint32) _mm256_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+  }
+
+  return find_start_code_tail (data, size, i);
+}
+
+static gboolean
+cpu_supports (GstCodecSimd simd)
+{
+#if defined (__GNUC__) || defined (__clang__)
+  __builtin_cpu_init ();
+
+  switch (simd) {
+    case GST_CODEC_SIMD_SSE2:
+      return __builtin_cpu_supports ("sse2");
+    case GST_CODEC_SIMD_AVX2:
+      return __builtin_cpu_supports ("avx2");
+    default:
+      return FALSE;
+  }
+#else
+  int info[4];
+
+  switch (simd) {
+    case GST_CODEC_SIMD_SSE2:
+      /* baseline on x86-64 */
+      return TRUE;
+    case GST_CODEC_SIMD_AVX2:
+      __cpuid (info, 0);
+      if (info[0] < 7)
+        return FALSE;
+      /* AVX and OSXSAVE, and the OS saving the YMM registers */
+      __cpuid (info, 1);
+      if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv (0) & 6) != 6)
+        return FALSE;
+      __cpuidex (info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+    default:
+      return FALSE;
+  }
+#endif
+}
+#endif
+
+GstCodecStartCodeFunc
+gst_codec_get_start_code_func (GstCodecSimd simd)
+{
+  switch (simd) {
+    case GST_CODEC_SIMD_NONE:
+      return find_start_code_scalar;
+#ifdef HAVE_X86_SIMD
+    case GST_CODEC_SIMD_SSE2:
+      return cpu_supports (simd) ? find_start_code_sse2 : NULL;
+    case GST_CODEC_SIMD_AVX2:
+      return cpu_supports (simd) ? find_start_code_avx2 : NULL;
+#endif
+    default:
+      return NULL;
+  }
+}
+
+gssize
+gst_codec_find_start_code (const guint8 * data, gsize size)
+{
+  static gsize best = 0;
+
+  if (g_once_init_enter (&best)) {
+    GstCodecStartCodeFunc func =
+        gst_codec_get_start_code_func (GST_CODEC_SIMD_AVX2);
+
+    if (!func)
+      func = gst_codec_get_start_code_func (GST_CODEC_SIMD_SSE2);
+    if (!func)
+      func = find_start_code_scalar;
+
+    g_once_init_leave (&best, (gsize) func);
+  }
+
+  return ((GstCodecStartCodeFunc) best) (data, size);
+}
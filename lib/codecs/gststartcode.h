@@ -0,0 +1,46 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Annex B start code (00 00 01) search. The fastest implementation the CPU
+ * supports is picked at runtime. */
+
+typedef enum
+{
+  GST_CODEC_SIMD_NONE,
+  GST_CODEC_SIMD_SSE2,
+  GST_CODEC_SIMD_AVX2,
+} GstCodecSimd;
+
+/* Returns the offset of the first start code in @data, or -1 if there is
+ * none. */
+typedef gssize (*GstCodecStartCodeFunc) (const guint8 * data, gsize size);
+
+gssize                  gst_codec_find_start_code      (const guint8 * data,
+                                                        gsize size);
+
+/* Returns the implementation using @simd, or NULL if it isn't built in or
+ * the CPU doesn't support it. Meant for tests and benchmarks. */
+GstCodecStartCodeFunc   gst_codec_get_start_code_func  (GstCodecSimd simd);
+
+G_END_DECLS
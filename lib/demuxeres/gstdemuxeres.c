@@ -59,6 +59,10 @@ struct _GstDemuxerESPrivate
   GThread *bus_thread;
   gboolean bus_exit;
   GstSample *pending_sample;
+
+  GstDemuxerESFlags flags;
+  /* caps of the last video packet */
+  GstCaps *video_caps;
 };
 
 
@@ -140,6 +144,29 @@ appsink_handle_event (GstDemuxerES * demuxer, GstEvent * event)
   return ret;
 }
 
+static void
+gst_parse_stream_update_video_format (GstDemuxerEStream * stream,
+    GstCaps * caps)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  const gchar *format = gst_structure_get_string (s, "stream-format");
+  const GValue *codec_data = gst_structure_get_value (s, "codec_data");
+  GstDemuxerESVideoInfo *video = &stream->data.video;
+
+  video->packetized = format && strcmp (format, "byte-stream") != 0;
+
+  g_clear_pointer (&video->codec_data, g_free);
+  video->codec_data_size = 0;
+
+  if (video->packetized && codec_data && GST_VALUE_HOLDS_BUFFER (codec_data)) {
+    GstBuffer *buffer = gst_value_get_buffer (codec_data);
+
+    video->codec_data_size = gst_buffer_get_size (buffer);
+    video->codec_data = g_malloc (video->codec_data_size);
+    gst_buffer_extract (buffer, 0, video->codec_data, video->codec_data_size);
+  }
+}
+
 static GstDemuxerESPacket *
 appsink_read_packet (GstDemuxerES * demuxer)
 {
@@ -165,6 +192,18 @@ appsink_read_packet (GstDemuxerES * demuxer)
   }
 
   if (sample) {
+    GstCaps *caps = gst_sample_get_caps (sample);
+
+    if (priv->current_stream_type == DEMUXER_ES_STREAM_TYPE_VIDEO && caps
+        && caps != priv->video_caps) {
+      GstDemuxerEStream *stream =
+          g_list_nth_data (priv->streams, priv->current_stream_id);
+
+      gst_caps_replace (&priv->video_caps, caps);
+      if (stream)
+        gst_parse_stream_update_video_format (stream, caps);
+    }
+
     buffer = gst_sample_get_buffer (sample);
     if (buffer) {
       packet = g_new (GstDemuxerESPacket, 1);
@@ -175,7 +214,8 @@ appsink_read_packet (GstDemuxerES * demuxer)
         .packet_number = packet_counter,
         .pts = GST_BUFFER_PTS (buffer),
         .dts = GST_BUFFER_DTS (buffer),
-        .duration = GST_BUFFER_DURATION (buffer)
+        .duration = GST_BUFFER_DURATION (buffer),
+        .keyframe = !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)
       };
       packet->priv = g_new (GstDemuxerESPacketPrivate, 1),
       packet->priv->sample = sample;
@@ -294,6 +334,7 @@ gst_parse_stream_teardown (GstDemuxerEStream * stream)
     case DEMUXER_ES_STREAM_TYPE_VIDEO:
       g_free (stream->data.video.profile);
       g_free (stream->data.video.level);
+      g_free (stream->data.video.codec_data);
       break;
     default:
       break;
@@ -331,6 +372,11 @@ gst_parse_stream_create (GstDemuxerES * demuxer, GstPad * pad)
       stream->data.video.level =
           g_strdup (gst_structure_get_string (s, "level"));
       stream->data.video.vcodec = gst_parse_stream_get_vcodec_from_caps (caps);
+      GstCaps *current = gst_pad_get_current_caps (pad);
+      if (current) {
+        gst_parse_stream_update_video_format (stream, current);
+        gst_caps_unref (current);
+      }
       break;
     }
     case DEMUXER_ES_STREAM_TYPE_AUDIO:
@@ -440,16 +486,27 @@ autoplug_query_caps (GstElement * uridecodebin, GstPad * pad,
       goto done;
     GstDemuxerESVideoCodec codec_id =
         gst_parse_stream_get_vcodec_from_caps (caps);
+    /* the parsers keep their input format when downstream accepts it */
     switch (codec_id) {
       case DEMUXER_ES_VIDEO_CODEC_H264:
-        result =
-            gst_caps_from_string
-            ("video/x-h264,stream-format=byte-stream,alignment=au");
+        if (demuxer->priv->flags & DEMUXER_ES_FLAG_PACKETIZED)
+          result =
+              gst_caps_from_string
+              ("video/x-h264,stream-format=(string){avc,avc3,byte-stream},alignment=au");
+        else
+          result =
+              gst_caps_from_string
+              ("video/x-h264,stream-format=byte-stream,alignment=au");
         break;
       case DEMUXER_ES_VIDEO_CODEC_H265:
-        result =
-            gst_caps_from_string
-            ("video/x-h265,stream-format=byte-stream,alignment=au");
+        if (demuxer->priv->flags & DEMUXER_ES_FLAG_PACKETIZED)
+          result =
+              gst_caps_from_string
+              ("video/x-h265,stream-format=(string){hvc1,hev1,byte-stream},alignment=au");
+        else
+          result =
+              gst_caps_from_string
+              ("video/x-h265,stream-format=byte-stream,alignment=au");
         break;
       default:
         GST_DEBUG ("Unknown codec id %d", codec_id);
@@ -547,6 +604,12 @@ check_for_bus_message_cb (gpointer data)
 
 GstDemuxerES *
 gst_demuxer_es_new (const gchar * uri)
+{
+  return gst_demuxer_es_new_full (uri, DEMUXER_ES_FLAG_NONE);
+}
+
+GstDemuxerES *
+gst_demuxer_es_new_full (const gchar * uri, GstDemuxerESFlags flags)
 {
   GstDemuxerES *demuxer;
   GstDemuxerESPrivate *priv;
@@ -563,6 +626,7 @@ gst_demuxer_es_new (const gchar * uri)
   g_assert (demuxer != NULL);
   demuxer->priv = g_new0 (GstDemuxerESPrivate, 1);
   priv = demuxer->priv;
+  priv->flags = flags;
 
   g_mutex_init (&priv->ready_mutex);
   g_cond_init (&priv->ready_cond);
@@ -665,6 +729,81 @@ gst_demuxer_es_read_packet (GstDemuxerES * demuxer,
   return result;
 }
 
+gboolean
+gst_demuxer_es_seek (GstDemuxerES * demuxer, gint64 time,
+    GstDemuxerESSeekFlags flags, gint64 * position)
+{
+  GstDemuxerESPrivate *priv;
+  GstSeekFlags seek_flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT;
+  GstDemuxerEStream *video;
+  GstMiniObject *object;
+  GstBuffer *buffer;
+
+  if (!demuxer || time < 0)
+    return FALSE;
+
+  priv = demuxer->priv;
+
+  check_for_bus_message (demuxer);
+  if (priv->state == DEMUXER_ES_STATE_ERROR)
+    return FALSE;
+
+  if (flags & DEMUXER_ES_SEEK_FLAG_SNAP_AFTER)
+    seek_flags |= GST_SEEK_FLAG_SNAP_AFTER;
+  else if (flags & DEMUXER_ES_SEEK_FLAG_SNAP_NEAREST)
+    seek_flags |= GST_SEEK_FLAG_SNAP_NEAREST;
+  else
+    seek_flags |= GST_SEEK_FLAG_SNAP_BEFORE;
+
+  /* the flush drops what the appsink queued, but not the sample already
+   * pulled */
+  gst_clear_sample (&priv->pending_sample);
+
+  if (!gst_element_seek_simple (priv->pipeline, GST_FORMAT_TIME, seek_flags,
+          time)) {
+    GST_WARNING ("Unable to seek to %" GST_TIME_FORMAT, GST_TIME_ARGS (time));
+    return FALSE;
+  }
+
+  /* reading might have reached the end before */
+  set_demuxer_state (demuxer, DEMUXER_ES_STATE_READY);
+
+  /* the position is the one of the video stream, where the keyframe is:
+   * the packets of other streams before its first one are dropped, and
+   * that one is kept for the next read */
+  video = gst_demuxer_es_find_best_stream (demuxer,
+      DEMUXER_ES_STREAM_TYPE_VIDEO);
+  while ((object =
+          gst_app_sink_try_pull_object (GST_APP_SINK (priv->appsink), -1))) {
+    if (GST_IS_EVENT (object)) {
+      appsink_handle_event (demuxer, GST_EVENT (object));
+    } else if (GST_IS_SAMPLE (object)) {
+      if (!video || (priv->current_stream_type == DEMUXER_ES_STREAM_TYPE_VIDEO
+              && (guint) priv->current_stream_id == video->id)) {
+        priv->pending_sample = GST_SAMPLE (object);
+        break;
+      }
+      gst_sample_unref (GST_SAMPLE (object));
+    }
+  }
+
+  if (!priv->pending_sample) {
+    GST_WARNING ("No packet after seeking to %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (time));
+    return FALSE;
+  }
+
+  buffer = gst_sample_get_buffer (priv->pending_sample);
+  GST_DEBUG ("Seek to %" GST_TIME_FORMAT " reached %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (time), GST_TIME_ARGS (buffer ? GST_BUFFER_PTS (buffer) :
+          GST_CLOCK_TIME_NONE));
+
+  if (position)
+    *position = buffer ? (gint64) GST_BUFFER_PTS (buffer) : -1;
+
+  return TRUE;
+}
+
 GstDemuxerEStream *
 gst_demuxer_es_find_best_stream (GstDemuxerES * demuxer,
     GstDemuxerEStreamType type)
@@ -723,6 +862,7 @@ gst_demuxer_es_teardown (GstDemuxerES * demuxer)
 
   g_list_free_full (priv->streams, (GDestroyNotify) gst_parse_stream_teardown);
   gst_object_unref (priv->pipeline);
+  gst_clear_caps (&priv->video_caps);
 
   g_cond_clear (&priv->ready_cond);
   g_mutex_clear (&priv->ready_mutex);
@@ -73,6 +73,25 @@ typedef enum GstDemuxerESAudioCodec {
   DEMUXER_ES_AUDIO_CODEC_AAC,
 } GstDemuxerESAudioCodec;
 
+typedef enum _GstDemuxerESFlags
+{
+  DEMUXER_ES_FLAG_NONE = 0,
+  /* H.264 and H.265 keep the format of the container: length prefixed NAL
+   * units (avc, hvc1...) aren't converted to byte-stream. */
+  DEMUXER_ES_FLAG_PACKETIZED = 1 << 0,
+} GstDemuxerESFlags;
+
+/* Where a seek lands: the keyframe at or before the requested time, unless
+ * one of these is set. */
+typedef enum _GstDemuxerESSeekFlags
+{
+  DEMUXER_ES_SEEK_FLAG_NONE = 0,
+  /* the keyframe at or after the requested time */
+  DEMUXER_ES_SEEK_FLAG_SNAP_AFTER = 1 << 0,
+  /* the keyframe closest to the requested time */
+  DEMUXER_ES_SEEK_FLAG_SNAP_NEAREST = 1 << 1,
+} GstDemuxerESSeekFlags;
+
 typedef enum _GstDemuxerESResult
 {
   /*< public >*/
@@ -92,6 +111,8 @@ typedef struct {
     gint64 pts;
     gint64 dts;
     gint64 duration;
+    /* where gst_demuxer_es_seek() can land */
+    gboolean keyframe;
 } GstDemuxerESPacket;
 
 typedef struct _GstDemuxerVideoInfo {
@@ -100,6 +121,12 @@ typedef struct _GstDemuxerVideoInfo {
   gchar* level;
   GstDemuxerESVideoCodec vcodec;
   GstVideoInfo info;
+  /* With DEMUXER_ES_FLAG_PACKETIZED, whether the packets are length
+   * prefixed, and the avcC/hvcC record if any. Updated when a packet with
+   * new caps is read. */
+  gboolean packetized;
+  guint8* codec_data;
+  gsize codec_data_size;
 } GstDemuxerESVideoInfo;
 
 typedef struct _GstDemuxerAudioInfo {
@@ -127,12 +154,24 @@ typedef struct
 GST_DEMUXER_ES_API
 GstDemuxerES * gst_demuxer_es_new (const gchar * uri);
 
+GST_DEMUXER_ES_API
+GstDemuxerES * gst_demuxer_es_new_full (const gchar * uri, GstDemuxerESFlags flags);
+
 GST_DEMUXER_ES_API
 GstDemuxerESResult gst_demuxer_es_read_packet (GstDemuxerES * demuxer, GstDemuxerESPacket ** packet);
 
 GST_DEMUXER_ES_API
 void gst_demuxer_es_clear_packet (GstDemuxerESPacket * packet);
 
+/* Seeks to the keyframe chosen by @flags around @time, in nanoseconds.
+ * The packets not read yet are dropped, and the next one read is the first
+ * packet of the video stream from the keyframe on, the packets of other
+ * streams before it being dropped too. Its pts, the position actually
+ * reached, is returned in @position if not NULL. Returns FALSE if the container can't
+ * seek or there is nothing to read from there. */
+GST_DEMUXER_ES_API
+gboolean gst_demuxer_es_seek (GstDemuxerES * demuxer, gint64 time, GstDemuxerESSeekFlags flags, gint64 * position);
+
 GST_DEMUXER_ES_API
 GstDemuxerEStream * gst_demuxer_es_find_best_stream (GstDemuxerES * demuxer, GstDemuxerEStreamType type);
 
@@ -0,0 +1,141 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "gstvkarraypool.h"
+
+/* arrays are neither grown beyond this nor kept if longer */
+#define MAX_RESERVED_BYTES (2 * 1024 * 1024)
+/* the reserved size decays by 1/16 on each release of a shorter array */
+#define RESERVED_SIZE_DECAY_SHIFT 4
+
+struct _GstVkArrayPool
+{
+  gint ref_count;
+
+  guint element_size;
+  guint max_arrays;
+
+  GMutex lock;
+  GPtrArray *arrays;
+  guint reserved_size;
+  guint max_reserved_size;
+
+  guint64 acquired;
+  guint64 allocated;
+};
+
+GstVkArrayPool *
+gst_vk_array_pool_new (guint element_size, guint max_arrays)
+{
+  GstVkArrayPool *pool = g_new0 (GstVkArrayPool, 1);
+
+  pool->ref_count = 1;
+  pool->element_size = element_size;
+  pool->max_arrays = max_arrays;
+  pool->max_reserved_size = MAX (MAX_RESERVED_BYTES / element_size, 1);
+  g_mutex_init (&pool->lock);
+  pool->arrays = g_ptr_array_sized_new (max_arrays);
+
+  return pool;
+}
+
+GstVkArrayPool *
+gst_vk_array_pool_ref (GstVkArrayPool * pool)
+{
+  g_atomic_int_inc (&pool->ref_count);
+  return pool;
+}
+
+void
+gst_vk_array_pool_unref (GstVkArrayPool * pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->ref_count))
+    return;
+
+  g_ptr_array_foreach (pool->arrays, (GFunc) g_array_unref, NULL);
+  g_ptr_array_unref (pool->arrays);
+  g_mutex_clear (&pool->lock);
+  g_free (pool);
+}
+
+GArray *
+gst_vk_array_pool_acquire (GstVkArrayPool * pool)
+{
+  GArray *array = NULL;
+  guint reserved_size;
+
+  g_mutex_lock (&pool->lock);
+  pool->acquired++;
+  if (pool->arrays->len > 0) {
+    array = (GArray *) g_ptr_array_remove_index_fast (pool->arrays,
+        pool->arrays->len - 1);
+  } else {
+    pool->allocated++;
+  }
+  reserved_size = pool->reserved_size;
+  g_mutex_unlock (&pool->lock);
+
+  if (!array) {
+    array = g_array_sized_new (FALSE, FALSE, pool->element_size, reserved_size);
+  } else if (reserved_size > 0) {
+    /* grows a reused array to the reserved size, once, instead of
+     * reallocating while it's filled */
+    g_array_set_size (array, reserved_size);
+    g_array_set_size (array, 0);
+  }
+
+  return array;
+}
+
+void
+gst_vk_array_pool_release (GstVkArrayPool * pool, GArray * array)
+{
+  guint reserved_size;
+
+  g_mutex_lock (&pool->lock);
+  /* follows the longest arrays released lately, but at most doubles at
+   * once, so a single large picture doesn't grow every array acquired
+   * afterwards */
+  reserved_size = MAX (array->len, pool->reserved_size -
+      (pool->reserved_size >> RESERVED_SIZE_DECAY_SHIFT));
+  if (pool->reserved_size > 0)
+    reserved_size = MIN (reserved_size, 2 * pool->reserved_size);
+  pool->reserved_size = MIN (reserved_size, pool->max_reserved_size);
+  if (array->len <= pool->max_reserved_size
+      && pool->arrays->len < pool->max_arrays) {
+    /* keeps the allocated storage */
+    g_array_set_size (array, 0);
+    g_ptr_array_add (pool->arrays, array);
+    array = NULL;
+  }
+  g_mutex_unlock (&pool->lock);
+
+  if (array)
+    g_array_unref (array);
+}
+
+void
+gst_vk_array_pool_get_stats (GstVkArrayPool * pool, guint64 * acquired,
+    guint64 * allocated)
+{
+  g_mutex_lock (&pool->lock);
+  if (acquired)
+    *acquired = pool->acquired;
+  if (allocated)
+    *allocated = pool->allocated;
+  g_mutex_unlock (&pool->lock);
+}
@@ -0,0 +1,47 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Recycles GArrays between pictures, so their storage is reused instead of
+ * being reallocated while slices are appended. Acquired arrays are sized to
+ * the longest ones released lately, up to 2 MiB; longer arrays are freed
+ * instead of kept. The pool is refcounted since pictures might outlive the
+ * decoder that created them. */
+typedef struct _GstVkArrayPool GstVkArrayPool;
+
+GstVkArrayPool *  gst_vk_array_pool_new        (guint element_size,
+                                                guint max_arrays);
+
+GstVkArrayPool *  gst_vk_array_pool_ref        (GstVkArrayPool * pool);
+
+void              gst_vk_array_pool_unref      (GstVkArrayPool * pool);
+
+GArray *          gst_vk_array_pool_acquire    (GstVkArrayPool * pool);
+
+void              gst_vk_array_pool_release    (GstVkArrayPool * pool,
+                                                GArray * array);
+
+void              gst_vk_array_pool_get_stats  (GstVkArrayPool * pool,
+                                                guint64 * acquired,
+                                                guint64 * allocated);
+
+G_END_DECLS
@@ -0,0 +1,180 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "gstvkbitstream.h"
+
+#include <string.h>
+
+void
+gst_vk_bitstream_init (GstVkBitstream * bitstream, GstVkArrayPool * pool,
+    const GstCodecBitstreamAllocator * allocator, gsize size_hint)
+{
+  memset (bitstream, 0, sizeof (*bitstream));
+  bitstream->pool = gst_vk_array_pool_ref (pool);
+  bitstream->size_hint = size_hint;
+  if (allocator && allocator->alloc)
+    bitstream->allocator = *allocator;
+  else
+    bitstream->array = gst_vk_array_pool_acquire (pool);
+}
+
+void
+gst_vk_bitstream_init_by_reference (GstVkBitstream * bitstream,
+    GstVkArrayPool * segments_pool)
+{
+  memset (bitstream, 0, sizeof (*bitstream));
+  bitstream->segments_pool = gst_vk_array_pool_ref (segments_pool);
+  bitstream->segments = gst_vk_array_pool_acquire (segments_pool);
+}
+
+static void
+release_allocated (GstVkBitstream * bitstream)
+{
+  if (bitstream->data && bitstream->allocator.release)
+    bitstream->allocator.release (bitstream->allocator.user_data,
+        bitstream->data);
+  bitstream->data = NULL;
+  bitstream->size = 0;
+}
+
+static gboolean
+reserve_allocated (GstVkBitstream * bitstream, gsize needed)
+{
+  gsize size, allocated = 0;
+  guint8 *data;
+
+  if (bitstream->len + needed <= bitstream->size)
+    return TRUE;
+
+  size = MAX (bitstream->size_hint, 2 * bitstream->size);
+  size = MAX (size, bitstream->len + needed);
+  data = bitstream->allocator.alloc (bitstream->allocator.user_data, size,
+      &allocated);
+  if (!data)
+    return FALSE;
+
+  if (bitstream->len > 0)
+    memcpy (data, bitstream->data, bitstream->len);
+  release_allocated (bitstream);
+  bitstream->data = data;
+  bitstream->size = MAX (allocated, size);
+
+  return TRUE;
+}
+
+void
+gst_vk_bitstream_append (GstVkBitstream * bitstream, const guint8 * start_code,
+    gsize start_code_size, const guint8 * data, gsize size)
+{
+  gsize needed = start_code_size + size;
+
+  if (!bitstream->array && !reserve_allocated (bitstream, needed)) {
+    /* the rest of the picture goes in the decoder's memory */
+    bitstream->array = gst_vk_array_pool_acquire (bitstream->pool);
+    g_array_append_vals (bitstream->array, bitstream->data, bitstream->len);
+    release_allocated (bitstream);
+    bitstream->len = 0;
+  }
+
+  if (bitstream->array) {
+    g_array_append_vals (bitstream->array, start_code, start_code_size);
+    g_array_append_vals (bitstream->array, data, size);
+    return;
+  }
+
+  memcpy (bitstream->data + bitstream->len, start_code, start_code_size);
+  memcpy (bitstream->data + bitstream->len + start_code_size, data, size);
+  bitstream->len += needed;
+}
+
+gboolean
+gst_vk_bitstream_append_reference (GstVkBitstream * bitstream,
+    gsize start_code_size, GstBuffer * input, gsize offset, gsize size)
+{
+  GstCodecSliceSegment segment;
+
+  if (!input)
+    return FALSE;
+
+  if (!bitstream->input) {
+    if (!gst_buffer_map (input, &bitstream->input_map, GST_MAP_READ))
+      return FALSE;
+    bitstream->input = gst_buffer_ref (input);
+  } else if (bitstream->input != input) {
+    return FALSE;
+  }
+
+  if (offset + size > bitstream->input_map.size)
+    return FALSE;
+
+  segment.data = bitstream->input_map.data + offset;
+  segment.size = size;
+  g_array_append_val (bitstream->segments, segment);
+  bitstream->len += start_code_size + size;
+
+  return TRUE;
+}
+
+const GstCodecSliceSegment *
+gst_vk_bitstream_get_segments (GstVkBitstream * bitstream, guint * n_segments)
+{
+  if (!bitstream->segments) {
+    *n_segments = 0;
+    return NULL;
+  }
+
+  *n_segments = bitstream->segments->len;
+  return (const GstCodecSliceSegment *) bitstream->segments->data;
+}
+
+const guint8 *
+gst_vk_bitstream_get_data (GstVkBitstream * bitstream, gsize * len)
+{
+  if (bitstream->array) {
+    *len = bitstream->array->len;
+    return (const guint8 *) bitstream->array->data;
+  }
+
+  *len = bitstream->len;
+  return bitstream->data;
+}
+
+void
+gst_vk_bitstream_hand_over (GstVkBitstream * bitstream)
+{
+  bitstream->data = NULL;
+  bitstream->size = 0;
+}
+
+void
+gst_vk_bitstream_clear (GstVkBitstream * bitstream)
+{
+  release_allocated (bitstream);
+  if (bitstream->array)
+    gst_vk_array_pool_release (bitstream->pool, bitstream->array);
+  if (bitstream->pool)
+    gst_vk_array_pool_unref (bitstream->pool);
+  if (bitstream->input) {
+    gst_buffer_unmap (bitstream->input, &bitstream->input_map);
+    gst_buffer_unref (bitstream->input);
+  }
+  if (bitstream->segments)
+    gst_vk_array_pool_release (bitstream->segments_pool, bitstream->segments);
+  if (bitstream->segments_pool)
+    gst_vk_array_pool_unref (bitstream->segments_pool);
+  memset (bitstream, 0, sizeof (*bitstream));
+}
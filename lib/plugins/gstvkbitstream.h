@@ -0,0 +1,79 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+
+#include "gstvkarraypool.h"
+#include "gstcodecbitstream.h"
+
+G_BEGIN_DECLS
+
+/* The slices of a picture, with their start codes. They are written in the
+ * memory of the application's allocator, if there's one, and otherwise, or
+ * if it fails, in an array from the pool. By reference, they are segments
+ * pointing into the input buffer instead, and the length and offsets are
+ * the ones they would have written. */
+typedef struct
+{
+  GstCodecBitstreamAllocator allocator;
+  GstVkArrayPool *pool;
+  GArray *array;
+  guint8 *data;
+  gsize size;
+  gsize len;
+  /* first allocation size, usually the size of the access unit */
+  gsize size_hint;
+  GstVkArrayPool *segments_pool;
+  GArray *segments;
+  GstBuffer *input;
+  GstMapInfo input_map;
+} GstVkBitstream;
+
+void              gst_vk_bitstream_init        (GstVkBitstream * bitstream,
+                                                GstVkArrayPool * pool,
+                                                const GstCodecBitstreamAllocator * allocator,
+                                                gsize size_hint);
+
+void              gst_vk_bitstream_append      (GstVkBitstream * bitstream,
+                                                const guint8 * start_code,
+                                                gsize start_code_size,
+                                                const guint8 * data,
+                                                gsize size);
+
+void              gst_vk_bitstream_init_by_reference (GstVkBitstream * bitstream,
+                                                GstVkArrayPool * segments_pool);
+
+gboolean          gst_vk_bitstream_append_reference (GstVkBitstream * bitstream,
+                                                gsize start_code_size,
+                                                GstBuffer * input,
+                                                gsize offset,
+                                                gsize size);
+
+const GstCodecSliceSegment * gst_vk_bitstream_get_segments (GstVkBitstream * bitstream,
+                                                guint * n_segments);
+
+const guint8 *    gst_vk_bitstream_get_data    (GstVkBitstream * bitstream,
+                                                gsize * len);
+
+/* the application owns the allocated memory from now on */
+void              gst_vk_bitstream_hand_over   (GstVkBitstream * bitstream);
+
+void              gst_vk_bitstream_clear       (GstVkBitstream * bitstream);
+
+G_END_DECLS
@@ -21,6 +21,9 @@
 
 
 #include "videoutils.h"
+#include "gstvkarraypool.h"
+#include "gstvkbitstream.h"
+#include "gstvkpicpool.h"
 
 #include "VulkanVideoParserIf.h"
 
@@ -38,17 +41,26 @@ static GstStaticPadTemplate src_factory =
 GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("video/x-raw, format=(string)NV12"));
 
-typedef struct _VkH264Picture VkH264Picture;
-struct _VkH264Picture
+/* Parameter set snapshots. They are filled once per received parameter set,
+ * allocated with param_set_new(), and never modified afterwards, so every
+ * picture using them just keeps a reference. */
+typedef struct _VkH264Sps VkH264Sps;
+struct _VkH264Sps
 {
   StdVideoH264HrdParameters hrd;
   StdVideoH264SequenceParameterSetVui vui;
   StdVideoH264SequenceParameterSet sps;
-  StdVideoH264PictureParameterSet pps;
-  StdVideoH264ScalingLists scaling_lists_sps, scaling_lists_pps;
+  StdVideoH264ScalingLists scaling_lists;
   int32_t offset_for_ref_frame[255];
 };
 
+typedef struct _VkH264Pps VkH264Pps;
+struct _VkH264Pps
+{
+  StdVideoH264PictureParameterSet pps;
+  StdVideoH264ScalingLists scaling_lists;
+};
+
 typedef struct _GstVkH264Dec GstVkH264Dec;
 struct _GstVkH264Dec
 {
@@ -58,29 +70,53 @@ struct _GstVkH264Dec
 
   gint max_dpb_size;
 
-  VkH264Picture vkp;
+  VkH264Sps *sps[GST_H264_MAX_SPS_COUNT];
+  VkH264Pps *pps[GST_H264_MAX_PPS_COUNT];
   GArray *refs;
 
   VkSharedBaseObj<VkParserVideoRefCountBase> spsclient, ppsclient;
 
   guint32 sps_update_count;
   guint32 pps_update_count;
+
+  GstVkPicPool *pic_pool;
+  GstCodecPictureCache *picture_cache;
+  GstVkArrayPool *bitstream_pool;
+  GstVkArrayPool *slice_offsets_pool;
+  GstCodecBitstreamAllocator bitstream_allocator;
+  GstCodecSliceSegmentsCallback slice_segments;
+  GstVkArrayPool *segments_pool;
+  GstVkArrayPool *slice_group_map_pool;
+
+  GstCodecStats *stats;
 };
 
 struct VkPic
 {
   VkPicIf *pic;
   VkParserPictureData data;
-  GByteArray *bitstream;
-  VkH264Picture vkp;
-  uint8_t *slice_group_map;
+  GstVkBitstream bitstream;
+  VkH264Sps *sps;
+  VkH264Pps *pps;
+  GArray *slice_group_map;
   GArray *slice_offsets;
+  GstVkPicPool *pic_pool;
+  GstVkArrayPool *slice_offsets_pool;
+  GstVkArrayPool *slice_group_map_pool;
+  GstCodecStats *stats;
 };
 
+/* pictures in the DPB, plus the second fields and the ones in flight */
+#define VK_PIC_POOL_SIZE 36
+
 enum
 {
   PROP_USER_DATA = 1,
   PROP_OOB_PIC_PARAMS,
+  PROP_STATS,
+  PROP_BITSTREAM_ALLOCATOR,
+  PROP_SLICE_SEGMENTS,
+  PROP_KEYFRAMES_ONLY,
 };
 
 G_DEFINE_TYPE(GstVkH264Dec, gst_vk_h264_dec, GST_TYPE_H264_DECODER)
@@ -185,15 +221,39 @@ get_h264_weighted_bipred_idc (guint8 weighted_bipred_idc)
   return STD_VIDEO_H264_WEIGHTED_BIPRED_IDC_INVALID;
 }
 
-static VkPic *vk_pic_new (VkPicIf * pic)
+static VkPic *
+vk_pic_new (GstVkH264Dec * self, VkPicIf * pic, gsize size_hint)
 {
-  VkPic *vkpic = g_new0 (struct VkPic, 1);
+  VkPic *vkpic =
+      static_cast<VkPic *>(gst_vk_pic_pool_acquire (self->pic_pool));
   uint32_t zero = 0;
 
+  /* recycled pictures aren't cleared, the rest of the fields, data
+   * included, are set before they're read */
   vkpic->pic = pic;
-  vkpic->bitstream = g_byte_array_new ();
-  vkpic->slice_offsets = g_array_new (FALSE, FALSE, sizeof (uint32_t));
+  vkpic->pic_pool = gst_vk_pic_pool_ref (self->pic_pool);
+  vkpic->sps = NULL;
+  vkpic->pps = NULL;
+  vkpic->stats = NULL;
+  if (self->slice_segments.func) {
+    gst_vk_bitstream_init_by_reference (&vkpic->bitstream,
+        self->segments_pool);
+  } else {
+    gst_vk_bitstream_init (&vkpic->bitstream, self->bitstream_pool,
+        &self->bitstream_allocator, size_hint);
+  }
+  vkpic->slice_offsets_pool = gst_vk_array_pool_ref (self->slice_offsets_pool);
+  vkpic->slice_offsets = gst_vk_array_pool_acquire (self->slice_offsets_pool);
   g_array_append_val (vkpic->slice_offsets, zero);
+  vkpic->slice_group_map_pool =
+      gst_vk_array_pool_ref (self->slice_group_map_pool);
+  vkpic->slice_group_map =
+      gst_vk_array_pool_acquire (self->slice_group_map_pool);
+  if (self->stats) {
+    vkpic->stats = gst_codec_stats_ref (self->stats);
+    gst_codec_stats_gauge_add (vkpic->stats,
+        GST_CODEC_STATS_PICTURES_IN_FLIGHT, 1);
+  }
   return vkpic;
 }
 
@@ -201,14 +261,29 @@ static void
 vk_pic_free (gpointer data)
 {
   VkPic *vkpic = static_cast<VkPic *>(data);
+  GstVkPicPool *pic_pool;
+
   if (vkpic->pic)
     vkpic->pic->Release ();
-  g_byte_array_unref (vkpic->bitstream);
-  g_free ((uint32_t *)vkpic->data.pSliceDataOffsets);
-  g_free (vkpic->data.pBitstreamData);
-  g_array_unref (vkpic->slice_offsets);
-  g_free (vkpic->slice_group_map);
-  g_free (vkpic);
+  gst_vk_bitstream_clear (&vkpic->bitstream);
+  gst_vk_array_pool_release (vkpic->slice_offsets_pool, vkpic->slice_offsets);
+  gst_vk_array_pool_unref (vkpic->slice_offsets_pool);
+  gst_vk_array_pool_release (vkpic->slice_group_map_pool,
+      vkpic->slice_group_map);
+  gst_vk_array_pool_unref (vkpic->slice_group_map_pool);
+  if (vkpic->sps)
+    param_set_unref (vkpic->sps);
+  if (vkpic->pps)
+    param_set_unref (vkpic->pps);
+  if (vkpic->stats) {
+    gst_codec_stats_gauge_add (vkpic->stats,
+        GST_CODEC_STATS_PICTURES_IN_FLIGHT, -1);
+    gst_codec_stats_unref (vkpic->stats);
+  }
+  /* vkpic can't be touched once it's back in the pool */
+  pic_pool = vkpic->pic_pool;
+  gst_vk_pic_pool_release (pic_pool, vkpic);
+  gst_vk_pic_pool_unref (pic_pool);
 }
 
 static bool
@@ -229,7 +304,9 @@ gst_vk_h264_dec_new_sequence (GstH264Decoder * decoder, const GstH264SPS * sps,
   GstVideoCodecState *state;
   VkParserSequenceInfo seqInfo;
   guint dar_n = 0, dar_d = 0;
+  gint dpb_size;
 
+  /* ProbeVulkanVideoDecodeParserSequence() fills it the same way */
   seqInfo = VkParserSequenceInfo {
     .eCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT,
     .isSVC = profile_is_svc(decoder->input_state->caps),
@@ -279,8 +356,19 @@ gst_vk_h264_dec_new_sequence (GstH264Decoder * decoder, const GstH264SPS * sps,
     seqInfo.lDARHeight = dar_d;
   }
 
-  if (self->client)
+  if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
     self->max_dpb_size = self->client->BeginSequence (&seqInfo);
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+  }
+
+  dpb_size = self->client ? self->max_dpb_size : max_dpb_size;
+  /* every field has its own picture */
+  gst_vk_pic_pool_set_capacity (self->pic_pool, MAX (2 * (dpb_size + 1), 0));
+  gst_codec_picture_cache_set_capacity (self->picture_cache,
+      MAX (2 * (dpb_size + 1), 0));
 
   state =
       gst_video_decoder_set_output_state (dec, GST_VIDEO_FORMAT_NV12,
@@ -296,21 +384,34 @@ static GstFlowReturn
 gst_vk_h264_dec_decode_slice (GstH264Decoder * decoder, GstH264Picture * picture,
     GstH264Slice * slice, GArray * ref_pic_list0, GArray * ref_pic_list1)
 {
+  GstVkH264Dec *self = GST_VK_H264_DEC (decoder);
   VkPic *vkpic = static_cast<VkPic *>(gst_h264_picture_get_user_data(picture));
   static const uint8_t nal[] = { 0, 0, 1 };
   uint32_t offset;
 
   vkpic->data.nNumSlices++;
   // nvidia parser adds 000001 NAL unit identifier at every slice
-  g_byte_array_append (vkpic->bitstream, nal, sizeof (nal));
-  g_byte_array_append (vkpic->bitstream, slice->nalu.data + slice->nalu.offset,
-      slice->nalu.size);
+  if (self->slice_segments.func) {
+    if (!gst_vk_bitstream_append_reference (&vkpic->bitstream, sizeof (nal),
+            gst_h264_decoder_get_input_buffer (decoder), slice->nalu.offset,
+            slice->nalu.size)) {
+      GST_ERROR_OBJECT (self, "Slice outside of the input buffer");
+      return GST_FLOW_ERROR;
+    }
+  } else {
+    gst_vk_bitstream_append (&vkpic->bitstream, nal, sizeof (nal),
+        slice->nalu.data + slice->nalu.offset, slice->nalu.size);
+    gst_codec_stats_add (self->stats, GST_CODEC_STATS_BYTES_COPIED,
+        slice->nalu.size + sizeof (nal));
+  }
   // GST_MEMDUMP_OBJECT(decoder, "SLICE :", slice->nalu.data + slice->nalu.offset, slice->nalu.size);
   offset =
       g_array_index (vkpic->slice_offsets, uint32_t,
       vkpic->slice_offsets->len - 1) + slice->nalu.size + sizeof (nal);
   g_array_append_val (vkpic->slice_offsets, offset);
 
+  gst_codec_stats_add (self->stats, GST_CODEC_STATS_SLICES, 1);
+
   return GST_FLOW_OK;
 }
 
@@ -323,15 +424,19 @@ gst_vk_h264_dec_new_picture (GstH264Decoder * decoder, GstVideoCodecFrame * fram
   VkPic *vkpic;
 
   if (self->client) {
-    if (!self->client->AllocPictureBuffer (&pic))
+    GstClockTime start = gst_codec_stats_start (self->stats);
+    bool allocated = self->client->AllocPictureBuffer (&pic);
+
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+    if (!allocated)
       return GST_FLOW_ERROR;
   }
 
-  vkpic = vk_pic_new (pic);
+  vkpic = vk_pic_new (self, pic, bitstream_size_hint (frame->input_buffer,
+          gst_h264_decoder_get_nal_length_size (decoder)));
   gst_h264_picture_set_user_data (picture, vkpic, vk_pic_free);
 
-  frame->output_buffer = gst_buffer_new ();
-
   return GST_FLOW_OK;
 }
 
@@ -341,14 +446,20 @@ gst_vk_h264_dec_new_field_picture (GstH264Decoder * decoder,
 {
   GstVkH264Dec *self = GST_VK_H264_DEC (decoder);
   VkPicIf *pic = nullptr;
-  VkPic *vkpic;
+  VkPic *vkpic, *first;
 
   if (self->client) {
-    if (!self->client->AllocPictureBuffer (&pic))
+    GstClockTime start = gst_codec_stats_start (self->stats);
+    bool allocated = self->client->AllocPictureBuffer (&pic);
+
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+    if (!allocated)
       return GST_FLOW_ERROR;
   }
 
-  vkpic = vk_pic_new (pic);
+  first = static_cast<VkPic *>(gst_h264_picture_get_user_data (first_field));
+  vkpic = vk_pic_new (self, pic, first ? first->bitstream.size_hint : 0);
   gst_h264_picture_set_user_data (second_field, vkpic, vk_pic_free);
 
   return GST_FLOW_OK;
@@ -362,15 +473,22 @@ gst_vk_h264_dec_output_picture (GstH264Decoder * decoder,
   VkPic *vkpic = reinterpret_cast<VkPic *>(gst_h264_picture_get_user_data(picture));;
 
   if (self->client) {
-    if (!self->client->DisplayPicture (vkpic->pic,
-            picture->system_frame_number * frame->duration / 100)) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+    bool displayed = self->client->DisplayPicture (vkpic->pic,
+        picture->system_frame_number * frame->duration / 100);
+
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+    if (!displayed) {
       gst_h264_picture_unref (picture);
       return GST_FLOW_ERROR;
     }
   }
 
   gst_h264_picture_unref (picture);
-  return gst_video_decoder_finish_frame (GST_VIDEO_DECODER (decoder), frame);
+  /* the picture was delivered to the client, there's nothing to push */
+  gst_video_decoder_release_frame (GST_VIDEO_DECODER (decoder), frame);
+  return GST_FLOW_OK;
 }
 
 static GstFlowReturn
@@ -378,28 +496,47 @@ gst_vk_h264_dec_end_picture (GstH264Decoder * decoder, GstH264Picture * picture)
 {
   GstVkH264Dec *self = GST_VK_H264_DEC (decoder);
   VkPic *vkpic = reinterpret_cast<VkPic *>(gst_h264_picture_get_user_data(picture));
-  gsize len;
   GstFlowReturn ret = GST_FLOW_OK;
+  const guint8 *data;
+  gsize len;
 
-  vkpic->data.pBitstreamData = g_byte_array_steal (vkpic->bitstream, &len);
+  /* the arrays are kept by the picture until it's freed */
+  data = gst_vk_bitstream_get_data (&vkpic->bitstream, &len);
+  vkpic->data.pBitstreamData = const_cast<uint8_t *>(data);
   vkpic->data.nBitstreamDataLen = static_cast<int32_t>(len);
   vkpic->data.pSliceDataOffsets =
-      static_cast <uint32_t *>(g_array_steal (vkpic->slice_offsets, NULL));
+      reinterpret_cast<uint32_t *>(vkpic->slice_offsets->data);
 
   if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
+    if (self->slice_segments.func) {
+      const GstCodecSliceSegment *segments;
+      guint n_segments;
+
+      segments = gst_vk_bitstream_get_segments (&vkpic->bitstream,
+          &n_segments);
+      self->slice_segments.func (self->slice_segments.user_data,
+          &vkpic->data, segments, n_segments);
+    }
+    gst_vk_bitstream_hand_over (&vkpic->bitstream);
     if (!self->client->DecodePicture (&vkpic->data))
       ret = GST_FLOW_ERROR;
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
   }
 
   return ret;
 }
 
 static uint8_t *
-get_slice_group_map (GstH264PPS * pps)
+get_slice_group_map (GstH264PPS * pps, GArray * map)
 {
   uint8_t *ret, i, j, k;
 
-  ret = g_new0 (uint8_t, pps->pic_size_in_map_units_minus1 + 1);
+  g_array_set_size (map, pps->pic_size_in_map_units_minus1 + 1);
+  ret = reinterpret_cast<uint8_t *>(map->data);
+  memset (ret, 0, map->len);
 
   if (pps->num_slice_groups_minus1 == 0)
     return ret;
@@ -463,20 +600,22 @@ get_slice_group_map (GstH264PPS * pps)
   return ret;
 }
 
-static void
-fill_sps (GstH264SPS * sps, VkH264Picture * vkp)
+static VkH264Sps *
+new_sps (GstH264SPS * sps)
 {
+  VkH264Sps *vkp =
+      static_cast<VkH264Sps *>(param_set_new (sizeof (VkH264Sps)));
   GstH264VUIParams *vui = &sps->vui_parameters;
   GstH264HRDParams *hrd = NULL;
 
   if (sps->scaling_matrix_present_flag) {
-    vkp->scaling_lists_sps.scaling_list_present_mask = 1;
-    vkp->scaling_lists_sps.use_default_scaling_matrix_mask = 0;
+    vkp->scaling_lists.scaling_list_present_mask = 1;
+    vkp->scaling_lists.use_default_scaling_matrix_mask = 0;
 
-    memcpy (&vkp->scaling_lists_sps.ScalingList4x4, &sps->scaling_lists_4x4,
-        sizeof (vkp->scaling_lists_sps.ScalingList4x4));
-    memcpy (&vkp->scaling_lists_sps.ScalingList8x8, &sps->scaling_lists_8x8,
-        sizeof (vkp->scaling_lists_sps.ScalingList8x8));
+    memcpy (&vkp->scaling_lists.ScalingList4x4, &sps->scaling_lists_4x4,
+        sizeof (vkp->scaling_lists.ScalingList4x4));
+    memcpy (&vkp->scaling_lists.ScalingList8x8, &sps->scaling_lists_8x8,
+        sizeof (vkp->scaling_lists.ScalingList8x8));
   }
 
   if (sps->num_ref_frames_in_pic_order_cnt_cycle > 0) {
@@ -583,23 +722,28 @@ fill_sps (GstH264SPS * sps, VkH264Picture * vkp)
     .pOffsetForRefFrame = (sps->num_ref_frames_in_pic_order_cnt_cycle > 0) ?
         vkp->offset_for_ref_frame : nullptr,
     .pScalingLists = sps->scaling_matrix_present_flag ?
-        &vkp->scaling_lists_sps : nullptr,
+        &vkp->scaling_lists : nullptr,
     .pSequenceParameterSetVui = sps->vui_parameters_present_flag ?
         &vkp->vui : nullptr,
   };
+
+  return vkp;
 }
 
-static void
-fill_pps (GstH264PPS * pps, VkH264Picture * vkp)
+static VkH264Pps *
+new_pps (GstH264PPS * pps)
 {
+  VkH264Pps *vkp =
+      static_cast<VkH264Pps *>(param_set_new (sizeof (VkH264Pps)));
+
   if (pps->pic_scaling_matrix_present_flag) {
-    vkp->scaling_lists_pps.scaling_list_present_mask = 1;
-    vkp->scaling_lists_pps.use_default_scaling_matrix_mask = 0;
+    vkp->scaling_lists.scaling_list_present_mask = 1;
+    vkp->scaling_lists.use_default_scaling_matrix_mask = 0;
 
-    memcpy (&vkp->scaling_lists_pps.ScalingList4x4, &pps->scaling_lists_4x4,
-        sizeof (vkp->scaling_lists_pps.ScalingList4x4));
-    memcpy (&vkp->scaling_lists_pps.ScalingList8x8, &pps->scaling_lists_8x8,
-        sizeof (vkp->scaling_lists_pps.ScalingList8x8));
+    memcpy (&vkp->scaling_lists.ScalingList4x4, &pps->scaling_lists_4x4,
+        sizeof (vkp->scaling_lists.ScalingList4x4));
+    memcpy (&vkp->scaling_lists.ScalingList8x8, &pps->scaling_lists_8x8,
+        sizeof (vkp->scaling_lists.ScalingList8x8));
   }
 
   vkp->pps = StdVideoH264PictureParameterSet {
@@ -625,8 +769,30 @@ fill_pps (GstH264PPS * pps, VkH264Picture * vkp)
     .second_chroma_qp_index_offset =
         static_cast<int8_t>(pps->second_chroma_qp_index_offset),
     .pScalingLists = pps->pic_scaling_matrix_present_flag ?
-        &vkp->scaling_lists_pps : NULL,
+        &vkp->scaling_lists : NULL,
   };
+
+  return vkp;
+}
+
+static VkH264Sps *
+gst_vk_h264_dec_set_sps (GstVkH264Dec * self, GstH264SPS * sps)
+{
+  if (sps->id >= GST_H264_MAX_SPS_COUNT)
+    return NULL;
+  if (self->sps[sps->id])
+    param_set_unref (self->sps[sps->id]);
+  return (self->sps[sps->id] = new_sps (sps));
+}
+
+static VkH264Pps *
+gst_vk_h264_dec_set_pps (GstVkH264Dec * self, GstH264PPS * pps)
+{
+  if (pps->id >= GST_H264_MAX_PPS_COUNT)
+    return NULL;
+  if (self->pps[pps->id])
+    param_set_unref (self->pps[pps->id]);
+  return (self->pps[pps->id] = new_pps (pps));
 }
 
 static void
@@ -686,16 +852,19 @@ gst_vk_h264_dec_start_picture (GstH264Decoder * decoder, GstH264Picture * pictur
   GstVkH264Dec *self = GST_VK_H264_DEC (decoder);
   VkPic *vkpic =
       reinterpret_cast <VkPic *>(gst_h264_picture_get_user_data (picture));
-  VkH264Picture *vkp = &self->vkp;
   GstH264PPS *pps = slice->header.pps;
   GstH264SPS *sps = pps->sequence;
 
-  if (!self->oob_pic_params
-      || (self->sps_update_count == 0 && self->sps_update_count == 0)) {
-    vkp = &vkpic->vkp;
-    fill_sps (sps, vkp);
-    fill_pps (pps, vkp);
-  }
+  /* parameter sets not notified through update_picture_parameters() */
+  if (!self->sps[sps->id])
+    gst_vk_h264_dec_set_sps (self, sps);
+  if (!self->pps[pps->id])
+    gst_vk_h264_dec_set_pps (self, pps);
+
+  vkpic->sps =
+      static_cast<VkH264Sps *>(param_set_ref (self->sps[sps->id]));
+  vkpic->pps =
+      static_cast<VkH264Pps *>(param_set_ref (self->pps[pps->id]));
 
   vkpic->data = VkParserPictureData {
     .PicWidthInMbs = sps->width / 16, // Coded Frame Size
@@ -728,9 +897,9 @@ gst_vk_h264_dec_start_picture (GstH264Decoder * decoder, GstH264Picture * pictur
 
   VkParserH264PictureData *h264 = &vkpic->data.CodecSpecific.h264;
   *h264 = VkParserH264PictureData {
-    .pStdSps = &vkp->sps,
+    .pStdSps = &vkpic->sps->sps,
     .pSpsClientObject = self->spsclient,
-    .pStdPps = &vkp->pps,
+    .pStdPps = &vkpic->pps->pps,
     .pPpsClientObject = self->ppsclient,
     .pic_parameter_set_id = static_cast<uint8_t>(pps->id),          // PPS ID
     .seq_parameter_set_id = static_cast<uint8_t>(pps->sequence->id),          // SPS ID
@@ -760,9 +929,7 @@ gst_vk_h264_dec_start_picture (GstH264Decoder * decoder, GstH264Picture * pictur
     .slice_group_map_type = pps->slice_group_map_type,
     .pic_init_qs_minus26 = pps->pic_init_qp_minus26,
     .slice_group_change_rate_minus1 = pps->slice_group_change_rate_minus1,
-    .pMb2SliceGroupMap =
-        (vkpic->slice_group_map = get_slice_group_map (pps),
-         vkpic->slice_group_map),
+    .pMb2SliceGroupMap = get_slice_group_map (pps, vkpic->slice_group_map),
     // // DPB
     // VkParserH264DpbEntry dpb[16 + 1]; // List of reference frames within the DPB
   };
@@ -798,8 +965,13 @@ gst_vk_h264_dec_unhandled_nalu (GstH264Decoder * decoder, const guint8 * data,
 {
   GstVkH264Dec *self = GST_VK_H264_DEC (decoder);
 
-  if (self->client)
+  if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
     self->client->UnhandledNALU (data, size);
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+  }
 }
 
 static void
@@ -812,31 +984,43 @@ gst_vk_h264_dec_update_picture_parameters (GstH264Decoder * decoder,
   switch (type) {
     case GST_H264_NAL_SPS:{
       GstH264SPS *sps = static_cast < GstH264SPS * >(nalu);
-      fill_sps (sps, &self->vkp);
+      VkH264Sps *vksps = gst_vk_h264_dec_set_sps (self, sps);
+      if (!vksps)
+        break;
       params = VkPictureParameters {
         .updateType = VK_PICTURE_PARAMETERS_UPDATE_H264_SPS,
-        .pH264Sps = &self->vkp.sps,
+        .pH264Sps = &vksps->sps,
         .updateSequenceCount = self->sps_update_count++,
       };
       if (self->client) {
+        GstClockTime start = gst_codec_stats_start (self->stats);
+
         if (!self->client->UpdatePictureParameters (&params, self->spsclient,
                 params.updateSequenceCount))
           GST_ERROR_OBJECT (self, "Failed to update sequence parameters");
+        gst_codec_stats_record (self->stats,
+            GST_CODEC_STATS_CLIENT_CALLBACKS, start);
       }
       break;
     }
     case GST_H264_NAL_PPS:{
       GstH264PPS *pps = static_cast < GstH264PPS * >(nalu);
-      fill_pps (pps, &self->vkp);
+      VkH264Pps *vkpps = gst_vk_h264_dec_set_pps (self, pps);
+      if (!vkpps)
+        break;
       params = VkPictureParameters {
         .updateType = VK_PICTURE_PARAMETERS_UPDATE_H264_PPS,
-        .pH264Pps = &self->vkp.pps,
+        .pH264Pps = &vkpps->pps,
         .updateSequenceCount = self->pps_update_count++,
       };
       if (self->client) {
+        GstClockTime start = gst_codec_stats_start (self->stats);
+
         if (!self->client->UpdatePictureParameters (&params, self->ppsclient,
                 params.updateSequenceCount))
           GST_ERROR_OBJECT (self, "Failed to update picture parameters");
+        gst_codec_stats_record (self->stats,
+            GST_CODEC_STATS_CLIENT_CALLBACKS, start);
       }
       break;
     }
@@ -857,6 +1041,33 @@ gst_vk_h264_dec_dispose (GObject * object)
 
   g_clear_pointer (&self->refs, g_array_unref);
 
+  for (guint i = 0; i < G_N_ELEMENTS (self->sps); i++)
+    g_clear_pointer (&self->sps[i], param_set_unref);
+  for (guint i = 0; i < G_N_ELEMENTS (self->pps); i++)
+    g_clear_pointer (&self->pps[i], param_set_unref);
+
+  if (self->bitstream_pool) {
+    guint64 acquired, allocated;
+
+    gst_vk_array_pool_get_stats (self->bitstream_pool, &acquired, &allocated);
+    GST_INFO_OBJECT (self, "%" G_GUINT64_FORMAT " bitstream allocations for %"
+        G_GUINT64_FORMAT " pictures", allocated, acquired);
+  }
+  if (self->pic_pool) {
+    guint64 hits, misses;
+
+    gst_vk_pic_pool_get_stats (self->pic_pool, &hits, &misses);
+    GST_INFO_OBJECT (self, "picture pool: %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses", hits, misses);
+  }
+  g_clear_pointer (&self->pic_pool, gst_vk_pic_pool_unref);
+  g_clear_pointer (&self->picture_cache, gst_codec_picture_cache_unref);
+  g_clear_pointer (&self->bitstream_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->slice_offsets_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->segments_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->slice_group_map_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->stats, gst_codec_stats_unref);
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -874,6 +1085,32 @@ gst_vk_h264_dec_set_property (GObject * object, guint property_id,
     case PROP_OOB_PIC_PARAMS:
       self->oob_pic_params = g_value_get_boolean (value);
       break;
+    case PROP_STATS:
+      self->stats = static_cast<GstCodecStats *>(g_value_get_pointer (value));
+      if (self->stats)
+        gst_codec_stats_ref (self->stats);
+      gst_h264_decoder_set_stats (GST_H264_DECODER (self), self->stats);
+      break;
+    case PROP_BITSTREAM_ALLOCATOR:{
+      const GstCodecBitstreamAllocator *allocator =
+          static_cast<GstCodecBitstreamAllocator *>(g_value_get_pointer (value));
+
+      if (allocator)
+        self->bitstream_allocator = *allocator;
+      break;
+    }
+    case PROP_SLICE_SEGMENTS:{
+      const GstCodecSliceSegmentsCallback *callback =
+          static_cast<GstCodecSliceSegmentsCallback *>(g_value_get_pointer (value));
+
+      if (callback)
+        self->slice_segments = *callback;
+      break;
+    }
+    case PROP_KEYFRAMES_ONLY:
+      gst_h264_decoder_set_keyframes_only (GST_H264_DECODER (self),
+          g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -921,6 +1158,26 @@ gst_vk_h264_dec_class_init (GstVkH264DecClass * klass)
       g_param_spec_boolean ("oob-pic-params", "oob-pic-params",
           "oop-pic-params", FALSE,
           GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_pointer ("stats", "stats",
+          "GstCodecStats where parsing counters and times are recorded",
+          GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_BITSTREAM_ALLOCATOR,
+      g_param_spec_pointer ("bitstream-allocator", "bitstream-allocator",
+          "GstCodecBitstreamAllocator where the slices are written, copied "
+          "when set", GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_SEGMENTS,
+      g_param_spec_pointer ("slice-segments", "slice-segments",
+          "GstCodecSliceSegmentsCallback receiving the slices by reference, "
+          "copied when set", GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_KEYFRAMES_ONLY,
+      g_param_spec_boolean ("keyframes-only", "keyframes-only",
+          "Skip the pictures which aren't IDR", FALSE,
+          GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
 }
 
 static void
@@ -930,4 +1187,15 @@ gst_vk_h264_dec_init (GstVkH264Dec * self)
 
   self->refs = g_array_sized_new (FALSE, TRUE, sizeof (GstH264Decoder *), 16);
   g_array_set_clear_func (self->refs, (GDestroyNotify) gst_clear_h264_picture);
+
+  self->pic_pool = gst_vk_pic_pool_new (sizeof (VkPic));
+  self->picture_cache = gst_codec_picture_cache_new (sizeof (GstH264Picture));
+  gst_h264_decoder_set_picture_cache (GST_H264_DECODER (self),
+      self->picture_cache);
+  self->bitstream_pool = gst_vk_array_pool_new (1, VK_PIC_POOL_SIZE);
+  self->slice_offsets_pool =
+      gst_vk_array_pool_new (sizeof (uint32_t), VK_PIC_POOL_SIZE);
+  self->segments_pool =
+      gst_vk_array_pool_new (sizeof (GstCodecSliceSegment), VK_PIC_POOL_SIZE);
+  self->slice_group_map_pool = gst_vk_array_pool_new (1, VK_PIC_POOL_SIZE);
 }
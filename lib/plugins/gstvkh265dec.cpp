@@ -21,6 +21,9 @@
 #include <atomic>
 
 #include "videoutils.h"
+#include "gstvkarraypool.h"
+#include "gstvkbitstream.h"
+#include "gstvkpicpool.h"
 #include "VulkanVideoParserIf.h"
 #include "vulkan_video_codec_h265std.h"
 
@@ -39,17 +42,32 @@ static GstStaticPadTemplate src_factory =
 GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("video/x-raw, format=(string)NV12"));
 
-typedef struct _VkH265Picture VkH265Picture;
-struct _VkH265Picture
+/* Parameter set snapshots. They are filled once per received parameter set,
+ * allocated with param_set_new(), and never modified afterwards, so every
+ * picture using them just keeps a reference. */
+typedef struct _VkH265Vps VkH265Vps;
+struct _VkH265Vps
+{
+  StdVideoH265VideoParameterSet vps;
+  StdVideoH265DecPicBufMgr pic_buf_mgr;
+};
+
+typedef struct _VkH265Sps VkH265Sps;
+struct _VkH265Sps
 {
   StdVideoH265HrdParameters hrd;
   StdVideoH265SequenceParameterSetVui vui;
   StdVideoH265ProfileTierLevel profileTierLevel;
   StdVideoH265SequenceParameterSet sps;
-  StdVideoH265PictureParameterSet pps;
-  StdVideoH265VideoParameterSet vps;
   StdVideoH265DecPicBufMgr pic_buf_mgr;
-  StdVideoH265ScalingLists scaling_lists_sps, scaling_lists_pps;
+  StdVideoH265ScalingLists scaling_lists;
+};
+
+typedef struct _VkH265Pps VkH265Pps;
+struct _VkH265Pps
+{
+  StdVideoH265PictureParameterSet pps;
+  StdVideoH265ScalingLists scaling_lists;
 };
 
 typedef struct _GstVkH265Dec GstVkH265Dec;
@@ -61,29 +79,56 @@ struct _GstVkH265Dec
 
   gint max_dpb_size;
 
-  VkH265Picture vkp;
+  VkH265Vps *vps[GST_H265_MAX_VPS_COUNT];
+  VkH265Sps *sps[GST_H265_MAX_SPS_COUNT];
+  VkH265Pps *pps[GST_H265_MAX_PPS_COUNT];
   GArray *refs;
 
   VkSharedBaseObj<VkParserVideoRefCountBase> spsclient, ppsclient, vpsclient;
 
   guint32 sps_update_count;
   guint32 pps_update_count;
+
+  GstVkPicPool *pic_pool;
+  GstCodecPictureCache *picture_cache;
+  GstVkArrayPool *bitstream_pool;
+  GstVkArrayPool *slice_offsets_pool;
+  GstCodecBitstreamAllocator bitstream_allocator;
+  GstCodecSliceSegmentsCallback slice_segments;
+  GstVkArrayPool *segments_pool;
+
+  GstCodecStats *stats;
 };
 
 struct VkPic
 {
   VkPicIf *pic;
   VkParserPictureData data;
-  GByteArray *bitstream;
-  VkH265Picture vkp;
+  GstVkBitstream bitstream;
+  VkH265Vps *vps;
+  VkH265Sps *sps;
+  VkH265Pps *pps;
+  /* only used when the PPS scaling lists replace the SPS ones */
+  StdVideoH265SequenceParameterSet std_sps;
   uint8_t *slice_group_map;
   GArray *slice_offsets;
+  GstVkPicPool *pic_pool;
+  GstVkArrayPool *slice_offsets_pool;
+  GstCodecStats *stats;
 };
 
+/* pictures in the DPB, plus the ones in flight */
+#define VK_PIC_POOL_SIZE 36
+
 enum
 {
   PROP_USER_DATA = 1,
   PROP_OOB_PIC_PARAMS,
+  PROP_STATS,
+  PROP_BITSTREAM_ALLOCATOR,
+  PROP_SLICE_SEGMENTS,
+  PROP_KEYFRAMES_ONLY,
+  PROP_TEMPORAL_LAYERS,
 };
 
 G_DEFINE_TYPE(GstVkH265Dec, gst_vk_h265_dec, GST_TYPE_H265_DECODER)
@@ -91,16 +136,37 @@ GST_ELEMENT_REGISTER_DEFINE_WITH_CODE (vkh265parse, "vkh265parse", GST_RANK_PRIM
 
 static gpointer parent_class = NULL;
 
-static VkPic
-*vk_pic_new (VkPicIf * pic)
+static VkPic *
+vk_pic_new (GstVkH265Dec * self, VkPicIf * pic, gsize size_hint)
 {
-  VkPic *vkpic = g_new0 (struct VkPic, 1);
+  VkPic *vkpic =
+      static_cast<VkPic *>(gst_vk_pic_pool_acquire (self->pic_pool));
   uint32_t zero = 0;
 
+  /* recycled pictures aren't cleared, the rest of the fields, data
+   * included, are set before they're read */
   vkpic->pic = pic;
-  vkpic->bitstream = g_byte_array_new ();
-  vkpic->slice_offsets = g_array_new (FALSE, FALSE, sizeof (uint32_t));
+  vkpic->pic_pool = gst_vk_pic_pool_ref (self->pic_pool);
+  vkpic->vps = NULL;
+  vkpic->sps = NULL;
+  vkpic->pps = NULL;
+  vkpic->slice_group_map = NULL;
+  vkpic->stats = NULL;
+  if (self->slice_segments.func) {
+    gst_vk_bitstream_init_by_reference (&vkpic->bitstream,
+        self->segments_pool);
+  } else {
+    gst_vk_bitstream_init (&vkpic->bitstream, self->bitstream_pool,
+        &self->bitstream_allocator, size_hint);
+  }
+  vkpic->slice_offsets_pool = gst_vk_array_pool_ref (self->slice_offsets_pool);
+  vkpic->slice_offsets = gst_vk_array_pool_acquire (self->slice_offsets_pool);
   g_array_append_val (vkpic->slice_offsets, zero);
+  if (self->stats) {
+    vkpic->stats = gst_codec_stats_ref (self->stats);
+    gst_codec_stats_gauge_add (vkpic->stats,
+        GST_CODEC_STATS_PICTURES_IN_FLIGHT, 1);
+  }
   return vkpic;
 }
 
@@ -108,14 +174,29 @@ static void
 vk_pic_free (gpointer data)
 {
   VkPic *vkpic = static_cast<VkPic *>(data);
+  GstVkPicPool *pic_pool;
+
   if (vkpic->pic)
     vkpic->pic->Release ();
-  g_byte_array_unref (vkpic->bitstream);
-  g_free ((uint32_t *)vkpic->data.pSliceDataOffsets);
-  g_free (vkpic->data.pBitstreamData);
-  g_array_unref (vkpic->slice_offsets);
+  gst_vk_bitstream_clear (&vkpic->bitstream);
+  gst_vk_array_pool_release (vkpic->slice_offsets_pool, vkpic->slice_offsets);
+  gst_vk_array_pool_unref (vkpic->slice_offsets_pool);
   g_free (vkpic->slice_group_map);
-  g_free (vkpic);
+  if (vkpic->vps)
+    param_set_unref (vkpic->vps);
+  if (vkpic->sps)
+    param_set_unref (vkpic->sps);
+  if (vkpic->pps)
+    param_set_unref (vkpic->pps);
+  if (vkpic->stats) {
+    gst_codec_stats_gauge_add (vkpic->stats,
+        GST_CODEC_STATS_PICTURES_IN_FLIGHT, -1);
+    gst_codec_stats_unref (vkpic->stats);
+  }
+  /* vkpic can't be touched once it's back in the pool */
+  pic_pool = vkpic->pic_pool;
+  gst_vk_pic_pool_release (pic_pool, vkpic);
+  gst_vk_pic_pool_unref (pic_pool);
 }
 
 static bool
@@ -169,7 +250,9 @@ gst_vk_h265_dec_new_sequence (GstH265Decoder * decoder, const GstH265SPS * sps,
   GstVideoCodecState *state;
   VkParserSequenceInfo seqInfo;
   guint dar_n = 0, dar_d = 0;
+  gint dpb_size;
 
+  /* ProbeVulkanVideoDecodeParserSequence() fills it the same way */
   seqInfo = VkParserSequenceInfo {
     .eCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT,
     .isSVC = profile_is_svc(decoder->input_state->caps),
@@ -229,8 +312,18 @@ gst_vk_h265_dec_new_sequence (GstH265Decoder * decoder, const GstH265SPS * sps,
     seqInfo.lDARHeight = dar_d;
   }
 
-  if (self->client)
+  if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
     self->max_dpb_size = self->client->BeginSequence (&seqInfo);
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+  }
+
+  dpb_size = self->client ? self->max_dpb_size : max_dpb_size;
+  gst_vk_pic_pool_set_capacity (self->pic_pool, MAX (dpb_size + 1, 0));
+  gst_codec_picture_cache_set_capacity (self->picture_cache,
+      MAX (dpb_size + 1, 0));
 
   state =
       gst_video_decoder_set_output_state (dec, GST_VIDEO_FORMAT_NV12,
@@ -246,6 +339,7 @@ static GstFlowReturn
 gst_vk_h265_dec_decode_slice (GstH265Decoder * decoder, GstH265Picture * picture,
     GstH265Slice * slice, GArray * ref_pic_list0, GArray * ref_pic_list1)
 {
+  GstVkH265Dec *self = GST_VK_H265_DEC (decoder);
   VkPic *vkpic = static_cast<VkPic *>(gst_h265_picture_get_user_data(picture));
   static const uint8_t nal[] = { 0, 0, 1 };
   const size_t start_code_size = sizeof(nal);
@@ -253,15 +347,27 @@ gst_vk_h265_dec_decode_slice (GstH265Decoder * decoder, GstH265Picture * picture
 
   vkpic->data.nNumSlices++;
   // nvidia parser adds 000001 NAL unit identifier at every slice
-  g_byte_array_append (vkpic->bitstream, nal, start_code_size);
-  g_byte_array_append (vkpic->bitstream, slice->nalu.data + slice->nalu.offset,
-      slice->nalu.size);
+  if (self->slice_segments.func) {
+    if (!gst_vk_bitstream_append_reference (&vkpic->bitstream, start_code_size,
+            gst_h265_decoder_get_input_buffer (decoder), slice->nalu.offset,
+            slice->nalu.size)) {
+      GST_ERROR_OBJECT (self, "Slice outside of the input buffer");
+      return GST_FLOW_ERROR;
+    }
+  } else {
+    gst_vk_bitstream_append (&vkpic->bitstream, nal, start_code_size,
+        slice->nalu.data + slice->nalu.offset, slice->nalu.size);
+    gst_codec_stats_add (self->stats, GST_CODEC_STATS_BYTES_COPIED,
+        slice->nalu.size + start_code_size);
+  }
   // GST_MEMDUMP_OBJECT(decoder, "SLICE :", slice->nalu.data + slice->nalu.offset, slice->nalu.size);
   offset =
       g_array_index (vkpic->slice_offsets, uint32_t,
       vkpic->slice_offsets->len - 1) + slice->nalu.size + start_code_size;
   g_array_append_val (vkpic->slice_offsets, offset);
 
+  gst_codec_stats_add (self->stats, GST_CODEC_STATS_SLICES, 1);
+
   return GST_FLOW_OK;
 }
 
@@ -274,15 +380,19 @@ gst_vk_h265_dec_new_picture (GstH265Decoder * decoder, GstVideoCodecFrame * fram
   VkPic *vkpic;
 
   if (self->client) {
-    if (!self->client->AllocPictureBuffer (&pic))
+    GstClockTime start = gst_codec_stats_start (self->stats);
+    bool allocated = self->client->AllocPictureBuffer (&pic);
+
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+    if (!allocated)
       return GST_FLOW_ERROR;
   }
 
-  vkpic = vk_pic_new (pic);
+  vkpic = vk_pic_new (self, pic, bitstream_size_hint (frame->input_buffer,
+          gst_h265_decoder_get_nal_length_size (decoder)));
   gst_h265_picture_set_user_data (picture, vkpic, vk_pic_free);
 
-  frame->output_buffer = gst_buffer_new ();
-
   return GST_FLOW_OK;
 }
 
@@ -294,16 +404,23 @@ gst_vk_h265_dec_output_picture (GstH265Decoder * decoder,
   VkPic *vkpic = reinterpret_cast<VkPic *>(gst_h265_picture_get_user_data(picture));;
 
   if (self->client) {
-    if (!self->client->DisplayPicture (vkpic->pic,
-            //FIXME: Why divided by 100  ???
-            picture->system_frame_number * frame->duration / 100)) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+    //FIXME: Why divided by 100  ???
+    bool displayed = self->client->DisplayPicture (vkpic->pic,
+        picture->system_frame_number * frame->duration / 100);
+
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+    if (!displayed) {
       gst_h265_picture_unref (picture);
       return GST_FLOW_ERROR;
     }
   }
 
   gst_h265_picture_unref (picture);
-  return gst_video_decoder_finish_frame (GST_VIDEO_DECODER (decoder), frame);
+  /* the picture was delivered to the client, there's nothing to push */
+  gst_video_decoder_release_frame (GST_VIDEO_DECODER (decoder), frame);
+  return GST_FLOW_OK;
 }
 
 static GstFlowReturn
@@ -311,13 +428,16 @@ gst_vk_h265_dec_end_picture (GstH265Decoder * decoder, GstH265Picture * picture)
 {
   GstVkH265Dec *self = GST_VK_H265_DEC (decoder);
   VkPic *vkpic = reinterpret_cast<VkPic *>(gst_h265_picture_get_user_data(picture));
-  gsize len;
   GstFlowReturn ret = GST_FLOW_OK;
+  const guint8 *data;
+  gsize len;
 
-  vkpic->data.pBitstreamData = g_byte_array_steal (vkpic->bitstream, &len);
+  /* the arrays are kept by the picture until it's freed */
+  data = gst_vk_bitstream_get_data (&vkpic->bitstream, &len);
+  vkpic->data.pBitstreamData = const_cast<uint8_t *>(data);
   vkpic->data.nBitstreamDataLen = static_cast<int32_t>(len);
   vkpic->data.pSliceDataOffsets =
-      static_cast <uint32_t *>(g_array_steal (vkpic->slice_offsets, NULL));
+      reinterpret_cast<uint32_t *>(vkpic->slice_offsets->data);
 
   // FIXME: This flag is set to TRUE unconditionally because VulkanVideoParser.cpp expects it be true
   // during the decode phase. It will be set to True by base class only when it will be added to the dpb
@@ -325,8 +445,22 @@ gst_vk_h265_dec_end_picture (GstH265Decoder * decoder, GstH265Picture * picture)
   vkpic->data.ref_pic_flag = TRUE;
 
   if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
+    if (self->slice_segments.func) {
+      const GstCodecSliceSegment *segments;
+      guint n_segments;
+
+      segments = gst_vk_bitstream_get_segments (&vkpic->bitstream,
+          &n_segments);
+      self->slice_segments.func (self->slice_segments.user_data,
+          &vkpic->data, segments, n_segments);
+    }
+    gst_vk_bitstream_hand_over (&vkpic->bitstream);
     if (!self->client->DecodePicture (&vkpic->data))
       ret = GST_FLOW_ERROR;
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
   }
 
   return ret;
@@ -356,8 +490,19 @@ fill_scaling_list(GstH265ScalingList* src, StdVideoH265ScalingLists* dest) {
 }
 
 static void
-fill_sps(GstH265SPS* sps, VkH265Picture* vkp)
+fill_pic_buf_mgr (GstH265VPS * vps, StdVideoH265DecPicBufMgr * dest)
 {
+  memcpy (dest->max_latency_increase_plus1, vps->max_latency_increase_plus1, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
+  memcpy (dest->max_dec_pic_buffering_minus1, vps->max_dec_pic_buffering_minus1, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
+  memcpy (dest->max_num_reorder_pics, vps->max_num_reorder_pics, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
+}
+
+static VkH265Sps *
+new_sps (GstH265SPS * sps)
+{
+    VkH265Sps *vkp =
+        static_cast<VkH265Sps *>(param_set_new (sizeof (VkH265Sps)));
+
     if (sps->vui_parameters_present_flag) {
       if (sps->vui_params.hrd_parameters_present_flag) {
         vkp->hrd = StdVideoH265HrdParameters {
@@ -444,7 +589,7 @@ fill_sps(GstH265SPS* sps, VkH265Picture* vkp)
       .general_level_idc = static_cast<StdVideoH265LevelIdc>(sps->profile_tier_level.level_idc),
     };
 
-    fill_scaling_list (&sps->scaling_list, &vkp->scaling_lists_sps);
+    fill_scaling_list (&sps->scaling_list, &vkp->scaling_lists);
 
     vkp->sps = StdVideoH265SequenceParameterSet {
         .flags = {
@@ -514,7 +659,7 @@ fill_sps(GstH265SPS* sps, VkH265Picture* vkp)
         .conf_win_bottom_offset = sps->conf_win_bottom_offset,
         .pProfileTierLevel = &vkp->profileTierLevel,
         .pDecPicBufMgr = &vkp->pic_buf_mgr, // FIXME: Not available in the NVidia parser
-        .pScalingLists = sps->scaling_list_enabled_flag ? &vkp->scaling_lists_sps : nullptr,
+        .pScalingLists = sps->scaling_list_enabled_flag ? &vkp->scaling_lists : nullptr,
         .pShortTermRefPicSet = nullptr, //FIXME
         .pLongTermRefPicsSps = nullptr, //FIXME
         .pSequenceParameterSetVui = &vkp->vui,
@@ -523,6 +668,7 @@ fill_sps(GstH265SPS* sps, VkH265Picture* vkp)
 
     if (sps->vps) {
       vkp->sps.sps_video_parameter_set_id = sps->vps->id;
+      fill_pic_buf_mgr (sps->vps, &vkp->pic_buf_mgr);
     }
 #if !GST_CHECK_VERSION (1,21,0)
     # define sps_extension_params sps_extnsion_params
@@ -545,13 +691,17 @@ fill_sps(GstH265SPS* sps, VkH265Picture* vkp)
       vkp->sps.motion_vector_resolution_control_idc = sps->sps_scc_extension_params.motion_vector_resolution_control_idc;
       vkp->sps.sps_num_palette_predictor_initializers_minus1 = sps->sps_scc_extension_params.sps_num_palette_predictor_initializer_minus1;
     }
+
+    return vkp;
 }
 
-static void
-fill_pps (GstH265PPS * pps, VkH265Picture * vkp)
+static VkH265Pps *
+new_pps (GstH265PPS * pps)
 {
+  VkH265Pps *vkp =
+      static_cast<VkH265Pps *>(param_set_new (sizeof (VkH265Pps)));
 
-  fill_scaling_list(&pps->scaling_list, &vkp->scaling_lists_pps);
+  fill_scaling_list(&pps->scaling_list, &vkp->scaling_lists);
 
   vkp->pps = StdVideoH265PictureParameterSet {
     .flags = {
@@ -621,7 +771,7 @@ fill_pps (GstH265PPS * pps, VkH265Picture * vkp)
     .num_tile_rows_minus1 = pps->num_tile_rows_minus1,
     //.column_width_minus1 = 0,// memcpy above
     //.row_height_minus1 = 0,// memcpy above
-    .pScalingLists =  pps->scaling_list_data_present_flag ? &vkp->scaling_lists_pps : nullptr,
+    .pScalingLists =  pps->scaling_list_data_present_flag ? &vkp->scaling_lists : nullptr,
     .pPredictorPaletteEntries = nullptr,
   };
 
@@ -629,11 +779,16 @@ fill_pps (GstH265PPS * pps, VkH265Picture * vkp)
   //memcpy(vkp->pps.cr_qp_offset_list, pps->cr_qp_offset, sizeof(vkp->pps.cr_qp_offset_list)); //STD_VIDEO_H265_CHROMA_QP_OFFSET_TILE_ROWS_LIST_SIZE
   memcpy(vkp->pps.column_width_minus1, pps->column_width_minus1, sizeof(vkp->pps.column_width_minus1)); //STD_VIDEO_H265_CHROMA_QP_OFFSET_TILE_COLS_LIST_SIZE
   memcpy(vkp->pps.row_height_minus1, pps->row_height_minus1, sizeof(vkp->pps.row_height_minus1)); 
+
+  return vkp;
 }
 
-static void
-fill_vps (GstH265VPS * vps, VkH265Picture * vkp)
+static VkH265Vps *
+new_vps (GstH265VPS * vps)
 {
+  VkH265Vps *vkp =
+      static_cast<VkH265Vps *>(param_set_new (sizeof (VkH265Vps)));
+
   vkp->vps = StdVideoH265VideoParameterSet {
     .flags = {
       .vps_temporal_id_nesting_flag = vps->temporal_id_nesting_flag,
@@ -649,10 +804,40 @@ fill_vps (GstH265VPS * vps, VkH265Picture * vkp)
     // const StdVideoH265HrdParameters*    pHrdParameters;
   };
 
-  memcpy (vkp->pic_buf_mgr.max_latency_increase_plus1, vps->max_latency_increase_plus1, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
-  memcpy (vkp->pic_buf_mgr.max_dec_pic_buffering_minus1, vps->max_dec_pic_buffering_minus1, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
-  memcpy (vkp->pic_buf_mgr.max_num_reorder_pics, vps->max_num_reorder_pics, STD_VIDEO_H265_SUBLAYERS_LIST_SIZE);
+  fill_pic_buf_mgr (vps, &vkp->pic_buf_mgr);
   vkp->vps.pDecPicBufMgr = &vkp->pic_buf_mgr;
+
+  return vkp;
+}
+
+static VkH265Vps *
+gst_vk_h265_dec_set_vps (GstVkH265Dec * self, GstH265VPS * vps)
+{
+  if (vps->id >= GST_H265_MAX_VPS_COUNT)
+    return NULL;
+  if (self->vps[vps->id])
+    param_set_unref (self->vps[vps->id]);
+  return (self->vps[vps->id] = new_vps (vps));
+}
+
+static VkH265Sps *
+gst_vk_h265_dec_set_sps (GstVkH265Dec * self, GstH265SPS * sps)
+{
+  if (sps->id >= GST_H265_MAX_SPS_COUNT)
+    return NULL;
+  if (self->sps[sps->id])
+    param_set_unref (self->sps[sps->id]);
+  return (self->sps[sps->id] = new_sps (sps));
+}
+
+static VkH265Pps *
+gst_vk_h265_dec_set_pps (GstVkH265Dec * self, GstH265PPS * pps)
+{
+  if (pps->id >= GST_H265_MAX_PPS_COUNT)
+    return NULL;
+  if (self->pps[pps->id])
+    param_set_unref (self->pps[pps->id]);
+  return (self->pps[pps->id] = new_pps (pps));
 }
 
 static GstFlowReturn
@@ -661,23 +846,35 @@ gst_vk_h265_dec_start_picture (GstH265Decoder * decoder, GstH265Picture * pictur
 {
   GstVkH265Dec *self = GST_VK_H265_DEC (decoder);
   VkPic *vkpic =  gst_vk_h265_dec_get_decoder_frame_from_picture(decoder, picture);
-  VkH265Picture *vkp = &self->vkp;
   GstH265PPS *pps = slice->header.pps;
   GstH265SPS *sps = pps->sps;
   GstH265VPS *vps = sps->vps;
-
-  if (!self->oob_pic_params
-      || (self->sps_update_count == 0 && self->sps_update_count == 0)) {
-    vkp = &vkpic->vkp;
-    fill_sps (sps, vkp);
-    fill_pps (pps, vkp);
-  }
+  const StdVideoH265SequenceParameterSet *std_sps;
+
+  /* parameter sets not notified through update_picture_parameters() */
+  if (!self->vps[vps->id])
+    gst_vk_h265_dec_set_vps (self, vps);
+  if (!self->sps[sps->id])
+    gst_vk_h265_dec_set_sps (self, sps);
+  if (!self->pps[pps->id])
+    gst_vk_h265_dec_set_pps (self, pps);
+
+  vkpic->vps =
+      static_cast<VkH265Vps *>(param_set_ref (self->vps[vps->id]));
+  vkpic->sps =
+      static_cast<VkH265Sps *>(param_set_ref (self->sps[sps->id]));
+  vkpic->pps =
+      static_cast<VkH265Pps *>(param_set_ref (self->pps[pps->id]));
+
+  std_sps = &vkpic->sps->sps;
   // Following bad/sys/nvcodec/gstnvh265dec.c
   if (pps->scaling_list_data_present_flag ||
       (sps->scaling_list_enabled_flag
           && !sps->scaling_list_data_present_flag)) {
-      fill_scaling_list (&pps->scaling_list, &vkp->scaling_lists_sps);
-      vkp->sps.pScalingLists  = &vkp->scaling_lists_sps;
+      /* the PPS snapshot already holds pps->scaling_list */
+      vkpic->std_sps = vkpic->sps->sps;
+      vkpic->std_sps.pScalingLists = &vkpic->pps->scaling_lists;
+      std_sps = &vkpic->std_sps;
     }
 
   vkpic->data = VkParserPictureData {
@@ -709,11 +906,11 @@ gst_vk_h265_dec_start_picture (GstH265Decoder * decoder, GstH265Picture * pictur
 
   VkParserHevcPictureData *h265 = &vkpic->data.CodecSpecific.hevc;
   *h265 = VkParserHevcPictureData {
-      .pStdVps = &vkp->vps,
+      .pStdVps = &vkpic->vps->vps,
       .pVpsClientObject = self->vpsclient,
-      .pStdSps = &vkp->sps,
+      .pStdSps = std_sps,
       .pSpsClientObject = self->spsclient,
-      .pStdPps = &vkp->pps,
+      .pStdPps = &vkpic->pps->pps,
       .pPpsClientObject = self->ppsclient,
       .pic_parameter_set_id = static_cast<uint8_t>(pps->id), // PPS ID
       .seq_parameter_set_id = static_cast<uint8_t>(sps->id), // SPS ID
@@ -842,8 +1039,13 @@ gst_vk_h265_dec_unhandled_nalu (GstH265Decoder * decoder, const guint8 * data,
 {
   GstVkH265Dec *self = GST_VK_H265_DEC (decoder);
 
-  if (self->client)
+  if (self->client) {
+    GstClockTime start = gst_codec_stats_start (self->stats);
+
     self->client->UnhandledNALU (data, size);
+    gst_codec_stats_record (self->stats, GST_CODEC_STATS_CLIENT_CALLBACKS,
+        start);
+  }
 }
 
 static void
@@ -856,46 +1058,64 @@ gst_vk_h265_dec_update_picture_parameters (GstH265Decoder * decoder,
   switch (type) {
     case GST_H265_NAL_SPS:{
       GstH265SPS *sps = static_cast < GstH265SPS * >(nalu);
-      fill_sps (sps, &self->vkp);
+      VkH265Sps *vksps = gst_vk_h265_dec_set_sps (self, sps);
+      if (!vksps)
+        break;
       params = VkPictureParameters {
         .updateType = VK_PICTURE_PARAMETERS_UPDATE_H265_SPS,
-        .pH265Sps = &self->vkp.sps,
+        .pH265Sps = &vksps->sps,
         .updateSequenceCount = self->sps_update_count++,
       };
       if (self->client) {
+        GstClockTime start = gst_codec_stats_start (self->stats);
+
         if (!self->client->UpdatePictureParameters (&params, self->spsclient,
                 params.updateSequenceCount))
           GST_ERROR_OBJECT (self, "Failed to update sequence parameters");
+        gst_codec_stats_record (self->stats,
+            GST_CODEC_STATS_CLIENT_CALLBACKS, start);
       }
       break;
     }
     case GST_H265_NAL_PPS:{
       GstH265PPS *pps = static_cast < GstH265PPS * >(nalu);
-      fill_pps (pps, &self->vkp);
+      VkH265Pps *vkpps = gst_vk_h265_dec_set_pps (self, pps);
+      if (!vkpps)
+        break;
       params = VkPictureParameters {
         .updateType = VK_PICTURE_PARAMETERS_UPDATE_H265_PPS,
-        .pH265Pps = &self->vkp.pps,
+        .pH265Pps = &vkpps->pps,
         .updateSequenceCount = self->pps_update_count++,
       };
       if (self->client) {
+        GstClockTime start = gst_codec_stats_start (self->stats);
+
         if (!self->client->UpdatePictureParameters (&params, self->ppsclient,
                 params.updateSequenceCount))
           GST_ERROR_OBJECT (self, "Failed to update picture parameters");
+        gst_codec_stats_record (self->stats,
+            GST_CODEC_STATS_CLIENT_CALLBACKS, start);
       }
       break;
     }
     case GST_H265_NAL_VPS:{
       GstH265VPS *vps = static_cast < GstH265VPS * >(nalu);
-      fill_vps (vps, &self->vkp);
+      VkH265Vps *vkvps = gst_vk_h265_dec_set_vps (self, vps);
+      if (!vkvps)
+        break;
       params = VkPictureParameters {
         .updateType = VK_PICTURE_PARAMETERS_UPDATE_H265_VPS,
-        .pH265Vps = &self->vkp.vps,
+        .pH265Vps = &vkvps->vps,
         .updateSequenceCount = self->pps_update_count++,
       };
       if (self->client) {
+        GstClockTime start = gst_codec_stats_start (self->stats);
+
         if (!self->client->UpdatePictureParameters (&params, self->vpsclient,
                 params.updateSequenceCount))
           GST_ERROR_OBJECT (self, "Failed to update picture parameters");
+        gst_codec_stats_record (self->stats,
+            GST_CODEC_STATS_CLIENT_CALLBACKS, start);
       }
       break;
     }
@@ -918,6 +1138,34 @@ gst_vk_h265_dec_dispose (GObject * object)
 
   g_clear_pointer (&self->refs, g_array_unref);
 
+  for (guint i = 0; i < G_N_ELEMENTS (self->vps); i++)
+    g_clear_pointer (&self->vps[i], param_set_unref);
+  for (guint i = 0; i < G_N_ELEMENTS (self->sps); i++)
+    g_clear_pointer (&self->sps[i], param_set_unref);
+  for (guint i = 0; i < G_N_ELEMENTS (self->pps); i++)
+    g_clear_pointer (&self->pps[i], param_set_unref);
+
+  if (self->bitstream_pool) {
+    guint64 acquired, allocated;
+
+    gst_vk_array_pool_get_stats (self->bitstream_pool, &acquired, &allocated);
+    GST_INFO_OBJECT (self, "%" G_GUINT64_FORMAT " bitstream allocations for %"
+        G_GUINT64_FORMAT " pictures", allocated, acquired);
+  }
+  if (self->pic_pool) {
+    guint64 hits, misses;
+
+    gst_vk_pic_pool_get_stats (self->pic_pool, &hits, &misses);
+    GST_INFO_OBJECT (self, "picture pool: %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses", hits, misses);
+  }
+  g_clear_pointer (&self->pic_pool, gst_vk_pic_pool_unref);
+  g_clear_pointer (&self->picture_cache, gst_codec_picture_cache_unref);
+  g_clear_pointer (&self->bitstream_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->slice_offsets_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->segments_pool, gst_vk_array_pool_unref);
+  g_clear_pointer (&self->stats, gst_codec_stats_unref);
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -935,6 +1183,36 @@ gst_vk_h265_dec_set_property (GObject * object, guint property_id,
     case PROP_OOB_PIC_PARAMS:
       self->oob_pic_params = g_value_get_boolean (value);
       break;
+    case PROP_STATS:
+      self->stats = static_cast<GstCodecStats *>(g_value_get_pointer (value));
+      if (self->stats)
+        gst_codec_stats_ref (self->stats);
+      gst_h265_decoder_set_stats (GST_H265_DECODER (self), self->stats);
+      break;
+    case PROP_BITSTREAM_ALLOCATOR:{
+      const GstCodecBitstreamAllocator *allocator =
+          static_cast<GstCodecBitstreamAllocator *>(g_value_get_pointer (value));
+
+      if (allocator)
+        self->bitstream_allocator = *allocator;
+      break;
+    }
+    case PROP_SLICE_SEGMENTS:{
+      const GstCodecSliceSegmentsCallback *callback =
+          static_cast<GstCodecSliceSegmentsCallback *>(g_value_get_pointer (value));
+
+      if (callback)
+        self->slice_segments = *callback;
+      break;
+    }
+    case PROP_KEYFRAMES_ONLY:
+      gst_h265_decoder_set_keyframes_only (GST_H265_DECODER (self),
+          g_value_get_boolean (value));
+      break;
+    case PROP_TEMPORAL_LAYERS:
+      gst_h265_decoder_set_temporal_layers (GST_H265_DECODER (self),
+          g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -981,6 +1259,32 @@ gst_vk_h265_dec_class_init (GstVkH265DecClass * klass)
       g_param_spec_boolean ("oob-pic-params", "oob-pic-params",
           "oop-pic-params", FALSE,
           GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_pointer ("stats", "stats",
+          "GstCodecStats where parsing counters and times are recorded",
+          GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_BITSTREAM_ALLOCATOR,
+      g_param_spec_pointer ("bitstream-allocator", "bitstream-allocator",
+          "GstCodecBitstreamAllocator where the slices are written, copied "
+          "when set", GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_SEGMENTS,
+      g_param_spec_pointer ("slice-segments", "slice-segments",
+          "GstCodecSliceSegmentsCallback receiving the slices by reference, "
+          "copied when set", GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_KEYFRAMES_ONLY,
+      g_param_spec_boolean ("keyframes-only", "keyframes-only",
+          "Skip the pictures which aren't IRAP", FALSE,
+          GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
+
+  g_object_class_install_property (gobject_class, PROP_TEMPORAL_LAYERS,
+      g_param_spec_uint ("temporal-layers", "temporal-layers",
+          "Temporal sub-layers parsed, the higher ones are dropped "
+          "(0 = all)", 0, 7, 0,
+          GParamFlags (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
 }
 
 static void
@@ -990,4 +1294,14 @@ gst_vk_h265_dec_init (GstVkH265Dec * self)
 
   self->refs = g_array_sized_new (FALSE, TRUE, sizeof (GstH265Decoder *), 16);
   g_array_set_clear_func (self->refs, (GDestroyNotify) gst_clear_h265_picture);
+
+  self->pic_pool = gst_vk_pic_pool_new (sizeof (VkPic));
+  self->picture_cache = gst_codec_picture_cache_new (sizeof (GstH265Picture));
+  gst_h265_decoder_set_picture_cache (GST_H265_DECODER (self),
+      self->picture_cache);
+  self->bitstream_pool = gst_vk_array_pool_new (1, VK_PIC_POOL_SIZE);
+  self->slice_offsets_pool =
+      gst_vk_array_pool_new (sizeof (uint32_t), VK_PIC_POOL_SIZE);
+  self->segments_pool =
+      gst_vk_array_pool_new (sizeof (GstCodecSliceSegment), VK_PIC_POOL_SIZE);
 }
@@ -0,0 +1,137 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "gstvkpicpool.h"
+
+struct _GstVkPicPool
+{
+  gint ref_count;
+
+  gsize pic_size;
+
+  GMutex lock;
+  GPtrArray *free_pics;
+  guint capacity;
+  /* acquired and not released yet */
+  guint outstanding;
+
+  guint64 hits;
+  guint64 misses;
+};
+
+GstVkPicPool *
+gst_vk_pic_pool_new (gsize pic_size)
+{
+  GstVkPicPool *pool = g_new0 (GstVkPicPool, 1);
+
+  pool->ref_count = 1;
+  pool->pic_size = pic_size;
+  g_mutex_init (&pool->lock);
+  pool->free_pics = g_ptr_array_new ();
+
+  return pool;
+}
+
+GstVkPicPool *
+gst_vk_pic_pool_ref (GstVkPicPool * pool)
+{
+  g_atomic_int_inc (&pool->ref_count);
+  return pool;
+}
+
+void
+gst_vk_pic_pool_unref (GstVkPicPool * pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->ref_count))
+    return;
+
+  g_ptr_array_foreach (pool->free_pics, (GFunc) g_free, NULL);
+  g_ptr_array_unref (pool->free_pics);
+  g_mutex_clear (&pool->lock);
+  g_free (pool);
+}
+
+/* Preallocates the pictures up to @capacity, counting the ones acquired
+ * since they come back to the pool, or drops the spare ones if it
+ * shrinks. */
+void
+gst_vk_pic_pool_set_capacity (GstVkPicPool * pool, guint capacity)
+{
+  guint spare;
+
+  g_mutex_lock (&pool->lock);
+  pool->capacity = capacity;
+  spare = capacity > pool->outstanding ? capacity - pool->outstanding : 0;
+  while (pool->free_pics->len > spare) {
+    g_free (g_ptr_array_remove_index_fast (pool->free_pics,
+            pool->free_pics->len - 1));
+  }
+  while (pool->free_pics->len < spare)
+    g_ptr_array_add (pool->free_pics, g_malloc (pool->pic_size));
+  g_mutex_unlock (&pool->lock);
+}
+
+/* The contents of the returned picture are undefined, the caller sets all
+ * the fields it reads. */
+gpointer
+gst_vk_pic_pool_acquire (GstVkPicPool * pool)
+{
+  gpointer pic = NULL;
+
+  g_mutex_lock (&pool->lock);
+  if (pool->free_pics->len > 0) {
+    pic = g_ptr_array_remove_index_fast (pool->free_pics,
+        pool->free_pics->len - 1);
+    pool->hits++;
+  } else {
+    pool->misses++;
+  }
+  pool->outstanding++;
+  g_mutex_unlock (&pool->lock);
+
+  if (!pic)
+    return g_malloc (pool->pic_size);
+
+  return pic;
+}
+
+void
+gst_vk_pic_pool_release (GstVkPicPool * pool, gpointer pic)
+{
+  g_mutex_lock (&pool->lock);
+  pool->outstanding--;
+  if (pool->free_pics->len + pool->outstanding < pool->capacity) {
+    g_ptr_array_add (pool->free_pics, pic);
+    pic = NULL;
+  }
+  g_mutex_unlock (&pool->lock);
+
+  g_free (pic);
+}
+
+void
+gst_vk_pic_pool_get_stats (GstVkPicPool * pool, guint64 * hits,
+    guint64 * misses)
+{
+  g_mutex_lock (&pool->lock);
+  if (hits)
+    *hits = pool->hits;
+  if (misses)
+    *misses = pool->misses;
+  g_mutex_unlock (&pool->lock);
+}
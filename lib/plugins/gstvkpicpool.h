@@ -0,0 +1,51 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Keeps freed picture structures of a fixed size around to reuse them for
+ * the next pictures, instead of allocating and releasing them per frame.
+ * They aren't cleared: the caller initializes the fields it reads. The pool
+ * holds up to its capacity, pictures in use included, which is meant to
+ * follow the DPB size negotiated with the client. It's refcounted since
+ * pictures might outlive the decoder that created them. */
+typedef struct _GstVkPicPool GstVkPicPool;
+
+GstVkPicPool *    gst_vk_pic_pool_new           (gsize pic_size);
+
+GstVkPicPool *    gst_vk_pic_pool_ref           (GstVkPicPool * pool);
+
+void              gst_vk_pic_pool_unref         (GstVkPicPool * pool);
+
+void              gst_vk_pic_pool_set_capacity  (GstVkPicPool * pool,
+                                                 guint capacity);
+
+gpointer          gst_vk_pic_pool_acquire       (GstVkPicPool * pool);
+
+void              gst_vk_pic_pool_release       (GstVkPicPool * pool,
+                                                 gpointer pic);
+
+void              gst_vk_pic_pool_get_stats     (GstVkPicPool * pool,
+                                                 guint64 * hits,
+                                                 guint64 * misses);
+
+G_END_DECLS
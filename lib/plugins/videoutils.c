@@ -35,3 +35,66 @@ pack_framerate (uint32_t numerator, uint32_t denominator)
   }
   return MAKEFRAMERATE (numerator, denominator);
 }
+
+/* keeps the payload aligned as malloc does */
+typedef union
+{
+  gint ref_count;
+  gint64 align_int;
+  gdouble align_double;
+  gpointer align_pointer;
+} ParamSetHeader;
+
+gpointer
+param_set_new (gsize size)
+{
+  ParamSetHeader *header = g_malloc0 (sizeof (ParamSetHeader) + size);
+
+  header->ref_count = 1;
+  return header + 1;
+}
+
+gpointer
+param_set_ref (gpointer set)
+{
+  ParamSetHeader *header = (ParamSetHeader *) set - 1;
+
+  g_atomic_int_inc (&header->ref_count);
+  return set;
+}
+
+void
+param_set_unref (gpointer set)
+{
+  ParamSetHeader *header = (ParamSetHeader *) set - 1;
+
+  if (g_atomic_int_dec_and_test (&header->ref_count))
+    g_free (header);
+}
+
+gsize
+bitstream_size_hint (GstBuffer * buffer, guint nal_length_size)
+{
+  gsize size = gst_buffer_get_size (buffer);
+  gsize offset = 0, nals = 0;
+  GstMapInfo map;
+
+  /* start codes never take more room than the ones or the 3 or 4 bytes
+   * length prefixes they replace */
+  if (nal_length_size == 0 || nal_length_size >= 3)
+    return size;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return size;
+  while (offset + nal_length_size <= map.size) {
+    gsize len = map.data[offset];
+
+    if (nal_length_size == 2)
+      len = (len << 8) | map.data[offset + 1];
+    offset += nal_length_size + len;
+    nals++;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  return size + nals * (3 - nal_length_size);
+}
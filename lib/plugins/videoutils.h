@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include <glib.h>
+#include <gst/gst.h>
 #include <stdint.h>
 
 G_BEGIN_DECLS
@@ -26,4 +26,15 @@ G_BEGIN_DECLS
 
 uint32_t pack_framerate(uint32_t numerator, uint32_t denominator);
 
+/* Refcounted zeroed block holding the Vulkan Std structures of a parameter
+ * set, so pictures share them instead of keeping their own copy. */
+gpointer param_set_new(gsize size);
+gpointer param_set_ref(gpointer set);
+void param_set_unref(gpointer set);
+
+/* Size of the slices of the access unit in @buffer once each NAL unit is
+ * prefixed by a 3 bytes start code, or an upper bound of it.
+ * @nal_length_size is 0 for byte-stream input. */
+gsize bitstream_size_hint(GstBuffer * buffer, guint nal_length_size);
+
 G_END_DECLS
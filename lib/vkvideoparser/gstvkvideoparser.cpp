@@ -16,6 +16,7 @@
  */
 
 #include "gstvkvideoparser.h"
+#include "gstcodecevent.h"
 
 enum
 {
@@ -29,19 +30,95 @@ GST_DEBUG_CATEGORY (gst_vk_video_parser_debug);
 #define GST_CAT_DEFAULT gst_vk_video_parser_debug
 
 
-GstVkVideoParser::GstVkVideoParser (gpointer user_data, VkVideoCodecOperationFlagBitsKHR codec, gboolean oob_pic_params)
+static guint8 *
+alloc_bitstream (gpointer user_data, gsize size, gsize * allocated)
+{
+  const VkParserGstOptions *options =
+      static_cast<const VkParserGstOptions *>(user_data);
+
+  return options->pfnAllocateBitstream (options->pBitstreamUserData, size,
+      allocated);
+}
+
+static void
+release_bitstream (gpointer user_data, guint8 * data)
+{
+  const VkParserGstOptions *options =
+      static_cast<const VkParserGstOptions *>(user_data);
+
+  if (options->pfnReleaseBitstream)
+    options->pfnReleaseBitstream (options->pBitstreamUserData, data);
+}
+
+static_assert (sizeof (GstCodecSliceSegment) == sizeof (VkParserGstSliceSegment),
+    "slice segments are handed to the client as they are");
+
+static void
+slice_segments (gpointer user_data, gconstpointer picture,
+    const GstCodecSliceSegment * segments, guint n_segments)
+{
+  const VkParserGstOptions *options =
+      static_cast<const VkParserGstOptions *>(user_data);
+
+  options->pfnSliceSegments (options->pSliceSegmentsUserData,
+      static_cast<const VkParserPictureData *>(picture),
+      reinterpret_cast<const VkParserGstSliceSegment *>(segments), n_segments);
+}
+
+GstVkVideoParser::GstVkVideoParser (gpointer user_data, VkVideoCodecOperationFlagBitsKHR codec, gboolean oob_pic_params,
+    const VkParserGstOptions& options, GstCodecStats* stats)
       :m_user_data(user_data),
       m_codec(codec),
-      m_oob_pic_params(oob_pic_params)
+      m_oob_pic_params(oob_pic_params),
+      m_options(options),
+      m_stats(stats),
+      m_bitstream_allocator{nullptr, nullptr, nullptr},
+      m_slice_segments{nullptr, nullptr},
+      m_parser(nullptr),
+      m_bus(nullptr),
+      m_elements{nullptr, nullptr},
+      m_srcpad(nullptr),
+      m_sinkpad(nullptr)
 {
   GST_DEBUG_CATEGORY_INIT (gst_vk_video_parser_debug, "vkvideoparser", 0, "Vulkan Video Parser");
+
+  if (m_options.pfnAllocateBitstream) {
+    m_bitstream_allocator.alloc = alloc_bitstream;
+    m_bitstream_allocator.release = release_bitstream;
+    m_bitstream_allocator.user_data = &m_options;
+  }
+  if (m_options.pfnSliceSegments) {
+    m_slice_segments.func = slice_segments;
+    m_slice_segments.user_data = &m_options;
+  }
 }
 
 GstVkVideoParser::~GstVkVideoParser()
 {
   GstMessage *msg;
 
-  gst_harness_teardown (m_parser);
+  if (m_options.eBackend == VK_PARSER_GST_BACKEND_DIRECT) {
+    /* downstream first, as in a bin */
+    for (auto element : m_elements) {
+      if (element) {
+        gst_element_set_state (element, GST_STATE_NULL);
+        gst_object_unref (element);
+      }
+    }
+    if (m_srcpad) {
+      gst_pad_set_active (m_srcpad, FALSE);
+      gst_object_unref (m_srcpad);
+    }
+    if (m_sinkpad) {
+      gst_pad_set_active (m_sinkpad, FALSE);
+      gst_object_unref (m_sinkpad);
+    }
+  } else if (m_parser) {
+    gst_harness_teardown (m_parser);
+  }
+
+  if (!m_bus)
+    return;
 
   /* drain bus after bin unref */
   while ((msg = gst_bus_pop (this->m_bus))) {
@@ -52,79 +129,156 @@ GstVkVideoParser::~GstVkVideoParser()
   gst_object_unref (this->m_bus);
 }
 
+static void
+log_message (GstMessage * msg)
+{
+  GST_DEBUG("%s", GST_MESSAGE_TYPE_NAME (msg));
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ERROR:{
+      GError *err = NULL;
+      char *debug = NULL;
+
+      gst_message_parse_error (msg, &err, &debug);
+      GST_ERROR("Error: %s - %s", err->message, debug);
+      g_clear_error (&err);
+      g_free (debug);
+      break;
+    }
+    case GST_MESSAGE_WARNING:{
+      GError *err = NULL;
+      char *debug = NULL;
+
+      gst_message_parse_warning (msg, &err, &debug);
+      GST_WARNING("Warning: %s - %s", err->message, debug);
+      g_clear_error (&err);
+      g_free (debug);
+      break;
+    }
+    case GST_MESSAGE_EOS:
+      GST_DEBUG("Got EOS");
+      break;
+    default:
+      break;
+  }
+}
+
 void
 GstVkVideoParser::ProcessMessages ()
 {
   GstMessage *msg;
 
   while ((msg = gst_bus_pop (this->m_bus))) {
-    GST_DEBUG("%s", GST_MESSAGE_TYPE_NAME (msg));
-
-    switch (GST_MESSAGE_TYPE (msg)) {
-      case GST_MESSAGE_ERROR:{
-        GError *err = NULL;
-        char *debug = NULL;
-
-        gst_message_parse_error (msg, &err, &debug);
-        GST_ERROR("Error: %s - %s", err->message, debug);
-        g_clear_error (&err);
-        g_free (debug);
-        break;
-      }
-      case GST_MESSAGE_WARNING:{
-        GError *err = NULL;
-        char *debug = NULL;
-
-        gst_message_parse_warning (msg, &err, &debug);
-        GST_WARNING("Warning: %s - %s", err->message, debug);
-        g_clear_error (&err);
-        g_free (debug);
-        break;
-      }
-      case GST_MESSAGE_EOS:
-        GST_DEBUG("Got EOS");
-        break;
-      default:
-        break;
-    }
-
+    log_message (msg);
     gst_message_unref (msg);
   }
 }
 
-bool GstVkVideoParser::Build ()
+/* The sequence header is the avcC/hvcC record for length prefixed input,
+ * and Annex B parameter sets otherwise. */
+static GstBuffer *
+sequence_header_buffer (const VkParserSequenceInfo * seq_info)
+{
+  if (!seq_info || seq_info->cbSequenceHeader <= 0
+      || seq_info->cbSequenceHeader > VK_MAX_SEQ_HDR_LEN)
+    return NULL;
+
+  return gst_buffer_new_memdup (seq_info->SequenceHeaderData,
+      seq_info->cbSequenceHeader);
+}
+
+bool GstVkVideoParser::Build (const VkParserSequenceInfo * seq_info)
 {
-  GstElement *bin, *decoder, *parser, *sink;
+  GstElement *decoder, *parser = NULL;
   const char *parser_name = NULL;
-  const char* src_caps_desc = NULL;
-  GstPad *pad;
+  const char *media_type = NULL;
+  const char *stream_format = "byte-stream";
+  GstBuffer *header;
+  GstCaps *caps;
+  bool ret;
+
+  header = sequence_header_buffer (seq_info);
 
   if (m_codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT) {
     parser_name = "h264parse";
-    src_caps_desc = "video/x-h264,stream-format=byte-stream";
+    media_type = "video/x-h264";
+    if (m_options.eStreamFormat == VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED)
+      stream_format = header ? "avc" : "avc3";
     decoder = gst_element_factory_make_full("vkh264parse", "user-data", m_user_data,
-        "oob-pic-params",  m_oob_pic_params, NULL);
+        "oob-pic-params",  m_oob_pic_params, "stats", m_stats,
+        "bitstream-allocator", &m_bitstream_allocator,
+        "slice-segments", &m_slice_segments,
+        "keyframes-only", m_options.bKeyframesOnly, NULL);
     g_assert (decoder);
     g_object_set(decoder, "compliance", 3, NULL);
   } else if (m_codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
     parser_name = "h265parse";
-    src_caps_desc = "video/x-h265,stream-format=byte-stream";
+    media_type = "video/x-h265";
+    if (m_options.eStreamFormat == VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED)
+      stream_format = header ? "hvc1" : "hev1";
     decoder = gst_element_factory_make_full("vkh265parse", "user-data", m_user_data,
-        "oob-pic-params", m_oob_pic_params, NULL);
+        "oob-pic-params", m_oob_pic_params, "stats", m_stats,
+        "bitstream-allocator", &m_bitstream_allocator,
+        "slice-segments", &m_slice_segments,
+        "keyframes-only", m_options.bKeyframesOnly,
+        "temporal-layers", MIN (m_options.nTemporalLayers, 7), NULL);
     g_assert (decoder);
   }
   else {
+    gst_clear_buffer (&header);
     return false;
   }
 
-  parser = gst_element_factory_make (parser_name, NULL);
+  caps = gst_caps_new_simple (media_type, "stream-format", G_TYPE_STRING,
+      stream_format, NULL);
+
+  if (m_options.eStreamFormat == VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED) {
+    /* packets are access units, handed to the decoder as they are */
+    gst_caps_set_simple (caps, "alignment", G_TYPE_STRING, "au", NULL);
+    if (header) {
+      gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER, header, NULL);
+      gst_clear_buffer (&header);
+    }
+  } else if (!m_options.bDecoderFraming) {
+    /* without alignment in the caps, the decoder frames the access units */
+    parser = gst_element_factory_make (parser_name, NULL);
+  }
+
+  if (m_options.eBackend == VK_PARSER_GST_BACKEND_DIRECT)
+    ret = BuildDirect (parser, decoder, caps);
+  else
+    ret = BuildHarness (parser, decoder, caps);
+  gst_caps_unref (caps);
+
+  /* Annex B parameter sets go in band, ahead of the first packet */
+  if (ret && header)
+    ret = PushBuffer (header, false) == GST_FLOW_OK;
+  else
+    gst_clear_buffer (&header);
+
+  return ret;
+}
+
+bool GstVkVideoParser::BuildHarness (GstElement * parser, GstElement * decoder,
+    GstCaps * caps)
+{
+  GstElement *bin, *sink;
+  GstPad *pad;
+
   sink = gst_element_factory_make ("fakesink", NULL);
   g_object_set (sink, "async", FALSE, "sync", FALSE, NULL);
 
   bin = gst_bin_new (NULL);
-  gst_bin_add_many (GST_BIN (bin), parser, decoder, sink, NULL);
+  gst_bin_add_many (GST_BIN (bin), decoder, sink, NULL);
+  if (parser) {
+    gst_bin_add (GST_BIN (bin), parser);
+    if (!gst_element_link (parser, decoder)) {
+      GST_WARNING("Failed to link element");
+      return false;
+    }
+  }
 
-  if (!gst_element_link_many (parser, decoder, sink, NULL)) {
+  if (!gst_element_link (decoder, sink)) {
     GST_WARNING("Failed to link element");
     return false;
   }
@@ -142,30 +296,192 @@ bool GstVkVideoParser::Build ()
 
   gst_harness_set_live (m_parser, TRUE);
 
-  gst_harness_set_src_caps_str (m_parser,
-      src_caps_desc);
+  gst_harness_set_src_caps (m_parser, gst_caps_ref (caps));
 
   gst_harness_play (m_parser);
 
   return true;
 }
 
+static GstFlowReturn
+direct_sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  /* pictures are delivered to the client, the decoders push nothing */
+  gst_buffer_unref (buffer);
+  return GST_FLOW_OK;
+}
+
+static gboolean
+direct_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static gboolean
+direct_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  /* behave like a live source, as the harness backend does */
+  if (GST_QUERY_TYPE (query) == GST_QUERY_LATENCY) {
+    gst_query_set_latency (query, TRUE, 0, GST_CLOCK_TIME_NONE);
+    return TRUE;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstBusSyncReply
+direct_bus_sync_handler (GstBus * bus, GstMessage * msg, gpointer user_data)
+{
+  log_message (msg);
+  return GST_BUS_DROP;
+}
+
+/* Messages are only logged, so all the parsers share one bus, instead of
+ * each one holding the file descriptors of its own. */
+static GstBus *
+direct_bus (void)
+{
+  static GstBus *bus = NULL;
+
+  if (g_once_init_enter (&bus)) {
+    GstBus *new_bus = gst_bus_new ();
+
+    gst_bus_set_sync_handler (new_bus, direct_bus_sync_handler, NULL, NULL);
+    g_once_init_leave (&bus, new_bus);
+  }
+
+  return GST_BUS (gst_object_ref (bus));
+}
+
+/* gst_element_link() refuses elements without a common bin */
+static bool
+link_static_pads (GstElement * src, GstElement * sink)
+{
+  GstPad *srcpad, *sinkpad;
+  GstPadLinkReturn ret;
+
+  srcpad = gst_element_get_static_pad (src, "src");
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  ret = gst_pad_link (srcpad, sinkpad);
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+
+  return ret == GST_PAD_LINK_OK;
+}
+
+bool GstVkVideoParser::BuildDirect (GstElement * parser, GstElement * decoder,
+    GstCaps * caps)
+{
+  GstPad *pad;
+  GstSegment segment;
+
+  /* downstream first, so state changes and teardown follow bin order */
+  m_elements[0] = GST_ELEMENT (gst_object_ref_sink (decoder));
+  if (parser)
+    m_elements[1] = GST_ELEMENT (gst_object_ref_sink (parser));
+
+  m_srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_query_function (m_srcpad, direct_src_query);
+
+  m_sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (m_sinkpad, direct_sink_chain);
+  gst_pad_set_event_function (m_sinkpad, direct_sink_event);
+
+  pad = gst_element_get_static_pad (parser ? parser : decoder, "sink");
+  if (gst_pad_link (m_srcpad, pad) != GST_PAD_LINK_OK) {
+    gst_object_unref (pad);
+    GST_WARNING("Failed to link element");
+    return false;
+  }
+  gst_object_unref (pad);
+
+  if (parser && !link_static_pads (parser, decoder)) {
+    GST_WARNING("Failed to link element");
+    return false;
+  }
+
+  pad = gst_element_get_static_pad (decoder, "src");
+  if (gst_pad_link (pad, m_sinkpad) != GST_PAD_LINK_OK) {
+    gst_object_unref (pad);
+    GST_WARNING("Failed to link element");
+    return false;
+  }
+  gst_object_unref (pad);
+
+  /* messages are logged as they are posted, instead of polling the bus after
+   * each buffer */
+  m_bus = direct_bus ();
+  gst_element_set_bus (decoder, m_bus);
+  if (parser)
+    gst_element_set_bus (parser, m_bus);
+
+  gst_pad_set_active (m_sinkpad, TRUE);
+  for (auto element : m_elements) {
+    if (element && gst_element_set_state (element, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+      GST_WARNING("Failed to start %s", GST_ELEMENT_NAME (element));
+      return false;
+    }
+  }
+  gst_pad_set_active (m_srcpad, TRUE);
+
+  gst_pad_push_event (m_srcpad, gst_event_new_stream_start ("vkvideoparser"));
+
+  gst_pad_push_event (m_srcpad, gst_event_new_caps (gst_caps_ref (caps)));
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (m_srcpad, gst_event_new_segment (&segment));
+
+  return true;
+}
+
 
 
-GstFlowReturn GstVkVideoParser::PushBuffer (GstBuffer * buffer)
+/* @buffer can be NULL with @eop, to end the access unit of the previous
+ * buffers */
+GstFlowReturn GstVkVideoParser::PushBuffer (GstBuffer * buffer, bool eop)
 {
   GstFlowReturn ret;
 
   GST_DEBUG("Pushing buffer: %" GST_PTR_FORMAT, buffer);
 
-  ret = gst_harness_push (m_parser, buffer);
+  g_return_val_if_fail (buffer || eop, GST_FLOW_ERROR);
+
+  /* the decoder finishes the access unit with this buffer, instead of
+   * waiting for the next one */
+  if (eop && m_options.bDecoderFraming) {
+    GstEvent *event = gst_codec_event_new_au_end ();
+    gboolean pushed;
+
+    if (m_options.eBackend == VK_PARSER_GST_BACKEND_DIRECT)
+      pushed = gst_pad_push_event (m_srcpad, event);
+    else
+      pushed = gst_harness_push_event (m_parser, event);
+    if (!pushed)
+      GST_WARNING("Couldn't push end of access unit");
+    if (!buffer)
+      return GST_FLOW_OK;
+  } else if (eop) {
+    /* h264parse and h265parse complete the access unit of a buffer with the
+     * marker flag, instead of holding it until the next one starts. Without
+     * data, an empty buffer carries the flag. */
+    if (!buffer)
+      buffer = gst_buffer_new ();
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_MARKER);
+  }
+
+  if (m_options.eBackend == VK_PARSER_GST_BACKEND_DIRECT)
+    ret = gst_pad_push (m_srcpad, buffer);
+  else
+    ret = gst_harness_push (m_parser, buffer);
   if (ret != GST_FLOW_OK && ret != GST_FLOW_EOS) {
     GST_WARNING("Couldn't push buffer: %s",
         gst_flow_get_name (ret));
     return ret;
   }
 
-  ProcessMessages ();
+  if (m_options.eBackend != VK_PARSER_GST_BACKEND_DIRECT)
+    ProcessMessages ();
 
   return ret;
 }
@@ -174,6 +490,12 @@ GstFlowReturn GstVkVideoParser::Eos ()
 {
   GST_DEBUG("Pushing EOS");
 
+  if (m_options.eBackend == VK_PARSER_GST_BACKEND_DIRECT) {
+    if (!gst_pad_push_event (m_srcpad, gst_event_new_eos ()))
+      return GST_FLOW_ERROR;
+    return GST_FLOW_EOS;
+  }
+
   if (!gst_harness_push_event (m_parser, gst_event_new_eos ()))
     return GST_FLOW_ERROR;
 
@@ -19,8 +19,9 @@
 
 #include <gst/gst.h>
 #include "gstharness.h"
-#define VK_ENABLE_BETA_EXTENSIONS 1
-#include <vulkan/vulkan.h>
+#include "gstcodecstats.h"
+#include "gstcodecbitstream.h"
+#include "vkvideodecodeparser.h"
 
 G_BEGIN_DECLS
 
@@ -28,20 +29,34 @@ class GstVkVideoParser {
 public:
     GstVkVideoParser(gpointer user_data,
                                        VkVideoCodecOperationFlagBitsKHR codec,
-                                       gboolean oob_pic_params);
+                                       gboolean oob_pic_params,
+                                       const VkParserGstOptions& options,
+                                       GstCodecStats* stats);
     ~GstVkVideoParser();
 
-    bool Build();
-    GstFlowReturn PushBuffer(GstBuffer *buffer);
+    bool Build(const VkParserSequenceInfo* seq_info);
+    GstFlowReturn PushBuffer(GstBuffer *buffer, bool eop);
     void ProcessMessages ();
     GstFlowReturn Eos();
 
 private:
+    bool BuildHarness(GstElement* parser, GstElement* decoder, GstCaps* caps);
+    bool BuildDirect(GstElement* parser, GstElement* decoder, GstCaps* caps);
+
     void* m_user_data;
     VkVideoCodecOperationFlagBitsKHR m_codec;
     bool m_oob_pic_params;
+    VkParserGstOptions m_options;
+    GstCodecStats* m_stats;
+    GstCodecBitstreamAllocator m_bitstream_allocator;
+    GstCodecSliceSegmentsCallback m_slice_segments;
     GstHarness* m_parser;
     GstBus* m_bus;
+
+    // direct backend
+    GstElement* m_elements[2];
+    GstPad* m_srcpad;
+    GstPad* m_sinkpad;
 };
 
 G_END_DECLS
@@ -20,6 +20,11 @@
 
 #include <vk_video/vulkan_video_codecs_common.h>
 
+#include <atomic>
+#include <cstring>
+#include <utility>
+#include <vector>
+
 
 GST_DEBUG_CATEGORY_EXTERN (gst_vk_video_parser_debug);
 #define GST_CAT_DEFAULT gst_vk_video_parser_debug
@@ -30,15 +35,81 @@ extern "C" {
 };
 #endif
 
+#define DEFAULT_QUEUE_DEPTH 16
+#define MAX_QUEUE_DEPTH 4096
+
+struct QueuedPacket {
+    GstBuffer* buffer;
+    bool eop;
+    bool eos;
+};
+
+// Lock-free ring with a single producer, the caller of ParseByteStream(), and
+// a single consumer, the parse thread. Indexes run freely and are masked.
+class PacketRing {
+public:
+    PacketRing()
+        : m_mask(0)
+        , m_head(0)
+        , m_tail(0)
+    {
+    }
+
+    void Init(uint32_t depth)
+    {
+        m_slots.resize(depth);
+        m_mask = depth - 1;
+    }
+
+    // producer side
+    bool Full() const { return m_tail.load(std::memory_order_relaxed) - m_head.load() == m_slots.size(); }
+    void Push(const QueuedPacket& packet)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_slots[tail & m_mask] = packet;
+        m_tail.store(tail + 1);
+    }
+
+    // consumer side
+    bool Empty() const { return m_head.load(std::memory_order_relaxed) == m_tail.load(); }
+    QueuedPacket Pop()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        QueuedPacket packet = m_slots[head & m_mask];
+        m_head.store(head + 1);
+        return packet;
+    }
+
+private:
+    std::vector<QueuedPacket> m_slots;
+    size_t m_mask;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+};
+
 class GstVkVideoDecoderParser : public VulkanVideoDecodeParser {
 public:
     GstVkVideoDecoderParser(VkVideoCodecOperationFlagBitsKHR codec)
         : m_refCount(1)
         , m_codec(codec)
         , m_parser(nullptr)
+        , m_options()
+        , m_thread(nullptr)
+        , m_waiters(0)
+        , m_pending(0)
+        , m_failed(false)
+        , m_stopping(false)
+        , m_stats(nullptr)
     {
+        g_mutex_init(&m_lock);
+        g_cond_init(&m_cond);
+        g_mutex_init(&m_stats_lock);
     }
 
+    bool SetOptions(const VkParserGstOptions* options);
+    bool Flush();
+    bool GetStats(VkParserGstStats* stats);
+
     VkResult Initialize(VkParserInitDecodeParameters*) final;
     bool Deinitialize() final;
     bool ParseByteStream(const VkParserBitstreamPacket*, int32_t*) final;
@@ -52,21 +123,97 @@ public:
     int32_t Release() final;
 
 private:
-    ~GstVkVideoDecoderParser() {}
+    ~GstVkVideoDecoderParser()
+    {
+        if (m_stats)
+            gst_codec_stats_unref(m_stats);
+        g_mutex_clear(&m_stats_lock);
+        g_cond_clear(&m_cond);
+        g_mutex_clear(&m_lock);
+    }
+
+    GstBuffer* WrapByteStream(const VkParserBitstreamPacket* bspacket);
+    bool Parse(GstBuffer* buffer, bool eop, bool eos);
+    bool QueueByteStream(const VkParserBitstreamPacket* bspacket);
+    static gpointer ParseThread(gpointer data);
+    void Wake();
+    template<typename Predicate> void WaitFor(Predicate ready);
 
     int m_refCount;
     VkVideoCodecOperationFlagBitsKHR m_codec;
     GstVkVideoParser* m_parser;
+    VkParserGstOptions m_options;
+
+    // async mode
+    PacketRing m_ring;
+    GThread* m_thread;
+    // m_lock and m_cond are only used to sleep, the state is atomic
+    GMutex m_lock;
+    GCond m_cond;
+    std::atomic<int> m_waiters;
+    // packets queued or being parsed
+    std::atomic<uint32_t> m_pending;
+    std::atomic<bool> m_failed;
+    std::atomic<bool> m_stopping;
+
+    // kept after Deinitialize(), so the last stream can be inspected.
+    // m_stats_lock guards replacing it against GetStats() from other threads.
+    GMutex m_stats_lock;
+    GstCodecStats* m_stats;
 };
 
+struct ByteStreamRelease {
+    VkParserReleaseByteStreamFuncType func;
+    void* user_data;
+    const uint8_t* data;
+};
+
+static void release_byte_stream(gpointer data)
+{
+    auto release = static_cast<ByteStreamRelease*>(data);
+
+    release->func(release->user_data, release->data);
+    g_free(release);
+}
+
+bool GstVkVideoDecoderParser::SetOptions(const VkParserGstOptions* options)
+{
+    // options are consumed when the pipeline is built
+    if (m_parser)
+        return false;
+
+    if (options->bZeroCopyInput && !options->pfnReleaseByteStream)
+        return false;
+
+    if (options->eBackend != VK_PARSER_GST_BACKEND_HARNESS
+        && options->eBackend != VK_PARSER_GST_BACKEND_DIRECT)
+        return false;
+
+    if (options->eBackpressure != VK_PARSER_GST_BACKPRESSURE_BLOCK
+        && options->eBackpressure != VK_PARSER_GST_BACKPRESSURE_FAIL)
+        return false;
+
+    if (options->nQueueDepth > MAX_QUEUE_DEPTH)
+        return false;
+
+    m_options = *options;
+    return true;
+}
+
 VkResult GstVkVideoDecoderParser::Initialize(VkParserInitDecodeParameters* params)
 {
+    GstCodecStats* stats;
+
     if (!(params && params->interfaceVersion == NV_VULKAN_VIDEO_PARSER_API_VERSION))
         return VK_ERROR_INITIALIZATION_FAILED;
 
     if (!params->pClient)
         return VK_ERROR_INITIALIZATION_FAILED;
 
+    // Deinitialize() has to be called first
+    if (m_parser)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
 
     if (!gst_init_check(NULL, NULL, NULL))
         return VK_ERROR_INITIALIZATION_FAILED;
@@ -75,15 +222,47 @@ VkResult GstVkVideoDecoderParser::Initialize(VkParserInitDecodeParameters* param
   GST_PLUGIN_STATIC_REGISTER(vkparser);
 #endif
 
-    m_parser = new GstVkVideoParser(params->pClient, m_codec, params->bOutOfBandPictureParameters);
-    if (!m_parser->Build())
+    // a previous stream may have failed
+    m_failed = false;
+    m_pending = 0;
+
+    stats = m_options.bCollectStats ? gst_codec_stats_new() : nullptr;
+    g_mutex_lock(&m_stats_lock);
+    std::swap(m_stats, stats);
+    g_mutex_unlock(&m_stats_lock);
+    if (stats)
+        gst_codec_stats_unref(stats);
+
+    m_parser = new GstVkVideoParser(params->pClient, m_codec, params->bOutOfBandPictureParameters, m_options, m_stats);
+    if (!m_parser->Build(params->pExternalSeqInfo)) {
+        delete m_parser;
+        m_parser = nullptr;
         return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (m_options.bAsync) {
+        uint32_t depth = m_options.nQueueDepth ? m_options.nQueueDepth : DEFAULT_QUEUE_DEPTH;
+
+        if (depth > 1)
+            depth = 1 << g_bit_storage(depth - 1);
+        m_ring.Init(depth);
+        m_thread = g_thread_new("vkparser", ParseThread, this);
+    }
 
     return VK_SUCCESS;
 }
 
 bool GstVkVideoDecoderParser::Deinitialize()
 {
+    // the queued packets are parsed before stopping
+    if (m_thread) {
+        m_stopping = true;
+        Wake();
+        g_thread_join(m_thread);
+        m_thread = nullptr;
+        m_stopping = false;
+    }
+
     if (m_parser) {
         delete m_parser;
         m_parser  = nullptr;
@@ -91,33 +270,197 @@ bool GstVkVideoDecoderParser::Deinitialize()
     return true;
 }
 
-bool GstVkVideoDecoderParser::ParseByteStream(const VkParserBitstreamPacket* bspacket, int32_t* parsed)
+GstBuffer* GstVkVideoDecoderParser::WrapByteStream(const VkParserBitstreamPacket* bspacket)
 {
-    if (parsed)
-        *parsed = 0;
+    if (m_options.bZeroCopyInput) {
+        auto release = g_new(ByteStreamRelease, 1);
+        release->func = m_options.pfnReleaseByteStream;
+        release->user_data = m_options.pReleaseUserData;
+        release->data = bspacket->pByteStream;
 
-    if (bspacket->nDataLength) {
-         auto buffer = gst_buffer_new_memdup(bspacket->pByteStream, bspacket->nDataLength);
-        if (!buffer)
-            return false;
+        return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+            const_cast<uint8_t*>(bspacket->pByteStream), bspacket->nDataLength,
+            0, bspacket->nDataLength, release, release_byte_stream);
+    }
 
-        auto ret = m_parser->PushBuffer(buffer);
+    gst_codec_stats_add(m_stats, GST_CODEC_STATS_BYTES_COPIED, bspacket->nDataLength);
+    return gst_buffer_new_memdup(bspacket->pByteStream, bspacket->nDataLength);
+}
+
+bool GstVkVideoDecoderParser::Parse(GstBuffer* buffer, bool eop, bool eos)
+{
+    if (buffer || eop) {
+        auto ret = m_parser->PushBuffer(buffer, eop);
         if (ret != GST_FLOW_OK)
             return false;
     }
 
-    if (bspacket->bEOS) {
+    if (eos) {
         auto ret = m_parser->Eos();
         if (ret != GST_FLOW_EOS)
             return false;
     }
 
+    return true;
+}
+
+void GstVkVideoDecoderParser::Wake()
+{
+    if (m_waiters.load() > 0) {
+        g_mutex_lock(&m_lock);
+        g_cond_broadcast(&m_cond);
+        g_mutex_unlock(&m_lock);
+    }
+}
+
+// Sleeps until ready() holds. Every change of the state ready() looks at is
+// followed by Wake().
+template<typename Predicate>
+void GstVkVideoDecoderParser::WaitFor(Predicate ready)
+{
+    if (ready())
+        return;
+
+    m_waiters++;
+    g_mutex_lock(&m_lock);
+    while (!ready())
+        g_cond_wait(&m_cond, &m_lock);
+    g_mutex_unlock(&m_lock);
+    m_waiters--;
+}
+
+gpointer GstVkVideoDecoderParser::ParseThread(gpointer data)
+{
+    auto self = static_cast<GstVkVideoDecoderParser*>(data);
+
+    while (true) {
+        self->WaitFor([self] { return !self->m_ring.Empty() || self->m_stopping; });
+        if (self->m_ring.Empty())
+            break;
+
+        QueuedPacket packet = self->m_ring.Pop();
+        self->Wake();
+
+        if (self->m_failed) {
+            if (packet.buffer)
+                gst_buffer_unref(packet.buffer);
+        } else if (!self->Parse(packet.buffer, packet.eop, packet.eos)) {
+            GST_WARNING("Failed to parse queued packet");
+            self->m_failed = true;
+        }
+
+        self->m_pending--;
+        self->Wake();
+    }
+
+    return nullptr;
+}
+
+bool GstVkVideoDecoderParser::QueueByteStream(const VkParserBitstreamPacket* bspacket)
+{
+    QueuedPacket packet = { };
+
+    if (m_failed)
+        return false;
+
+    if (m_ring.Full()) {
+        if (m_options.eBackpressure == VK_PARSER_GST_BACKPRESSURE_FAIL)
+            return false;
+        WaitFor([this] { return !m_ring.Full(); });
+    }
+
+    if (bspacket->nDataLength) {
+        packet.buffer = WrapByteStream(bspacket);
+        if (!packet.buffer)
+            return false;
+    }
+    packet.eop = bspacket->bEOP;
+    packet.eos = bspacket->bEOS;
+
+    m_pending++;
+    m_ring.Push(packet);
+    Wake();
+
+    return true;
+}
+
+bool GstVkVideoDecoderParser::ParseByteStream(const VkParserBitstreamPacket* bspacket, int32_t* parsed)
+{
+    if (parsed)
+        *parsed = 0;
+
+    if (m_thread) {
+        if (!(bspacket->nDataLength || bspacket->bEOP || bspacket->bEOS))
+            return true;
+        if (!QueueByteStream(bspacket))
+            return false;
+    } else {
+        GstBuffer* buffer = nullptr;
+
+        if (bspacket->nDataLength) {
+            buffer = WrapByteStream(bspacket);
+            if (!buffer)
+                return false;
+        }
+
+        if (!Parse(buffer, bspacket->bEOP, bspacket->bEOS))
+            return false;
+    }
+
     if (parsed)
         *parsed = bspacket->nDataLength;
 
     return true;
 }
 
+bool GstVkVideoDecoderParser::Flush()
+{
+    if (m_thread)
+        WaitFor([this] { return m_pending.load() == 0; });
+
+    return !m_failed;
+}
+
+static void copy_histogram(VkParserGstHistogram* dest, const GstCodecStatsHistogram* src)
+{
+    static_assert(VK_PARSER_GST_HISTOGRAM_BUCKETS == GST_CODEC_STATS_HISTOGRAM_BUCKETS,
+        "histogram layouts differ");
+
+    dest->count = src->count;
+    dest->total = src->total;
+    dest->max = src->max;
+    memcpy(dest->buckets, src->buckets, sizeof(dest->buckets));
+}
+
+bool GstVkVideoDecoderParser::GetStats(VkParserGstStats* stats)
+{
+    GstCodecStatsSnapshot snapshot;
+    GstCodecStats* current = nullptr;
+
+    g_mutex_lock(&m_stats_lock);
+    if (m_stats)
+        current = gst_codec_stats_ref(m_stats);
+    g_mutex_unlock(&m_stats_lock);
+
+    if (!current)
+        return false;
+
+    gst_codec_stats_snapshot(current, &snapshot);
+    gst_codec_stats_unref(current);
+
+    stats->nalsParsed = snapshot.counters[GST_CODEC_STATS_NALS];
+    stats->slicesAssembled = snapshot.counters[GST_CODEC_STATS_SLICES];
+    stats->bytesCopied = snapshot.counters[GST_CODEC_STATS_BYTES_COPIED];
+    stats->parameterSetsSkipped = snapshot.counters[GST_CODEC_STATS_PARAM_SETS_SKIPPED];
+    stats->picturesInFlight = snapshot.gauges[GST_CODEC_STATS_PICTURES_IN_FLIGHT];
+    stats->picturesInFlightPeak = snapshot.gauge_peaks[GST_CODEC_STATS_PICTURES_IN_FLIGHT];
+    copy_histogram(&stats->nalIdentification, &snapshot.timers[GST_CODEC_STATS_NAL_IDENTIFICATION]);
+    copy_histogram(&stats->dpbManagement, &snapshot.timers[GST_CODEC_STATS_DPB_MANAGEMENT]);
+    copy_histogram(&stats->clientCallbacks, &snapshot.timers[GST_CODEC_STATS_CLIENT_CALLBACKS]);
+
+    return true;
+}
+
 int32_t GstVkVideoDecoderParser::AddRef()
 {
     g_atomic_int_inc(&m_refCount);
@@ -149,3 +492,54 @@ bool CreateVulkanVideoDecodeParser(VulkanVideoDecodeParser** parser, VkVideoCode
     *parser = internalParser;
     return true;
 }
+
+bool SetVulkanVideoDecodeParserOptions(VulkanVideoDecodeParser* parser, const VkParserGstOptions* options)
+{
+    if (!(parser && options))
+        return false;
+
+    auto* internalParser = dynamic_cast<GstVkVideoDecoderParser*>(parser);
+    if (!internalParser)
+        return false;
+
+    return internalParser->SetOptions(options);
+}
+
+bool FlushVulkanVideoDecodeParser(VulkanVideoDecodeParser* parser)
+{
+    if (!parser)
+        return false;
+
+    auto* internalParser = dynamic_cast<GstVkVideoDecoderParser*>(parser);
+    if (!internalParser)
+        return false;
+
+    return internalParser->Flush();
+}
+
+bool GetVulkanVideoDecodeParserStats(VulkanVideoDecodeParser* parser, VkParserGstStats* stats)
+{
+    if (!(parser && stats))
+        return false;
+
+    auto* internalParser = dynamic_cast<GstVkVideoDecoderParser*>(parser);
+    if (!internalParser)
+        return false;
+
+    return internalParser->GetStats(stats);
+}
+
+uint64_t GetVulkanVideoDecodeParserHistogramPercentile(const VkParserGstHistogram* histogram, double percentile)
+{
+    GstCodecStatsHistogram src;
+
+    if (!histogram)
+        return 0;
+
+    src.count = histogram->count;
+    src.total = histogram->total;
+    src.max = histogram->max;
+    memcpy(src.buckets, histogram->buckets, sizeof(src.buckets));
+
+    return gst_codec_stats_histogram_percentile(&src, percentile);
+}
@@ -27,3 +27,153 @@ typedef void (*nvParserLogFuncType)(const char* format, ...);
 bool CreateVulkanVideoDecodeParser(VulkanVideoDecodeParser** ppobj, VkVideoCodecOperationFlagBitsKHR eCompression,
                                    const VkExtensionProperties* pStdExtensionVersion,
                                    nvParserLogFuncType pParserLogFunc, int logLevel);
+
+// Called once the parser doesn't need anymore a byte stream that was passed
+// without copy. See VkParserGstOptions::bZeroCopyInput.
+typedef void (*VkParserReleaseByteStreamFuncType)(void* pUserData, const uint8_t* pByteStream);
+
+// Returns at least nSize bytes where the slices of a picture are written,
+// start codes included, e.g. a mapped host visible VkBuffer, so they don't
+// have to be copied again before decoding. The usable size, which can be
+// larger, e.g. rounded up to minBitstreamBufferSizeAlignment, is returned in
+// pnAllocated. If NULL is returned the parser's own memory is used. The
+// memory belongs to the client once it's handed to DecodePicture() as
+// VkParserPictureData::pBitstreamData. Otherwise it's given back through
+// VkParserReleaseBitstreamFuncType, e.g. when a picture outgrows it.
+typedef uint8_t* (*VkParserAllocateBitstreamFuncType)(void* pUserData, size_t nSize, size_t* pnAllocated);
+typedef void (*VkParserReleaseBitstreamFuncType)(void* pUserData, uint8_t* pBitstream);
+
+// A slice NAL unit, without its start code.
+typedef struct VkParserGstSliceSegment {
+    const uint8_t* pData;
+    size_t nDataLength;
+} VkParserGstSliceSegment;
+
+// Receives the slices of pPicture right before it's handed to
+// DecodePicture(), pointing into the input packets instead of copied.
+// pPicture->pBitstreamData is then NULL, while nBitstreamDataLen and
+// pSliceDataOffsets describe the slices gathered back to back, each one
+// preceded by a 00 00 01 start code. The segments are valid until the
+// parser releases its reference on pPicture->pCurrPic.
+typedef void (*VkParserSliceSegmentsFuncType)(void* pUserData, const VkParserPictureData* pPicture,
+                                              const VkParserGstSliceSegment* pSegments, uint32_t nSegments);
+
+typedef enum VkParserGstBackpressure {
+    // ParseByteStream() waits for room in the queue
+    VK_PARSER_GST_BACKPRESSURE_BLOCK = 0,
+    // ParseByteStream() fails, without consuming the packet, if the queue is
+    // full, so it can be retried later
+    VK_PARSER_GST_BACKPRESSURE_FAIL,
+} VkParserGstBackpressure;
+
+typedef enum VkParserGstStreamFormat {
+    // Annex B byte stream, NAL units delimited by start codes
+    VK_PARSER_GST_STREAM_FORMAT_BYTE_STREAM = 0,
+    // NAL units prefixed by their size, as stored in MP4 and Matroska. Each
+    // packet is one access unit. The avcC/hvcC record, if any, is passed in
+    // VkParserInitDecodeParameters::pExternalSeqInfo.
+    VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED,
+} VkParserGstStreamFormat;
+
+typedef enum VkParserGstBackend {
+    // elements in a bin driven by GstHarness
+    VK_PARSER_GST_BACKEND_HARNESS = 0,
+    // elements linked pad to pad, buffers pushed straight from ParseByteStream()
+    VK_PARSER_GST_BACKEND_DIRECT,
+} VkParserGstBackend;
+
+// Options specific to this implementation of the parser. They are not part of
+// the NVIDIA parser API, thus they are set through
+// SetVulkanVideoDecodeParserOptions() before calling Initialize().
+typedef struct VkParserGstOptions {
+    // If set, VkParserBitstreamPacket::pByteStream is wrapped instead of
+    // copied. The caller has to keep the data alive and unmodified until
+    // pfnReleaseByteStream is called with that pointer, which happens within
+    // ParseByteStream() or Deinitialize(), in the caller's thread, or in the
+    // parse thread if bAsync is set.
+    bool bZeroCopyInput;
+    VkParserReleaseByteStreamFuncType pfnReleaseByteStream;
+    void* pReleaseUserData;
+    VkParserGstBackend eBackend;
+    // If set, ParseByteStream() queues the packet and returns right away. The
+    // packets are parsed, and the client called back, in a dedicated thread.
+    // Errors are reported by the next ParseByteStream() or by
+    // FlushVulkanVideoDecodeParser().
+    bool bAsync;
+    // Packets the queue can hold, rounded up to a power of two. 0 means 16.
+    uint32_t nQueueDepth;
+    VkParserGstBackpressure eBackpressure;
+    // If set, the counters and times in VkParserGstStats are collected.
+    bool bCollectStats;
+    // If set, no h264parse/h265parse element is used: the decoder element
+    // splits the byte stream into access units itself, and every NAL unit
+    // is parsed once. Either way, the picture in a packet with
+    // VkParserBitstreamPacket::bEOP set is handed to DecodePicture() without
+    // waiting for the next packet. An empty packet with bEOP set ends the
+    // picture of the packets before it.
+    bool bDecoderFraming;
+    // Length prefixed input never goes through a parse element nor start
+    // code scanning.
+    VkParserGstStreamFormat eStreamFormat;
+    // Optional, called from the thread parsing.
+    VkParserAllocateBitstreamFuncType pfnAllocateBitstream;
+    VkParserReleaseBitstreamFuncType pfnReleaseBitstream;
+    void* pBitstreamUserData;
+    // Optional, called from the thread parsing. Takes precedence over
+    // pfnAllocateBitstream. With bZeroCopyInput the slices point into the
+    // caller's memory, whose release is delayed accordingly.
+    VkParserSliceSegmentsFuncType pfnSliceSegments;
+    void* pSliceSegmentsUserData;
+    // If set, only the IDR (H.264) or IRAP (H.265) pictures are parsed and
+    // handed to the client. The other access units are dropped once their
+    // NAL units are identified, without calling AllocPictureBuffer().
+    bool bKeyframesOnly;
+    // H.265 only: number of temporal sub-layers parsed, for a lower frame
+    // rate. The NAL units with a TemporalId not lower than it are dropped
+    // once identified, so their pictures never reach the client. 0 means
+    // all of them.
+    uint32_t nTemporalLayers;
+} VkParserGstOptions;
+
+bool SetVulkanVideoDecodeParserOptions(VulkanVideoDecodeParser* pobj, const VkParserGstOptions* pOptions);
+
+// Waits until the packets queued in async mode are parsed. Returns false if
+// parsing failed.
+bool FlushVulkanVideoDecodeParser(VulkanVideoDecodeParser* pobj);
+
+// Times in nanoseconds. Buckets have logarithmic widths, four per power of
+// two, so a time is known within 25%.
+#define VK_PARSER_GST_HISTOGRAM_BUCKETS 160
+
+typedef struct VkParserGstHistogram {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[VK_PARSER_GST_HISTOGRAM_BUCKETS];
+} VkParserGstHistogram;
+
+typedef struct VkParserGstStats {
+    uint64_t nalsParsed;
+    uint64_t slicesAssembled;
+    // input packets copied by ParseByteStream() and slices copied into the
+    // picture bitstreams
+    uint64_t bytesCopied;
+    // parameter sets identical to the last ones of their ids, neither
+    // parsed again nor passed to UpdatePictureParameters()
+    uint64_t parameterSetsSkipped;
+    // pictures allocated from the client and not released yet
+    uint64_t picturesInFlight;
+    uint64_t picturesInFlightPeak;
+    VkParserGstHistogram nalIdentification;
+    // reference picture marking and reference lists construction
+    VkParserGstHistogram dpbManagement;
+    VkParserGstHistogram clientCallbacks;
+} VkParserGstStats;
+
+// Can be called from any thread at any time after Initialize(), even while
+// parsing. Returns false if VkParserGstOptions::bCollectStats wasn't set.
+bool GetVulkanVideoDecodeParserStats(VulkanVideoDecodeParser* pobj, VkParserGstStats* pStats);
+
+// Returns the time below which the given fraction, between 0 and 1, of the
+// recorded times are.
+uint64_t GetVulkanVideoDecodeParserHistogramPercentile(const VkParserGstHistogram* pHistogram, double percentile);
@@ -0,0 +1,190 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "vkvideoparserindex.h"
+
+#include "gstcodecindex.h"
+
+#include <glib.h>
+
+struct VkParserGstIndex {
+    GstCodecIndex* index;
+};
+
+static VkParserGstIndex* wrap_index(GstCodecIndex* index)
+{
+    auto* wrapper = new VkParserGstIndex;
+
+    wrapper->index = index;
+    return wrapper;
+}
+
+bool CreateVulkanVideoParserIndex(VkVideoCodecOperationFlagBitsKHR eCompression, VkParserGstIndex** ppIndex)
+{
+    GstCodecIndexCodec codec;
+
+    if (!ppIndex)
+        return false;
+
+    switch (eCompression) {
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT:
+        codec = GST_CODEC_INDEX_H264;
+        break;
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT:
+        codec = GST_CODEC_INDEX_H265;
+        break;
+    default:
+        return false;
+    }
+
+    *ppIndex = wrap_index(gst_codec_index_new(codec));
+    return true;
+}
+
+bool ScanVulkanVideoParserIndex(VkParserGstIndex* pIndex, const uint8_t* pByteStream, size_t size, int64_t pts)
+{
+    if (!(pIndex && (pByteStream || size == 0)))
+        return false;
+
+    gst_codec_index_scan(pIndex->index, pByteStream, size, pts);
+    return true;
+}
+
+bool BuildVulkanVideoParserIndex(VkVideoCodecOperationFlagBitsKHR eCompression, const char* pFilename, VkParserGstIndex** ppIndex)
+{
+    GMappedFile* file;
+    VkParserGstIndex* index;
+
+    if (!(pFilename && ppIndex))
+        return false;
+
+    file = g_mapped_file_new(pFilename, FALSE, NULL);
+    if (!file)
+        return false;
+
+    if (!CreateVulkanVideoParserIndex(eCompression, &index)) {
+        g_mapped_file_unref(file);
+        return false;
+    }
+
+    gst_codec_index_scan(index->index, reinterpret_cast<const guint8*>(g_mapped_file_get_contents(file)),
+                         g_mapped_file_get_length(file), -1);
+    g_mapped_file_unref(file);
+
+    *ppIndex = index;
+    return true;
+}
+
+bool SaveVulkanVideoParserIndex(VkParserGstIndex* pIndex, const char* pFilename)
+{
+    if (!(pIndex && pFilename))
+        return false;
+
+    return gst_codec_index_save(pIndex->index, pFilename, NULL);
+}
+
+bool LoadVulkanVideoParserIndex(const char* pFilename, VkParserGstIndex** ppIndex)
+{
+    GstCodecIndex* index;
+
+    if (!(pFilename && ppIndex))
+        return false;
+
+    index = gst_codec_index_load(pFilename, NULL);
+    if (!index)
+        return false;
+
+    *ppIndex = wrap_index(index);
+    return true;
+}
+
+void DestroyVulkanVideoParserIndex(VkParserGstIndex* pIndex)
+{
+    if (!pIndex)
+        return;
+
+    gst_codec_index_free(pIndex->index);
+    delete pIndex;
+}
+
+uint32_t GetVulkanVideoParserIndexEntryCount(VkParserGstIndex* pIndex)
+{
+    return pIndex ? gst_codec_index_get_n_entries(pIndex->index) : 0;
+}
+
+uint32_t GetVulkanVideoParserIndexFrameCount(VkParserGstIndex* pIndex)
+{
+    return pIndex ? gst_codec_index_get_n_frames(pIndex->index) : 0;
+}
+
+bool GetVulkanVideoParserIndexEntry(VkParserGstIndex* pIndex, uint32_t n, VkParserGstIndexEntry* pEntry)
+{
+    const GstCodecIndexEntry* entry;
+
+    if (!(pIndex && pEntry) || n >= gst_codec_index_get_n_entries(pIndex->index))
+        return false;
+
+    entry = gst_codec_index_get_entry(pIndex->index, n);
+    *pEntry = VkParserGstIndexEntry {
+        .offset = entry->offset,
+        .pts = entry->pts,
+        .frame = entry->frame,
+        .nalType = entry->nal_type,
+        .vpsId = entry->vps_id,
+        .spsId = entry->sps_id,
+        .ppsId = entry->pps_id,
+    };
+    return true;
+}
+
+bool StartVulkanVideoDecodeParserAtIndexEntry(VulkanVideoDecodeParser* pParser, VkParserGstIndex* pIndex, uint32_t n,
+                                              const uint8_t* pByteStream, size_t size, size_t* pOffset)
+{
+    const GstCodecIndexEntry* entry;
+    GArray* sets;
+    bool ret = true;
+
+    if (!(pParser && pIndex && pByteStream && pOffset) || n >= gst_codec_index_get_n_entries(pIndex->index))
+        return false;
+
+    entry = gst_codec_index_get_entry(pIndex->index, n);
+    if (entry->offset >= size)
+        return false;
+
+    sets = gst_codec_index_get_param_sets(pIndex->index, n);
+    for (guint i = 0; i < sets->len && ret; i++) {
+        const GstCodecIndexParamSet* ps = &g_array_index(sets, GstCodecIndexParamSet, i);
+        int32_t parsed;
+
+        if (ps->offset < 3 || ps->offset + ps->size > size) {
+            ret = false;
+            break;
+        }
+
+        // from its start code, which precedes the recorded offset
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = pByteStream + ps->offset - 3,
+            .nDataLength = static_cast<int32_t>(ps->size + 3),
+        };
+        ret = pParser->ParseByteStream(&pkt, &parsed);
+    }
+    g_array_unref(sets);
+
+    if (ret)
+        *pOffset = entry->offset;
+    return ret;
+}
@@ -0,0 +1,77 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include "vkvideodecodeparser.h"
+
+// Random access index of an H.264 or H.265 Annex B byte stream, for seeking
+// without parsing everything before the seek point. Building it only looks
+// at the NAL unit headers and the first bits of the slices and parameter
+// sets, so it runs at the speed of the start code search.
+//
+// Its entries are the IDR (H.264) or IRAP (H.265) access units, each of
+// them starting a GOP. The parameter sets in force at every entry are
+// recorded too, thus parsing can start at any entry.
+typedef struct VkParserGstIndex VkParserGstIndex;
+
+typedef struct VkParserGstIndexEntry {
+    // of the start code of the first NAL unit of the access unit
+    uint64_t offset;
+    // -1 if unknown
+    int64_t pts;
+    // access units before it, in decode order
+    uint32_t frame;
+    // of its first slice
+    uint8_t nalType;
+    // parameter sets it refers to, 0xffff if unknown
+    uint16_t vpsId;
+    uint16_t spsId;
+    uint16_t ppsId;
+} VkParserGstIndexEntry;
+
+bool CreateVulkanVideoParserIndex(VkVideoCodecOperationFlagBitsKHR eCompression, VkParserGstIndex** ppIndex);
+
+// Indexes complete NAL units: a whole stream, or a packet of a demuxed
+// stream. Consecutive calls index consecutive parts of the stream, and
+// offsets count the bytes of all of them. pts is given to the first access
+// unit starting in pByteStream, -1 if unknown.
+bool ScanVulkanVideoParserIndex(VkParserGstIndex* pIndex, const uint8_t* pByteStream, size_t size, int64_t pts);
+
+// Creates the index of a whole Annex B file, mapped in memory.
+bool BuildVulkanVideoParserIndex(VkVideoCodecOperationFlagBitsKHR eCompression, const char* pFilename, VkParserGstIndex** ppIndex);
+
+// The file is a compact binary record, independent of the platform.
+bool SaveVulkanVideoParserIndex(VkParserGstIndex* pIndex, const char* pFilename);
+bool LoadVulkanVideoParserIndex(const char* pFilename, VkParserGstIndex** ppIndex);
+
+void DestroyVulkanVideoParserIndex(VkParserGstIndex* pIndex);
+
+uint32_t GetVulkanVideoParserIndexEntryCount(VkParserGstIndex* pIndex);
+
+// Access units in the indexed stream.
+uint32_t GetVulkanVideoParserIndexFrameCount(VkParserGstIndex* pIndex);
+
+bool GetVulkanVideoParserIndexEntry(VkParserGstIndex* pIndex, uint32_t n, VkParserGstIndexEntry* pEntry);
+
+// Parses the parameter sets in force at entry n, taken from pByteStream, the
+// indexed stream, e.g. mapped in memory, and returns in pOffset where the
+// caller carries on calling ParseByteStream(). The parser must not have
+// parsed anything since Initialize(). With bZeroCopyInput the parameter sets
+// are passed in place, as pointers within pByteStream.
+bool StartVulkanVideoDecodeParserAtIndexEntry(VulkanVideoDecodeParser* pParser, VkParserGstIndex* pIndex, uint32_t n,
+                                              const uint8_t* pByteStream, size_t size, size_t* pOffset);
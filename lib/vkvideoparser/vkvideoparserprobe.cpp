@@ -0,0 +1,268 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "vkvideoparserprobe.h"
+
+#include "gstcodecdpbsize.h"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <string.h>
+
+// pack_framerate() of the elements, which live in another library when
+// the plugin is external.
+static uint32_t pack_framerate(uint32_t numerator, uint32_t denominator)
+{
+    while ((numerator >= (1 << 18)) || (denominator >= (1 << 14))) {
+        if (!(numerator % 5) && !(denominator % 5)) {
+            numerator /= 5;
+            denominator /= 5;
+        } else if (((numerator | denominator) & 1) && !(numerator % 3) && !(denominator % 3)) {
+            numerator /= 3;
+            denominator /= 3;
+        } else {
+            numerator = (numerator + 1) >> 1;
+            denominator = (denominator + 1) >> 1;
+        }
+    }
+    return (numerator << 14) | denominator;
+}
+
+// Same reduction as the fractions of the caps.
+static uint32_t pack_vui_framerate(guint64 num, guint64 den)
+{
+    gint64 gcd;
+
+    if (num == 0 || den == 0)
+        return pack_framerate(0, 1);
+
+    gcd = gst_util_greatest_common_divisor_int64(num, den);
+    return pack_framerate(num / gcd, den / gcd);
+}
+
+static void set_display_ratio(VkParserSequenceInfo* info, guint par_n, guint par_d)
+{
+    guint dar_n = 0, dar_d = 0;
+
+    if (par_n == 0 || par_d == 0)
+        par_n = par_d = 1;
+
+    if (gst_video_calculate_display_ratio(&dar_n, &dar_d, info->nDisplayWidth, info->nDisplayHeight, par_n, par_d, 1, 1)) {
+        info->lDARWidth = dar_n;
+        info->lDARHeight = dar_d;
+    }
+}
+
+// Mirrors gst_vk_h264_dec_new_sequence().
+static void fill_h264_sequence(const GstH264SPS* sps, VkParserSequenceInfo* info)
+{
+    const GstH264VUIParams* vui = &sps->vui_parameters;
+    guint64 fps_n = 0, fps_d = 1;
+
+    // h264parse counts two ticks per frame
+    if (sps->vui_parameters_present_flag && vui->timing_info_present_flag) {
+        fps_n = vui->time_scale;
+        fps_d = 2 * (guint64)vui->num_units_in_tick;
+    }
+
+    info->eCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+    info->isSVC = sps->profile_idc == GST_H264_PROFILE_SCALABLE_BASELINE
+        || sps->profile_idc == GST_H264_PROFILE_SCALABLE_HIGH;
+    info->frameRate = pack_vui_framerate(fps_n, fps_d) * 1000;
+    info->bProgSeq = sps->frame_mbs_only_flag;
+    info->nCodedWidth = sps->width;
+    info->nCodedHeight = sps->height;
+    info->nChromaFormat = sps->chroma_format_idc;
+    info->uBitDepthLumaMinus8 = sps->bit_depth_luma_minus8;
+    info->uBitDepthChromaMinus8 = sps->bit_depth_chroma_minus8;
+    info->nMinNumDecodeSurfaces = gst_codec_h264_get_max_dpb_size(sps) + 1;
+    info->codecProfile = sps->profile_idc;
+
+    if (sps->frame_cropping_flag) {
+        info->nDisplayWidth = sps->crop_rect_width;
+        info->nDisplayHeight = sps->crop_rect_height;
+    } else {
+        info->nDisplayWidth = sps->width;
+        info->nDisplayHeight = sps->height;
+    }
+
+    if (sps->vui_parameters_present_flag) {
+        info->uVideoFullRange = vui->video_full_range_flag;
+        if (vui->nal_hrd_parameters_present_flag)
+            info->lBitrate = vui->nal_hrd_parameters.bit_rate_scale;
+        else if (vui->vcl_hrd_parameters_present_flag)
+            info->lBitrate = vui->vcl_hrd_parameters.bit_rate_scale;
+        info->lVideoFormat = vui->video_format;
+        info->lColorPrimaries = vui->colour_primaries;
+        info->lTransferCharacteristics = vui->transfer_characteristics;
+        info->lMatrixCoefficients = vui->matrix_coefficients;
+        set_display_ratio(info, vui->par_n, vui->par_d);
+    } else {
+        set_display_ratio(info, 1, 1);
+    }
+}
+
+static bool probe_h264(const uint8_t* data, size_t size, VkParserSequenceInfo* info)
+{
+    GstH264NalParser* parser = gst_h264_nal_parser_new();
+    GstH264ParserResult res;
+    GstH264NalUnit nalu;
+    GstH264SPS sps;
+    guint offset = 0;
+    bool found = false;
+
+    do {
+        res = gst_h264_parser_identify_nalu(parser, data, offset, size, &nalu);
+        if (res != GST_H264_PARSER_OK && res != GST_H264_PARSER_NO_NAL_END)
+            break;
+
+        if (nalu.type == GST_H264_NAL_SPS && gst_h264_parse_sps(&nalu, &sps) == GST_H264_PARSER_OK) {
+            fill_h264_sequence(&sps, info);
+            gst_h264_sps_clear(&sps);
+            found = true;
+            break;
+        }
+
+        offset = nalu.offset + nalu.size;
+    } while (res == GST_H264_PARSER_OK);
+
+    gst_h264_nal_parser_free(parser);
+    return found;
+}
+
+static StdVideoH265ProfileIdc get_h265_profile_idc(guint8 profile_idc)
+{
+    switch (profile_idc) {
+    case GST_H265_PROFILE_IDC_MAIN:
+        return STD_VIDEO_H265_PROFILE_IDC_MAIN;
+    case GST_H265_PROFILE_IDC_MAIN_10:
+        return STD_VIDEO_H265_PROFILE_IDC_MAIN_10;
+    case GST_H265_PROFILE_IDC_MAIN_STILL_PICTURE:
+        return STD_VIDEO_H265_PROFILE_IDC_MAIN_STILL_PICTURE;
+    case GST_H265_PROFILE_IDC_FORMAT_RANGE_EXTENSION:
+        return STD_VIDEO_H265_PROFILE_IDC_FORMAT_RANGE_EXTENSIONS;
+    default:
+        break;
+    }
+
+    return STD_VIDEO_H265_PROFILE_IDC_INVALID;
+}
+
+// Mirrors gst_vk_h265_dec_new_sequence().
+static void fill_h265_sequence(const GstH265SPS* sps, VkParserSequenceInfo* info)
+{
+    const GstH265VUIParams* vui = &sps->vui_params;
+    guint8 profile_idc = sps->profile_tier_level.profile_idc;
+    guint64 fps_n = 0, fps_d = 1;
+
+    if (sps->vui_parameters_present_flag && vui->timing_info_present_flag) {
+        fps_n = vui->time_scale;
+        fps_d = vui->num_units_in_tick;
+    } else if (sps->vps && sps->vps->timing_info_present_flag) {
+        fps_n = sps->vps->time_scale;
+        fps_d = sps->vps->num_units_in_tick;
+    }
+
+    info->eCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT;
+    info->isSVC = profile_idc == GST_H265_PROFILE_IDC_SCALABLE_MAIN
+        || profile_idc == GST_H265_PROFILE_IDC_SCALABLE_FORMAT_RANGE_EXTENSION;
+    info->frameRate = pack_vui_framerate(fps_n, fps_d);
+    info->bProgSeq = !(sps->vui_parameters_present_flag && vui->field_seq_flag);
+    info->nCodedWidth = sps->width;
+    info->nCodedHeight = sps->height;
+    info->nChromaFormat = sps->chroma_format_idc;
+    info->uBitDepthLumaMinus8 = sps->bit_depth_luma_minus8;
+    info->uBitDepthChromaMinus8 = sps->bit_depth_chroma_minus8;
+    info->nMinNumDecodeSurfaces = MIN(gst_codec_h265_get_max_dpb_size(sps) + 1, 8);
+    info->codecProfile = static_cast<uint32_t>(get_h265_profile_idc(profile_idc));
+
+    if (sps->conformance_window_flag) {
+        info->nDisplayWidth = sps->crop_rect_width;
+        info->nDisplayHeight = sps->crop_rect_height;
+    } else {
+        info->nDisplayWidth = sps->width;
+        info->nDisplayHeight = sps->height;
+    }
+
+    if (sps->vui_parameters_present_flag) {
+        info->uVideoFullRange = vui->video_full_range_flag;
+        info->lVideoFormat = vui->video_format;
+        info->lColorPrimaries = vui->colour_primaries;
+        info->lTransferCharacteristics = vui->transfer_characteristics;
+        info->lMatrixCoefficients = vui->matrix_coefficients;
+        info->lBitrate = vui->hrd_params.bit_rate_scale;
+        set_display_ratio(info, vui->par_n, vui->par_d);
+    } else {
+        if (sps->vps)
+            info->lBitrate = sps->vps->hrd_params.bit_rate_scale;
+        set_display_ratio(info, 1, 1);
+    }
+}
+
+static bool probe_h265(const uint8_t* data, size_t size, VkParserSequenceInfo* info)
+{
+    GstH265Parser* parser = gst_h265_parser_new();
+    GstH265ParserResult res;
+    GstH265NalUnit nalu;
+    GstH265VPS vps;
+    GstH265SPS sps;
+    guint offset = 0;
+    bool found = false;
+
+    do {
+        res = gst_h265_parser_identify_nalu(parser, data, offset, size, &nalu);
+        if (res != GST_H265_PARSER_OK && res != GST_H265_PARSER_NO_NAL_END)
+            break;
+
+        // kept by the parser for the SPS referring to it
+        if (nalu.type == GST_H265_NAL_VPS)
+            gst_h265_parser_parse_vps(parser, &nalu, &vps);
+
+        if (nalu.type == GST_H265_NAL_SPS && gst_h265_parser_parse_sps(parser, &nalu, &sps, TRUE) == GST_H265_PARSER_OK) {
+            fill_h265_sequence(&sps, info);
+            found = true;
+            break;
+        }
+
+        offset = nalu.offset + nalu.size;
+    } while (res == GST_H265_PARSER_OK);
+
+    gst_h265_parser_free(parser);
+    return found;
+}
+
+bool ProbeVulkanVideoDecodeParserSequence(VkVideoCodecOperationFlagBitsKHR eCompression,
+                                          const uint8_t* pByteStream, size_t size,
+                                          VkParserSequenceInfo* pSequenceInfo)
+{
+    if (!(pByteStream && pSequenceInfo) || size > G_MAXUINT)
+        return false;
+
+    if (!gst_init_check(NULL, NULL, NULL))
+        return false;
+
+    memset(pSequenceInfo, 0, sizeof(*pSequenceInfo));
+
+    switch (eCompression) {
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT:
+        return probe_h264(pByteStream, size, pSequenceInfo);
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT:
+        return probe_h265(pByteStream, size, pSequenceInfo);
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,33 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include "vkvideodecodeparser.h"
+
+// Fills pSequenceInfo as BeginSequence() reports the first sequence of an
+// Annex B byte stream, only parsing its first SPS (and for H.265 the VPS
+// before it). No parser nor GStreamer element is created, so it's meant
+// for choosing a decoder, or sizing the decoded picture buffer, before
+// creating one.
+//
+// The frame rate comes from the VUI timing information, as the parse
+// elements read it. Returns false if no SPS could be parsed within the size
+// bytes.
+bool ProbeVulkanVideoDecodeParserSequence(VkVideoCodecOperationFlagBitsKHR eCompression,
+                                          const uint8_t* pByteStream, size_t size,
+                                          VkParserSequenceInfo* pSequenceInfo);
@@ -0,0 +1,323 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#include "vkvideoparsersession.h"
+
+#include <gst/gst.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_vk_video_parser_debug);
+#define GST_CAT_DEFAULT gst_vk_video_parser_debug
+
+// packets parsed by a worker before yielding to other sessions
+#define MAX_PACKETS_PER_RUN 16
+
+struct SessionPacket {
+    VkParserBitstreamPacket packet;
+    // copy of the data, if any; owned by the parser once it's parsed
+    uint8_t* data;
+};
+
+class VulkanVideoParserSessionManager {
+public:
+    VulkanVideoParserSessionManager()
+        : m_pool(nullptr)
+    {
+    }
+
+    ~VulkanVideoParserSessionManager()
+    {
+        if (m_pool)
+            g_thread_pool_free(m_pool, FALSE, TRUE);
+    }
+
+    bool Init(uint32_t workerCount);
+    bool Schedule(VulkanVideoParserSession* session);
+
+private:
+    GThreadPool* m_pool;
+};
+
+class VulkanVideoParserSession {
+public:
+    VulkanVideoParserSession(VulkanVideoParserSessionManager* manager, VulkanVideoDecodeParser* parser, const VkParserGstOptions& options)
+        : m_manager(manager)
+        , m_parser(parser)
+        , m_options(options)
+        , m_scheduled(false)
+        , m_failed(false)
+    {
+        g_mutex_init(&m_lock);
+        g_cond_init(&m_cond);
+        g_queue_init(&m_packets);
+    }
+
+    ~VulkanVideoParserSession()
+    {
+        m_parser->Release();
+        g_cond_clear(&m_cond);
+        g_mutex_clear(&m_lock);
+    }
+
+    bool Queue(const VkParserBitstreamPacket* packet);
+    bool Wait();
+    void Run();
+
+private:
+    bool Parse(SessionPacket* pkt);
+    void Drop(SessionPacket* pkt);
+
+    VulkanVideoParserSessionManager* m_manager;
+    VulkanVideoDecodeParser* m_parser;
+    // as given by the caller, not as set to the parser
+    VkParserGstOptions m_options;
+
+    GMutex m_lock;
+    GCond m_cond;
+    GQueue m_packets;
+    // true while the session is in the pool queue or run by a worker
+    bool m_scheduled;
+    bool m_failed;
+};
+
+static void run_session(gpointer data, gpointer user_data)
+{
+    static_cast<VulkanVideoParserSession*>(data)->Run();
+}
+
+static void free_packet_data(void* user_data, const uint8_t* data)
+{
+    g_free(const_cast<uint8_t*>(data));
+}
+
+bool VulkanVideoParserSessionManager::Init(uint32_t workerCount)
+{
+    GError* err = nullptr;
+
+    if (workerCount == 0)
+        workerCount = g_get_num_processors();
+
+    m_pool = g_thread_pool_new(run_session, this, workerCount, TRUE, &err);
+    if (!m_pool) {
+        g_warning("Failed to create the worker pool: %s", err->message);
+        g_clear_error(&err);
+        return false;
+    }
+
+    return true;
+}
+
+bool VulkanVideoParserSessionManager::Schedule(VulkanVideoParserSession* session)
+{
+    return g_thread_pool_push(m_pool, session, nullptr);
+}
+
+bool VulkanVideoParserSession::Queue(const VkParserBitstreamPacket* packet)
+{
+    auto pkt = g_new(SessionPacket, 1);
+    bool schedule = false;
+
+    pkt->packet = *packet;
+    pkt->data = nullptr;
+    if (!m_options.bZeroCopyInput && packet->nDataLength > 0) {
+        pkt->data = static_cast<uint8_t*>(g_malloc(packet->nDataLength));
+        memcpy(pkt->data, packet->pByteStream, packet->nDataLength);
+        pkt->packet.pByteStream = pkt->data;
+    }
+
+    g_mutex_lock(&m_lock);
+    g_queue_push_tail(&m_packets, pkt);
+    if (!m_scheduled)
+        schedule = m_scheduled = true;
+    g_mutex_unlock(&m_lock);
+
+    if (schedule && !m_manager->Schedule(this)) {
+        g_mutex_lock(&m_lock);
+        m_scheduled = false;
+        m_failed = true;
+        g_cond_broadcast(&m_cond);
+        g_mutex_unlock(&m_lock);
+        return false;
+    }
+
+    return true;
+}
+
+bool VulkanVideoParserSession::Wait()
+{
+    bool ret;
+
+    g_mutex_lock(&m_lock);
+    while (m_scheduled)
+        g_cond_wait(&m_cond, &m_lock);
+    // the pending packets, if any, were queued after a failed schedule
+    while (auto pkt = static_cast<SessionPacket*>(g_queue_pop_head(&m_packets)))
+        Drop(pkt);
+    ret = !m_failed;
+    g_mutex_unlock(&m_lock);
+
+    return ret;
+}
+
+bool VulkanVideoParserSession::Parse(SessionPacket* pkt)
+{
+    int32_t parsed;
+
+    // the parser takes care of the copy, even if parsing fails
+    return m_parser->ParseByteStream(&pkt->packet, &parsed);
+}
+
+void VulkanVideoParserSession::Drop(SessionPacket* pkt)
+{
+    if (pkt->data)
+        g_free(pkt->data);
+    else if (m_options.bZeroCopyInput && pkt->packet.nDataLength > 0)
+        m_options.pfnReleaseByteStream(m_options.pReleaseUserData, pkt->packet.pByteStream);
+}
+
+void VulkanVideoParserSession::Run()
+{
+    for (guint i = 0; i < MAX_PACKETS_PER_RUN; i++) {
+        SessionPacket* pkt;
+        bool failed;
+
+        g_mutex_lock(&m_lock);
+        pkt = static_cast<SessionPacket*>(g_queue_pop_head(&m_packets));
+        failed = m_failed;
+        if (!pkt) {
+            m_scheduled = false;
+            g_cond_broadcast(&m_cond);
+            g_mutex_unlock(&m_lock);
+            return;
+        }
+        g_mutex_unlock(&m_lock);
+
+        if (failed) {
+            Drop(pkt);
+        } else if (!Parse(pkt)) {
+            GST_WARNING("Failed to parse a packet of session %p", this);
+            g_mutex_lock(&m_lock);
+            m_failed = true;
+            g_mutex_unlock(&m_lock);
+        }
+
+        g_free(pkt);
+    }
+
+    // let the other sessions run before parsing the rest
+    g_mutex_lock(&m_lock);
+    if (g_queue_is_empty(&m_packets)) {
+        m_scheduled = false;
+        g_cond_broadcast(&m_cond);
+    } else if (!m_manager->Schedule(this)) {
+        m_scheduled = false;
+        m_failed = true;
+        g_cond_broadcast(&m_cond);
+    }
+    g_mutex_unlock(&m_lock);
+}
+
+bool CreateVulkanVideoParserSessionManager(VulkanVideoParserSessionManager** manager, uint32_t workerCount)
+{
+    if (!manager)
+        return false;
+
+    auto* internalManager = new VulkanVideoParserSessionManager();
+    if (!internalManager->Init(workerCount)) {
+        delete internalManager;
+        return false;
+    }
+
+    *manager = internalManager;
+    return true;
+}
+
+void DestroyVulkanVideoParserSessionManager(VulkanVideoParserSessionManager* manager)
+{
+    delete manager;
+}
+
+bool CreateVulkanVideoParserSession(VulkanVideoParserSessionManager* manager,
+                                    VkVideoCodecOperationFlagBitsKHR codec,
+                                    VkParserInitDecodeParameters* params,
+                                    const VkParserGstOptions* options,
+                                    VulkanVideoParserSession** session)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    VkParserGstOptions sessionOptions = { };
+    VkParserGstOptions parserOptions;
+
+    if (!(manager && session))
+        return false;
+
+    if (options)
+        sessionOptions = *options;
+    if (sessionOptions.bZeroCopyInput && !sessionOptions.pfnReleaseByteStream)
+        return false;
+
+    // the workers already parse asynchronously, and the session copies the
+    // packets itself, so the parser wraps them either way
+    parserOptions = sessionOptions;
+    parserOptions.eBackend = VK_PARSER_GST_BACKEND_DIRECT;
+    parserOptions.bAsync = false;
+    if (!parserOptions.bZeroCopyInput) {
+        parserOptions.bZeroCopyInput = true;
+        parserOptions.pfnReleaseByteStream = free_packet_data;
+        parserOptions.pReleaseUserData = nullptr;
+    }
+
+    if (!CreateVulkanVideoDecodeParser(&parser, codec, nullptr, nullptr, 0))
+        return false;
+
+    if (!SetVulkanVideoDecodeParserOptions(parser, &parserOptions)
+        || parser->Initialize(params) != VK_SUCCESS) {
+        parser->Release();
+        return false;
+    }
+
+    *session = new VulkanVideoParserSession(manager, parser, sessionOptions);
+    return true;
+}
+
+bool QueueVulkanVideoParserSessionPacket(VulkanVideoParserSession* session, const VkParserBitstreamPacket* packet)
+{
+    if (!(session && packet))
+        return false;
+
+    return session->Queue(packet);
+}
+
+bool WaitVulkanVideoParserSession(VulkanVideoParserSession* session)
+{
+    if (!session)
+        return false;
+
+    return session->Wait();
+}
+
+bool DestroyVulkanVideoParserSession(VulkanVideoParserSession* session)
+{
+    bool ret;
+
+    if (!session)
+        return false;
+
+    ret = session->Wait();
+    delete session;
+    return ret;
+}
@@ -0,0 +1,57 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include "vkvideodecodeparser.h"
+
+// Runs many parsers on a fixed pool of worker threads, instead of each stream
+// parsing in its own thread.
+//
+// Every session owns a parser. Packets queued to a session are parsed in
+// order, by one worker at a time, so the client callbacks of a session are
+// delivered on a worker thread but never concurrently. Sessions always use
+// the direct backend, and never the async mode, thus they don't add threads,
+// and their parsers share a single bus.
+class VulkanVideoParserSessionManager;
+class VulkanVideoParserSession;
+
+// workerCount 0 means one worker per CPU.
+bool CreateVulkanVideoParserSessionManager(VulkanVideoParserSessionManager** ppManager, uint32_t workerCount);
+
+// Waits for the queued packets. All the sessions have to be destroyed before.
+void DestroyVulkanVideoParserSessionManager(VulkanVideoParserSessionManager* pManager);
+
+// Creates and initializes a parser for the session. pOptions might be null.
+// Unless bZeroCopyInput is set, queued packets are copied once, and with
+// bZeroCopyInput pfnReleaseByteStream is called from a worker thread.
+bool CreateVulkanVideoParserSession(VulkanVideoParserSessionManager* pManager,
+                                    VkVideoCodecOperationFlagBitsKHR eCompression,
+                                    VkParserInitDecodeParameters* pParams,
+                                    const VkParserGstOptions* pOptions,
+                                    VulkanVideoParserSession** ppSession);
+
+// Queues the packet to be parsed by a worker and returns right away.
+bool QueueVulkanVideoParserSessionPacket(VulkanVideoParserSession* pSession, const VkParserBitstreamPacket* pPacket);
+
+// Blocks until all the queued packets are parsed. Returns false if any of
+// them failed; packets queued after a failure are dropped.
+bool WaitVulkanVideoParserSession(VulkanVideoParserSession* pSession);
+
+// Waits for the queued packets and releases the parser.
+bool DestroyVulkanVideoParserSession(VulkanVideoParserSession* pSession);
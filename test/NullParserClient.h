@@ -0,0 +1,87 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include "VideoParserClient.h"
+
+/* Client that only counts the callbacks, so benchmarks measure the parser
+ * and not the client. */
+class NullParserClient : public VkParserVideoDecodeClient {
+public:
+    NullParserClient()
+        : m_dpb(32)
+    {
+    }
+
+    int32_t BeginSequence(const VkParserSequenceInfo* info) final
+    {
+        m_sequences++;
+        return 17;
+    }
+
+    bool AllocPictureBuffer(VkPicIf** pic) final
+    {
+        for (auto& apic : m_dpb) {
+            if (apic.isAvailable()) {
+                apic.AddRef();
+                *pic = &apic;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        m_decoded++;
+        m_bitstreamBytes += pic->nBitstreamDataLen;
+        return true;
+    }
+
+    bool UpdatePictureParameters(VkPictureParameters* params, VkSharedBaseObj<VkParserVideoRefCountBase>& shared, uint64_t count) final
+    {
+        m_parameters++;
+        shared = PictureParameterSet::create();
+        return true;
+    }
+
+    bool DisplayPicture(VkPicIf* pic, int64_t ts) final
+    {
+        m_displayed++;
+        return true;
+    }
+
+    void UnhandledNALU(const uint8_t*, int32_t) final
+    {
+    }
+
+    uint64_t decoded() const { return m_decoded; }
+    uint64_t displayed() const { return m_displayed; }
+    uint64_t sequences() const { return m_sequences; }
+    uint64_t parameters() const { return m_parameters; }
+    uint64_t bitstreamBytes() const { return m_bitstreamBytes; }
+
+private:
+    std::vector<Picture> m_dpb;
+    uint64_t m_decoded = 0;
+    uint64_t m_displayed = 0;
+    uint64_t m_sequences = 0;
+    uint64_t m_parameters = 0;
+    uint64_t m_bitstreamBytes = 0;
+};
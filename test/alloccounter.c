@@ -0,0 +1,197 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+#include "alloccounter.h"
+
+static atomic_ullong allocations;
+static atomic_ullong module_allocations[ALLOC_COUNTER_MAX_MODULES];
+static const char *tracked_modules[ALLOC_COUNTER_MAX_MODULES];
+static unsigned n_tracked_modules;
+
+#if defined(__GLIBC__)
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+
+/* libraries doing allocations for their callers */
+static const char *helpers[] = {
+  "/libc.so", "/libc-", "/ld-linux", "/libstdc++", "/libgcc_s",
+  "/libglib-2.0", "/libgobject-2.0", "/libgstreamer-1.0", "/libgstbase-1.0",
+  "/libgstcodecparsers-1.0",
+};
+
+static __thread bool unwinding;
+
+static bool
+is_helper (const char *path)
+{
+  for (size_t i = 0; i < sizeof (helpers) / sizeof (helpers[0]); i++) {
+    if (strstr (path, helpers[i]))
+      return true;
+  }
+  return false;
+}
+
+static void
+count_module (void *caller)
+{
+  void *frames[64];
+  int n, first;
+
+  /* backtrace() and dladdr() might allocate themselves */
+  if (unwinding)
+    return;
+  unwinding = true;
+
+  n = backtrace (frames, 64);
+  /* skips the frames of the interposer */
+  for (first = 0; first < n && frames[first] != caller; first++);
+  for (int i = first; i < n; i++) {
+    Dl_info info;
+
+    if (!dladdr (frames[i], &info) || !info.dli_fname)
+      continue;
+    if (is_helper (info.dli_fname))
+      continue;
+    for (unsigned m = 0; m < n_tracked_modules; m++) {
+      if (strstr (info.dli_fname, tracked_modules[m])) {
+        atomic_fetch_add_explicit (&module_allocations[m], 1,
+            memory_order_relaxed);
+        break;
+      }
+    }
+    break;
+  }
+
+  unwinding = false;
+}
+
+static inline void
+count (void *caller)
+{
+  atomic_fetch_add_explicit (&allocations, 1, memory_order_relaxed);
+  if (n_tracked_modules > 0)
+    count_module (caller);
+}
+
+void *
+malloc (size_t size)
+{
+  count (__builtin_return_address (0));
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  count (__builtin_return_address (0));
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  count (__builtin_return_address (0));
+  return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+  count (__builtin_return_address (0));
+  return __libc_memalign (alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+  count (__builtin_return_address (0));
+  return __libc_memalign (alignment, size);
+}
+
+int
+posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+  void *mem;
+
+  count (__builtin_return_address (0));
+  mem = __libc_memalign (alignment, size);
+  if (!mem)
+    return ENOMEM;
+  *ptr = mem;
+  return 0;
+}
+
+bool
+alloc_counter_supported (void)
+{
+  return true;
+}
+
+bool
+alloc_counter_track_module (const char *module)
+{
+  if (n_tracked_modules == ALLOC_COUNTER_MAX_MODULES)
+    return false;
+  tracked_modules[n_tracked_modules++] = module;
+  return true;
+}
+
+#else
+
+bool
+alloc_counter_supported (void)
+{
+  return false;
+}
+
+bool
+alloc_counter_track_module (const char *module)
+{
+  return false;
+}
+
+#endif
+
+uint64_t
+alloc_counter_get (void)
+{
+  return atomic_load (&allocations);
+}
+
+uint64_t
+alloc_counter_get_module (unsigned index)
+{
+  if (index >= ALLOC_COUNTER_MAX_MODULES)
+    return 0;
+  return atomic_load (&module_allocations[index]);
+}
@@ -0,0 +1,45 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counts the heap allocations of the whole process, by interposing malloc()
+ * and friends. Only available with the GNU C library. */
+bool alloc_counter_supported(void);
+uint64_t alloc_counter_get(void);
+
+#define ALLOC_COUNTER_MAX_MODULES 4
+
+/* Counts, besides, the allocations made on behalf of the shared object whose
+ * path contains @module: the ones where it's the first caller outside GLib,
+ * GStreamer core and base libraries, the codec parsers and the C and C++
+ * runtimes. Up to ALLOC_COUNTER_MAX_MODULES are counted apart, in the order
+ * they're tracked. It unwinds the stack on every allocation, so it's slow. */
+bool alloc_counter_track_module(const char* module);
+uint64_t alloc_counter_get_module(unsigned index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,222 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Heap allocations per picture of the bitstream and slice offsets arrays,
+ * created for each picture as the elements used to, and recycled through
+ * GstVkArrayPool. The slices of the given stream are appended as the
+ * elements do, with a few pictures alive at once. */
+
+#include <deque>
+#include <vector>
+
+#include <glib.h>
+
+#include "alloccounter.h"
+#include "benchutils.h"
+#include "gstvkarraypool.h"
+
+/* as in the elements */
+#define VK_PIC_POOL_SIZE 36
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+/* the slices of each picture */
+typedef std::vector<std::vector<Nal>> Pictures;
+
+static bool is_slice(const guint8* nal)
+{
+    guint type = nal_type(codec, nal);
+
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT)
+        return type < 32;
+    return type >= 1 && type <= 5;
+}
+
+/* first_mb_in_slice == 0 or first_slice_segment_in_pic_flag == 1 */
+static bool is_first_slice(const guint8* nal)
+{
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT)
+        return (nal[2] & 0x80) != 0;
+    return (nal[1] & 0x80) != 0;
+}
+
+static Pictures split_pictures(const guint8* data, gsize size)
+{
+    Pictures pictures;
+
+    for (const Nal& nal : split_annexb(data, size)) {
+        if (nal.size < 3 || !is_slice(nal.data))
+            continue;
+        if (pictures.empty() || is_first_slice(nal.data))
+            pictures.emplace_back();
+        pictures.back().push_back(nal);
+    }
+
+    return pictures;
+}
+
+struct Arrays {
+    GArray* bitstream;
+    GArray* slice_offsets;
+};
+
+class ArrayFactory {
+public:
+    virtual ~ArrayFactory() { }
+    virtual Arrays acquire() = 0;
+    virtual void release(Arrays& arrays) = 0;
+};
+
+class NewArrays : public ArrayFactory {
+public:
+    Arrays acquire() final
+    {
+        return { g_array_new(FALSE, FALSE, 1), g_array_new(FALSE, FALSE, sizeof(uint32_t)) };
+    }
+
+    void release(Arrays& arrays) final
+    {
+        g_array_unref(arrays.bitstream);
+        g_array_unref(arrays.slice_offsets);
+    }
+};
+
+class PooledArrays : public ArrayFactory {
+public:
+    PooledArrays()
+        : m_bitstream(gst_vk_array_pool_new(1, VK_PIC_POOL_SIZE))
+        , m_slice_offsets(gst_vk_array_pool_new(sizeof(uint32_t), VK_PIC_POOL_SIZE))
+    {
+    }
+
+    ~PooledArrays()
+    {
+        gst_vk_array_pool_unref(m_bitstream);
+        gst_vk_array_pool_unref(m_slice_offsets);
+    }
+
+    Arrays acquire() final
+    {
+        return { gst_vk_array_pool_acquire(m_bitstream), gst_vk_array_pool_acquire(m_slice_offsets) };
+    }
+
+    void release(Arrays& arrays) final
+    {
+        gst_vk_array_pool_release(m_bitstream, arrays.bitstream);
+        gst_vk_array_pool_release(m_slice_offsets, arrays.slice_offsets);
+    }
+
+private:
+    GstVkArrayPool* m_bitstream;
+    GstVkArrayPool* m_slice_offsets;
+};
+
+static void fill(const Pictures& pictures, ArrayFactory& factory, guint in_flight,
+    std::deque<Arrays>& alive)
+{
+    static const guint8 start_code[] = { 0x00, 0x00, 0x01 };
+
+    for (const std::vector<Nal>& slices : pictures) {
+        Arrays arrays = factory.acquire();
+        uint32_t offset = 0;
+
+        g_array_append_val(arrays.slice_offsets, offset);
+        for (const Nal& nal : slices) {
+            g_array_append_vals(arrays.bitstream, start_code, sizeof(start_code));
+            g_array_append_vals(arrays.bitstream, nal.data, nal.size);
+            offset = arrays.bitstream->len;
+            g_array_append_val(arrays.slice_offsets, offset);
+        }
+
+        alive.push_back(arrays);
+        if (alive.size() > in_flight) {
+            factory.release(alive.front());
+            alive.pop_front();
+        }
+    }
+}
+
+/* the first copy of the stream fills the pool, the other ones are measured */
+static void run(const char* label, const Pictures& pictures, ArrayFactory& factory,
+    guint repeat, guint in_flight)
+{
+    std::deque<Arrays> alive;
+    uint64_t allocations;
+    gint64 start, elapsed;
+
+    fill(pictures, factory, in_flight, alive);
+
+    allocations = alloc_counter_get();
+    start = g_get_monotonic_time();
+    for (guint i = 1; i < repeat; i++)
+        fill(pictures, factory, in_flight, alive);
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+    allocations = alloc_counter_get() - allocations;
+
+    for (Arrays& arrays : alive)
+        factory.release(arrays);
+
+    if (alloc_counter_supported()) {
+        INFO("%-7s: %.2f allocations per picture, %.3f us per picture", label,
+            (double)allocations / (pictures.size() * (repeat - 1)),
+            (double)elapsed / (pictures.size() * (repeat - 1)));
+    } else {
+        INFO("%-7s: %.3f us per picture", label,
+            (double)elapsed / (pictures.size() * (repeat - 1)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    gint repeat = 20;
+    gint in_flight = 4;
+    Pictures pictures;
+
+    const GOptionEntry entries[] = {
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Times the stream is filled in", NULL },
+        { "in-flight", 'i', 0, G_OPTION_ARG_INT, &in_flight, "Pictures alive at once", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (repeat <= 1 || in_flight < 0 || in_flight >= VK_PIC_POOL_SIZE) {
+        ERR ("Invalid repetitions or pictures in flight.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    pictures = split_pictures (args.data (), args.size ());
+    if (pictures.empty ()) {
+        ERR ("No slices found.");
+        return EXIT_FAILURE;
+    }
+
+    if (!alloc_counter_supported ())
+        INFO ("Heap allocations can't be counted on this platform");
+
+    {
+        NewArrays factory;
+        run ("g_array", pictures, factory, repeat, in_flight);
+    }
+    {
+        PooledArrays factory;
+        run ("pool", pictures, factory, repeat, in_flight);
+    }
+
+    return EXIT_SUCCESS;
+}
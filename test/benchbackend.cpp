@@ -0,0 +1,102 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Compares the per packet latency and the throughput of the harness backend
+ * against the direct one. */
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+static bool run(const guint8* data, gsize size, gsize chunk, VkParserGstBackend backend)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    VkParserGstOptions options = {
+        .eBackend = backend,
+    };
+    std::vector<gint64> latencies;
+    gint64 start, elapsed;
+    int32_t parsed;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    latencies.reserve(size / chunk + 1);
+    start = g_get_monotonic_time();
+
+    for (gsize offset = 0; offset < size; offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+        gint64 before = g_get_monotonic_time();
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            break;
+        }
+
+        latencies.push_back(g_get_monotonic_time() - before);
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    destroy_parser(parser);
+
+    INFO("%-7s: %" G_GUINT64_FORMAT " frames, %.1f frames/s, %.2f MB/s, "
+         "packet latency p50 %" G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT
+         " us, max %" G_GINT64_FORMAT " us",
+        backend == VK_PARSER_GST_BACKEND_DIRECT ? "direct" : "harness",
+        client.decoded(), client.decoded() * 1e6 / elapsed,
+        size / (double)elapsed, percentile(latencies, 0.5),
+        percentile(latencies, 0.99), percentile(latencies, 1.0));
+
+    return client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gint chunk = BUFSIZ;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "chunk", 's', 0, G_OPTION_ARG_INT, &chunk, "Size of each packet", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (chunk <= 0) {
+        ERR ("Invalid chunk size.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    if (!run (args.data (), args.size (), chunk, VK_PARSER_GST_BACKEND_HARNESS))
+        ret = EXIT_FAILURE;
+    if (!run (args.data (), args.size (), chunk, VK_PARSER_GST_BACKEND_DIRECT))
+        ret = EXIT_FAILURE;
+
+    return ret;
+}
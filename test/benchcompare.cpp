@@ -0,0 +1,311 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Runs our parser and the NVIDIA one over the same streams and prints
+ * throughput, per packet latency, peak RSS and callback counts side by side.
+ * Each parser is loaded from its library in a child process, so the peak RSS
+ * is its own and both can export the same symbols. A stream is flagged, and
+ * the benchmark fails, if our parser is slower than the NVIDIA one by more
+ * than the given threshold. */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gmodule.h>
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+#ifdef G_OS_WIN32
+#define VKPARSER_CREATE_VULKAN_PARSER_SYMBOL "CreateVulkanVideoDecodeParser"
+#else
+#define VKPARSER_CREATE_VULKAN_PARSER_SYMBOL "_Z29CreateVulkanVideoDecodeParserPP23VulkanVideoDecodeParser32VkVideoCodecOperationFlagBitsKHRPK21VkExtensionPropertiesPFvPKczEi"
+#endif
+
+typedef bool (* CreateVulkanVideoDecodeParserFunc)(VulkanVideoDecodeParser** ppobj, VkVideoCodecOperationFlagBitsKHR eCompression,
+                                   const VkExtensionProperties* pStdExtensionVersion,
+                                   nvParserLogFuncType pParserLogFunc, int logLevel);
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+struct Result {
+    guint64 frames;
+    guint64 displayed;
+    guint64 sequences;
+    guint64 parameters;
+    gint64 elapsed;
+    gint64 p50;
+    gint64 p99;
+    gint64 max;
+    gint64 peak_rss;
+};
+
+#define RESULT_FORMAT "RESULT %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT \
+    " %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT \
+    " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT
+
+static gint64 peak_rss_kb()
+{
+#ifdef G_OS_UNIX
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return -1;
+}
+
+/* Worker side: parses the stream with the parser in library and prints a
+ * RESULT line for the parent. */
+static bool run(const gchar* library, const guint8* data, gsize size, gsize chunk)
+{
+    static const VkExtensionProperties h264StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_SPEC_VERSION };
+    static const VkExtensionProperties h265StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_SPEC_VERSION };
+    CreateVulkanVideoDecodeParserFunc createParser = nullptr;
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    VkParserInitDecodeParameters params = {
+        .interfaceVersion = NV_VULKAN_VIDEO_PARSER_API_VERSION,
+        .pClient = &client,
+        .bOutOfBandPictureParameters = true,
+    };
+    std::vector<gint64> latencies;
+    gint64 start, elapsed;
+    int32_t parsed;
+    GModule* module;
+    bool ret = true;
+
+    module = g_module_open(library, G_MODULE_BIND_LAZY);
+    if (!module) {
+        ERR("Unable to open the module %s: %s", library, g_module_error());
+        return false;
+    }
+
+    if (!g_module_symbol(module, VKPARSER_CREATE_VULKAN_PARSER_SYMBOL, (gpointer*)&createParser)
+        || !createParser) {
+        ERR("Unable to find the parser in %s: %s", library, g_module_error());
+        g_module_close(module);
+        return false;
+    }
+
+    if (!createParser(&parser, codec,
+            codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? &h265StdExtensionVersion : &h264StdExtensionVersion,
+            (nvParserLogFuncType)printf, 0)) {
+        g_module_close(module);
+        return false;
+    }
+
+    if (parser->Initialize(&params) != VK_SUCCESS) {
+        parser->Release();
+        g_module_close(module);
+        return false;
+    }
+
+    latencies.reserve(size / chunk + 1);
+    start = g_get_monotonic_time();
+
+    for (gsize offset = 0; offset < size; offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+        gint64 before = g_get_monotonic_time();
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            ret = false;
+            break;
+        }
+
+        latencies.push_back(g_get_monotonic_time() - before);
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    parser->Deinitialize();
+    parser->Release();
+    g_module_close(module);
+
+    if (!ret)
+        return false;
+
+    INFO(RESULT_FORMAT, client.decoded(), client.displayed(), client.sequences(),
+        client.parameters(), elapsed, percentile(latencies, 0.5),
+        percentile(latencies, 0.99), percentile(latencies, 1.0), peak_rss_kb());
+
+    return true;
+}
+
+/* Parent side: runs a worker for library and reads back its RESULT line. */
+static bool spawn(const gchar* self, const gchar* library, const gchar* filename,
+    gint chunk, Result* result)
+{
+    gchar chunk_str[16];
+    gchar* output = NULL;
+    gchar* line;
+    gint status;
+    GError* err = NULL;
+    bool ret = false;
+
+    g_snprintf(chunk_str, sizeof(chunk_str), "%d", chunk);
+
+    const gchar* argv[] = {
+        self, "--worker", library, "-s", chunk_str,
+        "-c", codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? "h265" : "h264",
+        filename, NULL
+    };
+
+    if (!g_spawn_sync(NULL, (gchar**)argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL,
+            &output, NULL, &status, &err)) {
+        ERR("Unable to run %s: %s", self, err->message);
+        g_clear_error(&err);
+        return false;
+    }
+
+    if (!g_spawn_check_exit_status(status, &err)) {
+        ERR("%s failed on %s: %s", library, filename, err->message);
+        g_clear_error(&err);
+    } else if ((line = strstr(output, "RESULT ")) == NULL
+        || sscanf(line, RESULT_FORMAT, &result->frames, &result->displayed, &result->sequences,
+               &result->parameters, &result->elapsed, &result->p50, &result->p99,
+               &result->max, &result->peak_rss) != 9) {
+        ERR("No result from %s on %s", library, filename);
+    } else {
+        ret = true;
+    }
+
+    g_free(output);
+    return ret;
+}
+
+static void print_result(const gchar* name, const Result* r, gsize size)
+{
+    gchar rss[32];
+
+    if (r->peak_rss >= 0)
+        g_snprintf(rss, sizeof(rss), "%" G_GINT64_FORMAT " kB", r->peak_rss);
+    else
+        g_strlcpy(rss, "n/a", sizeof(rss));
+
+    INFO("  %-6s %6" G_GUINT64_FORMAT " %9.1f %8.2f %6" G_GINT64_FORMAT " %6" G_GINT64_FORMAT
+         " %6" G_GINT64_FORMAT " %10s   %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT
+         "/%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT,
+        name, r->frames, r->frames * 1e6 / r->elapsed, size / (double)r->elapsed,
+        r->p50, r->p99, r->max, rss, r->sequences, r->parameters, r->frames,
+        r->displayed);
+}
+
+/* Returns false if a parser failed or ours is slower than the threshold
+ * allows. */
+static bool compare(const gchar* self, const gchar* gst, const gchar* nv,
+    const gchar* filename, gint chunk, gdouble threshold)
+{
+    Result ours = { }, theirs = { };
+    GStatBuf st;
+    gsize size;
+    gdouble slowdown;
+
+    if (g_stat(filename, &st) != 0) {
+        ERR("Unable to read %s", filename);
+        return false;
+    }
+    size = st.st_size;
+
+    if (!spawn(self, gst, filename, chunk, &ours) || !spawn(self, nv, filename, chunk, &theirs))
+        return false;
+
+    INFO("%s", filename);
+    INFO("  parser frames   frames/s     MB/s    p50    p99    max   peak RSS   seq/params/decode/display");
+    print_result("gst", &ours, size);
+    print_result("nv", &theirs, size);
+
+    if (ours.frames != theirs.frames || ours.displayed != theirs.displayed)
+        INFO("  callback counts differ");
+
+    slowdown = (ours.elapsed - theirs.elapsed) * 100.0 / theirs.elapsed;
+    if (slowdown > threshold) {
+        ERR("%s: gst parser is %.1f%% slower than nv (threshold %.1f%%)",
+            filename, slowdown, threshold);
+        return false;
+    }
+
+    INFO("  gst parser is %.1f%% %s than nv", ABS(slowdown),
+        slowdown > 0 ? "slower" : "faster");
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    GError *err = NULL;
+    gchar *gst_lib = NULL;
+    gchar *nv_lib = NULL;
+    gchar *worker = NULL;
+    gint chunk = BUFSIZ;
+    gdouble threshold = 10.0;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "chunk", 's', 0, G_OPTION_ARG_INT, &chunk, "Size of each packet", NULL },
+        { "gst", 'g', 0, G_OPTION_ARG_FILENAME, &gst_lib, "Library with the GStreamer based parser", NULL },
+        { "nv", 'n', 0, G_OPTION_ARG_FILENAME, &nv_lib, "Library with the NVIDIA parser", NULL },
+        { "threshold", 't', 0, G_OPTION_ARG_DOUBLE, &threshold, "Allowed slowdown, in percent, against the NVIDIA parser", NULL },
+        { "worker", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &worker, NULL, NULL },
+        { NULL }
+    };
+    // each file is read by the worker comparing it
+    TestArgs args (argc, argv, "BENCHMARK", entries, TEST_SAMPLE_FILENAME);
+
+    if (chunk <= 0) {
+        ERR ("Invalid chunk size.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    if (worker) {
+        gchar *contents = NULL;
+        gsize size;
+
+        if (!g_file_get_contents (args.filename (), &contents, &size, &err)) {
+            ERR ("Unable to read %s: %s", args.filename (), err->message);
+            g_clear_error (&err);
+            ret = EXIT_FAILURE;
+        } else if (!run (worker, (const guint8 *) contents, size, chunk)) {
+            ret = EXIT_FAILURE;
+        }
+
+        g_free (contents);
+    } else if (!gst_lib || !nv_lib) {
+        ERR ("Please provide both parser libraries.");
+        ret = EXIT_FAILURE;
+    } else {
+        for (const gchar* const* filename = args.filenames (); *filename; filename++) {
+            if (!compare (argv[0], gst_lib, nv_lib, *filename, chunk, threshold))
+                ret = EXIT_FAILURE;
+        }
+    }
+
+    g_free (worker);
+    g_free (gst_lib);
+    g_free (nv_lib);
+
+    return ret;
+}
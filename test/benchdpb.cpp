@@ -0,0 +1,237 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Measures the decoded picture buffer bookkeeping done for every picture,
+ * without any parsing: reference lists construction, reference marking and
+ * bumping, with a DPB full of references. */
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "gsth264picture.h"
+#include "gsth265picture.h"
+
+#define MAX_REFS 16
+#define MAX_FRAME_NUM 256
+#define MAX_LONG_TERM_REFS 4
+
+static void clear_list(GArray* list)
+{
+    for (guint i = 0; i < list->len; i++)
+        gst_mini_object_unref(g_array_index(list, GstMiniObject*, i));
+    g_array_set_size(list, 0);
+}
+
+static bool h264_mmco(GstH264Dpb* dpb, GstH264Picture* picture, guint8 op, guint32 diff, guint32 idx)
+{
+    GstH264RefPicMarking marking = { };
+
+    marking.memory_management_control_operation = op;
+    marking.difference_of_pic_nums_minus1 = diff;
+    marking.long_term_frame_idx = idx;
+
+    if (!gst_h264_dpb_perform_memory_management_control_operation(dpb, &marking, picture)) {
+        ERR("MMCO %u failed on frame %u", op, picture->system_frame_number);
+        return false;
+    }
+    return true;
+}
+
+/* Every picture is a reference. With mmco the references are kept under
+ * MAX_REFS by MMCO 1, one out of four is made long term by MMCO 3 and one
+ * out of eight marks itself long term by MMCO 6, otherwise the sliding
+ * window unmarks the oldest. */
+static bool run_h264(guint frames, bool mmco)
+{
+    GstH264Dpb* dpb = gst_h264_dpb_new();
+    GArray* refs = g_array_sized_new(FALSE, TRUE, sizeof(GstH264Picture*), MAX_REFS);
+    guint64 listed = 0, outputs = 0;
+    gint64 start, elapsed;
+    bool ret = true;
+
+    gst_h264_dpb_set_max_num_frames(dpb, MAX_REFS + 1);
+    gst_h264_dpb_set_max_num_reorder_frames(dpb, 2);
+
+    start = g_get_monotonic_time();
+
+    for (guint n = 0; n < frames && ret; n++) {
+        GstH264Picture* picture = gst_h264_picture_new();
+        GstH264Picture* out;
+        gint frame_num = n % MAX_FRAME_NUM;
+
+        picture->system_frame_number = n;
+        picture->frame_num = picture->pic_num = frame_num;
+        picture->pic_order_cnt = picture->top_field_order_cnt = picture->bottom_field_order_cnt = 2 * n;
+        gst_h264_picture_set_reference(picture, GST_H264_PICTURE_REF_SHORT_TERM, FALSE);
+
+        gst_h264_dpb_update_pic_nums(dpb, picture, frame_num, MAX_FRAME_NUM);
+
+        gst_h264_dpb_get_pictures_short_term_ref(dpb, FALSE, FALSE, refs);
+        gst_h264_dpb_get_pictures_long_term_ref(dpb, FALSE, refs);
+        listed += refs->len;
+        clear_list(refs);
+
+        if (mmco) {
+            if (gst_h264_dpb_num_ref_frames(dpb) >= MAX_REFS - 1) {
+                GstH264Picture* oldest = gst_h264_dpb_get_lowest_frame_num_short_ref(dpb);
+
+                if (!oldest) {
+                    ERR("no short term reference on frame %u", n);
+                    ret = false;
+                    break;
+                }
+                ret = h264_mmco(dpb, picture, 1, frame_num - oldest->pic_num - 1, 0);
+                gst_h264_picture_unref(oldest);
+            }
+            if (ret && n % 4 == 0 && n > 0)
+                ret = h264_mmco(dpb, picture, 3, 0, (n / 4) % MAX_LONG_TERM_REFS);
+            if (ret && n % 8 == 5)
+                ret = h264_mmco(dpb, picture, 6, 0, (n / 8) % MAX_LONG_TERM_REFS);
+        } else {
+            while (gst_h264_dpb_num_ref_frames(dpb) >= MAX_REFS) {
+                GstH264Picture* oldest = gst_h264_dpb_get_lowest_frame_num_short_ref(dpb);
+
+                gst_h264_dpb_set_reference(dpb, oldest, GST_H264_PICTURE_REF_NONE, TRUE);
+                gst_h264_picture_unref(oldest);
+            }
+        }
+
+        gst_h264_dpb_delete_unused(dpb);
+        while (gst_h264_dpb_needs_bump(dpb, picture, GST_H264_DPB_BUMP_NORMAL_LATENCY)
+            && (out = gst_h264_dpb_bump(dpb, FALSE))) {
+            outputs++;
+            gst_h264_picture_unref(out);
+        }
+        gst_h264_dpb_add(dpb, picture);
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    g_array_unref(refs);
+    gst_h264_dpb_free(dpb);
+
+    if (ret) {
+        INFO("h264 %-14s: %u frames, %.1f references listed per frame, %.1f ns per frame",
+            mmco ? "mmco" : "sliding window", frames, (double)listed / frames,
+            elapsed * 1000.0 / frames);
+    }
+
+    return ret && outputs > 0 && listed > 0;
+}
+
+/* Hierarchical B alike RPS: the previous MAX_REFS - 1 pictures, one out of
+ * four of them kept long term, the rest unmarked as the decoder does. */
+static bool run_h265(guint frames)
+{
+    GstH265Dpb* dpb = gst_h265_dpb_new();
+    GstH265Picture* rps[MAX_REFS];
+    guint64 found = 0, outputs = 0;
+    gint64 start, elapsed;
+
+    gst_h265_dpb_set_max_num_pics(dpb, MAX_REFS);
+
+    start = g_get_monotonic_time();
+
+    for (guint n = 0; n < frames; n++) {
+        GstH265Picture* picture = gst_h265_picture_new();
+        GstH265Picture* out;
+        GArray* all;
+        guint num_rps = 0;
+
+        picture->system_frame_number = n;
+        picture->pic_order_cnt = n;
+        picture->pic_order_cnt_lsb = n % MAX_FRAME_NUM;
+        picture->output_flag = TRUE;
+
+        for (guint i = 1; i < MAX_REFS && i <= n; i++) {
+            gint poc = n - i;
+            GstH265Picture* ref = poc % 4 == 0
+                ? gst_h265_dpb_get_ref_by_poc(dpb, poc)
+                : gst_h265_dpb_get_short_ref_by_poc(dpb, poc);
+
+            if (!ref)
+                continue;
+            if (poc % 4 == 0)
+                gst_h265_dpb_set_reference(dpb, ref, TRUE, TRUE);
+            rps[num_rps++] = ref;
+        }
+        found += num_rps;
+
+        all = gst_h265_dpb_get_pictures_all(dpb);
+        for (guint i = 0; i < all->len; i++) {
+            GstH265Picture* pic = g_array_index(all, GstH265Picture*, i);
+            bool in_rps = false;
+
+            for (guint j = 0; j < num_rps && !in_rps; j++)
+                in_rps = rps[j] == pic;
+            if (!in_rps)
+                gst_h265_dpb_set_reference(dpb, pic, FALSE, FALSE);
+        }
+        g_array_unref(all);
+
+        for (guint i = 0; i < num_rps; i++)
+            gst_h265_picture_unref(rps[i]);
+
+        gst_h265_dpb_delete_unused(dpb);
+        gst_h265_dpb_add(dpb, picture);
+        while (gst_h265_dpb_needs_bump(dpb, 2, 0, MAX_REFS)
+            && (out = gst_h265_dpb_bump(dpb, FALSE))) {
+            outputs++;
+            gst_h265_picture_unref(out);
+        }
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    gst_h265_dpb_free(dpb);
+
+    INFO("h265 %-14s: %u frames, %.1f references found per frame, %.1f ns per frame",
+        "rps", frames, (double)found / frames, elapsed * 1000.0 / frames);
+
+    return outputs > 0 && found > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gint frames = 100000;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "frames", 'f', 0, G_OPTION_ARG_INT, &frames, "Frames to simulate", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries, TEST_SAMPLE_NONE);
+
+    if (frames <= 0) {
+        ERR ("Invalid number of frames.");
+        return EXIT_FAILURE;
+    }
+
+    gst_init (NULL, NULL);
+
+    if (args.codec () == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
+        if (!run_h265 (frames))
+            ret = EXIT_FAILURE;
+    } else {
+        if (!run_h264 (frames, false))
+            ret = EXIT_FAILURE;
+        if (!run_h264 (frames, true))
+            ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
@@ -0,0 +1,145 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Index benchmark: throughput of BuildVulkanVideoParserIndex() on a file
+ * made by concatenating the given stream up to the requested size, next to
+ * the throughput of just reading that file, and the size of the index. */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "benchutils.h"
+#include "vkvideoparserindex.h"
+
+#define READ_CHUNK (4 << 20)
+
+static bool write_stream(const gchar* path, const guint8* data, gsize size, guint64 target)
+{
+    FILE* file = g_fopen(path, "wb");
+    guint64 written = 0;
+    bool ret = true;
+
+    if (!file)
+        return false;
+
+    while (written < target && ret) {
+        ret = fwrite(data, 1, size, file) == size;
+        written += size;
+    }
+
+    return fclose(file) == 0 && ret;
+}
+
+// the baseline: the file has to be read whole anyway
+static gint64 read_stream(const gchar* path)
+{
+    std::vector<guint8> buf(READ_CHUNK);
+    FILE* file = g_fopen(path, "rb");
+    gint64 start;
+    size_t len;
+
+    if (!file)
+        return -1;
+
+    start = g_get_monotonic_time();
+    do
+        len = fread(buf.data(), 1, buf.size(), file);
+    while (len == buf.size());
+    fclose(file);
+
+    return MAX(g_get_monotonic_time() - start, 1);
+}
+
+int main(int argc, char** argv)
+{
+    GError *err = NULL;
+    gchar *stream_path = NULL, *index_path = NULL;
+    gint megabytes = 256;
+    guint64 stream_size;
+    VkParserGstIndex *index = NULL;
+    gint64 start, elapsed, read_elapsed;
+    GStatBuf st;
+    gint fd;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "megabytes", 'm', 0, G_OPTION_ARG_INT, &megabytes, "Size of the indexed file", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (megabytes <= 0) {
+        ERR ("Invalid size.");
+        return EXIT_FAILURE;
+    }
+
+    fd = g_file_open_tmp ("benchindex-XXXXXX.es", &stream_path, &err);
+    if (fd < 0) {
+        ERR ("Unable to create a file: %s", err->message);
+        g_clear_error (&err);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+    g_close (fd, NULL);
+
+    if (!write_stream (stream_path, args.data (), args.size (), (guint64) megabytes << 20)
+        || g_stat (stream_path, &st) != 0) {
+        ERR ("Unable to write %s", stream_path);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+    stream_size = st.st_size;
+
+    // also brings the file into the page cache for both runs
+    read_elapsed = read_stream (stream_path);
+
+    start = g_get_monotonic_time ();
+    if (!BuildVulkanVideoParserIndex (args.codec (), stream_path, &index)) {
+        ERR ("Unable to index %s", stream_path);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+    elapsed = MAX (g_get_monotonic_time () - start, 1);
+    read_elapsed = MIN (read_elapsed, read_stream (stream_path));
+
+    index_path = g_strconcat (stream_path, ".idx", NULL);
+    if (!SaveVulkanVideoParserIndex (index, index_path) || g_stat (index_path, &st) != 0) {
+        ERR ("Unable to save the index");
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+
+    INFO ("%s %" G_GUINT64_FORMAT " MB: %u entries, %u frames, index of %" G_GUINT64_FORMAT " bytes",
+        args.codecName (), stream_size >> 20, GetVulkanVideoParserIndexEntryCount (index),
+        GetVulkanVideoParserIndexFrameCount (index), (guint64) st.st_size);
+    INFO ("  indexing: %.1f MB/s", stream_size / (double) elapsed);
+    INFO ("  reading:  %.1f MB/s", stream_size / (double) read_elapsed);
+
+bail:
+    DestroyVulkanVideoParserIndex (index);
+    if (index_path)
+        g_remove (index_path);
+    if (stream_path)
+        g_remove (stream_path);
+    g_free (index_path);
+    g_free (stream_path);
+
+    return ret;
+}
@@ -0,0 +1,134 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Parser benchmark: frames/s, MB/s, per packet latency and heap allocations
+ * per frame, with a client that does nothing, on the given stream and on a
+ * synthetic long stream made by concatenating it. With -k only the keyframes
+ * are parsed, so frames/s is the keyframe extraction rate. */
+
+#include <glib.h>
+
+#include "alloccounter.h"
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+static VkParserGstOptions options = { };
+
+static bool run(const guint8* data, gsize size, gsize chunk, guint repeat)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    std::vector<gint64> latencies;
+    uint64_t allocations;
+    gint64 start, elapsed;
+    int32_t parsed;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    latencies.reserve(size / chunk + 1);
+    allocations = alloc_counter_get();
+    start = g_get_monotonic_time();
+
+    for (gsize offset = 0; offset < size; offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+        gint64 before = g_get_monotonic_time();
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            break;
+        }
+
+        latencies.push_back(g_get_monotonic_time() - before);
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+    allocations = alloc_counter_get() - allocations;
+
+    destroy_parser(parser);
+
+    INFO("%s x%-3u: %" G_GUINT64_FORMAT " frames, %.1f frames/s, %.2f MB/s, "
+         "packet latency p50 %" G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT " us",
+        codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? "h265" : "h264",
+        repeat, client.decoded(), client.decoded() * 1e6 / elapsed,
+        size / (double)elapsed, percentile(latencies, 0.5),
+        percentile(latencies, 0.99));
+    if (client.decoded() > 0)
+        INFO("          %.1f us per frame (%s%s)", (double)elapsed / client.decoded(),
+            options.bDecoderFraming ? "decoder framing" : "parse element",
+            options.bKeyframesOnly ? ", keyframes only" : "");
+
+    if (alloc_counter_supported() && client.decoded() > 0)
+        INFO("          %.1f allocations per frame",
+            (double)allocations / client.decoded());
+
+    return client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gint chunk = BUFSIZ;
+    gint repeat = 20;
+    gboolean direct = FALSE;
+    gboolean framing = FALSE;
+    gboolean keyframes = FALSE;
+    gint temporal_layers = 0;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "chunk", 's', 0, G_OPTION_ARG_INT, &chunk, "Size of each packet", NULL },
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Times the stream is concatenated for the long run", NULL },
+        { "direct", 'd', 0, G_OPTION_ARG_NONE, &direct, "Use the direct backend", NULL },
+        { "decoder-framing", 'F', 0, G_OPTION_ARG_NONE, &framing, "Drop the parse element, the decoder frames access units", NULL },
+        { "keyframes-only", 'k', 0, G_OPTION_ARG_NONE, &keyframes, "Skip the pictures which aren't IDR/IRAP", NULL },
+        { "temporal-layers", 't', 0, G_OPTION_ARG_INT, &temporal_layers, "H.265 temporal sub-layers parsed, 0 for all", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (chunk <= 0 || repeat <= 0) {
+        ERR ("Invalid chunk size or repetitions.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+    if (direct)
+      options.eBackend = VK_PARSER_GST_BACKEND_DIRECT;
+    options.bDecoderFraming = framing;
+    options.bKeyframesOnly = keyframes;
+    options.nTemporalLayers = MAX (temporal_layers, 0);
+
+    if (!alloc_counter_supported ())
+        INFO ("Heap allocations can't be counted on this platform");
+
+    if (!run (args.data (), args.size (), chunk, 1))
+        ret = EXIT_FAILURE;
+
+    std::vector<guint8> stream = repeat_bytes (args.data (), args.size (), repeat);
+
+    if (!run (stream.data (), stream.size (), chunk, repeat))
+        ret = EXIT_FAILURE;
+
+    return ret;
+}
@@ -0,0 +1,187 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Probe benchmark: time to get the sequence information of a stream with
+ * ProbeVulkanVideoDecodeParserSequence(), against creating and initializing
+ * a parser and feeding it until BeginSequence() is called. It fails if both
+ * don't agree on the picture geometry, format and DPB size. */
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "VideoParserClient.h"
+#include "vkvideoparserprobe.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+/* Only keeps the first sequence; no picture is ever decoded. */
+class SequenceClient : public VkParserVideoDecodeClient {
+public:
+    int32_t BeginSequence(const VkParserSequenceInfo* info) final
+    {
+        if (!m_started)
+            m_info = *info;
+        m_started = true;
+        return 17;
+    }
+
+    bool AllocPictureBuffer(VkPicIf** pic) final
+    {
+        return false;
+    }
+
+    bool DecodePicture(VkParserPictureData* pic) final
+    {
+        return true;
+    }
+
+    bool UpdatePictureParameters(VkPictureParameters* params, VkSharedBaseObj<VkParserVideoRefCountBase>& shared, uint64_t count) final
+    {
+        shared = PictureParameterSet::create();
+        return true;
+    }
+
+    bool DisplayPicture(VkPicIf* pic, int64_t ts) final
+    {
+        return true;
+    }
+
+    void UnhandledNALU(const uint8_t*, int32_t) final
+    {
+    }
+
+    bool started() const { return m_started; }
+    const VkParserSequenceInfo& info() const { return m_info; }
+
+private:
+    bool m_started = false;
+    VkParserSequenceInfo m_info = { };
+};
+
+static bool parse_until_sequence(const guint8* data, gsize size, gsize chunk, VkParserSequenceInfo* info)
+{
+    VulkanVideoDecodeParser* parser;
+    SequenceClient client;
+    int32_t parsed;
+
+    parser = create_parser(codec, &client);
+    if (!parser)
+        return false;
+
+    for (gsize offset = 0; offset < size && !client.started(); offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+
+        if (!parser->ParseByteStream(&pkt, &parsed))
+            break;
+    }
+
+    destroy_parser(parser);
+
+    if (client.started())
+        *info = client.info();
+    return client.started();
+}
+
+static bool same_sequence(const VkParserSequenceInfo* probed, const VkParserSequenceInfo* parsed)
+{
+    bool same = true;
+
+#define CHECK_FIELD(field)                                                    \
+    if (probed->field != parsed->field) {                                     \
+        ERR("probed " #field " %d, parsed %d", (int)probed->field,            \
+            (int)parsed->field);                                              \
+        same = false;                                                         \
+    }
+
+    CHECK_FIELD(eCodec);
+    CHECK_FIELD(nCodedWidth);
+    CHECK_FIELD(nCodedHeight);
+    CHECK_FIELD(nDisplayWidth);
+    CHECK_FIELD(nDisplayHeight);
+    CHECK_FIELD(nChromaFormat);
+    CHECK_FIELD(uBitDepthLumaMinus8);
+    CHECK_FIELD(uBitDepthChromaMinus8);
+    CHECK_FIELD(nMinNumDecodeSurfaces);
+    CHECK_FIELD(codecProfile);
+    CHECK_FIELD(bProgSeq);
+
+#undef CHECK_FIELD
+
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    gint chunk = BUFSIZ;
+    gint iterations = 100;
+    std::vector<gint64> probe_times, parse_times;
+    VkParserSequenceInfo probed, parsed;
+    gint64 probe_p50, parse_p50;
+
+    const GOptionEntry entries[] = {
+        { "chunk", 's', 0, G_OPTION_ARG_INT, &chunk, "Size of each packet fed to the parser", NULL },
+        { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Times each way is measured", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (chunk <= 0 || iterations <= 0) {
+        ERR ("Invalid chunk size or iterations.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    // the first runs pay for GStreamer's and the plugin's initialization
+    if (!ProbeVulkanVideoDecodeParserSequence (codec, args.data (), args.size (), &probed)
+        || !parse_until_sequence (args.data (), args.size (), chunk, &parsed)) {
+        ERR ("No sequence found in %s", args.filename ());
+        return EXIT_FAILURE;
+    }
+
+    if (!same_sequence (&probed, &parsed))
+        return EXIT_FAILURE;
+
+    for (gint i = 0; i < iterations; i++) {
+        gint64 start = g_get_monotonic_time ();
+
+        ProbeVulkanVideoDecodeParserSequence (codec, args.data (), args.size (), &probed);
+        probe_times.push_back (g_get_monotonic_time () - start);
+
+        start = g_get_monotonic_time ();
+        parse_until_sequence (args.data (), args.size (), chunk, &parsed);
+        parse_times.push_back (g_get_monotonic_time () - start);
+    }
+
+    probe_p50 = percentile (probe_times, 0.5);
+    parse_p50 = percentile (parse_times, 0.5);
+
+    INFO ("%s %ux%u, %u surfaces", args.codecName (),
+        probed.nDisplayWidth, probed.nDisplayHeight, probed.nMinNumDecodeSurfaces);
+    INFO ("  probe:                  p50 %" G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT " us",
+        probe_p50, percentile (probe_times, 0.99));
+    INFO ("  parse until sequence:   p50 %" G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT " us",
+        parse_p50, percentile (parse_times, 0.99));
+    INFO ("  %.1fx faster", (double) parse_p50 / MAX (probe_p50, 1));
+
+    return EXIT_SUCCESS;
+}
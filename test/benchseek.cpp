@@ -0,0 +1,185 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/* Seek benchmark: time to the first packet at a position deep into a file
+ * made by concatenating the given stream, reading from the start against
+ * gst_demuxer_es_seek(). */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "benchutils.h"
+#include "gstdemuxeres.h"
+
+static bool write_stream(const gchar* path, const guint8* data, gsize size, gint repeat)
+{
+    FILE* file = g_fopen(path, "wb");
+    bool ret = true;
+
+    if (!file)
+        return false;
+
+    while (repeat-- > 0 && ret)
+        ret = fwrite(data, 1, size, file) == size;
+
+    return fclose(file) == 0 && ret;
+}
+
+// the pts of the last packet, or -1
+static gint64 get_duration(const gchar* path)
+{
+    GstDemuxerES* demuxer = gst_demuxer_es_new(path);
+    GstDemuxerESPacket* pkt;
+    GstDemuxerESResult result;
+    gint64 last = -1;
+
+    if (!demuxer)
+        return -1;
+
+    while ((result = gst_demuxer_es_read_packet(demuxer, &pkt)) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+        last = MAX(last, pkt->pts);
+        gst_demuxer_es_clear_packet(pkt);
+        if (result == DEMUXER_ES_RESULT_LAST_PACKET)
+            break;
+    }
+
+    gst_demuxer_es_teardown(demuxer);
+    return result == DEMUXER_ES_RESULT_ERROR ? -1 : last;
+}
+
+// reads until the first packet at or after @target, returns its pts
+static gint64 read_to(const gchar* path, gint64 target, gint64* elapsed)
+{
+    gint64 start = g_get_monotonic_time();
+    GstDemuxerES* demuxer = gst_demuxer_es_new(path);
+    GstDemuxerESPacket* pkt;
+    GstDemuxerESResult result;
+    gint64 pts = -1;
+
+    if (!demuxer)
+        return -1;
+
+    while ((result = gst_demuxer_es_read_packet(demuxer, &pkt)) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+        bool done = pkt->pts >= target || result == DEMUXER_ES_RESULT_LAST_PACKET;
+
+        if (done)
+            pts = pkt->pts;
+        gst_demuxer_es_clear_packet(pkt);
+        if (done)
+            break;
+    }
+    *elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    gst_demuxer_es_teardown(demuxer);
+    return pts;
+}
+
+// seeks to the keyframe before @target and reads the packet there
+static gint64 seek_to(const gchar* path, gint64 target, gint64* elapsed)
+{
+    gint64 start = g_get_monotonic_time();
+    GstDemuxerES* demuxer = gst_demuxer_es_new(path);
+    GstDemuxerESPacket* pkt;
+    gint64 position = -1, pts = -1;
+
+    if (!demuxer)
+        return -1;
+
+    if (gst_demuxer_es_seek(demuxer, target, DEMUXER_ES_SEEK_FLAG_NONE, &position)
+        && gst_demuxer_es_read_packet(demuxer, &pkt) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+        pts = pkt->pts;
+        gst_demuxer_es_clear_packet(pkt);
+    }
+    *elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    gst_demuxer_es_teardown(demuxer);
+    return pts == position ? pts : -1;
+}
+
+int main(int argc, char** argv)
+{
+    GError *err = NULL;
+    gchar *stream_path = NULL;
+    gint repeat = 500;
+    gdouble fraction = 0.9;
+    gint64 duration, target, read_pts, seek_pts;
+    gint64 read_elapsed = 0, seek_elapsed = 0;
+    gint fd;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Copies of the stream in the file", NULL },
+        { "position", 'p', 0, G_OPTION_ARG_DOUBLE, &fraction, "Where to seek, as a fraction of the duration", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (repeat <= 0 || fraction < 0 || fraction > 1) {
+        ERR ("Invalid repetitions or position.");
+        return EXIT_FAILURE;
+    }
+
+    fd = g_file_open_tmp ("benchseek-XXXXXX.es", &stream_path, &err);
+    if (fd < 0) {
+        ERR ("Unable to create a file: %s", err->message);
+        g_clear_error (&err);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+    g_close (fd, NULL);
+
+    if (!write_stream (stream_path, args.data (), args.size (), repeat)) {
+        ERR ("Unable to write %s", stream_path);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+
+    // also brings the file into the page cache for both runs
+    duration = get_duration (stream_path);
+    if (duration <= 0) {
+        ERR ("Unable to read the timestamps of %s", stream_path);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+    target = duration * fraction;
+
+    read_pts = read_to (stream_path, target, &read_elapsed);
+    seek_pts = seek_to (stream_path, target, &seek_elapsed);
+    if (read_pts < 0 || seek_pts < 0 || seek_pts > target) {
+        ERR ("Unable to seek to %" G_GINT64_FORMAT ": reached %" G_GINT64_FORMAT,
+            target, seek_pts);
+        ret = EXIT_FAILURE;
+        goto bail;
+    }
+
+    INFO ("%s x%d, seeking to %.3f s of %.3f s", args.filename (), repeat,
+        target / 1e9, duration / 1e9);
+    INFO ("  reading: %.3f ms, first packet at %.3f s", read_elapsed / 1e3, read_pts / 1e9);
+    INFO ("  seeking: %.3f ms, first packet at %.3f s (%.1fx)", seek_elapsed / 1e3,
+        seek_pts / 1e9, read_elapsed / (double) seek_elapsed);
+
+bail:
+    if (stream_path)
+        g_remove (stream_path);
+    g_free (stream_path);
+
+    return ret;
+}
@@ -0,0 +1,151 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/* Measures the throughput of the session manager as the number of
+ * concurrent streams grows, with a fixed number of workers. */
+
+#include <glib.h>
+
+#include <memory>
+#include <vector>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+#include "vkvideoparsersession.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+static void release_byte_stream(void* user_data, const uint8_t* data)
+{
+    // the file contents outlive the sessions
+}
+
+static bool run(VulkanVideoParserSessionManager* manager, const guint8* data, gsize size, gsize chunk, guint streams)
+{
+    std::vector<std::unique_ptr<NullParserClient>> clients;
+    std::vector<VulkanVideoParserSession*> sessions;
+    VkParserGstOptions options = {
+        .bZeroCopyInput = true,
+        .pfnReleaseByteStream = release_byte_stream,
+    };
+    uint64_t decoded = 0;
+    gint64 start, elapsed;
+    bool ret = true;
+
+    for (guint i = 0; i < streams; i++) {
+        VulkanVideoParserSession* session;
+
+        clients.emplace_back(new NullParserClient());
+
+        VkParserInitDecodeParameters params = {
+            .interfaceVersion = NV_VULKAN_VIDEO_PARSER_API_VERSION,
+            .pClient = clients.back().get(),
+            .bOutOfBandPictureParameters = true,
+        };
+
+        if (!CreateVulkanVideoParserSession(manager, codec, &params, &options, &session)) {
+            ERR("failed to create session %u", i);
+            ret = false;
+            break;
+        }
+        sessions.push_back(session);
+    }
+
+    start = g_get_monotonic_time();
+
+    // interleaved, as packets would arrive from independent streams
+    for (gsize offset = 0; ret && offset < size; offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+
+        for (auto session : sessions) {
+            if (!QueueVulkanVideoParserSessionPacket(session, &pkt)) {
+                ERR("failed to queue packet.");
+                ret = false;
+                break;
+            }
+        }
+    }
+
+    for (auto session : sessions) {
+        if (!WaitVulkanVideoParserSession(session)) {
+            ERR("failed to parse bitstream.");
+            ret = false;
+        }
+    }
+
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    for (auto session : sessions)
+        DestroyVulkanVideoParserSession(session);
+
+    for (auto& client : clients) {
+        if (client->decoded() == 0)
+            ret = false;
+        decoded += client->decoded();
+    }
+
+    INFO("%3u streams: %" G_GUINT64_FORMAT " frames, %.1f frames/s, "
+         "%.1f frames/s per stream, %.2f MB/s",
+        streams, decoded, decoded * 1e6 / elapsed,
+        decoded * 1e6 / elapsed / streams, size * (double)streams / elapsed);
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    gint chunk = BUFSIZ;
+    gint workers = 0;
+    gint max_streams = 32;
+    gint ret = EXIT_SUCCESS;
+    VulkanVideoParserSessionManager* manager;
+
+    const GOptionEntry entries[] = {
+        { "chunk", 's', 0, G_OPTION_ARG_INT, &chunk, "Size of each packet", NULL },
+        { "workers", 'w', 0, G_OPTION_ARG_INT, &workers, "Number of worker threads (0 = one per CPU)", NULL },
+        { "streams", 'n', 0, G_OPTION_ARG_INT, &max_streams, "Maximum number of concurrent streams", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (chunk <= 0 || workers < 0 || max_streams <= 0) {
+        ERR ("Invalid chunk size, workers or streams.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    if (!CreateVulkanVideoParserSessionManager(&manager, workers)) {
+        ERR ("Unable to create the session manager");
+        return EXIT_FAILURE;
+    }
+
+    for (gint streams = 1; streams <= max_streams; streams *= 2) {
+        if (!run (manager, args.data (), args.size (), chunk, streams))
+            ret = EXIT_FAILURE;
+    }
+
+    DestroyVulkanVideoParserSessionManager(manager);
+
+    return ret;
+}
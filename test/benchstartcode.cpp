@@ -0,0 +1,159 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Measures the Annex B start code scanners on a sample file and on a
+ * synthetic 100 Mbps intra-only stream, whose large slices are the worst
+ * case for the NAL splitting. */
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "gststartcode.h"
+
+/* 100 Mbps at 30 fps */
+#define SYNTHETIC_FRAME_SIZE (100 * 1000 * 1000 / 8 / 30)
+#define SYNTHETIC_SLICES 4
+
+struct Scanner {
+    const char* name;
+    GstCodecSimd simd;
+};
+
+static const Scanner scanners[] = {
+    { "scalar", GST_CODEC_SIMD_NONE },
+    { "sse2", GST_CODEC_SIMD_SSE2 },
+    { "avx2", GST_CODEC_SIMD_AVX2 },
+};
+
+/* Random slice payloads, with emulation prevention bytes so there are no
+ * start codes but the ones delimiting the NAL units. */
+static GByteArray* synthetic_stream(guint frames)
+{
+    GByteArray* stream = g_byte_array_sized_new(frames * (SYNTHETIC_FRAME_SIZE + 64));
+    GRand* rand = g_rand_new_with_seed(1);
+    static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+
+    for (guint i = 0; i < frames; i++) {
+        for (guint j = 0; j < SYNTHETIC_SLICES; j++) {
+            guint zeros = 0;
+
+            g_byte_array_append(stream, start_code, sizeof(start_code));
+            for (guint k = 0; k < SYNTHETIC_FRAME_SIZE / SYNTHETIC_SLICES; k++) {
+                /* skewed towards zero, like entropy coded data isn't */
+                guint8 byte = g_rand_int_range(rand, 0, 8) == 0 ? 0 : g_rand_int_range(rand, 0, 256);
+
+                if (zeros >= 2 && byte <= 3) {
+                    static const guint8 epb = 0x03;
+                    g_byte_array_append(stream, &epb, 1);
+                    zeros = 0;
+                }
+                g_byte_array_append(stream, &byte, 1);
+                zeros = byte == 0 ? zeros + 1 : 0;
+            }
+            /* rbsp trailing bits */
+            if (zeros > 0) {
+                static const guint8 stop = 0x80;
+                g_byte_array_append(stream, &stop, 1);
+            }
+        }
+    }
+
+    g_rand_free(rand);
+    return stream;
+}
+
+static guint64 count_start_codes(GstCodecStartCodeFunc func, const guint8* data, gsize size)
+{
+    guint64 count = 0;
+    gsize offset = 0;
+
+    while (offset < size) {
+        gssize found = func(data + offset, size - offset);
+
+        if (found < 0)
+            break;
+        count++;
+        offset += found + 3;
+    }
+
+    return count;
+}
+
+static bool run(const char* label, const guint8* data, gsize size, gint repeat)
+{
+    guint64 expected = 0;
+
+    for (const Scanner& scanner : scanners) {
+        GstCodecStartCodeFunc func = gst_codec_get_start_code_func(scanner.simd);
+        guint64 count = 0;
+        gint64 start, elapsed;
+
+        if (!func) {
+            INFO("%-9s %-6s: not supported", label, scanner.name);
+            continue;
+        }
+
+        start = g_get_monotonic_time();
+        for (gint i = 0; i < repeat; i++)
+            count = count_start_codes(func, data, size);
+        elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+        if (scanner.simd == GST_CODEC_SIMD_NONE) {
+            expected = count;
+        } else if (count != expected) {
+            ERR("%s %s: %" G_GUINT64_FORMAT " start codes, expected %" G_GUINT64_FORMAT,
+                label, scanner.name, count, expected);
+            return false;
+        }
+
+        INFO("%-9s %-6s: %" G_GUINT64_FORMAT " start codes, %.2f GB/s", label,
+            scanner.name, count, (double)size * repeat / elapsed / 1000.0);
+    }
+
+    return expected > 0;
+}
+
+int main(int argc, char** argv)
+{
+    GByteArray *synthetic;
+    gint repeat = 20;
+    gint frames = 60;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Times each buffer is scanned", NULL },
+        { "frames", 'f', 0, G_OPTION_ARG_INT, &frames, "Frames of the synthetic stream", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "BENCHMARK", entries);
+
+    if (repeat <= 0 || frames <= 0) {
+        ERR ("Invalid repetitions or frames.");
+        return EXIT_FAILURE;
+    }
+
+    if (!run ("sample", args.data (), args.size (), repeat))
+        ret = EXIT_FAILURE;
+
+    synthetic = synthetic_stream (frames);
+    if (!run ("synthetic", synthetic->data, synthetic->len, repeat))
+        ret = EXIT_FAILURE;
+
+    g_byte_array_unref (synthetic);
+
+    return ret;
+}
@@ -0,0 +1,290 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "utils.h"
+#include "vkvideodecodeparser.h"
+
+// meson's exit code for skipped tests
+#define EXIT_SKIP 77
+
+static inline gint64 percentile(std::vector<gint64>& samples, double p)
+{
+    size_t idx;
+
+    if (samples.empty())
+        return 0;
+
+    idx = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx];
+}
+
+// What a test needs of the file named in its command line
+enum TestSample {
+    TEST_SAMPLE_CONTENTS, // read whole
+    TEST_SAMPLE_FILENAME, // opened by the test itself, ie with the demuxer
+    TEST_SAMPLE_NONE,
+};
+
+// The command line of the tests and benchmarks: -c for the codec, the
+// program's own options and the sample. It exits with an error message if
+// they can't be parsed or the sample can't be read.
+class TestArgs {
+public:
+    TestArgs(int argc, char** argv, const char* parameter, const GOptionEntry* entries,
+        TestSample sample = TEST_SAMPLE_CONTENTS)
+    {
+        GOptionContext* ctx;
+        GError* err = NULL;
+        gchar* codec_str = NULL;
+        const GOptionEntry common[] = {
+            { "codec", 'c', 0, G_OPTION_ARG_STRING, &codec_str, "Codec to use ie h265", NULL },
+            { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &m_filenames, NULL },
+            { NULL }
+        };
+
+        g_set_prgname(argv[0]);
+
+        ctx = g_option_context_new(parameter);
+        g_option_context_add_main_entries(ctx, common, NULL);
+        if (entries)
+            g_option_context_add_main_entries(ctx, entries, NULL);
+
+        if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+            ERR("Error initializing: %s", err->message);
+            g_option_context_free(ctx);
+            g_clear_error(&err);
+            exit(EXIT_FAILURE);
+        }
+
+        g_option_context_free(ctx);
+
+        if (codec_str && strcmp(codec_str, "h265") == 0)
+            m_codec = VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT;
+        g_free(codec_str);
+
+        if (sample == TEST_SAMPLE_NONE)
+            return;
+
+        if (!(m_filenames != NULL && *m_filenames != NULL)) {
+            ERR("Please provide a filename.");
+            exit(EXIT_FAILURE);
+        }
+
+        if (sample == TEST_SAMPLE_FILENAME)
+            return;
+
+        if (!g_file_get_contents(m_filenames[0], &m_contents, &m_size, &err)) {
+            ERR("Unable to read %s: %s", m_filenames[0], err->message);
+            g_clear_error(&err);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ~TestArgs()
+    {
+        g_free(m_contents);
+        g_strfreev(m_filenames);
+    }
+
+    VkVideoCodecOperationFlagBitsKHR codec() const { return m_codec; }
+    const char* codecName() const
+    {
+        return m_codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? "h265" : "h264";
+    }
+    const gchar* filename() const { return m_filenames ? m_filenames[0] : NULL; }
+    // NULL terminated, all the files named in the command line
+    const gchar* const* filenames() const { return m_filenames; }
+    const guint8* data() const { return reinterpret_cast<const guint8*>(m_contents); }
+    gsize size() const { return m_size; }
+
+private:
+    VkVideoCodecOperationFlagBitsKHR m_codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+    gchar** m_filenames = NULL;
+    gchar* m_contents = NULL;
+    gsize m_size = 0;
+};
+
+// Returns a parser initialized for @client, with @options if not NULL and
+// the out of band parameters in @seq_info if not NULL, or NULL.
+static inline VulkanVideoDecodeParser* create_parser(VkVideoCodecOperationFlagBitsKHR codec,
+    VkParserVideoDecodeClient* client, const VkParserGstOptions* options = nullptr,
+    VkParserSequenceInfo* seq_info = nullptr)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    VkParserInitDecodeParameters params = {
+        .interfaceVersion = NV_VULKAN_VIDEO_PARSER_API_VERSION,
+        .pClient = client,
+        .pExternalSeqInfo = seq_info,
+        .bOutOfBandPictureParameters = true,
+    };
+
+    if (!CreateVulkanVideoDecodeParser(&parser, codec, nullptr, (nvParserLogFuncType)printf, 0))
+        return nullptr;
+
+    if ((options && !SetVulkanVideoDecodeParserOptions(parser, options))
+        || parser->Initialize(&params) != VK_SUCCESS) {
+        parser->Release();
+        return nullptr;
+    }
+
+    return parser;
+}
+
+static inline void destroy_parser(VulkanVideoDecodeParser* parser)
+{
+    parser->Deinitialize();
+    parser->Release();
+}
+
+// Feeds @size bytes in packets of at most @chunk bytes, the last one with
+// bEOS set. Returns false as soon as one of them fails.
+static inline bool parse_bytes(VulkanVideoDecodeParser* parser, const guint8* data, gsize size,
+    gsize chunk = G_MAXSIZE)
+{
+    int32_t parsed;
+
+    for (gsize offset = 0; offset < size; offset += chunk) {
+        gsize len = MIN(chunk, size - offset);
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(len),
+            .bEOS = offset + len == size,
+        };
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// @repeat copies of @data back to back; every copy of a sample starts with
+// its parameter sets and an IDR.
+static inline std::vector<guint8> repeat_bytes(const guint8* data, gsize size, guint repeat)
+{
+    std::vector<guint8> out;
+
+    out.reserve(size * repeat);
+    for (guint i = 0; i < repeat; i++)
+        out.insert(out.end(), data, data + size);
+
+    return out;
+}
+
+// FNV-1a, to compare bitstreams
+static inline uint32_t hash_bytes(const uint8_t* data, size_t len, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+// A NAL unit of an Annex B byte stream, without its start code and the
+// trailing zero bytes.
+struct Nal {
+    const guint8* data;
+    gsize size;
+};
+
+static inline std::vector<Nal> split_annexb(const guint8* data, gsize size)
+{
+    std::vector<Nal> nals;
+    gsize start = 0;
+
+    for (gsize i = 0; i + 2 < size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start > 0) {
+                gsize end = i;
+                while (end > start && data[end - 1] == 0)
+                    end--;
+                nals.push_back({ data + start, end - start });
+            }
+            start = i + 3;
+            i += 2;
+        }
+    }
+    if (start > 0 && start < size)
+        nals.push_back({ data + start, size - start });
+
+    return nals;
+}
+
+static inline guint nal_type(VkVideoCodecOperationFlagBitsKHR codec, const guint8* nal)
+{
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT)
+        return (nal[0] >> 1) & 0x3f;
+    return nal[0] & 0x1f;
+}
+
+static inline bool is_parameter_set(VkVideoCodecOperationFlagBitsKHR codec, guint type)
+{
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT)
+        return type >= 32 && type <= 34;
+    return type == 7 || type == 8;
+}
+
+// The access units of an Annex B byte stream, with the start codes of their
+// NAL units. One begins at the first access unit delimiter, parameter set,
+// SEI or slice of a picture after the slices of the previous one.
+static inline std::vector<Nal> split_access_units(VkVideoCodecOperationFlagBitsKHR codec,
+    const guint8* data, gsize size)
+{
+    std::vector<Nal> aus;
+    gsize start = 0;
+    bool slices = false;
+
+    for (const Nal& nal : split_annexb(data, size)) {
+        guint type = nal_type(codec, nal.data);
+        gsize offset = nal.data - 3 - data;
+        bool vcl, first;
+
+        if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
+            vcl = type < 32;
+            // first_slice_segment_in_pic_flag
+            first = vcl ? nal.size > 2 && (nal.data[2] & 0x80)
+                        : (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44);
+        } else {
+            vcl = type >= 1 && type <= 5;
+            // first_mb_in_slice == 0
+            first = vcl ? nal.size > 1 && (nal.data[1] & 0x80)
+                        : (type >= 6 && type <= 9) || (type >= 14 && type <= 18);
+        }
+
+        if (first && slices) {
+            aus.push_back({ data + start, offset - start });
+            start = offset;
+            slices = false;
+        }
+        slices |= vcl;
+    }
+    if (start < size)
+        aus.push_back({ data + start, size - start });
+
+    return aus;
+}
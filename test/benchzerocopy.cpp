@@ -0,0 +1,140 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Compares the input copy done by ParseByteStream() against the zero-copy
+ * mode, which wraps the caller memory, with the bytes the parser counts as
+ * copied in both. Each packet is one access unit with bEOP set, so the
+ * parse element takes it whole instead of merging the packets it spans in
+ * its adapter, a copy the parser doesn't count. */
+
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+struct ReleaseCounter {
+    uint64_t packets = 0;
+};
+
+static void release_byte_stream(void* user_data, const uint8_t* data)
+{
+    static_cast<ReleaseCounter*>(user_data)->packets++;
+}
+
+static bool run(const std::vector<Nal>& aus, bool zero_copy, uint64_t* copied)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    ReleaseCounter released;
+    VkParserGstOptions options = {
+        .bZeroCopyInput = zero_copy,
+        .pfnReleaseByteStream = release_byte_stream,
+        .pReleaseUserData = &released,
+        .bCollectStats = true,
+    };
+    VkParserGstStats stats = { };
+    uint64_t packets = 0;
+    gint64 start, elapsed;
+    int32_t parsed;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    start = g_get_monotonic_time();
+
+    for (const Nal& au : aus) {
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = au.data,
+            .nDataLength = static_cast<int32_t>(au.size),
+            .bEOS = &au == &aus.back(),
+            .bEOP = true,
+        };
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            break;
+        }
+        if (parsed != pkt.nDataLength) {
+            ERR("%d of %d bytes parsed.", parsed, pkt.nDataLength);
+            break;
+        }
+
+        packets++;
+    }
+
+    if (!GetVulkanVideoDecodeParserStats(parser, &stats)) {
+        ERR("failed to get the parser stats.");
+        parser->Deinitialize();
+        parser->Release();
+        return false;
+    }
+    *copied = stats.bytesCopied;
+
+    parser->Deinitialize();
+    elapsed = g_get_monotonic_time() - start;
+    parser->Release();
+
+    if (packets != aus.size())
+        return false;
+
+    if (zero_copy && released.packets != packets) {
+        ERR("%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " packets released",
+            released.packets, packets);
+        return false;
+    }
+
+    INFO("%-9s: %" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT
+         " bytes copied (%.1f per frame), %.3f ms",
+        zero_copy ? "zero-copy" : "memdup", client.decoded(), stats.bytesCopied,
+        client.decoded() ? (double)stats.bytesCopied / client.decoded() : 0.0,
+        elapsed / 1000.0);
+
+    return client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t memdup_copied = 0, zero_copy_copied = 0;
+    std::vector<Nal> aus;
+    gint ret = EXIT_SUCCESS;
+    TestArgs args (argc, argv, "BENCHMARK", NULL);
+
+    codec = args.codec ();
+
+    aus = split_access_units (codec, args.data (), args.size ());
+    if (aus.empty ()) {
+        ERR ("No access units found.");
+        return EXIT_FAILURE;
+    }
+
+    if (!run (aus, false, &memdup_copied))
+        ret = EXIT_FAILURE;
+    if (!run (aus, true, &zero_copy_copied))
+        ret = EXIT_FAILURE;
+
+    if (ret == EXIT_SUCCESS) {
+        INFO ("zero-copy saves %" G_GINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes copied",
+            (gint64) (memdup_copied - zero_copy_copied), memdup_copied);
+    }
+
+    return ret;
+}
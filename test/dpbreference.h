@@ -0,0 +1,152 @@
+/* GStreamer
+ * Copyright (C) 2019 Seungha Yang <seungha.yang@navercorp.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The decoded picture buffers as they were before being turned into
+ * reference masks: a plain list of pictures walked by every query. Only
+ * used to check the current implementation behaves the same. */
+
+#pragma once
+
+#include "gsth264picture.h"
+#include "gsth265picture.h"
+
+G_BEGIN_DECLS
+
+typedef struct _RefH264Dpb RefH264Dpb;
+typedef struct _RefH265Dpb RefH265Dpb;
+
+RefH264Dpb *     ref_h264_dpb_new (void);
+
+void             ref_h264_dpb_free (RefH264Dpb * dpb);
+
+void             ref_h264_dpb_set_max_num_frames (RefH264Dpb * dpb,
+                                                  gint max_num_frames);
+
+void             ref_h264_dpb_set_interlaced (RefH264Dpb * dpb,
+                                              gboolean interlaced);
+
+void             ref_h264_dpb_set_max_num_reorder_frames (RefH264Dpb * dpb,
+                                                          guint32 max_num_reorder_frames);
+
+void             ref_h264_dpb_clear (RefH264Dpb * dpb);
+
+void             ref_h264_dpb_add (RefH264Dpb * dpb,
+                                   GstH264Picture * picture);
+
+void             ref_h264_dpb_delete_unused (RefH264Dpb * dpb);
+
+gint             ref_h264_dpb_num_ref_frames (RefH264Dpb * dpb);
+
+void             ref_h264_dpb_mark_all_non_ref (RefH264Dpb * dpb);
+
+GstH264Picture * ref_h264_dpb_get_short_ref_by_pic_num (RefH264Dpb * dpb,
+                                                        gint pic_num);
+
+GstH264Picture * ref_h264_dpb_get_long_ref_by_long_term_pic_num (RefH264Dpb * dpb,
+                                                                 gint long_term_pic_num);
+
+GstH264Picture * ref_h264_dpb_get_lowest_frame_num_short_ref (RefH264Dpb * dpb);
+
+void             ref_h264_dpb_get_pictures_short_term_ref (RefH264Dpb * dpb,
+                                                           gboolean include_non_existing,
+                                                           gboolean include_second_field,
+                                                           GArray * out);
+
+void             ref_h264_dpb_get_pictures_long_term_ref (RefH264Dpb * dpb,
+                                                          gboolean include_second_field,
+                                                          GArray * out);
+
+GArray *         ref_h264_dpb_get_pictures_all (RefH264Dpb * dpb);
+
+gint             ref_h264_dpb_get_size (RefH264Dpb * dpb);
+
+GstH264Picture * ref_h264_dpb_get_picture (RefH264Dpb * dpb,
+                                           guint32 system_frame_number);
+
+gboolean         ref_h264_dpb_has_empty_frame_buffer (RefH264Dpb * dpb);
+
+gboolean         ref_h264_dpb_needs_bump (RefH264Dpb * dpb,
+                                          GstH264Picture * to_insert,
+                                          GstH264DpbBumpMode latency_mode);
+
+GstH264Picture * ref_h264_dpb_bump (RefH264Dpb * dpb,
+                                    gboolean drain);
+
+void             ref_h264_dpb_set_last_output (RefH264Dpb * dpb,
+                                               GstH264Picture * picture);
+
+gboolean         ref_h264_dpb_perform_memory_management_control_operation (RefH264Dpb * dpb,
+                                                                           GstH264RefPicMarking * ref_pic_marking,
+                                                                           GstH264Picture * picture);
+
+void             ref_h264_dpb_update_pic_nums (RefH264Dpb * dpb,
+                                               GstH264Picture * current_picture,
+                                               gint frame_num,
+                                               gint max_frame_num);
+
+void             ref_h264_picture_set_reference (GstH264Picture * picture,
+                                                 GstH264PictureReference reference,
+                                                 gboolean other_field);
+
+RefH265Dpb *     ref_h265_dpb_new (void);
+
+void             ref_h265_dpb_free (RefH265Dpb * dpb);
+
+void             ref_h265_dpb_set_max_num_pics (RefH265Dpb * dpb,
+                                                gint max_num_pics);
+
+void             ref_h265_dpb_clear (RefH265Dpb * dpb);
+
+void             ref_h265_dpb_add (RefH265Dpb * dpb,
+                                   GstH265Picture * picture);
+
+void             ref_h265_dpb_delete_unused (RefH265Dpb * dpb);
+
+gint             ref_h265_dpb_num_ref_pictures (RefH265Dpb * dpb);
+
+void             ref_h265_dpb_mark_all_non_ref (RefH265Dpb * dpb);
+
+GstH265Picture * ref_h265_dpb_get_ref_by_poc (RefH265Dpb * dpb,
+                                              gint poc);
+
+GstH265Picture * ref_h265_dpb_get_ref_by_poc_lsb (RefH265Dpb * dpb,
+                                                  gint poc_lsb);
+
+GstH265Picture * ref_h265_dpb_get_short_ref_by_poc (RefH265Dpb * dpb,
+                                                    gint poc);
+
+GstH265Picture * ref_h265_dpb_get_long_ref_by_poc (RefH265Dpb * dpb,
+                                                   gint poc);
+
+GArray *         ref_h265_dpb_get_pictures_all (RefH265Dpb * dpb);
+
+gint             ref_h265_dpb_get_size (RefH265Dpb * dpb);
+
+GstH265Picture * ref_h265_dpb_get_picture (RefH265Dpb * dpb,
+                                           guint32 system_frame_number);
+
+gboolean         ref_h265_dpb_needs_bump (RefH265Dpb * dpb,
+                                          guint max_num_reorder_pics,
+                                          guint max_latency_increase,
+                                          guint max_dec_pic_buffering);
+
+GstH265Picture * ref_h265_dpb_bump (RefH265Dpb * dpb,
+                                    gboolean drain);
+
+G_END_DECLS
@@ -0,0 +1,189 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Writes the slices in memory from a client allocator, standing for a
+ * mapped upload buffer, and checks the client gets the same bitstreams,
+ * aligned, as when the parser uses its own memory. */
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+/* minBitstreamBufferOffsetAlignment and minBitstreamBufferSizeAlignment of
+ * a usual decode profile */
+#define UPLOAD_ALIGNMENT 256
+
+static uintptr_t round_up(uintptr_t value)
+{
+    return (value + UPLOAD_ALIGNMENT - 1) & ~static_cast<uintptr_t>(UPLOAD_ALIGNMENT - 1);
+}
+
+class UploadAllocator {
+public:
+    static uint8_t* Allocate(void* user_data, size_t size, size_t* allocated)
+    {
+        UploadAllocator* self = static_cast<UploadAllocator*>(user_data);
+        size_t aligned_size = round_up(size);
+        std::unique_ptr<uint8_t[]> block(new uint8_t[aligned_size + UPLOAD_ALIGNMENT]);
+        uint8_t* data = reinterpret_cast<uint8_t*>(round_up(reinterpret_cast<uintptr_t>(block.get())));
+
+        self->m_blocks[data] = { std::move(block), aligned_size };
+        self->m_allocations++;
+        *allocated = aligned_size;
+        return data;
+    }
+
+    static void Release(void* user_data, uint8_t* data)
+    {
+        UploadAllocator* self = static_cast<UploadAllocator*>(user_data);
+
+        self->m_blocks.erase(data);
+        self->m_released++;
+    }
+
+    /* called by the client once the picture is decoded */
+    bool Consume(const uint8_t* data, size_t len)
+    {
+        auto block = m_blocks.find(const_cast<uint8_t*>(data));
+
+        if (block == m_blocks.end() || len > block->second.size)
+            return false;
+        m_blocks.erase(block);
+        return true;
+    }
+
+    uint64_t allocations() const { return m_allocations; }
+    uint64_t released() const { return m_released; }
+    size_t outstanding() const { return m_blocks.size(); }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> storage;
+        size_t size;
+    };
+
+    std::map<uint8_t*, Block> m_blocks;
+    uint64_t m_allocations = 0;
+    uint64_t m_released = 0;
+};
+
+class BitstreamClient : public NullParserClient {
+public:
+    explicit BitstreamClient(UploadAllocator* allocator)
+        : m_allocator(allocator)
+    {
+    }
+
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        const uint8_t* data = pic->pBitstreamData;
+
+        m_hashes.push_back(hash_bytes(data, pic->nBitstreamDataLen));
+
+        if (m_allocator && pic->nBitstreamDataLen > 0) {
+            if (reinterpret_cast<uintptr_t>(data) % UPLOAD_ALIGNMENT != 0
+                || !m_allocator->Consume(data, pic->nBitstreamDataLen))
+                m_foreign++;
+        }
+
+        return NullParserClient::DecodePicture(pic);
+    }
+
+    const std::vector<uint32_t>& hashes() const { return m_hashes; }
+    uint64_t foreign() const { return m_foreign; }
+
+private:
+    UploadAllocator* m_allocator;
+    std::vector<uint32_t> m_hashes;
+    uint64_t m_foreign = 0;
+};
+
+static bool run(const guint8* data, gsize size, bool direct, UploadAllocator* allocator,
+    std::vector<uint32_t>& hashes)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    BitstreamClient client(allocator);
+    VkParserGstOptions options = {
+        .eBackend = direct ? VK_PARSER_GST_BACKEND_DIRECT : VK_PARSER_GST_BACKEND_HARNESS,
+    };
+    bool ret;
+
+    if (allocator) {
+        options.pfnAllocateBitstream = UploadAllocator::Allocate;
+        options.pfnReleaseBitstream = UploadAllocator::Release;
+        options.pBitstreamUserData = allocator;
+    }
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, data, size, BUFSIZ);
+
+    destroy_parser(parser);
+
+    if (allocator) {
+        INFO("%" G_GUINT64_FORMAT " pictures, %" G_GUINT64_FORMAT " allocations, %"
+             G_GUINT64_FORMAT " released by the parser",
+            client.decoded(), allocator->allocations(), allocator->released());
+        if (client.foreign() > 0) {
+            ERR("%" G_GUINT64_FORMAT " bitstreams not in client memory", client.foreign());
+            ret = false;
+        }
+        if (allocator->outstanding() > 0) {
+            ERR("%zu allocations leaked", allocator->outstanding());
+            ret = false;
+        }
+    }
+
+    hashes = client.hashes();
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gboolean direct = FALSE;
+    UploadAllocator allocator;
+    std::vector<uint32_t> expected, hashes;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "direct", 'd', 0, G_OPTION_ARG_NONE, &direct, "Use the direct backend", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries);
+
+    codec = args.codec ();
+
+    if (!run (args.data (), args.size (), direct, nullptr, expected)
+        || !run (args.data (), args.size (), direct, &allocator, hashes))
+        ret = EXIT_FAILURE;
+
+    if (ret == EXIT_SUCCESS && hashes != expected) {
+        ERR ("bitstreams differ from the ones in the parser memory");
+        ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
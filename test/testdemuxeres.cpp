@@ -16,6 +16,7 @@
  */
 
 #include <gst/gst.h>
+#include <glib/gstdio.h>
 #include "utils.h"
 #include "gstdemuxeres.h"
 #include "stdlib.h"
@@ -37,14 +38,207 @@ print_video_info (GstDemuxerEStream * stream)
   INFO ("");
 }
 
+static gboolean seek = FALSE;
+static gboolean seek_mid = FALSE;
+
+/* copies of the stream in the file seeked into, each one starting with a
+ * keyframe */
+#define SEEK_MID_COPIES 4
+
+static GstDemuxerESResult
+read_packets (GstDemuxerES * demuxer, gint * count, gint64 * first_pts)
+{
+  GstDemuxerESPacket *pkt;
+  GstDemuxerESResult result;
+
+  *count = 0;
+  while ((result =
+          gst_demuxer_es_read_packet (demuxer,
+              &pkt)) <= DEMUXER_ES_RESULT_NO_PACKET) {
+    if (result <= DEMUXER_ES_RESULT_LAST_PACKET) {
+      INFO ("A %s packet of type %s stream_id %d with size %lu.",
+      (result == DEMUXER_ES_RESULT_LAST_PACKET)? "last":"new",
+          gst_demuxer_es_get_stream_type_name(pkt->stream_type), pkt->stream_id, pkt->data_size);
+      if (*count == 0)
+        *first_pts = pkt->pts;
+      (*count)++;
+      gst_demuxer_es_clear_packet (pkt);
+      if(result == DEMUXER_ES_RESULT_LAST_PACKET)
+        break;
+    } else {
+      ERR ("No packet available.");
+    }
+  }
+
+  return result;
+}
+
+/* seeking back to the start reads the same packets again */
+static int
+check_seek (GstDemuxerES * demuxer, gint count, gint64 first_pts)
+{
+  GstDemuxerESResult result;
+  gint64 position = -1;
+  gint64 pts = -1;
+  gint again;
+
+  if (!gst_demuxer_es_seek (demuxer, 0, DEMUXER_ES_SEEK_FLAG_NONE, &position)) {
+    ERR ("Unable to seek to the start.");
+    return EXIT_FAILURE;
+  }
+
+  result = read_packets (demuxer, &again, &pts);
+  if (result == DEMUXER_ES_RESULT_ERROR) {
+    ERR ("An error occured during the read of frame after seeking.");
+    return EXIT_FAILURE;
+  }
+
+  if (again != count || position != first_pts || pts != first_pts) {
+    ERR ("After seeking %d packet(s) from %" G_GINT64_FORMAT " instead of %d from %"
+        G_GINT64_FORMAT, again, position, count, first_pts);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static gboolean
+write_copies (const gchar * filename, gchar ** path)
+{
+  GError *err = NULL;
+  gchar *contents = NULL;
+  gsize size;
+  GString *copies;
+  gboolean ret;
+  gint fd, i;
+
+  if (!g_file_get_contents (filename, &contents, &size, &err)) {
+    ERR ("Unable to read %s: %s", filename, err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  fd = g_file_open_tmp ("testdemuxeres-XXXXXX.es", path, &err);
+  if (fd < 0) {
+    ERR ("Unable to create a file: %s", err->message);
+    g_clear_error (&err);
+    g_free (contents);
+    return FALSE;
+  }
+  g_close (fd, NULL);
+
+  copies = g_string_sized_new (size * SEEK_MID_COPIES);
+  for (i = 0; i < SEEK_MID_COPIES; i++)
+    g_string_append_len (copies, contents, size);
+  g_free (contents);
+
+  ret = g_file_set_contents (*path, copies->str, copies->len, &err);
+  if (!ret) {
+    ERR ("Unable to write %s: %s", *path, err->message);
+    g_clear_error (&err);
+  }
+  g_string_free (copies, TRUE);
+
+  return ret;
+}
+
+/* seeking between two keyframes of a file made of copies of the stream
+ * lands on the first one */
+static int
+check_seek_mid (gchar * filename)
+{
+  GstDemuxerES *demuxer = NULL;
+  GstDemuxerESPacket *pkt;
+  GstDemuxerESResult result;
+  GArray *keyframes = g_array_new (FALSE, FALSE, sizeof (gint64));
+  gchar *path = NULL;
+  gint64 target, expected, position = -1, pts = -1;
+  guint i;
+  int ret = EXIT_FAILURE;
+
+  if (!write_copies (filename, &path))
+    goto bail;
+
+  demuxer = gst_demuxer_es_new (path);
+  if (!demuxer) {
+    ERR ("An error occured during the parser creation.");
+    goto bail;
+  }
+
+  while ((result =
+          gst_demuxer_es_read_packet (demuxer,
+              &pkt)) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+    if (pkt->stream_type == DEMUXER_ES_STREAM_TYPE_VIDEO && pkt->keyframe)
+      g_array_append_val (keyframes, pkt->pts);
+    gst_demuxer_es_clear_packet (pkt);
+    if (result == DEMUXER_ES_RESULT_LAST_PACKET)
+      break;
+  }
+  if (result == DEMUXER_ES_RESULT_ERROR) {
+    ERR ("An error occured during the read of frame.");
+    goto bail;
+  }
+  if (keyframes->len < SEEK_MID_COPIES) {
+    ERR ("Only %u keyframe(s) in %d copies of the stream.", keyframes->len,
+        SEEK_MID_COPIES);
+    goto bail;
+  }
+
+  /* halfway to the keyframe after the one in the middle */
+  i = keyframes->len / 2;
+  expected = g_array_index (keyframes, gint64, i);
+  if (i + 1 < keyframes->len)
+    target = expected + (g_array_index (keyframes, gint64, i + 1) - expected) / 2;
+  else
+    target = expected + 1;
+  if (target <= expected) {
+    ERR ("No time between the keyframes at %" G_GINT64_FORMAT, expected);
+    goto bail;
+  }
+
+  if (!gst_demuxer_es_seek (demuxer, target, DEMUXER_ES_SEEK_FLAG_NONE,
+          &position)) {
+    ERR ("Unable to seek to %" G_GINT64_FORMAT, target);
+    goto bail;
+  }
+
+  result = gst_demuxer_es_read_packet (demuxer, &pkt);
+  if (result > DEMUXER_ES_RESULT_LAST_PACKET) {
+    ERR ("No packet after seeking to %" G_GINT64_FORMAT, target);
+    goto bail;
+  }
+  pts = pkt->pts;
+  gst_demuxer_es_clear_packet (pkt);
+
+  if (position != expected || pts != expected) {
+    ERR ("Seeking to %" G_GINT64_FORMAT " reached %" G_GINT64_FORMAT
+        " and read from %" G_GINT64_FORMAT " instead of the keyframe at %"
+        G_GINT64_FORMAT, target, position, pts, expected);
+    goto bail;
+  }
+
+  ret = EXIT_SUCCESS;
+
+bail:
+  if (demuxer)
+    gst_demuxer_es_teardown (demuxer);
+  if (path)
+    g_remove (path);
+  g_free (path);
+  g_array_unref (keyframes);
+
+  return ret;
+}
+
 int
 process_file (gchar * filename)
 {
-  GstDemuxerESPacket *pkt;
   GstDemuxerEStream *stream;
   GstDemuxerESResult result;
   GstDemuxerES *demuxer = gst_demuxer_es_new (filename);
   gint count = 0;
+  gint64 first_pts = -1;
+  int ret = EXIT_SUCCESS;
 
   if (!demuxer) {
     ERR ("An error occured during the parser creation.");
@@ -60,21 +254,7 @@ process_file (gchar * filename)
 
   print_video_info (stream);
 
-  while ((result =
-          gst_demuxer_es_read_packet (demuxer,
-              &pkt)) <= DEMUXER_ES_RESULT_NO_PACKET) {
-    if (result <= DEMUXER_ES_RESULT_LAST_PACKET) {
-      INFO ("A %s packet of type %s stream_id %d with size %lu.",
-      (result == DEMUXER_ES_RESULT_LAST_PACKET)? "last":"new",
-          gst_demuxer_es_get_stream_type_name(pkt->stream_type), pkt->stream_id, pkt->data_size);
-      count++;
-      gst_demuxer_es_clear_packet (pkt);
-      if(result == DEMUXER_ES_RESULT_LAST_PACKET)
-        break;
-    } else {
-      ERR ("No packet available.");
-    }
-  }
+  result = read_packets (demuxer, &count, &first_pts);
 
   if (result == DEMUXER_ES_RESULT_ERROR) {
     ERR ("An error occured during the read of frame.");
@@ -82,8 +262,15 @@ process_file (gchar * filename)
   } else if (result == DEMUXER_ES_RESULT_LAST_PACKET)
     DBG ("The parser exited with success. Found %d packet(s).", count);
 
+  if (seek)
+    ret = check_seek (demuxer, count, first_pts);
+
   gst_demuxer_es_teardown (demuxer);
-  return EXIT_SUCCESS;
+
+  if (seek_mid)
+    ret |= check_seek_mid (filename);
+
+  return ret;
 }
 
 int
@@ -97,6 +284,10 @@ main (int argc, char **argv)
   gint ret = EXIT_SUCCESS;
 
   const GOptionEntry entries[] = {
+    {"seek", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &seek,
+        "Seek back to the start and read the packets again", NULL},
+    {"seek-mid", 'm', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &seek_mid,
+        "Seek between two keyframes of copies of the stream", NULL},
     {G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY,
         &filenames, "Media files to play", NULL},
     {NULL,},
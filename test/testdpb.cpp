@@ -0,0 +1,599 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Runs random sequences of additions, reference marking (sliding window,
+ * MMCO and RPS alike), queries and bumping on the decoded picture buffers
+ * and on the list-based implementation they replaced, logging every
+ * result, and fails if the logs of any seed differ. */
+
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "dpbreference.h"
+
+#define NUM_STEPS 400
+#define MAX_FRAME_NUM 16
+
+#define ID(p) ((p) ? (gint)(p)->system_frame_number : -1)
+
+class Random {
+public:
+    explicit Random(guint seed)
+        : m_state(88172645463325252ull + seed * 7919ull)
+    {
+    }
+
+    // In [0, n)
+    guint operator()(guint n)
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state % n;
+    }
+
+private:
+    guint64 m_state;
+};
+
+template <typename Dpb>
+struct H264DpbOps {
+    Dpb* (*create)(void);
+    void (*free)(Dpb*);
+    void (*set_max_num_frames)(Dpb*, gint);
+    void (*set_interlaced)(Dpb*, gboolean);
+    void (*set_max_num_reorder_frames)(Dpb*, guint32);
+    void (*clear)(Dpb*);
+    void (*add)(Dpb*, GstH264Picture*);
+    void (*delete_unused)(Dpb*);
+    gint (*num_ref_frames)(Dpb*);
+    GstH264Picture* (*get_short_ref_by_pic_num)(Dpb*, gint);
+    GstH264Picture* (*get_long_ref_by_long_term_pic_num)(Dpb*, gint);
+    GstH264Picture* (*get_lowest_frame_num_short_ref)(Dpb*);
+    void (*get_pictures_short_term_ref)(Dpb*, gboolean, gboolean, GArray*);
+    void (*get_pictures_long_term_ref)(Dpb*, gboolean, GArray*);
+    GArray* (*get_pictures_all)(Dpb*);
+    gint (*get_size)(Dpb*);
+    GstH264Picture* (*get_picture)(Dpb*, guint32);
+    gboolean (*has_empty_frame_buffer)(Dpb*);
+    gboolean (*needs_bump)(Dpb*, GstH264Picture*, GstH264DpbBumpMode);
+    GstH264Picture* (*bump)(Dpb*, gboolean);
+    void (*set_last_output)(Dpb*, GstH264Picture*);
+    gboolean (*perform_mmco)(Dpb*, GstH264RefPicMarking*, GstH264Picture*);
+    void (*update_pic_nums)(Dpb*, GstH264Picture*, gint, gint);
+    // Of a picture in the DPB
+    void (*set_reference)(Dpb*, GstH264Picture*, GstH264PictureReference, gboolean);
+};
+
+static void ref_h264_dpb_set_reference(RefH264Dpb* dpb, GstH264Picture* picture,
+    GstH264PictureReference reference, gboolean other_field)
+{
+    ref_h264_picture_set_reference(picture, reference, other_field);
+}
+
+static const H264DpbOps<GstH264Dpb> h264_dpb = {
+    gst_h264_dpb_new,
+    gst_h264_dpb_free,
+    gst_h264_dpb_set_max_num_frames,
+    gst_h264_dpb_set_interlaced,
+    gst_h264_dpb_set_max_num_reorder_frames,
+    gst_h264_dpb_clear,
+    gst_h264_dpb_add,
+    gst_h264_dpb_delete_unused,
+    gst_h264_dpb_num_ref_frames,
+    gst_h264_dpb_get_short_ref_by_pic_num,
+    gst_h264_dpb_get_long_ref_by_long_term_pic_num,
+    gst_h264_dpb_get_lowest_frame_num_short_ref,
+    gst_h264_dpb_get_pictures_short_term_ref,
+    gst_h264_dpb_get_pictures_long_term_ref,
+    gst_h264_dpb_get_pictures_all,
+    gst_h264_dpb_get_size,
+    gst_h264_dpb_get_picture,
+    gst_h264_dpb_has_empty_frame_buffer,
+    gst_h264_dpb_needs_bump,
+    gst_h264_dpb_bump,
+    gst_h264_dpb_set_last_output,
+    gst_h264_dpb_perform_memory_management_control_operation,
+    gst_h264_dpb_update_pic_nums,
+    gst_h264_dpb_set_reference,
+};
+
+static const H264DpbOps<RefH264Dpb> h264_reference = {
+    ref_h264_dpb_new,
+    ref_h264_dpb_free,
+    ref_h264_dpb_set_max_num_frames,
+    ref_h264_dpb_set_interlaced,
+    ref_h264_dpb_set_max_num_reorder_frames,
+    ref_h264_dpb_clear,
+    ref_h264_dpb_add,
+    ref_h264_dpb_delete_unused,
+    ref_h264_dpb_num_ref_frames,
+    ref_h264_dpb_get_short_ref_by_pic_num,
+    ref_h264_dpb_get_long_ref_by_long_term_pic_num,
+    ref_h264_dpb_get_lowest_frame_num_short_ref,
+    ref_h264_dpb_get_pictures_short_term_ref,
+    ref_h264_dpb_get_pictures_long_term_ref,
+    ref_h264_dpb_get_pictures_all,
+    ref_h264_dpb_get_size,
+    ref_h264_dpb_get_picture,
+    ref_h264_dpb_has_empty_frame_buffer,
+    ref_h264_dpb_needs_bump,
+    ref_h264_dpb_bump,
+    ref_h264_dpb_set_last_output,
+    ref_h264_dpb_perform_memory_management_control_operation,
+    ref_h264_dpb_update_pic_nums,
+    ref_h264_dpb_set_reference,
+};
+
+template <typename Dpb>
+struct H265DpbOps {
+    Dpb* (*create)(void);
+    void (*free)(Dpb*);
+    void (*set_max_num_pics)(Dpb*, gint);
+    void (*clear)(Dpb*);
+    void (*add)(Dpb*, GstH265Picture*);
+    void (*delete_unused)(Dpb*);
+    gint (*num_ref_pictures)(Dpb*);
+    void (*mark_all_non_ref)(Dpb*);
+    GstH265Picture* (*get_ref_by_poc)(Dpb*, gint);
+    GstH265Picture* (*get_ref_by_poc_lsb)(Dpb*, gint);
+    GstH265Picture* (*get_short_ref_by_poc)(Dpb*, gint);
+    GstH265Picture* (*get_long_ref_by_poc)(Dpb*, gint);
+    GArray* (*get_pictures_all)(Dpb*);
+    gint (*get_size)(Dpb*);
+    GstH265Picture* (*get_picture)(Dpb*, guint32);
+    gboolean (*needs_bump)(Dpb*, guint, guint, guint);
+    GstH265Picture* (*bump)(Dpb*, gboolean);
+    void (*set_reference)(Dpb*, GstH265Picture*, gboolean, gboolean);
+};
+
+static void ref_h265_dpb_set_reference(RefH265Dpb* dpb, GstH265Picture* picture,
+    gboolean ref, gboolean long_term)
+{
+    picture->ref = ref;
+    picture->long_term = long_term;
+}
+
+static const H265DpbOps<GstH265Dpb> h265_dpb = {
+    gst_h265_dpb_new,
+    gst_h265_dpb_free,
+    gst_h265_dpb_set_max_num_pics,
+    gst_h265_dpb_clear,
+    gst_h265_dpb_add,
+    gst_h265_dpb_delete_unused,
+    gst_h265_dpb_num_ref_pictures,
+    gst_h265_dpb_mark_all_non_ref,
+    gst_h265_dpb_get_ref_by_poc,
+    gst_h265_dpb_get_ref_by_poc_lsb,
+    gst_h265_dpb_get_short_ref_by_poc,
+    gst_h265_dpb_get_long_ref_by_poc,
+    gst_h265_dpb_get_pictures_all,
+    gst_h265_dpb_get_size,
+    gst_h265_dpb_get_picture,
+    gst_h265_dpb_needs_bump,
+    gst_h265_dpb_bump,
+    gst_h265_dpb_set_reference,
+};
+
+static const H265DpbOps<RefH265Dpb> h265_reference = {
+    ref_h265_dpb_new,
+    ref_h265_dpb_free,
+    ref_h265_dpb_set_max_num_pics,
+    ref_h265_dpb_clear,
+    ref_h265_dpb_add,
+    ref_h265_dpb_delete_unused,
+    ref_h265_dpb_num_ref_pictures,
+    ref_h265_dpb_mark_all_non_ref,
+    ref_h265_dpb_get_ref_by_poc,
+    ref_h265_dpb_get_ref_by_poc_lsb,
+    ref_h265_dpb_get_short_ref_by_poc,
+    ref_h265_dpb_get_long_ref_by_poc,
+    ref_h265_dpb_get_pictures_all,
+    ref_h265_dpb_get_size,
+    ref_h265_dpb_get_picture,
+    ref_h265_dpb_needs_bump,
+    ref_h265_dpb_bump,
+    ref_h265_dpb_set_reference,
+};
+
+template <typename Dpb>
+class H264Run {
+public:
+    H264Run(const H264DpbOps<Dpb>& ops, guint seed, GString* log)
+        : m_ops(ops)
+        , m_rnd(seed)
+        , m_log(log)
+        , m_dpb(ops.create())
+    {
+    }
+
+    ~H264Run()
+    {
+        m_ops.free(m_dpb);
+        // Fields point to each other without holding a reference
+        for (GstH264Picture* field : m_fields)
+            gst_h264_picture_unref(field);
+    }
+
+    void run(bool interlaced)
+    {
+        gint max_frames = 2 + m_rnd(15);
+        gint frame_num = 0, poc = 0;
+
+        m_ops.set_max_num_frames(m_dpb, max_frames);
+        m_ops.set_interlaced(m_dpb, interlaced);
+        m_ops.set_max_num_reorder_frames(m_dpb, m_rnd(max_frames + 1));
+
+        for (guint n = 0; n < NUM_STEPS; n++) {
+            bool field_pair = interlaced && m_rnd(2);
+            bool ref = m_rnd(4) != 0;
+            GstH264Picture* picture = create_picture(poc, frame_num,
+                field_pair ? GST_H264_PICTURE_FIELD_TOP_FIELD : GST_H264_PICTURE_FIELD_FRAME);
+
+            if (m_rnd(30) == 0)
+                picture->nonexisting = TRUE;
+
+            m_ops.update_pic_nums(m_dpb, picture, frame_num, MAX_FRAME_NUM);
+            queries();
+
+            if (ref) {
+                gst_h264_picture_set_reference(picture,
+                    m_rnd(8) ? GST_H264_PICTURE_REF_SHORT_TERM : GST_H264_PICTURE_REF_LONG_TERM, FALSE);
+                if (m_rnd(3) == 0) {
+                    for (guint k = 1 + m_rnd(3); k > 0; k--)
+                        mmco(picture);
+                } else {
+                    sliding_window(max_frames);
+                }
+            }
+
+            m_ops.delete_unused(m_dpb);
+            dump();
+            bump((GstH264DpbBumpMode)m_rnd(3), picture, false);
+
+            if (picture->ref || m_ops.has_empty_frame_buffer(m_dpb)) {
+                if (field_pair) {
+                    GstH264Picture* second = create_picture(poc + 1, frame_num,
+                        GST_H264_PICTURE_FIELD_BOTTOM_FIELD);
+
+                    second->second_field = TRUE;
+                    second->other_field = picture;
+                    second->ref = picture->ref;
+                    m_fields.push_back(gst_h264_picture_ref(picture));
+                    m_fields.push_back(gst_h264_picture_ref(second));
+
+                    m_ops.add(m_dpb, picture);
+                    m_ops.update_pic_nums(m_dpb, second, frame_num, MAX_FRAME_NUM);
+                    if (second->ref && m_rnd(4) == 0)
+                        mmco(second);
+                    m_ops.add(m_dpb, second);
+                } else {
+                    m_ops.add(m_dpb, picture);
+                }
+            } else {
+                m_ops.set_last_output(m_dpb, picture);
+                g_string_append_printf(m_log, "direct %d\n", ID(picture));
+                gst_h264_picture_unref(picture);
+            }
+            dump();
+
+            GstH264Picture* found = m_ops.get_picture(m_dpb, m_next_id - 1 - m_rnd(4));
+            g_string_append_printf(m_log, "get %d\n", ID(found));
+            if (found)
+                gst_h264_picture_unref(found);
+
+            if (ref)
+                frame_num = (frame_num + 1) % MAX_FRAME_NUM;
+            poc += 2 + 2 * (gint)m_rnd(3) - (m_rnd(4) == 0 ? 6 : 0);
+
+            if (m_rnd(60) == 0) {
+                bump(GST_H264_DPB_BUMP_NORMAL_LATENCY, NULL, true);
+                m_ops.clear(m_dpb);
+                poc = 0;
+                g_string_append(m_log, "clear\n");
+            }
+        }
+
+        bump(GST_H264_DPB_BUMP_NORMAL_LATENCY, NULL, true);
+    }
+
+private:
+    GstH264Picture* create_picture(gint poc, gint frame_num, GstH264PictureField field)
+    {
+        GstH264Picture* picture = gst_h264_picture_new();
+
+        picture->system_frame_number = m_next_id++;
+        picture->pic_order_cnt = picture->top_field_order_cnt = picture->bottom_field_order_cnt = poc;
+        picture->frame_num = picture->pic_num = frame_num;
+        picture->field = field;
+        picture->long_term_frame_idx = m_rnd(4);
+        return picture;
+    }
+
+    void dump()
+    {
+        GArray* all = m_ops.get_pictures_all(m_dpb);
+
+        g_string_append(m_log, "dpb:");
+        for (guint i = 0; i < all->len; i++) {
+            GstH264Picture* p = g_array_index(all, GstH264Picture*, i);
+
+            g_string_append_printf(m_log, " %d/r%d/o%d/pn%d/lt%d/fw%d/ltf%d", ID(p), p->ref,
+                p->needed_for_output, p->pic_num, p->long_term_pic_num, p->frame_num_wrap,
+                p->long_term_frame_idx);
+        }
+        g_string_append_c(m_log, '\n');
+        g_array_unref(all);
+    }
+
+    void queries()
+    {
+        GArray* refs = g_array_sized_new(FALSE, TRUE, sizeof(GstH264Picture*), 16);
+        GstH264Picture* lowest;
+
+        g_string_append_printf(m_log, "nref %d size %d empty %d\n", m_ops.num_ref_frames(m_dpb),
+            m_ops.get_size(m_dpb), m_ops.has_empty_frame_buffer(m_dpb));
+
+        for (gint x = -20; x < 40; x += 1 + m_rnd(3)) {
+            GstH264Picture* short_ref = m_ops.get_short_ref_by_pic_num(m_dpb, x);
+            GstH264Picture* long_ref = m_ops.get_long_ref_by_long_term_pic_num(m_dpb, x % 8);
+
+            g_string_append_printf(m_log, "s%d=%d l%d=%d ", x, ID(short_ref), x % 8, ID(long_ref));
+        }
+
+        lowest = m_ops.get_lowest_frame_num_short_ref(m_dpb);
+        g_string_append_printf(m_log, "\nlowest %d\n", ID(lowest));
+        if (lowest)
+            gst_h264_picture_unref(lowest);
+
+        for (guint a = 0; a < 2; a++) {
+            for (guint b = 0; b < 2; b++) {
+                m_ops.get_pictures_short_term_ref(m_dpb, a, b, refs);
+                m_ops.get_pictures_long_term_ref(m_dpb, b, refs);
+                g_string_append_printf(m_log, "refs%u%u:", a, b);
+                for (guint i = 0; i < refs->len; i++) {
+                    GstH264Picture* p = g_array_index(refs, GstH264Picture*, i);
+
+                    g_string_append_printf(m_log, " %d", ID(p));
+                    gst_h264_picture_unref(p);
+                }
+                g_string_append_c(m_log, '\n');
+                g_array_set_size(refs, 0);
+            }
+        }
+
+        g_array_unref(refs);
+    }
+
+    void mmco(GstH264Picture* picture)
+    {
+        GstH264RefPicMarking marking = { };
+
+        marking.memory_management_control_operation = 1 + m_rnd(6);
+        marking.difference_of_pic_nums_minus1 = m_rnd(6);
+        marking.long_term_pic_num = m_rnd(8);
+        marking.long_term_frame_idx = m_rnd(4);
+        marking.max_long_term_frame_idx_plus1 = m_rnd(4);
+
+        // MMCO 5 empties the DPB: keep it rare
+        if (marking.memory_management_control_operation == 5 && m_rnd(4))
+            return;
+
+        g_string_append_printf(m_log, "mmco %u -> %d\n", marking.memory_management_control_operation,
+            m_ops.perform_mmco(m_dpb, &marking, picture));
+        dump();
+    }
+
+    void sliding_window(gint max_frames)
+    {
+        while (m_ops.num_ref_frames(m_dpb) >= MAX(1, max_frames - 1)) {
+            GstH264Picture* oldest = m_ops.get_lowest_frame_num_short_ref(m_dpb);
+
+            if (!oldest)
+                break;
+            g_string_append_printf(m_log, "unmark %d fw %d other %d\n", ID(oldest),
+                oldest->frame_num_wrap, ID(oldest->other_field));
+            m_ops.set_reference(m_dpb, oldest, GST_H264_PICTURE_REF_NONE, TRUE);
+            gst_h264_picture_unref(oldest);
+        }
+    }
+
+    void bump(GstH264DpbBumpMode mode, GstH264Picture* to_insert, bool drain)
+    {
+        GstH264Picture* out;
+
+        while ((drain || m_ops.needs_bump(m_dpb, to_insert, mode))
+            && (out = m_ops.bump(m_dpb, drain))) {
+            g_string_append_printf(m_log, "out %d flags %u\n", ID(out), out->buffer_flags);
+            gst_h264_picture_unref(out);
+        }
+    }
+
+    const H264DpbOps<Dpb>& m_ops;
+    Random m_rnd;
+    GString* m_log;
+    Dpb* m_dpb;
+    guint32 m_next_id = 0;
+    std::vector<GstH264Picture*> m_fields;
+};
+
+template <typename Dpb>
+static void run_h265(const H265DpbOps<Dpb>& ops, guint seed, GString* log)
+{
+    Random rnd(seed);
+    Dpb* dpb = ops.create();
+    gint max_pics = 2 + rnd(15);
+    guint max_reorder = rnd(max_pics), max_latency = rnd(5), max_dec = 1 + rnd(max_pics);
+    guint32 next_id = 0;
+    gint poc = 0;
+
+    ops.set_max_num_pics(dpb, max_pics);
+
+    for (guint n = 0; n < NUM_STEPS; n++) {
+        GArray* all = ops.get_pictures_all(dpb);
+        GstH265Picture *picture, *out, *found;
+
+        // RPS: keep, unmark or make long term every reference
+        if (rnd(10) == 0) {
+            ops.mark_all_non_ref(dpb);
+        } else {
+            for (guint i = 0; i < all->len; i++) {
+                GstH265Picture* p = g_array_index(all, GstH265Picture*, i);
+                guint r = rnd(6);
+
+                if (r == 0)
+                    ops.set_reference(dpb, p, FALSE, FALSE);
+                else if (r == 1)
+                    ops.set_reference(dpb, p, TRUE, TRUE);
+            }
+        }
+        g_array_unref(all);
+
+        g_string_append_printf(log, "nref %d size %d\n", ops.num_ref_pictures(dpb), ops.get_size(dpb));
+        for (gint x = poc - 20; x < poc + 4; x++) {
+            GstH265Picture* refs[] = {
+                ops.get_ref_by_poc(dpb, x),
+                ops.get_ref_by_poc_lsb(dpb, x & 15),
+                ops.get_short_ref_by_poc(dpb, x),
+                ops.get_long_ref_by_poc(dpb, x),
+            };
+
+            g_string_append_printf(log, "%d:", x);
+            for (GstH265Picture* ref : refs) {
+                g_string_append_printf(log, " %d", ID(ref));
+                if (ref)
+                    gst_h265_picture_unref(ref);
+            }
+            g_string_append_c(log, '\n');
+        }
+
+        ops.delete_unused(dpb);
+        while (ops.needs_bump(dpb, max_reorder, max_latency, max_dec) && (out = ops.bump(dpb, FALSE))) {
+            g_string_append_printf(log, "out %d\n", ID(out));
+            gst_h265_picture_unref(out);
+        }
+
+        picture = gst_h265_picture_new();
+        picture->system_frame_number = next_id++;
+        picture->pic_order_cnt = poc;
+        picture->pic_order_cnt_lsb = poc & 15;
+        picture->output_flag = rnd(8) != 0;
+        picture->ref = TRUE;
+        ops.add(dpb, picture);
+
+        all = ops.get_pictures_all(dpb);
+        g_string_append(log, "dpb:");
+        for (guint i = 0; i < all->len; i++) {
+            GstH265Picture* p = g_array_index(all, GstH265Picture*, i);
+
+            g_string_append_printf(log, " %d/r%d/l%d/o%d/c%u", ID(p), p->ref, p->long_term,
+                p->needed_for_output, p->pic_latency_cnt);
+        }
+        g_string_append_c(log, '\n');
+        g_array_unref(all);
+
+        found = ops.get_picture(dpb, next_id - 1 - rnd(4));
+        g_string_append_printf(log, "get %d\n", ID(found));
+        if (found)
+            gst_h265_picture_unref(found);
+
+        poc += 1 + rnd(3);
+
+        if (rnd(80) == 0) {
+            while ((out = ops.bump(dpb, TRUE))) {
+                g_string_append_printf(log, "drain %d\n", ID(out));
+                gst_h265_picture_unref(out);
+            }
+            ops.clear(dpb);
+            poc = 0;
+            g_string_append(log, "clear\n");
+        }
+    }
+
+    ops.free(dpb);
+}
+
+// Prints the first line where the logs differ
+static void report_difference(guint seed, const GString* log, const GString* expected)
+{
+    gchar** lines = g_strsplit(log->str, "\n", -1);
+    gchar** expected_lines = g_strsplit(expected->str, "\n", -1);
+    guint i;
+
+    for (i = 0; lines[i] && expected_lines[i]; i++) {
+        if (strcmp(lines[i], expected_lines[i]) != 0)
+            break;
+    }
+
+    ERR("seed %u differs at line %u:\n  got:      %s\n  expected: %s", seed, i + 1,
+        lines[i] ? lines[i] : "(end)", expected_lines[i] ? expected_lines[i] : "(end)");
+
+    g_strfreev(lines);
+    g_strfreev(expected_lines);
+}
+
+int main(int argc, char** argv)
+{
+    gint seeds = 300;
+    guint failed = 0;
+
+    const GOptionEntry entries[] = {
+        { "seeds", 's', 0, G_OPTION_ARG_INT, &seeds, "Random sequences to compare", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries, TEST_SAMPLE_NONE);
+
+    if (seeds <= 0) {
+        ERR ("Invalid number of seeds.");
+        return EXIT_FAILURE;
+    }
+
+    gst_init (NULL, NULL);
+
+    for (guint seed = 0; seed < (guint) seeds; seed++) {
+        GString* log = g_string_new (NULL);
+        GString* expected = g_string_new (NULL);
+
+        if (args.codec () == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
+            run_h265 (h265_dpb, seed, log);
+            run_h265 (h265_reference, seed, expected);
+        } else {
+            // One out of three sequences has field pairs
+            H264Run<GstH264Dpb> (h264_dpb, seed, log).run (seed % 3 == 0);
+            H264Run<RefH264Dpb> (h264_reference, seed, expected).run (seed % 3 == 0);
+        }
+
+        if (!g_string_equal (log, expected)) {
+            report_difference (seed, log, expected);
+            failed++;
+        }
+
+        g_string_free (log, TRUE);
+        g_string_free (expected, TRUE);
+    }
+
+    if (failed > 0) {
+        ERR ("%u of %d %s sequences differ", failed, seeds, args.codecName ());
+        return EXIT_FAILURE;
+    }
+
+    INFO ("%d %s sequences match the list-based DPB", seeds, args.codecName ());
+
+    return EXIT_SUCCESS;
+}
@@ -29,8 +29,39 @@
 #define ERR(FMT, ...) g_print("ERROR: " FMT, ##__VA_ARGS__)
 
 static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+static VkParserGstOptions options = { };
 
 
+static void print_histogram(const char* name, const VkParserGstHistogram* histogram)
+{
+    g_print("  %-18s: %" G_GUINT64_FORMAT " calls, %" G_GUINT64_FORMAT " ns total, p50 %"
+        G_GUINT64_FORMAT " ns, p99 %" G_GUINT64_FORMAT " ns, max %" G_GUINT64_FORMAT " ns\n",
+        name, histogram->count, histogram->total,
+        GetVulkanVideoDecodeParserHistogramPercentile(histogram, 0.5),
+        GetVulkanVideoDecodeParserHistogramPercentile(histogram, 0.99), histogram->max);
+}
+
+static bool print_stats(VulkanVideoDecodeParser* parser)
+{
+    VkParserGstStats stats;
+
+    if (!GetVulkanVideoDecodeParserStats(parser, &stats))
+        return false;
+
+    g_print("Stats:\n");
+    g_print("  NALs parsed       : %" G_GUINT64_FORMAT "\n", stats.nalsParsed);
+    g_print("  slices assembled  : %" G_GUINT64_FORMAT "\n", stats.slicesAssembled);
+    g_print("  bytes copied      : %" G_GUINT64_FORMAT "\n", stats.bytesCopied);
+    g_print("  param sets skipped: %" G_GUINT64_FORMAT "\n", stats.parameterSetsSkipped);
+    g_print("  pictures in flight: %" G_GUINT64_FORMAT " (peak %" G_GUINT64_FORMAT ")\n",
+        stats.picturesInFlight, stats.picturesInFlightPeak);
+    print_histogram("NAL identification", &stats.nalIdentification);
+    print_histogram("DPB management", &stats.dpbManagement);
+    print_histogram("client callbacks", &stats.clientCallbacks);
+
+    return stats.nalsParsed > 0 && stats.slicesAssembled > 0;
+}
+
 static bool parse(FILE* stream, bool quiet)
 {
     VulkanVideoDecodeParser* parser = nullptr;
@@ -64,6 +95,9 @@ static bool parse(FILE* stream, bool quiet)
     if (!ret)
         return ret;
 
+    ret = SetVulkanVideoDecodeParserOptions(parser, &options);
+    assert(ret);
+
     ret = (parser->Initialize(&params) == VK_SUCCESS);
 
     if (!ret)
@@ -87,7 +121,17 @@ static bool parse(FILE* stream, bool quiet)
         assert(pkt.nDataLength == parsed);
     }
 
+    if (!FlushVulkanVideoDecodeParser(parser))
+        ERR ("failed to parse queued bitstream.\n");
+
     ret = (parser->Deinitialize() == 0);
+
+    if (options.bCollectStats && !print_stats(parser)) {
+        ERR ("no stats collected.\n");
+        parser->Release();
+        return false;
+    }
+
     ret = (parser->Release() == 0);
     assert(ret);
     return ret;
@@ -118,11 +162,21 @@ int main(int argc, char** argv)
     gchar **filenames = NULL;
     gchar *codec_str = NULL;
     gboolean quiet = FALSE;
+    gboolean direct = FALSE;
+    gboolean async = FALSE;
+    gint queue_depth = 0;
+    gboolean stats = FALSE;
+    gboolean framing = FALSE;
     gint ret = EXIT_SUCCESS;
 
     static GOptionEntry entries[] = {
         { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, "Quiet parser", NULL },
         { "codec", 'c', 0, G_OPTION_ARG_STRING, &codec_str, "Codec to use ie h265", NULL },
+        { "direct", 'd', 0, G_OPTION_ARG_NONE, &direct, "Use the direct backend", NULL },
+        { "async", 'a', 0, G_OPTION_ARG_NONE, &async, "Parse in a dedicated thread", NULL },
+        { "queue-depth", 'Q', 0, G_OPTION_ARG_INT, &queue_depth, "Packets queued in async mode", NULL },
+        { "stats", 'S', 0, G_OPTION_ARG_NONE, &stats, "Print parsing counters and times", NULL },
+        { "decoder-framing", 'F', 0, G_OPTION_ARG_NONE, &framing, "Drop the parse element, the decoder frames access units", NULL },
         {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL},
         { NULL }
     };
@@ -156,6 +210,13 @@ int main(int argc, char** argv)
       codec = VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT;
     g_free (codec_str);
 
+    if (direct)
+      options.eBackend = VK_PARSER_GST_BACKEND_DIRECT;
+    options.bAsync = async;
+    options.nQueueDepth = MAX (queue_depth, 0);
+    options.bCollectStats = stats;
+    options.bDecoderFraming = framing;
+
     int num = g_strv_length (filenames);
     for (int i = 0; i < num; ++i)
         ret |= process_file (filenames[i], quiet);
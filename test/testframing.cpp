@@ -0,0 +1,102 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Parses a stream split in packets of 1, 7 and 4096 bytes, with the parse
+ * element and with the decoder framing the access units, and checks the
+ * pictures handed to the client are the same as when the stream is passed
+ * at once. */
+
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+class FramingClient : public NullParserClient {
+public:
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        m_pictures.push_back(hash_bytes(pic->pBitstreamData, pic->nBitstreamDataLen));
+
+        return NullParserClient::DecodePicture(pic);
+    }
+
+    const std::vector<uint32_t>& pictures() const { return m_pictures; }
+
+private:
+    std::vector<uint32_t> m_pictures;
+};
+
+static bool run(const guint8* data, gsize size, bool framing, gsize chunk,
+    std::vector<uint32_t>& pictures)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    FramingClient client;
+    VkParserGstOptions options = {
+        .bDecoderFraming = framing,
+    };
+    bool ret;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, data, size, chunk);
+
+    destroy_parser(parser);
+
+    pictures = client.pictures();
+
+    return ret && !pictures.empty();
+}
+
+int main(int argc, char** argv)
+{
+    static const gsize chunks[] = { 1, 7, 4096 };
+    gint ret = EXIT_SUCCESS;
+    TestArgs args (argc, argv, "TEST", NULL);
+
+    codec = args.codec ();
+
+    for (bool framing : { false, true }) {
+        const char* name = framing ? "decoder framing" : "parse element";
+        std::vector<uint32_t> expected;
+
+        if (!run (args.data (), args.size (), framing, G_MAXSIZE, expected)) {
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        INFO ("%-15s: %zu pictures", name, expected.size ());
+
+        for (gsize chunk : chunks) {
+            std::vector<uint32_t> pictures;
+
+            if (!run (args.data (), args.size (), framing, chunk, pictures)) {
+                ret = EXIT_FAILURE;
+            } else if (pictures != expected) {
+                ERR ("%s, %" G_GSIZE_FORMAT " bytes packets: %zu pictures unlike the %zu of the whole stream",
+                    name, chunk, pictures.size (), expected.size ());
+                ret = EXIT_FAILURE;
+            }
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,300 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Indexes the stream concatenated three times, the last two copies without
+ * parameter sets, and checks every IDR/IRAP is an entry, the index survives
+ * being saved and loaded, and parsing started at any entry decodes all the
+ * pictures from there on. For H.264 it's done again with the PPS id set to
+ * 255. */
+
+#include <cstring>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+#include "vkvideoparserindex.h"
+
+#define COPIES 3
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+// only the first copy has parameter sets, so starting at the other entries
+// relies on the index to find them
+static std::vector<guint8> concatenate(const guint8* data, gsize size)
+{
+    static const guint8 start_code[] = { 0, 0, 0, 1 };
+    std::vector<guint8> out(data, data + size);
+    std::vector<Nal> nals = split_annexb(data, size);
+
+    for (guint i = 1; i < COPIES; i++) {
+        for (const Nal& nal : nals) {
+            if (is_parameter_set(codec, nal_type(codec, nal.data)))
+                continue;
+            out.insert(out.end(), start_code, start_code + sizeof(start_code));
+            out.insert(out.end(), nal.data, nal.data + nal.size);
+        }
+    }
+
+    return out;
+}
+
+static void append_bits(std::vector<bool>& bits, guint32 value, guint n)
+{
+    while (n-- > 0)
+        bits.push_back((value >> n) & 1);
+}
+
+// Sets the id of the PPS and of the slices referring to it, 0 in the
+// samples, to 255, the highest one. ue(255) is 16 bits longer than ue(0),
+// so the slice data stays byte aligned.
+static bool set_pps_id_255(const std::vector<guint8>& stream, std::vector<guint8>& out)
+{
+    for (const Nal& nal : split_annexb(stream.data(), stream.size())) {
+        guint type = nal_type(codec, nal.data);
+        // of pic_parameter_set_id, after first_mb_in_slice and slice_type
+        guint field = type == 8 ? 0 : 2;
+        std::vector<bool> bits, id;
+        std::vector<guint8> rbsp;
+        gsize pos = 0;
+        guint zeros = 0;
+
+        out.insert(out.end(), { 0, 0, 0, 1, nal.data[0] });
+
+        if (type != 8 && type != 1 && type != 5) {
+            out.insert(out.end(), nal.data + 1, nal.data + nal.size);
+            continue;
+        }
+
+        for (gsize i = 1; i < nal.size; i++) {
+            if (zeros >= 2 && nal.data[i] == 3) {
+                zeros = 0;
+                continue;
+            }
+            zeros = nal.data[i] ? 0 : zeros + 1;
+            append_bits(bits, nal.data[i], 8);
+        }
+
+        for (guint i = 0; i <= field; i++) {
+            guint leading = 0;
+
+            while (pos < bits.size() && !bits[pos]) {
+                leading++;
+                pos++;
+            }
+            if (i < field)
+                pos += leading + 1;
+            else if (leading != 0)
+                return false;
+        }
+        if (pos >= bits.size())
+            return false;
+
+        bits.erase(bits.begin() + pos);
+        append_bits(id, 0, 8);
+        append_bits(id, 256, 9);
+        bits.insert(bits.begin() + pos, id.begin(), id.end());
+
+        zeros = 0;
+        for (gsize i = 0; i < bits.size(); i += 8) {
+            guint8 byte = 0;
+
+            for (gsize j = i; j < i + 8; j++)
+                byte = (byte << 1) | bits[j];
+            if (zeros >= 2 && byte <= 3) {
+                out.push_back(3);
+                zeros = 0;
+            }
+            zeros = byte ? 0 : zeros + 1;
+            out.push_back(byte);
+        }
+    }
+
+    return true;
+}
+
+// Returns the pictures decoded from the entry n on, or from the start if n
+// is negative.
+static gint64 run(const std::vector<guint8>& stream, VkParserGstIndex* index, gint n)
+{
+    VulkanVideoDecodeParser* parser;
+    NullParserClient client;
+    size_t offset = 0;
+    gint64 ret = -1;
+
+    parser = create_parser(codec, &client);
+    if (!parser)
+        return -1;
+
+    if (n >= 0 && !StartVulkanVideoDecodeParserAtIndexEntry(parser, index, n, stream.data(), stream.size(), &offset))
+        ERR("failed to start at entry %d.", n);
+    else if (parse_bytes(parser, stream.data() + offset, stream.size() - offset))
+        ret = 0;
+
+    destroy_parser(parser);
+
+    return ret < 0 ? -1 : client.decoded();
+}
+
+static bool same_entries(VkParserGstIndex* a, VkParserGstIndex* b)
+{
+    if (GetVulkanVideoParserIndexEntryCount(a) != GetVulkanVideoParserIndexEntryCount(b)
+        || GetVulkanVideoParserIndexFrameCount(a) != GetVulkanVideoParserIndexFrameCount(b))
+        return false;
+
+    for (uint32_t i = 0; i < GetVulkanVideoParserIndexEntryCount(a); i++) {
+        VkParserGstIndexEntry ea, eb;
+
+        if (!GetVulkanVideoParserIndexEntry(a, i, &ea) || !GetVulkanVideoParserIndexEntry(b, i, &eb)
+            || memcmp(&ea, &eb, sizeof(ea)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// pps_id is the one every entry must refer to, or -1
+static bool check_index(const std::vector<guint8>& stream, const gchar* stream_path, const gchar* index_path,
+    gint pps_id)
+{
+    VkParserGstIndex *index = nullptr, *scanned = nullptr, *loaded = nullptr;
+    gint64 total;
+    bool ret = false;
+
+    total = run(stream, nullptr, -1);
+    if (total <= 0) {
+        ERR("no picture decoded.");
+        return false;
+    }
+
+    if (!BuildVulkanVideoParserIndex(codec, stream_path, &index)) {
+        ERR("failed to index %s.", stream_path);
+        return false;
+    }
+
+    INFO("%u entries, %u frames", GetVulkanVideoParserIndexEntryCount(index),
+        GetVulkanVideoParserIndexFrameCount(index));
+
+    if (GetVulkanVideoParserIndexEntryCount(index) < COPIES) {
+        ERR("%u entries instead of at least %u.", GetVulkanVideoParserIndexEntryCount(index), COPIES);
+        goto bail;
+    }
+    if (GetVulkanVideoParserIndexFrameCount(index) != total) {
+        ERR("%u frames indexed instead of %" G_GINT64_FORMAT ".", GetVulkanVideoParserIndexFrameCount(index), total);
+        goto bail;
+    }
+
+    if (!CreateVulkanVideoParserIndex(codec, &scanned)
+        || !ScanVulkanVideoParserIndex(scanned, stream.data(), stream.size(), -1)
+        || !same_entries(index, scanned)) {
+        ERR("scanning the stream in memory gives another index.");
+        goto bail;
+    }
+
+    if (!SaveVulkanVideoParserIndex(index, index_path)
+        || !LoadVulkanVideoParserIndex(index_path, &loaded)
+        || !same_entries(index, loaded)) {
+        ERR("the index changed after saving and loading it.");
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < GetVulkanVideoParserIndexEntryCount(loaded); i++) {
+        VkParserGstIndexEntry entry;
+        gint64 decoded;
+
+        GetVulkanVideoParserIndexEntry(loaded, i, &entry);
+        if (entry.offset + 3 > stream.size() || memcmp(stream.data() + entry.offset, "\0\0\1", 3) != 0) {
+            ERR("entry %u at %" G_GUINT64_FORMAT " isn't a start code.", i, entry.offset);
+            goto bail;
+        }
+        if (pps_id >= 0 && (entry.ppsId != pps_id || entry.spsId == 0xffff)) {
+            ERR("entry %u refers to PPS %u and SPS %u instead of PPS %d.", i, entry.ppsId, entry.spsId, pps_id);
+            goto bail;
+        }
+
+        decoded = run(stream, loaded, i);
+        if (decoded != total - entry.frame) {
+            ERR("%" G_GINT64_FORMAT " pictures decoded from entry %u instead of %" G_GINT64_FORMAT ".",
+                decoded, i, total - entry.frame);
+            goto bail;
+        }
+    }
+
+    ret = true;
+
+bail:
+    DestroyVulkanVideoParserIndex(loaded);
+    DestroyVulkanVideoParserIndex(scanned);
+    DestroyVulkanVideoParserIndex(index);
+    return ret;
+}
+
+static bool check_stream(const std::vector<guint8>& stream, gint pps_id)
+{
+    GError *err = NULL;
+    gchar *stream_path = NULL, *index_path = NULL;
+    gint fd;
+    bool ret = false;
+
+    fd = g_file_open_tmp ("testindex-XXXXXX.es", &stream_path, &err);
+    if (fd < 0 || !g_file_set_contents (stream_path, (const gchar *) stream.data (), stream.size (), &err)) {
+        ERR ("Unable to write the stream: %s", err->message);
+        g_clear_error (&err);
+    } else {
+        index_path = g_strconcat (stream_path, ".idx", NULL);
+        ret = check_index (stream, stream_path, index_path, pps_id);
+        g_remove (index_path);
+    }
+
+    if (fd >= 0) {
+        g_close (fd, NULL);
+        g_remove (stream_path);
+    }
+
+    g_free (index_path);
+    g_free (stream_path);
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    gint ret = EXIT_SUCCESS;
+    TestArgs args (argc, argv, "TEST", NULL);
+
+    codec = args.codec ();
+
+    std::vector<guint8> stream = concatenate (args.data (), args.size ());
+
+    if (!check_stream (stream, -1))
+        ret = EXIT_FAILURE;
+
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT) {
+        std::vector<guint8> pps_255;
+
+        if (!set_pps_id_255 (stream, pps_255)) {
+            ERR ("The PPS id of the stream isn't 0.");
+            ret = EXIT_FAILURE;
+        } else if (!check_stream (pps_255, 255)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    return ret;
+}
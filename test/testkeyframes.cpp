@@ -0,0 +1,160 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/* Parses a stream made of a few copies of the given one, fully and with
+ * keyframes only, and checks the latter hands exactly the keyframes of the
+ * former to the client, and displays all of them. */
+
+#include <cstring>
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+/* @nal points to the NAL unit header */
+static bool is_keyframe_slice(const guint8* nal)
+{
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
+        guint8 type = (nal[0] >> 1) & 0x3f;
+        return type >= 16 && type <= 23;
+    }
+
+    return (nal[0] & 0x1f) == 5;
+}
+
+/* first_mb_in_slice == 0 or first_slice_segment_in_pic_flag == 1 */
+static bool is_first_slice(const guint8* nal)
+{
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT)
+        return (nal[2] & 0x80) != 0;
+    return (nal[1] & 0x80) != 0;
+}
+
+static guint count_keyframes(const guint8* data, gsize size)
+{
+    guint count = 0;
+
+    for (gsize i = 0; i + 5 < size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (is_keyframe_slice(data + i + 3) && is_first_slice(data + i + 3))
+                count++;
+            i += 2;
+        }
+    }
+
+    return count;
+}
+
+class KeyframesClient : public NullParserClient {
+public:
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        /* the bitstream starts with a start code */
+        if (pic->nBitstreamDataLen > 4 && is_keyframe_slice(pic->pBitstreamData + 3))
+            m_keyframes.push_back(hash_bytes(pic->pBitstreamData, pic->nBitstreamDataLen));
+
+        return NullParserClient::DecodePicture(pic);
+    }
+
+    const std::vector<uint32_t>& keyframes() const { return m_keyframes; }
+
+private:
+    std::vector<uint32_t> m_keyframes;
+};
+
+static bool run(const guint8* data, gsize size, bool framing, bool keyframes_only,
+    std::vector<uint32_t>& keyframes)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    KeyframesClient client;
+    VkParserGstOptions options = {
+        .bDecoderFraming = framing,
+        .bKeyframesOnly = keyframes_only,
+    };
+    bool ret;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, data, size);
+
+    destroy_parser(parser);
+
+    INFO("%-14s: %" G_GUINT64_FORMAT " pictures decoded, %" G_GUINT64_FORMAT " displayed",
+        keyframes_only ? "keyframes only" : "all", client.decoded(), client.displayed());
+
+    if (keyframes_only) {
+        if (client.decoded() != client.keyframes().size()) {
+            ERR("%" G_GUINT64_FORMAT " pictures aren't keyframes",
+                client.decoded() - client.keyframes().size());
+            ret = false;
+        }
+        if (client.displayed() != client.decoded()) {
+            ERR("%" G_GUINT64_FORMAT " keyframes not displayed",
+                client.decoded() - client.displayed());
+            ret = false;
+        }
+    }
+
+    keyframes = client.keyframes();
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gboolean framing = FALSE;
+    gint repeat = 3;
+    std::vector<uint32_t> expected, keyframes;
+    guint count;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "decoder-framing", 'F', 0, G_OPTION_ARG_NONE, &framing, "Drop the parse element, the decoder frames access units", NULL },
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Times the stream is concatenated", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries);
+
+    if (repeat <= 0) {
+        ERR ("Invalid repetitions.");
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    std::vector<guint8> stream = repeat_bytes (args.data (), args.size (), repeat);
+
+    count = count_keyframes (stream.data (), stream.size ());
+
+    if (!run (stream.data (), stream.size (), framing, false, expected)
+        || !run (stream.data (), stream.size (), framing, true, keyframes))
+        ret = EXIT_FAILURE;
+
+    if (ret == EXIT_SUCCESS && (expected.size () != count || keyframes != expected)) {
+        ERR ("%zu keyframes instead of the %zu of the %u in the stream",
+            keyframes.size (), expected.size (), count);
+        ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
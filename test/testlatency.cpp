@@ -0,0 +1,181 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Measures the time from ParseByteStream() to DecodePicture() when each
+ * packet is one access unit. With bEOP set, the picture has to be handed
+ * to the client before ParseByteStream() returns. With -b, each access unit
+ * is split in small packets, followed by an empty one with bEOP set. */
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+#include "gstdemuxeres.h"
+
+class LatencyParserClient : public NullParserClient {
+public:
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        gint64 now = g_get_monotonic_time();
+
+        // one picture per packet
+        if (decoded() < m_pushed.size())
+            m_latencies.push_back(now - m_pushed[decoded()]);
+        if (decoded() + 1 < m_pushed.size())
+            m_late++;
+
+        return NullParserClient::DecodePicture(pic);
+    }
+
+    void Pushed() { m_pushed.push_back(g_get_monotonic_time()); }
+    // pictures decoded while parsing a later packet
+    uint64_t late() const { return m_late; }
+    std::vector<gint64>& latencies() { return m_latencies; }
+
+private:
+    std::vector<gint64> m_pushed;
+    std::vector<gint64> m_latencies;
+    uint64_t m_late = 0;
+};
+
+// packets an access unit is split in with a bare bEOP
+#define BARE_EOP_CHUNK 7
+
+static bool parse_bare_eop(VulkanVideoDecodeParser* parser, const guint8* data, gsize size,
+    bool eos)
+{
+    VkParserBitstreamPacket eop_packet = {
+        .bEOS = eos,
+        .bEOP = true,
+    };
+    int32_t parsed;
+
+    for (gsize offset = 0; offset < size; offset += BARE_EOP_CHUNK) {
+        VkParserBitstreamPacket packet = {
+            .pByteStream = data + offset,
+            .nDataLength = static_cast<int32_t>(MIN(BARE_EOP_CHUNK, size - offset)),
+        };
+
+        if (!parser->ParseByteStream(&packet, &parsed))
+            return false;
+    }
+
+    return parser->ParseByteStream(&eop_packet, &parsed);
+}
+
+static bool run(const gchar* filename, VkVideoCodecOperationFlagBitsKHR codec,
+    const VkParserGstOptions* options, bool eop, bool bare_eop)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    LatencyParserClient client;
+    GstDemuxerES* demuxer;
+    GstDemuxerESPacket* pkt;
+    GstDemuxerESResult result;
+    int32_t parsed;
+    uint64_t packets = 0;
+    bool ret = true;
+
+    demuxer = gst_demuxer_es_new(filename);
+    if (!demuxer) {
+        ERR("Unable to open %s", filename);
+        return false;
+    }
+
+    parser = create_parser(codec, &client, options);
+    if (!parser) {
+        gst_demuxer_es_teardown(demuxer);
+        return false;
+    }
+
+    while ((result = gst_demuxer_es_read_packet(demuxer, &pkt)) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+        VkParserBitstreamPacket packet = {
+            .pByteStream = pkt->data,
+            .nDataLength = static_cast<int32_t>(pkt->data_size),
+            .bEOS = result == DEMUXER_ES_RESULT_LAST_PACKET,
+            .bEOP = eop,
+        };
+
+        client.Pushed();
+        if (bare_eop) {
+            if (!parse_bare_eop(parser, pkt->data, pkt->data_size, packet.bEOS)) {
+                ERR("failed to parse bitstream.");
+                ret = false;
+            }
+        } else if (!parser->ParseByteStream(&packet, &parsed)) {
+            ERR("failed to parse bitstream.");
+            ret = false;
+        }
+        packets++;
+
+        gst_demuxer_es_clear_packet(pkt);
+        if (!ret || result == DEMUXER_ES_RESULT_LAST_PACKET)
+            break;
+    }
+
+    if (result == DEMUXER_ES_RESULT_ERROR) {
+        ERR("Failed to read a packet.");
+        ret = false;
+    }
+
+    destroy_parser(parser);
+    gst_demuxer_es_teardown(demuxer);
+
+    INFO("%-8s: %" G_GUINT64_FORMAT " packets, %" G_GUINT64_FORMAT " pictures, %"
+         G_GUINT64_FORMAT " decoded after a later packet, latency p50 %" G_GINT64_FORMAT
+         " us, p99 %" G_GINT64_FORMAT " us",
+        bare_eop ? "bare eop" : eop ? "eop" : "no eop", packets, client.decoded(), client.late(),
+        percentile(client.latencies(), 0.5), percentile(client.latencies(), 0.99));
+
+    if ((eop || bare_eop) && client.late() > 0) {
+        ERR("%" G_GUINT64_FORMAT " pictures weren't decoded within their packet", client.late());
+        ret = false;
+    }
+
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gboolean direct = FALSE;
+    gboolean no_eop = FALSE;
+    gboolean parse_element = FALSE;
+    gboolean bare_eop = FALSE;
+    VkParserGstOptions options = { };
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "direct", 'd', 0, G_OPTION_ARG_NONE, &direct, "Use the direct backend", NULL },
+        { "no-eop", 'n', 0, G_OPTION_ARG_NONE, &no_eop, "Also measure packets without bEOP", NULL },
+        { "parse-element", 'p', 0, G_OPTION_ARG_NONE, &parse_element, "Frame the access units with the parse element", NULL },
+        { "bare-eop", 'b', 0, G_OPTION_ARG_NONE, &bare_eop, "Also end the access units with an empty bEOP packet", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries, TEST_SAMPLE_FILENAME);
+
+    if (direct)
+      options.eBackend = VK_PARSER_GST_BACKEND_DIRECT;
+    options.bDecoderFraming = !parse_element;
+
+    if (no_eop && !run (args.filename (), args.codec (), &options, false, false))
+        ret = EXIT_FAILURE;
+    if (!run (args.filename (), args.codec (), &options, true, false))
+        ret = EXIT_FAILURE;
+    if (bare_eop && !run (args.filename (), args.codec (), &options, false, true))
+        ret = EXIT_FAILURE;
+
+    return ret;
+}
@@ -0,0 +1,229 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Parses the access units of a stream as length prefixed NAL units, with
+ * the parameter sets in an avcC/hvcC record, and checks the same pictures
+ * are decoded as from the byte-stream. Packets the demuxer already hands
+ * length prefixed are passed through unconverted. */
+
+#include <cstring>
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+#include "gstdemuxeres.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+static void append_be(std::vector<guint8>& out, guint32 value, guint bytes)
+{
+    while (bytes-- > 0)
+        out.push_back((value >> (bytes * 8)) & 0xff);
+}
+
+/* only the fields the parser reads are filled */
+static std::vector<guint8> codec_data(const std::vector<Nal>& sets)
+{
+    std::vector<guint8> out;
+
+    if (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT) {
+        static const guint8 types[] = { 32, 33, 34 };
+
+        out.resize(23);
+        out[0] = 1;
+        out[21] = 0x03; /* lengthSizeMinusOne */
+        out[22] = G_N_ELEMENTS(types);
+        for (guint8 type : types) {
+            guint count = 0;
+            for (const Nal& nal : sets)
+                count += nal_type(codec, nal.data) == type;
+            out.push_back(0x80 | type);
+            append_be(out, count, 2);
+            for (const Nal& nal : sets) {
+                if (nal_type(codec, nal.data) != type)
+                    continue;
+                append_be(out, nal.size, 2);
+                out.insert(out.end(), nal.data, nal.data + nal.size);
+            }
+        }
+    } else {
+        for (guint8 type : { 7, 8 }) {
+            guint count = 0;
+            for (const Nal& nal : sets)
+                count += nal_type(codec, nal.data) == type;
+            if (type == 7) {
+                const Nal& sps = sets[0];
+                out = { 1, sps.data[1], sps.data[2], sps.data[3], 0xff,
+                    static_cast<guint8>(0xe0 | count) };
+            } else {
+                out.push_back(count);
+            }
+            for (const Nal& nal : sets) {
+                if (nal_type(codec, nal.data) != type)
+                    continue;
+                append_be(out, nal.size, 2);
+                out.insert(out.end(), nal.data, nal.data + nal.size);
+            }
+        }
+    }
+
+    return out;
+}
+
+struct Stream {
+    std::vector<std::vector<guint8>> packets;
+    std::vector<guint8> codecData;
+};
+
+static bool read_stream(const gchar* filename, Stream& annexb, Stream& prefixed)
+{
+    GstDemuxerES* demuxer;
+    GstDemuxerEStream* stream;
+    GstDemuxerESPacket* pkt;
+    GstDemuxerESResult result;
+    std::vector<Nal> sets;
+
+    demuxer = gst_demuxer_es_new_full(filename, DEMUXER_ES_FLAG_PACKETIZED);
+    if (!demuxer) {
+        ERR("Unable to open %s", filename);
+        return false;
+    }
+
+    stream = gst_demuxer_es_find_best_stream(demuxer, DEMUXER_ES_STREAM_TYPE_VIDEO);
+    if (!stream) {
+        ERR("No video stream in %s", filename);
+        gst_demuxer_es_teardown(demuxer);
+        return false;
+    }
+
+    while ((result = gst_demuxer_es_read_packet(demuxer, &pkt)) <= DEMUXER_ES_RESULT_LAST_PACKET) {
+        if (pkt->stream_type == DEMUXER_ES_STREAM_TYPE_VIDEO) {
+            if (stream->data.video.packetized) {
+                prefixed.packets.emplace_back(pkt->data, pkt->data + pkt->data_size);
+            } else {
+                std::vector<guint8> converted;
+
+                annexb.packets.emplace_back(pkt->data, pkt->data + pkt->data_size);
+                for (const Nal& nal : split_annexb(pkt->data, pkt->data_size)) {
+                    if (prefixed.packets.empty() && is_parameter_set(codec, nal_type(codec, nal.data)))
+                        sets.push_back(nal);
+                    append_be(converted, nal.size, 4);
+                    converted.insert(converted.end(), nal.data, nal.data + nal.size);
+                }
+                if (prefixed.packets.empty() && !sets.empty())
+                    prefixed.codecData = codec_data(sets);
+                prefixed.packets.push_back(std::move(converted));
+            }
+        }
+
+        gst_demuxer_es_clear_packet(pkt);
+        if (result == DEMUXER_ES_RESULT_LAST_PACKET)
+            break;
+    }
+
+    if (stream->data.video.packetized)
+        prefixed.codecData.assign(stream->data.video.codec_data,
+            stream->data.video.codec_data + stream->data.video.codec_data_size);
+
+    gst_demuxer_es_teardown(demuxer);
+
+    if (result == DEMUXER_ES_RESULT_ERROR) {
+        ERR("Failed to read a packet.");
+        return false;
+    }
+
+    return true;
+}
+
+static bool run(const Stream& stream, VkParserGstStreamFormat format, uint64_t* decoded)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    VkParserSequenceInfo seqInfo = { };
+    VkParserGstOptions options = {
+        .eStreamFormat = format,
+    };
+    gint64 start, elapsed;
+    int32_t parsed;
+    bool ret = true;
+
+    if (stream.codecData.size() > sizeof(seqInfo.SequenceHeaderData)) {
+        ERR("codec data too large");
+        return false;
+    }
+    seqInfo.cbSequenceHeader = stream.codecData.size();
+    memcpy(seqInfo.SequenceHeaderData, stream.codecData.data(), stream.codecData.size());
+
+    parser = create_parser(codec, &client, &options,
+        stream.codecData.empty() ? nullptr : &seqInfo);
+    if (!parser)
+        return false;
+
+    start = g_get_monotonic_time();
+
+    for (size_t i = 0; i < stream.packets.size() && ret; i++) {
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = stream.packets[i].data(),
+            .nDataLength = static_cast<int32_t>(stream.packets[i].size()),
+            .bEOS = i + 1 == stream.packets.size(),
+        };
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            ret = false;
+        }
+    }
+
+    destroy_parser(parser);
+    elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+    INFO("%-15s: %" G_GUINT64_FORMAT " pictures, %.1f us per picture",
+        format == VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED ? "length prefixed" : "byte-stream",
+        client.decoded(), client.decoded() ? (double)elapsed / client.decoded() : 0.0);
+
+    *decoded = client.decoded();
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    Stream annexb, prefixed;
+    uint64_t decoded = 0, expected = 0;
+    gint ret = EXIT_SUCCESS;
+    TestArgs args (argc, argv, "TEST", NULL, TEST_SAMPLE_FILENAME);
+
+    codec = args.codec ();
+
+    if (!read_stream (args.filename (), annexb, prefixed))
+        return EXIT_FAILURE;
+
+    if (!annexb.packets.empty ()
+        && !run (annexb, VK_PARSER_GST_STREAM_FORMAT_BYTE_STREAM, &expected))
+        ret = EXIT_FAILURE;
+    if (!run (prefixed, VK_PARSER_GST_STREAM_FORMAT_LENGTH_PREFIXED, &decoded))
+        ret = EXIT_FAILURE;
+
+    if (!annexb.packets.empty () && decoded != expected) {
+        ERR ("%" G_GUINT64_FORMAT " pictures decoded, expected %" G_GUINT64_FORMAT,
+            decoded, expected);
+        ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
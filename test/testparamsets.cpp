@@ -0,0 +1,134 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/* Parses the stream again with every parameter set sent twice in a row,
+ * and checks the copies are skipped: the same pictures are decoded, the
+ * client gets no extra parameter updates and every copy is counted. */
+
+#include <cstring>
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+static std::vector<guint8> duplicate_parameter_sets(const guint8* data, gsize size, guint64& copies)
+{
+    static const guint8 start_code[] = { 0, 0, 0, 1 };
+    std::vector<guint8> out;
+
+    copies = 0;
+    for (const Nal& nal : split_annexb(data, size)) {
+        guint repeat = is_parameter_set(codec, nal_type(codec, nal.data)) ? 2 : 1;
+
+        for (guint i = 0; i < repeat; i++) {
+            out.insert(out.end(), start_code, start_code + sizeof(start_code));
+            out.insert(out.end(), nal.data, nal.data + nal.size);
+        }
+        copies += repeat - 1;
+    }
+
+    return out;
+}
+
+struct Result {
+    guint64 decoded;
+    guint64 parameters;
+    guint64 skipped;
+};
+
+static bool run(const guint8* data, gsize size, bool framing, Result& result)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    NullParserClient client;
+    VkParserGstOptions options = {
+        .bCollectStats = true,
+        .bDecoderFraming = framing,
+    };
+    VkParserGstStats stats;
+    bool ret;
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, data, size);
+
+    parser->Deinitialize();
+    if (!GetVulkanVideoDecodeParserStats(parser, &stats)) {
+        ERR("no stats collected.");
+        ret = false;
+    }
+    parser->Release();
+
+    result = Result { client.decoded(), client.parameters(), stats.parameterSetsSkipped };
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    gboolean framing = FALSE;
+    guint64 copies;
+    Result expected, result;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "decoder-framing", 'F', 0, G_OPTION_ARG_NONE, &framing, "Drop the parse element, the decoder frames access units", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries);
+
+    codec = args.codec ();
+
+    std::vector<guint8> duplicated = duplicate_parameter_sets (args.data (), args.size (), copies);
+
+    if (copies == 0) {
+        ERR ("no parameter sets in %s", args.filename ());
+        ret = EXIT_FAILURE;
+    } else if (!run (args.data (), args.size (), framing, expected)
+        || !run (duplicated.data (), duplicated.size (), framing, result)) {
+        ret = EXIT_FAILURE;
+    }
+
+    if (ret == EXIT_SUCCESS) {
+        INFO ("%" G_GUINT64_FORMAT " pictures, %" G_GUINT64_FORMAT " parameter updates, %"
+            G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " copies skipped", result.decoded,
+            result.parameters, result.skipped - expected.skipped, copies);
+
+        if (result.decoded != expected.decoded) {
+            ERR ("%" G_GUINT64_FORMAT " pictures decoded instead of %" G_GUINT64_FORMAT,
+                result.decoded, expected.decoded);
+            ret = EXIT_FAILURE;
+        }
+        if (result.parameters != expected.parameters) {
+            ERR ("%" G_GUINT64_FORMAT " parameter updates instead of %" G_GUINT64_FORMAT,
+                result.parameters, expected.parameters);
+            ret = EXIT_FAILURE;
+        }
+        if (result.skipped - expected.skipped != copies) {
+            ERR ("%" G_GUINT64_FORMAT " parameter sets skipped instead of %" G_GUINT64_FORMAT,
+                result.skipped - expected.skipped, copies);
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,173 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Receives the slices by reference and checks, once gathered, they are the
+ * bitstreams the parser copies otherwise, and that none of them was copied
+ * on the way. */
+
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+class SegmentsClient : public NullParserClient {
+public:
+    SegmentsClient(const guint8* input, gsize input_size)
+        : m_input(input)
+        , m_inputSize(input_size)
+    {
+    }
+
+    static void Segments(void* user_data, const VkParserPictureData* pic,
+        const VkParserGstSliceSegment* segments, uint32_t n_segments)
+    {
+        static const uint8_t start_code[] = { 0, 0, 1 };
+        SegmentsClient* self = static_cast<SegmentsClient*>(user_data);
+        uint32_t hash = hash_bytes(nullptr, 0);
+        size_t len = 0;
+
+        if (n_segments != pic->nNumSlices)
+            self->m_mismatches++;
+
+        for (uint32_t i = 0; i < n_segments; i++) {
+            if (pic->pSliceDataOffsets[i] != len)
+                self->m_mismatches++;
+            hash = hash_bytes(start_code, sizeof(start_code), hash);
+            hash = hash_bytes(segments[i].pData, segments[i].nDataLength, hash);
+            len += sizeof(start_code) + segments[i].nDataLength;
+
+            if (segments[i].pData >= self->m_input
+                && segments[i].pData + segments[i].nDataLength <= self->m_input + self->m_inputSize)
+                self->m_inInput++;
+            self->m_segments++;
+        }
+
+        if (len != static_cast<size_t>(pic->nBitstreamDataLen))
+            self->m_mismatches++;
+        self->m_hashes.push_back(hash);
+    }
+
+    bool DecodePicture(VkParserPictureData* pic) override
+    {
+        if (!m_input)
+            m_hashes.push_back(hash_bytes(pic->pBitstreamData, pic->nBitstreamDataLen));
+        else if (pic->pBitstreamData)
+            m_mismatches++;
+
+        return NullParserClient::DecodePicture(pic);
+    }
+
+    const std::vector<uint32_t>& hashes() const { return m_hashes; }
+    uint64_t mismatches() const { return m_mismatches; }
+    uint64_t segments() const { return m_segments; }
+    uint64_t inInput() const { return m_inInput; }
+
+private:
+    const guint8* m_input;
+    gsize m_inputSize;
+    std::vector<uint32_t> m_hashes;
+    uint64_t m_mismatches = 0;
+    uint64_t m_segments = 0;
+    uint64_t m_inInput = 0;
+};
+
+static void release_byte_stream(void* user_data, const uint8_t* data)
+{
+}
+
+/* By reference, the stream is passed without copy in a single packet, so
+ * the decoder frames the access units as sub-buffers of it. */
+static bool run(const guint8* data, gsize size, bool by_reference, std::vector<uint32_t>& hashes)
+{
+    VulkanVideoDecodeParser* parser = nullptr;
+    SegmentsClient client(by_reference ? data : nullptr, size);
+    VkParserGstOptions options = {
+        .bZeroCopyInput = by_reference,
+        .pfnReleaseByteStream = release_byte_stream,
+        .bCollectStats = true,
+        .bDecoderFraming = by_reference,
+    };
+    VkParserGstStats stats;
+    bool ret;
+
+    if (by_reference) {
+        options.pfnSliceSegments = SegmentsClient::Segments;
+        options.pSliceSegmentsUserData = &client;
+    }
+
+    parser = create_parser(codec, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, data, size);
+
+    parser->Deinitialize();
+    if (!GetVulkanVideoDecodeParserStats(parser, &stats)) {
+        ERR("no stats collected.");
+        ret = false;
+    }
+    parser->Release();
+
+    if (!ret)
+        return false;
+
+    INFO("%-12s: %" G_GUINT64_FORMAT " pictures, %" G_GUINT64_FORMAT " bytes copied",
+        by_reference ? "by reference" : "copied", client.decoded(), stats.bytesCopied);
+
+    if (by_reference) {
+        if (client.mismatches() > 0) {
+            ERR("%" G_GUINT64_FORMAT " segments not matching the picture", client.mismatches());
+            ret = false;
+        }
+        if (client.inInput() != client.segments()) {
+            ERR("%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " segments not in the input",
+                client.segments() - client.inInput(), client.segments());
+            ret = false;
+        }
+        if (stats.bytesCopied > 0) {
+            ERR("bitstream copied");
+            ret = false;
+        }
+    }
+
+    hashes = client.hashes();
+    return ret && client.decoded() > 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<uint32_t> expected, hashes;
+    gint ret = EXIT_SUCCESS;
+    TestArgs args (argc, argv, "TEST", NULL);
+
+    codec = args.codec ();
+
+    if (!run (args.data (), args.size (), false, expected)
+        || !run (args.data (), args.size (), true, hashes))
+        ret = EXIT_FAILURE;
+
+    if (ret == EXIT_SUCCESS && hashes != expected) {
+        ERR ("gathered segments differ from the copied bitstreams");
+        ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
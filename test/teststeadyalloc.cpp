@@ -0,0 +1,229 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Feeds a stream repeated a few times, one access unit per packet, and
+ * fails if the decoder elements allocate heap memory once the first GOPs,
+ * which fill the DPB and the pools, are parsed. Both the default
+ * configuration, h264parse/h265parse driven by GstHarness, and the direct
+ * backend with the decoder framing the stream are covered. The allocations
+ * done by GstVideoDecoder are reported, not checked: it allocates a frame
+ * per input buffer. The parser library and the parse elements wrapping the
+ * packets aren't accounted. */
+
+#include <vector>
+
+#include <glib.h>
+
+#include "alloccounter.h"
+#include "benchutils.h"
+#include "NullParserClient.h"
+
+static VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_EXT;
+
+// where GstVideoDecoder is
+#define VIDEO_MODULE "libgstvideo-1.0"
+
+enum {
+    MODULE_ELEMENTS,
+    MODULE_VIDEO,
+};
+
+static bool is_aud(guint type)
+{
+    return codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? type == 35 : type == 9;
+}
+
+static bool is_keyframe(guint type)
+{
+    return codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? type >= 16 && type <= 23 : type == 5;
+}
+
+static void release_byte_stream(void* user_data, const uint8_t* data)
+{
+}
+
+struct Unit {
+    gsize offset;
+    gsize size;
+    bool keyframe;
+};
+
+static gint run(const guint8* data, gsize size, guint repeat, guint warmup, bool direct,
+    const gchar* module)
+{
+    static const guint8 start_code[] = { 0, 0, 0, 1 };
+    VulkanVideoDecodeParser* parser;
+    NullParserClient client;
+    VkParserGstOptions options = {
+        .bZeroCopyInput = true,
+        .pfnReleaseByteStream = release_byte_stream,
+        .eBackend = VK_PARSER_GST_BACKEND_DIRECT,
+        .bDecoderFraming = true,
+    };
+    std::vector<Nal> nals = split_annexb(data, size);
+    std::vector<Unit> units;
+    GByteArray* stream;
+    uint64_t total = 0, in_module = 0, in_video = 0, warmup_in_module = 0, decoded = 0;
+    gsize first_checked = G_MAXSIZE;
+    guint gops = 0;
+    int32_t parsed;
+    bool ret = true;
+
+    // the parameter sets are only sent once: updating them isn't part of
+    // the per-picture path
+    stream = g_byte_array_new();
+    for (guint r = 0; r < repeat; r++) {
+        for (const Nal& nal : nals) {
+            guint type = nal_type(codec, nal.data);
+
+            if (r > 0 && is_parameter_set(codec, type))
+                continue;
+            if (is_aud(type) || units.empty())
+                units.push_back({ stream->len, 0, false });
+            if (is_keyframe(type) && !units.back().keyframe) {
+                units.back().keyframe = true;
+                // the first access unit of the GOPs after the warm up
+                if (gops++ == warmup)
+                    first_checked = units.size() - 1;
+            }
+            g_byte_array_append(stream, start_code, sizeof(start_code));
+            g_byte_array_append(stream, nal.data, nal.size);
+            units.back().size = stream->len - units.back().offset;
+        }
+    }
+
+    if (first_checked == G_MAXSIZE) {
+        ERR("only %u GOPs in the stream", gops);
+        g_byte_array_unref(stream);
+        return EXIT_FAILURE;
+    }
+
+    parser = create_parser(codec, &client, direct ? &options : nullptr);
+    if (!parser) {
+        g_byte_array_unref(stream);
+        return EXIT_FAILURE;
+    }
+
+    for (gsize i = 0; i < units.size(); i++) {
+        VkParserBitstreamPacket pkt = {
+            .pByteStream = stream->data + units[i].offset,
+            .nDataLength = static_cast<int32_t>(units[i].size),
+            .bEOP = true,
+        };
+
+        if (i == first_checked) {
+            warmup_in_module = alloc_counter_get_module(MODULE_ELEMENTS);
+            total = alloc_counter_get();
+            in_module = warmup_in_module;
+            in_video = alloc_counter_get_module(MODULE_VIDEO);
+            decoded = client.decoded();
+        }
+
+        if (!parser->ParseByteStream(&pkt, &parsed)) {
+            ERR("failed to parse bitstream.");
+            ret = false;
+            break;
+        }
+    }
+
+    total = alloc_counter_get() - total;
+    in_module = alloc_counter_get_module(MODULE_ELEMENTS) - in_module;
+    in_video = alloc_counter_get_module(MODULE_VIDEO) - in_video;
+    decoded = client.decoded() - decoded;
+
+    {
+        VkParserBitstreamPacket eos = {
+            .bEOS = true,
+        };
+
+        if (!parser->ParseByteStream(&eos, &parsed))
+            ret = false;
+    }
+
+    destroy_parser(parser);
+    g_byte_array_unref(stream);
+
+    if (!ret)
+        return EXIT_FAILURE;
+
+    // e.g. the elements are linked in the parser library
+    if (warmup_in_module == 0) {
+        INFO("No allocation seen in %s, is it loaded?", module);
+        return EXIT_SKIP;
+    }
+
+    if (decoded == 0) {
+        ERR("no picture decoded after the warm up");
+        return EXIT_FAILURE;
+    }
+
+    INFO("%s %s: %" G_GUINT64_FORMAT " pictures after %u GOPs, %.2f allocations per "
+         "picture, %.2f in GstVideoDecoder, %" G_GUINT64_FORMAT " in %s",
+        codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT ? "h265" : "h264",
+        direct ? "direct" : "default", decoded, warmup, (double)total / decoded,
+        (double)in_video / decoded, in_module, module);
+
+    if (in_module > 0) {
+        ERR("%" G_GUINT64_FORMAT " allocations in steady state", in_module);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    gchar *module = NULL;
+    gint repeat = 4;
+    gint warmup = 1;
+    gboolean direct = FALSE;
+    gint ret;
+
+    const GOptionEntry entries[] = {
+        { "module", 'm', 0, G_OPTION_ARG_STRING, &module, "Shared object whose allocations are checked", NULL },
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Times the stream is concatenated", NULL },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup, "GOPs parsed before checking", NULL },
+        { "direct", 'd', 0, G_OPTION_ARG_NONE, &direct, "Direct backend, with the decoder framing the stream", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries);
+
+    if (warmup <= 0 || repeat <= 0) {
+        ERR ("Invalid repetitions or warm up.");
+        g_free (module);
+        return EXIT_FAILURE;
+    }
+
+    codec = args.codec ();
+
+    if (!module)
+        module = g_strdup ("libgstvkparser");
+
+    // in this order: MODULE_ELEMENTS, MODULE_VIDEO
+    if (!alloc_counter_supported () || !alloc_counter_track_module (module)
+        || !alloc_counter_track_module (VIDEO_MODULE)) {
+        INFO ("Heap allocations can't be counted on this platform");
+        g_free (module);
+        return EXIT_SKIP;
+    }
+
+    ret = run (args.data (), args.size (), repeat, warmup, direct, module);
+
+    g_free (module);
+
+    return ret;
+}
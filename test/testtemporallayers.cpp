@@ -0,0 +1,514 @@
+/* VideoParser
+ * Copyright (C) 2022 Igalia, S.L.
+ *     Author: Víctor Jáquez <vjaquez@igalia.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You
+ * may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.  See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Parses a hand-assembled H.265 stream with three temporal sub-layers, a
+ * dyadic hierarchy of GOPs of four pictures, keeping every number of
+ * sub-layers. It checks that no picture of a dropped sub-layer is
+ * allocated or decoded, that the reference picture sets of the kept ones
+ * point to the expected, already decoded, pictures, and that keeping them
+ * all (0) decodes and displays the whole stream. */
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <glib.h>
+
+#include "benchutils.h"
+#include "VideoParserClient.h"
+
+#define NUM_SUB_LAYERS 3
+#define GOP_SIZE 4
+#define LOG2_MAX_POC_LSB 8
+
+enum {
+    NAL_TRAIL_N = 0,
+    NAL_TRAIL_R = 1,
+    NAL_IDR_W_RADL = 19,
+    NAL_VPS = 32,
+    NAL_SPS = 33,
+    NAL_PPS = 34,
+};
+
+enum {
+    SLICE_B = 0,
+    SLICE_P = 1,
+    SLICE_I = 2,
+};
+
+struct Ref {
+    gint poc;
+    bool used;
+};
+
+struct TestPicture {
+    gint poc;
+    guint temporal_id;
+    guint nal_type;
+    guint slice_type;
+    // short term reference picture set: closest first
+    std::vector<Ref> before;
+    std::vector<Ref> after;
+};
+
+class BitWriter {
+public:
+    void put(guint32 value, guint bits)
+    {
+        while (bits-- > 0) {
+            if (m_bit == 0)
+                m_data.push_back(0);
+            m_data.back() |= ((value >> bits) & 1) << (7 - m_bit);
+            m_bit = (m_bit + 1) % 8;
+        }
+    }
+
+    void ue(guint32 value)
+    {
+        guint len = g_bit_storage(value + 1) - 1;
+
+        put(0, len);
+        put(value + 1, len + 1);
+    }
+
+    void se(gint32 value)
+    {
+        ue(value > 0 ? 2 * value - 1 : -2 * value);
+    }
+
+    // rbsp_trailing_bits() and byte_alignment() alike
+    void align()
+    {
+        put(1, 1);
+        while (m_bit != 0)
+            put(0, 1);
+    }
+
+    const std::vector<guint8>& data() const { return m_data; }
+
+private:
+    std::vector<guint8> m_data;
+    guint m_bit = 0;
+};
+
+static void append_nal(std::vector<guint8>& stream, guint type, guint temporal_id,
+    const BitWriter& rbsp)
+{
+    guint zeros = 0;
+
+    stream.insert(stream.end(), { 0, 0, 0, 1 });
+    stream.push_back(type << 1);
+    stream.push_back(temporal_id + 1);
+
+    for (guint8 byte : rbsp.data()) {
+        if (zeros >= 2 && byte <= 3) {
+            stream.push_back(3);
+            zeros = 0;
+        }
+        stream.push_back(byte);
+        zeros = byte == 0 ? zeros + 1 : 0;
+    }
+}
+
+// Main profile, level 1, no sub-layer profile nor level
+static void write_profile_tier_level(BitWriter& bw)
+{
+    bw.put(0, 2); // general_profile_space
+    bw.put(0, 1); // general_tier_flag
+    bw.put(1, 5); // general_profile_idc
+    bw.put(0x60000000, 32); // general_profile_compatibility_flag[1, 2]
+    bw.put(1, 1); // general_progressive_source_flag
+    bw.put(0, 1); // general_interlaced_source_flag
+    bw.put(0, 1); // general_non_packed_constraint_flag
+    bw.put(1, 1); // general_frame_only_constraint_flag
+    bw.put(0, 32); // general_reserved_zero_43bits and general_inbld_flag
+    bw.put(0, 12);
+    bw.put(30, 8); // general_level_idc
+    for (guint i = 0; i < NUM_SUB_LAYERS - 1; i++) {
+        bw.put(0, 1); // sub_layer_profile_present_flag
+        bw.put(0, 1); // sub_layer_level_present_flag
+    }
+    for (guint i = NUM_SUB_LAYERS - 1; i < 8; i++)
+        bw.put(0, 2); // reserved_zero_2bits
+}
+
+static void write_sub_layer_ordering_info(BitWriter& bw)
+{
+    bw.put(0, 1); // sub_layer_ordering_info_present_flag
+    bw.ue(4); // max_dec_pic_buffering_minus1
+    bw.ue(2); // max_num_reorder_pics
+    bw.ue(0); // max_latency_increase_plus1
+}
+
+static void write_parameter_sets(std::vector<guint8>& stream)
+{
+    BitWriter vps, sps, pps;
+
+    vps.put(0, 4); // vps_video_parameter_set_id
+    vps.put(1, 1); // vps_base_layer_internal_flag
+    vps.put(1, 1); // vps_base_layer_available_flag
+    vps.put(0, 6); // vps_max_layers_minus1
+    vps.put(NUM_SUB_LAYERS - 1, 3); // vps_max_sub_layers_minus1
+    vps.put(0, 1); // vps_temporal_id_nesting_flag
+    vps.put(0xffff, 16); // vps_reserved_0xffff_16bits
+    write_profile_tier_level(vps);
+    write_sub_layer_ordering_info(vps);
+    vps.put(0, 6); // vps_max_layer_id
+    vps.ue(0); // vps_num_layer_sets_minus1
+    vps.put(0, 1); // vps_timing_info_present_flag
+    vps.put(0, 1); // vps_extension_flag
+    vps.align();
+    append_nal(stream, NAL_VPS, 0, vps);
+
+    sps.put(0, 4); // sps_video_parameter_set_id
+    sps.put(NUM_SUB_LAYERS - 1, 3); // sps_max_sub_layers_minus1
+    sps.put(0, 1); // sps_temporal_id_nesting_flag
+    write_profile_tier_level(sps);
+    sps.ue(0); // sps_seq_parameter_set_id
+    sps.ue(1); // chroma_format_idc
+    sps.ue(64); // pic_width_in_luma_samples
+    sps.ue(64); // pic_height_in_luma_samples
+    sps.put(0, 1); // conformance_window_flag
+    sps.ue(0); // bit_depth_luma_minus8
+    sps.ue(0); // bit_depth_chroma_minus8
+    sps.ue(LOG2_MAX_POC_LSB - 4); // log2_max_pic_order_cnt_lsb_minus4
+    write_sub_layer_ordering_info(sps);
+    sps.ue(0); // log2_min_luma_coding_block_size_minus3
+    sps.ue(1); // log2_diff_max_min_luma_coding_block_size
+    sps.ue(0); // log2_min_luma_transform_block_size_minus2
+    sps.ue(2); // log2_diff_max_min_luma_transform_block_size
+    sps.ue(0); // max_transform_hierarchy_depth_inter
+    sps.ue(0); // max_transform_hierarchy_depth_intra
+    sps.put(0, 1); // scaling_list_enabled_flag
+    sps.put(0, 1); // amp_enabled_flag
+    sps.put(0, 1); // sample_adaptive_offset_enabled_flag
+    sps.put(0, 1); // pcm_enabled_flag
+    sps.ue(0); // num_short_term_ref_pic_sets
+    sps.put(0, 1); // long_term_ref_pics_present_flag
+    sps.put(0, 1); // sps_temporal_mvp_enabled_flag
+    sps.put(0, 1); // strong_intra_smoothing_enabled_flag
+    sps.put(0, 1); // vui_parameters_present_flag
+    sps.put(0, 1); // sps_extension_present_flag
+    sps.align();
+    append_nal(stream, NAL_SPS, 0, sps);
+
+    pps.ue(0); // pps_pic_parameter_set_id
+    pps.ue(0); // pps_seq_parameter_set_id
+    pps.put(0, 1); // dependent_slice_segments_enabled_flag
+    pps.put(0, 1); // output_flag_present_flag
+    pps.put(0, 3); // num_extra_slice_header_bits
+    pps.put(0, 1); // sign_data_hiding_enabled_flag
+    pps.put(0, 1); // cabac_init_present_flag
+    pps.ue(0); // num_ref_idx_l0_default_active_minus1
+    pps.ue(0); // num_ref_idx_l1_default_active_minus1
+    pps.se(0); // init_qp_minus26
+    pps.put(0, 1); // constrained_intra_pred_flag
+    pps.put(0, 1); // transform_skip_enabled_flag
+    pps.put(0, 1); // cu_qp_delta_enabled_flag
+    pps.se(0); // pps_cb_qp_offset
+    pps.se(0); // pps_cr_qp_offset
+    pps.put(0, 1); // pps_slice_chroma_qp_offsets_present_flag
+    pps.put(0, 1); // weighted_pred_flag
+    pps.put(0, 1); // weighted_bipred_flag
+    pps.put(0, 1); // transquant_bypass_enabled_flag
+    pps.put(0, 1); // tiles_enabled_flag
+    pps.put(0, 1); // entropy_coding_sync_enabled_flag
+    pps.put(0, 1); // pps_loop_filter_across_slices_enabled_flag
+    pps.put(0, 1); // deblocking_filter_control_present_flag
+    pps.put(0, 1); // pps_scaling_list_data_present_flag
+    pps.put(0, 1); // lists_modification_present_flag
+    pps.ue(0); // log2_parallel_merge_level_minus2
+    pps.put(0, 1); // slice_segment_header_extension_present_flag
+    pps.put(0, 1); // pps_extension_present_flag
+    pps.align();
+    append_nal(stream, NAL_PPS, 0, pps);
+}
+
+// One slice segment per picture, followed by a few bytes standing for the
+// slice data, which isn't parsed.
+static void write_picture(std::vector<guint8>& stream, const TestPicture& pic)
+{
+    BitWriter slice;
+    gint prev;
+
+    slice.put(1, 1); // first_slice_segment_in_pic_flag
+    if (pic.nal_type == NAL_IDR_W_RADL)
+        slice.put(0, 1); // no_output_of_prior_pics_flag
+    slice.ue(0); // slice_pic_parameter_set_id
+    slice.ue(pic.slice_type);
+
+    if (pic.nal_type != NAL_IDR_W_RADL) {
+        slice.put(pic.poc % (1 << LOG2_MAX_POC_LSB), LOG2_MAX_POC_LSB); // slice_pic_order_cnt_lsb
+        slice.put(0, 1); // short_term_ref_pic_set_sps_flag
+        slice.ue(pic.before.size()); // num_negative_pics
+        slice.ue(pic.after.size()); // num_positive_pics
+        prev = pic.poc;
+        for (const Ref& ref : pic.before) {
+            slice.ue(prev - ref.poc - 1); // delta_poc_s0_minus1
+            slice.put(ref.used, 1); // used_by_curr_pic_s0_flag
+            prev = ref.poc;
+        }
+        prev = pic.poc;
+        for (const Ref& ref : pic.after) {
+            slice.ue(ref.poc - prev - 1); // delta_poc_s1_minus1
+            slice.put(ref.used, 1); // used_by_curr_pic_s1_flag
+            prev = ref.poc;
+        }
+    }
+
+    if (pic.slice_type != SLICE_I) {
+        slice.put(1, 1); // num_ref_idx_active_override_flag
+        slice.ue(0); // num_ref_idx_l0_active_minus1
+        if (pic.slice_type == SLICE_B) {
+            slice.ue(0); // num_ref_idx_l1_active_minus1
+            slice.put(0, 1); // mvd_l1_zero_flag
+        }
+        slice.ue(0); // five_minus_max_num_merge_cand
+    }
+
+    slice.se(0); // slice_qp_delta
+    slice.align();
+    for (guint i = 0; i < 4; i++)
+        slice.put(0xa5, 8);
+
+    append_nal(stream, pic.nal_type, pic.temporal_id, slice);
+}
+
+// In decoding order: an IDR, then per GOP the picture of sub-layer 0
+// predicted from the previous one, the one of sub-layer 1 in the middle,
+// and the two non-reference ones of sub-layer 2 between them.
+static std::vector<TestPicture> create_pictures(guint gops)
+{
+    std::vector<TestPicture> pictures;
+
+    pictures.push_back({ 0, 0, NAL_IDR_W_RADL, SLICE_I, {}, {} });
+
+    for (guint g = 0; g < gops; g++) {
+        gint base = g * GOP_SIZE;
+
+        pictures.push_back({ base + 4, 0, NAL_TRAIL_R, SLICE_P,
+            { { base, true } }, {} });
+        pictures.push_back({ base + 2, 1, NAL_TRAIL_R, SLICE_B,
+            { { base, true } }, { { base + 4, true } } });
+        pictures.push_back({ base + 1, 2, NAL_TRAIL_N, SLICE_B,
+            { { base, true } }, { { base + 2, true }, { base + 4, false } } });
+        pictures.push_back({ base + 3, 2, NAL_TRAIL_N, SLICE_B,
+            { { base + 2, true } }, { { base + 4, true } } });
+    }
+
+    return pictures;
+}
+
+class TemporalLayersClient : public VkParserVideoDecodeClient {
+public:
+    TemporalLayersClient(const std::vector<TestPicture>& pictures, guint layers)
+        : m_dpb(32)
+        , m_layers(layers)
+    {
+        for (const TestPicture& pic : pictures)
+            m_pictures[pic.poc] = &pic;
+    }
+
+    int32_t BeginSequence(const VkParserSequenceInfo* info) final
+    {
+        return 17;
+    }
+
+    bool AllocPictureBuffer(VkPicIf** pic) final
+    {
+        m_allocated++;
+        for (auto& apic : m_dpb) {
+            if (apic.isAvailable()) {
+                apic.AddRef();
+                *pic = &apic;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool DecodePicture(VkParserPictureData* pic) final
+    {
+        const VkParserHevcPictureData& hevc = pic->CodecSpecific.hevc;
+        gint poc = hevc.CurrPicOrderCntVal;
+        auto it = m_pictures.find(poc);
+
+        m_decoded++;
+
+        if (it == m_pictures.end()) {
+            ERR("unknown picture with POC %d", poc);
+            m_errors++;
+            return true;
+        }
+        if (m_layers > 0 && it->second->temporal_id >= m_layers) {
+            ERR("picture %d of the dropped sub-layer %u decoded", poc, it->second->temporal_id);
+            m_errors++;
+        }
+        if (!m_done.insert(poc).second) {
+            ERR("picture %d decoded twice", poc);
+            m_errors++;
+        }
+
+        check_refs(hevc, it->second->before, hevc.NumPocStCurrBefore, hevc.RefPicSetStCurrBefore, "before");
+        check_refs(hevc, it->second->after, hevc.NumPocStCurrAfter, hevc.RefPicSetStCurrAfter, "after");
+        if (hevc.NumPocLtCurr != 0) {
+            ERR("picture %d has %d long term references", poc, hevc.NumPocLtCurr);
+            m_errors++;
+        }
+
+        return true;
+    }
+
+    bool UpdatePictureParameters(VkPictureParameters* params, VkSharedBaseObj<VkParserVideoRefCountBase>& shared, uint64_t count) final
+    {
+        shared = PictureParameterSet::create();
+        return true;
+    }
+
+    bool DisplayPicture(VkPicIf* pic, int64_t ts) final
+    {
+        m_displayed++;
+        return true;
+    }
+
+    void UnhandledNALU(const uint8_t*, int32_t) final
+    {
+    }
+
+    guint allocated() const { return m_allocated; }
+    guint decoded() const { return m_decoded; }
+    guint displayed() const { return m_displayed; }
+    guint errors() const { return m_errors; }
+
+private:
+    void check_refs(const VkParserHevcPictureData& hevc, const std::vector<Ref>& refs,
+        gint num, const int8_t* indices, const char* kind)
+    {
+        gint poc = hevc.CurrPicOrderCntVal;
+        gint i = 0;
+
+        for (const Ref& ref : refs) {
+            gint idx;
+
+            if (!ref.used)
+                continue;
+
+            idx = i < num && i < 8 ? indices[i] : -1;
+            if (idx < 0 || idx >= 16 || !hevc.RefPics[idx] || hevc.PicOrderCntVal[idx] != ref.poc) {
+                ERR("picture %d: reference %s %d is %d instead of %d", poc, kind, i,
+                    idx >= 0 && idx < 16 ? hevc.PicOrderCntVal[idx] : -1, ref.poc);
+                m_errors++;
+            } else if (m_done.count(ref.poc) == 0) {
+                ERR("picture %d: reference %d not decoded yet", poc, ref.poc);
+                m_errors++;
+            }
+            i++;
+        }
+
+        if (i != num) {
+            ERR("picture %d: %d references %s instead of %d", poc, num, kind, i);
+            m_errors++;
+        }
+    }
+
+    std::vector<Picture> m_dpb;
+    std::map<gint, const TestPicture*> m_pictures;
+    std::set<gint> m_done;
+    guint m_layers;
+    guint m_allocated = 0;
+    guint m_decoded = 0;
+    guint m_displayed = 0;
+    guint m_errors = 0;
+};
+
+static bool run(const std::vector<guint8>& stream, const std::vector<TestPicture>& pictures,
+    bool framing, guint layers)
+{
+    VulkanVideoDecodeParser* parser;
+    TemporalLayersClient client(pictures, layers);
+    VkParserGstOptions options = {
+        .bDecoderFraming = framing,
+        .nTemporalLayers = layers,
+    };
+    guint expected = 0;
+    bool ret;
+
+    for (const TestPicture& pic : pictures) {
+        if (layers == 0 || pic.temporal_id < layers)
+            expected++;
+    }
+
+    parser = create_parser(VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_EXT, &client, &options);
+    if (!parser)
+        return false;
+
+    ret = parse_bytes(parser, stream.data(), stream.size());
+
+    destroy_parser(parser);
+
+    INFO("%u sub-layers: %u pictures allocated, %u decoded, %u displayed, %u expected",
+        layers, client.allocated(), client.decoded(), client.displayed(), expected);
+
+    if (client.errors() > 0)
+        ret = false;
+    if (client.allocated() != expected || client.decoded() != expected) {
+        ERR("%u pictures allocated and %u decoded instead of %u", client.allocated(),
+            client.decoded(), expected);
+        ret = false;
+    }
+    if (client.displayed() != expected) {
+        ERR("%u pictures displayed instead of %u", client.displayed(), expected);
+        ret = false;
+    }
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    gboolean framing = FALSE;
+    gint gops = 4;
+    std::vector<guint8> stream;
+    gint ret = EXIT_SUCCESS;
+
+    const GOptionEntry entries[] = {
+        { "decoder-framing", 'F', 0, G_OPTION_ARG_NONE, &framing, "Drop the parse element, the decoder frames access units", NULL },
+        { "gops", 'g', 0, G_OPTION_ARG_INT, &gops, "GOPs in the stream", NULL },
+        { NULL }
+    };
+    TestArgs args (argc, argv, "TEST", entries, TEST_SAMPLE_NONE);
+
+    // the POCs must fit in slice_pic_order_cnt_lsb
+    if (gops <= 0 || gops * GOP_SIZE >= (1 << LOG2_MAX_POC_LSB)) {
+        ERR ("Invalid number of GOPs.");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TestPicture> pictures = create_pictures (gops);
+
+    write_parameter_sets (stream);
+    for (const TestPicture& pic : pictures)
+        write_picture (stream, pic);
+
+    for (guint layers = 0; layers <= NUM_SUB_LAYERS; layers++) {
+        if (!run (stream, pictures, framing, layers))
+            ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}